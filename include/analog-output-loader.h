@@ -0,0 +1,292 @@
+/*! \file analog-output-loader.h
+ *
+ * Header for the AnalogOutputLoader class, which reads analog output
+ * signals from HDF5 files on a worker thread.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_ANALOG_OUTPUT_LOADER_H
+#define MEACTL_ANALOG_OUTPUT_LOADER_H
+
+#include "stimulus-validator.h"
+#include "waveform-view.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+
+#include <functional>
+#include <memory>
+
+/*! \class AnalogOutputLoader
+ *
+ * The AnalogOutputLoader reads the `analog-output` dataset of an HDF5
+ * file away from the GUI thread. The dataset has either one dimension,
+ * holding a single channel, or two shaped (channels, samples), whose
+ * channels are interleaved into frames as they are read. Stimulus files
+ * may be hundreds of megabytes, so the dataset is read in chunks of
+ * ChunkSize samples, reporting progress after each one. A load may be
+ * canceled between chunks, and starting a new load cancels the previous
+ * one.
+ *
+ * If the dataset is stored contiguously in the file as uncompressed,
+ * little-endian doubles, it is not read at all. The file is instead mapped
+ * into memory, and the signal read through a WaveformView straight from
+ * the page cache. Other datasets are read through the HDF5 library.
+ *
+ * Each signal is checked, and if need be resampled or clipped, by the
+ * StimulusValidator with the options set by setOptions(). This is done
+ * on the worker thread too, as is hashing the signal, so that it can be
+ * cached and compared with the signal the server holds. The sample rate
+ * of the signal is read from the `sample-rate` attribute of the dataset,
+ * if it has one.
+ *
+ * The HDF5 library is not built to be used from several threads at once,
+ * so reads made through any loader are serialized.
+ */
+class AnalogOutputLoader : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Number of samples read from the file at a time. */
+		static const int ChunkSize = 1 << 20;
+
+		/*! Largest number of channels in a signal. */
+		static const int MaxChannels = 64;
+
+		/*! The shape of a signal. */
+		struct Shape {
+
+			/*! Number of channels. */
+			int channels;
+
+			/*! Number of frames, the length of each channel. */
+			qint64 frames;
+
+			/*! Sample rate in Hz, or 0 if not known. */
+			double sampleRate;
+		};
+
+		/*! Function called with the number of samples read so far and
+		 * the total, returning false to cancel the read.
+		 */
+		using ProgressFunction = std::function<bool(qint64 read, qint64 total)>;
+
+		/*! Construct an AnalogOutputLoader. */
+		AnalogOutputLoader(QObject* parent = nullptr);
+
+		/*! Destroy an AnalogOutputLoader, canceling any load and
+		 * waiting for the worker to stop.
+		 */
+		~AnalogOutputLoader();
+
+		/* Copying is not allowed. */
+		AnalogOutputLoader(const AnalogOutputLoader&) = delete;
+		AnalogOutputLoader(AnalogOutputLoader&&) = delete;
+		AnalogOutputLoader& operator=(const AnalogOutputLoader&) = delete;
+
+		/*! Read an analog output signal from the `analog-output` dataset
+		 * of an HDF5 file, on the calling thread.
+		 *
+		 * \param file The name of the file.
+		 * \param progress Function called after each chunk is read.
+		 * \return The signal, or an empty signal if the read was canceled.
+		 * \throws std::invalid_argument if the file is not valid.
+		 */
+		static WaveformView read(const QString& file,
+				ProgressFunction progress = nullptr);
+
+		/*! Map the `analog-output` dataset of an HDF5 file into memory,
+		 * if it is a single channel stored contiguously as uncompressed
+		 * little-endian doubles.
+		 *
+		 * \param file The name of the file.
+		 * \return A view of the dataset, or a null view if it cannot be
+		 * 	mapped and must be read with read().
+		 * \throws std::invalid_argument if the file is not valid.
+		 */
+		static WaveformView map(const QString& file);
+
+		/*! Return the shape of the `analog-output` dataset of an HDF5
+		 * file.
+		 *
+		 * \throws std::invalid_argument if the file is not valid.
+		 */
+		static Shape shape(const QString& file);
+
+		/*! \class Reader
+		 *
+		 * A Reader holds the `analog-output` dataset of an HDF5 file
+		 * open, so that it can be read a few frames at a time without
+		 * opening the file and dataset again for each read. A Reader may
+		 * be used from any thread, though only one at a time.
+		 */
+		class Reader {
+
+			public:
+
+				/*! Open the `analog-output` dataset of an HDF5 file.
+				 *
+				 * \throws std::invalid_argument if the file is not valid.
+				 */
+				explicit Reader(const QString& file);
+
+				/*! Close the dataset and the file. */
+				~Reader();
+
+				/* Copying is not allowed. */
+				Reader(const Reader&) = delete;
+				Reader(Reader&&) = delete;
+				Reader& operator=(const Reader&) = delete;
+
+				/*! Return the shape of the dataset. */
+				Shape shape() const;
+
+				/*! Read some frames of the dataset.
+				 *
+				 * \param offset The index of the first frame to read.
+				 * \param count The number of frames to read. Fewer are
+				 * 	read if the dataset ends first.
+				 * \return The samples, interleaved, or an empty signal if
+				 * 	the offset is past the end of the dataset.
+				 * \throws std::invalid_argument if the frames cannot be
+				 * 	read.
+				 */
+				QVector<double> read(qint64 offset, qint64 count);
+
+			private:
+
+				/*! The open file and dataset. */
+				struct Handle;
+				std::unique_ptr<Handle> handle;
+
+				/*! Shape of the dataset. */
+				Shape dims;
+
+				/*! Scratch space for reading channels side by side. */
+				QVector<double> planar;
+		};
+
+		/*! Return true while a file is being loaded. */
+		bool isLoading() const;
+
+		/*! Return the file being loaded, or last loaded. */
+		QString file() const;
+
+		/*! Return the options used to check signals. */
+		StimulusValidator::Options options() const;
+
+		/*! Set the options used to check signals loaded from now on. */
+		void setOptions(const StimulusValidator::Options& options);
+
+	public slots:
+
+		/*! Start loading a file on a worker thread, canceling any
+		 * file already being loaded. The result is reported by
+		 * loaded() or failed().
+		 *
+		 * \param file The name of the file.
+		 */
+		void load(const QString& file);
+
+		/*! Start checking a signal already in memory on a worker thread,
+		 * as if it were loaded from a file, canceling any file already
+		 * being loaded.
+		 *
+		 * \param name The name reported in place of a file.
+		 * \param signal The signal.
+		 * \param hash The hash of the signal, or an empty array if not
+		 * 	known.
+		 */
+		void load(const QString& name, const WaveformView& signal,
+				const QByteArray& hash);
+
+		/*! Cancel loading the current file, if any. */
+		void cancel();
+
+	signals:
+
+		/*! Emitted as the file is read.
+		 *
+		 * \param read The number of samples read so far.
+		 * \param total The number of samples in the file.
+		 */
+		void progress(qint64 read, qint64 total);
+
+		/*! Emitted when a signal has been checked, just before it is
+		 * reported by loaded(), or failed() if it cannot be sent.
+		 *
+		 * \param file The name of the file.
+		 * \param summary The summary of the signal to be sent.
+		 */
+		void validated(const QString& file, const StimulusValidator::Summary& summary);
+
+		/*! Emitted when a file has been loaded.
+		 *
+		 * \param file The name of the file.
+		 * \param aout The signal read or mapped from the file, as
+		 * 	changed by the StimulusValidator.
+		 * \param hash The hash of the signal, see StimulusCache::hash().
+		 */
+		void loaded(const QString& file, const WaveformView& aout,
+				const QByteArray& hash);
+
+		/*! Emitted when a file could not be loaded.
+		 *
+		 * \param file The name of the file.
+		 * \param msg Describes the error.
+		 */
+		void failed(const QString& file, const QString& msg);
+
+		/*! Emitted when loading a file is canceled.
+		 *
+		 * \param file The name of the file.
+		 */
+		void canceled(const QString& file);
+
+	private:
+
+		/*! The outcome of loading a file on the worker thread. */
+		struct Result {
+			WaveformView data;
+			QByteArray hash;
+			StimulusValidator::Summary summary;
+			QString error;
+		};
+
+		/* Check a signal, and hash the one to send. The hash given is
+		 * kept if the signal is not changed.
+		 */
+		static Result check(const WaveformView& signal, const QByteArray& hash,
+				const StimulusValidator::Options& options, ProgressFunction progress);
+
+		/* Cancel any load, then run a new one on a worker thread, passing
+		 * it a function to report progress, which returns false once the
+		 * load is canceled.
+		 */
+		void run(const QString& name, std::function<Result(ProgressFunction)> work);
+
+		/*! Name of the file being loaded, or last loaded. */
+		QString currentFile;
+
+		/*! True while a file is being loaded. */
+		bool loading;
+
+		/*! Options used to check signals. */
+		StimulusValidator::Options validatorOptions;
+
+		/*! Number of loads started or canceled, used to ignore the
+		 * result of a load which has since been canceled.
+		 */
+		quint64 generation;
+
+		/*! Flag set to stop the worker reading the current file. */
+		std::shared_ptr<QAtomicInt> cancelFlag;
+
+		/*! Workers which may still be running. */
+		QList<QFuture<Result>> workers;
+};
+
+#endif
+
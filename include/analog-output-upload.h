@@ -0,0 +1,284 @@
+/*! \file analog-output-upload.h
+ *
+ * Header for the AnalogOutputUpload class, which streams an analog
+ * output signal from a file to the BLDS in chunks.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_ANALOG_OUTPUT_UPLOAD_H
+#define MEACTL_ANALOG_OUTPUT_UPLOAD_H
+
+#include "analog-output-loader.h"
+#include "blds-session.h"
+#include "stimulus-cache.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+
+#include <functional>
+#include <memory>
+
+/*! \class AnalogOutputUpload
+ *
+ * The AnalogOutputUpload sends the `analog-output` dataset of an HDF5
+ * file to the BLDS in bounded chunks, rather than as one message holding
+ * the whole signal, so that memory does not grow with the signal's length
+ * and other requests are interleaved with the upload.
+ *
+ * The chunks are sent through three source parameters, which are an
+ * extension of the BLDS protocol made by this client:
+ *
+ * 	- `analog-output-begin`, with the number of samples, starts an
+ * 	upload, discarding any earlier unfinished one.
+ * 	- `analog-output-chunk`, with up to ChunkSize samples in whole
+ * 	frames, appends to the upload.
+ * 	- `analog-output-end`, with the number of samples again, completes
+ * 	the upload if exactly that many were received.
+ *
+ * A server which does not know these parameters rejects the first one,
+ * and the upload then falls back to sending the whole signal as a single
+ * `analog-output` parameter. At most Window chunks are unacknowledged at
+ * once. Chunks are read on a worker thread, or straight from a mapping
+ * of the file if it can be mapped, and each is checked by the
+ * StimulusValidator with the options set by setOptions() as it is read.
+ *
+ * Signals cached in the session's StimulusCache are sent from memory, or
+ * not at all if the server already holds them. A streamed signal is
+ * only cached by its hash.
+ */
+class AnalogOutputUpload : public QObject {
+	Q_OBJECT
+
+		/*! Number of samples sent in each chunk. */
+		const int ChunkSize = 1 << 16;
+
+		/*! Largest number of chunks sent but not acknowledged. */
+		const int Window = 4;
+
+		/*! Time in milliseconds to wait for each reply. */
+		const int RequestTimeout = 10000;
+
+	public:
+
+		/*! Construct an AnalogOutputUpload.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param parent The parent object.
+		 */
+		AnalogOutputUpload(BldsSession* session, QObject* parent = nullptr);
+
+		/*! Destroy an AnalogOutputUpload, canceling any upload. */
+		~AnalogOutputUpload();
+
+		/* Copying is not allowed. */
+		AnalogOutputUpload(const AnalogOutputUpload&) = delete;
+		AnalogOutputUpload(AnalogOutputUpload&&) = delete;
+		AnalogOutputUpload& operator=(const AnalogOutputUpload&) = delete;
+
+		/*! Return true while an upload is running. */
+		bool isRunning() const;
+
+		/*! Return the file being uploaded, or last uploaded. */
+		QString file() const;
+
+		/*! Return the shape of the signal being uploaded, or last
+		 * uploaded, once known.
+		 */
+		AnalogOutputLoader::Shape shape() const;
+
+		/*! Return the options used to check signals. */
+		StimulusValidator::Options options() const;
+
+		/*! Set the options used to check signals sent from now on. */
+		void setOptions(const StimulusValidator::Options& options);
+
+	public slots:
+
+		/*! Start uploading the analog output in a file, canceling any
+		 * upload already running. The result is reported by finished().
+		 *
+		 * `analog-output-channels` is set first if the server expects
+		 * another number of channels. A signal which must be resampled
+		 * is read whole and sent from memory. If any chunk cannot be
+		 * sent, the upload fails before it is completed, leaving the
+		 * server's analog output unchanged.
+		 *
+		 * \param file The name of the file.
+		 */
+		void start(const QString& file);
+
+		/*! Start sending a signal already in memory, such as one which
+		 * was generated, canceling any upload already running.
+		 *
+		 * \param name The name reported in place of a file.
+		 * \param signal The signal.
+		 * \param hash The hash of the signal (see StimulusCache::hash()),
+		 * 	or an empty array to hash it as it is sent.
+		 */
+		void start(const QString& name, const WaveformView& signal,
+				const QByteArray& hash);
+
+		/*! Cancel the running upload, if any. The analog output on the
+		 * server is left unchanged, and the partial upload is discarded
+		 * by the server when the next one begins.
+		 */
+		void cancel();
+
+	signals:
+
+		/*! Emitted as chunks are acknowledged by the server.
+		 *
+		 * \param sent The number of samples acknowledged so far.
+		 * \param total The number of samples in the signal.
+		 */
+		void progress(qint64 sent, qint64 total);
+
+		/*! Emitted when every sample of the signal has been checked,
+		 * before the upload is completed.
+		 *
+		 * \param file The name of the file.
+		 * \param summary The summary of the signal sent.
+		 */
+		void validated(const QString& file, const StimulusValidator::Summary& summary);
+
+		/*! Emitted when an upload ends.
+		 *
+		 * \param file The name of the file.
+		 * \param success True if the server holds the new analog output.
+		 * \param msg If the upload failed, describes why.
+		 */
+		void finished(const QString& file, bool success, const QString& msg);
+
+		/*! Emitted when an upload is canceled.
+		 *
+		 * \param file The name of the file.
+		 */
+		void canceled(const QString& file);
+
+	private:
+
+		/*! Samples read from the file on a worker thread. */
+		struct Chunk {
+			QVector<double> samples;
+			WaveformView view;
+			std::shared_ptr<AnalogOutputLoader::Reader> reader;
+			qint64 total;
+			int channels;
+			double sampleRate;
+			StimulusValidator::Summary summary;
+			QString error;
+		};
+
+		/* Check a signal in memory on a worker thread, then send it. */
+		void checkAndSend(const WaveformView& signal, const QByteArray& hash);
+
+		/* Run a read on a worker thread, calling done with its result
+		 * unless the upload has ended meanwhile.
+		 */
+		void runWorker(std::function<Chunk()> read,
+				std::function<void(const Chunk&)> done);
+
+		/* Forget the previous upload, and start a new one. */
+		void reset(const QString& name);
+
+		/* Send a signal in memory, unless the server already holds it. */
+		void sendFromMemory(const WaveformView& signal, const QByteArray& hash);
+
+		/* Send the number of channels to the server if needed, then
+		 * announce the upload.
+		 */
+		void begin();
+
+		/* Announce the upload to the server, then start sending chunks. */
+		void sendBegin();
+
+		/* Read the next chunk, if the window allows. */
+		void readNext();
+
+		/* Send a chunk which has been read. */
+		void sendChunk(const QVector<double>& chunk);
+
+		/* Handle the acknowledgment of a chunk of the given size. */
+		void handleChunkReply(qint64 count, bool success, const QString& msg);
+
+		/* Complete the upload once every chunk is acknowledged. */
+		void sendEnd();
+
+		/* Send the whole signal in one message, for older servers. */
+		void fallBack();
+
+		/* End the upload, and notify. */
+		void finish(bool success, const QString& msg);
+
+		/*! Session used to communicate with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Reads the whole signal when falling back, or when it must
+		 * be resampled.
+		 */
+		AnalogOutputLoader* loader;
+
+		/*! True if the loader reads the signal to be resampled, rather
+		 * than to fall back.
+		 */
+		bool resampling;
+
+		/*! Options used to check signals. */
+		StimulusValidator::Options validatorOptions;
+
+		/*! Summary of the chunks checked so far. */
+		StimulusValidator::Summary summary;
+
+		/*! Name of the file being uploaded. */
+		QString currentFile;
+
+		/*! True while an upload is running. */
+		bool running;
+
+		/*! True while a chunk is being read from the file. */
+		bool reading;
+
+		/*! Number of uploads started or canceled, used to ignore
+		 * replies and reads for an upload which has since ended.
+		 */
+		quint64 generation;
+
+		/*! Number of samples in the signal, in all channels. */
+		qint64 total;
+
+		/*! Number of channels in the signal. */
+		int channels;
+
+		/*! Number of samples read from the file and sent, and the
+		 * number acknowledged by the server.
+		 */
+		qint64 readCount;
+		qint64 ackedCount;
+
+		/*! Number of chunks sent but not acknowledged. */
+		int inFlight;
+
+		/*! True if the hash of the signal was given, from the cache or
+		 * by the caller, rather than computed as the signal is sent.
+		 */
+		bool fromCache;
+
+		/*! The open dataset, if the signal is read chunk by chunk. */
+		std::shared_ptr<AnalogOutputLoader::Reader> reader;
+
+		/*! The signal, if cached or mapped, sent from memory. */
+		WaveformView source;
+
+		/*! Hashes the signal as it is read from the file. */
+		QCryptographicHash hasher;
+
+		/*! Hash of the signal, once known. */
+		QByteArray digest;
+
+		/*! Reads which may still be running. */
+		QList<QFuture<Chunk>> workers;
+};
+
+#endif
+
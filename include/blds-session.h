@@ -0,0 +1,667 @@
+/*! \file blds-session.h
+ *
+ * Header for the BldsSession class, which routes replies from the
+ * BLDS to the requests which caused them, and batches status queries.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_BLDS_SESSION_H
+#define MEACTL_BLDS_SESSION_H
+
+#include "libblds-client/include/blds-client.h"
+
+#include "data-chunk.h"
+#include "latency-recorder.h"
+#include "stimulus-cache.h"
+
+#include <QtCore>
+
+#include <functional>
+
+/*! \class BldsSession
+ *
+ * The BldsSession class owns the connection to the BLDS, and dispatches each
+ * reply from the server to exactly one continuation supplied with the request.
+ *
+ * The BldsClient reports the replies to `get`, `set` and `setSource`
+ * requests by the name of the parameter alone. The session instead gives
+ * each request an ID, and keeps a queue of in-flight request IDs for each
+ * request type and parameter. The server handles requests in the order in
+ * which they are sent, so a reply is matched to the oldest request for its
+ * parameter, and several requests for the same parameter may be in flight
+ * at once. Replies which match no request are emitted by valuePushed().
+ *
+ * A single session is shared by all windows talking to the same server.
+ * The client runs on a worker thread owned by the session, see client(),
+ * while the session itself and every handler stay on the thread which
+ * made it.
+ */
+class BldsSession : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Identifies a request made through the session. */
+		using RequestId = quint64;
+
+		/*! Function called with the reply to a `get` request. */
+		using GetHandler = std::function<void(bool valid, const QVariant& data)>;
+
+		/*! Function called with the reply to a `set` or `setSource` request. */
+		using SetHandler = std::function<void(bool success, const QString& msg)>;
+
+		/*! Function called with the full status reply from the server. */
+		using StatusHandler = std::function<void(const QJsonObject&)>;
+
+		/*! Function called with the values of a requested set of parameters.
+		 * Parameters not known to the server are absent from the map.
+		 */
+		using ValuesHandler = std::function<void(const QVariantMap&)>;
+
+		/*! Function called with the status of the data source. */
+		using SourceStatusHandler = std::function<void(bool exists, const QJsonObject&)>;
+
+		/*! Function called with the reply to a data request. */
+		using DataHandler = std::function<void(bool valid, const QString& msg,
+				const DataChunk& chunk)>;
+
+		/*! A call made on the client, on the client's thread. */
+		using ClientCall = std::function<void(BldsClient* client)>;
+
+		/*! Passed as a request's timeout to wait indefinitely for its reply. */
+		static const int NoTimeout = 0;
+
+		/*! Message passed to the handler of a request which timed out. */
+		static const char* TimeoutMessage;
+
+		/*! Message passed to the handler of a request in flight when
+		 * the connection was lost.
+		 */
+		static const char* ConnectionLostMessage;
+
+		/*! Delay in milliseconds before the first reconnection attempt. */
+		static const int InitialReconnectDelay = 250;
+
+		/*! Longest delay in milliseconds between reconnection attempts. */
+		static const int MaxReconnectDelay = 8000;
+
+		/*! Number of failed reconnection attempts after which the session
+		 * gives up.
+		 */
+		static const int MaxReconnectAttempts = 12;
+
+		/*! States of the connection to the BLDS.
+		 *
+		 * If the connection is lost after it has been made, the session
+		 * is Reconnecting. It waits between attempts with an exponential
+		 * backoff from InitialReconnectDelay, bounded by MaxReconnectDelay,
+		 * and gives up after MaxReconnectAttempts. Once reconnected, it
+		 * resynchronizes with a single status request, see reconnected().
+		 * Objects using the session stay connected to it throughout, since
+		 * only the underlying client is replaced.
+		 */
+		enum class State {
+			Disconnected,
+			Connecting,
+			Connected,
+			Reconnecting
+		};
+
+		/*! Construct a BldsSession. This does not connect to the server.
+		 *
+		 * \param hostname The hostname or IP address of the BLDS.
+		 * \param parent The parent object.
+		 */
+		BldsSession(const QString& hostname, QObject* parent = nullptr);
+
+		/*! Destroy a BldsSession. */
+		~BldsSession();
+
+		/* Copying is not allowed. */
+		BldsSession(const BldsSession&) = delete;
+		BldsSession(BldsSession&&) = delete;
+		BldsSession& operator=(const BldsSession&) = delete;
+
+		/*! Return the underlying client. This is replaced when the
+		 * session reconnects, and so should not be kept. It lives on
+		 * the session's worker thread, so it must only be used through
+		 * queued connections.
+		 *
+		 * All socket I/O and parsing of replies happens on the worker
+		 * thread. Requests are posted to the client in order through
+		 * clientCallPosted(), and replies come back through queued
+		 * connections.
+		 */
+		BldsClient* client() const;
+
+		/*! Return the hostname of the BLDS. */
+		QString hostname() const;
+
+		/*! Return the state of the connection. */
+		State state() const;
+
+		/*! Return the recorder of round trip times, if any. */
+		LatencyRecorder* latencyRecorder() const;
+
+		/*! Set the recorder of the round trip time of each request. Every
+		 * request is timestamped when it is sent and when its reply
+		 * arrives, and the difference is recorded by command. The
+		 * recorder is not owned by the session.
+		 */
+		void setLatencyRecorder(LatencyRecorder* recorder);
+
+		/*! Return the cache of analog output signals, if any. */
+		StimulusCache* stimulusCache() const;
+
+		/*! Set the cache of analog output signals read from files, used
+		 * by windows sending the analog output. The cache is not owned
+		 * by the session.
+		 */
+		void setStimulusCache(StimulusCache* cache);
+
+		/*! Return the hash of the analog output signal the server holds
+		 * (see StimulusCache::hash()), or an empty array if it is not
+		 * known or there is none. A signal the server already holds need
+		 * not be sent again. The hash is forgotten whenever the analog
+		 * output may have changed without it, e.g., when the source is
+		 * replaced or the connection is lost.
+		 */
+		QByteArray analogOutputHash() const;
+
+		/*! Record the hash of the analog output signal the server holds,
+		 * once the server has accepted it.
+		 */
+		void setAnalogOutputHash(const QByteArray& hash);
+
+		/*! Return true if the `analog-output-channels` parameter must be
+		 * set before sending an analog output signal with the given
+		 * number of channels. A server which does not report the
+		 * parameter is taken to expect a single channel.
+		 */
+		bool needsAnalogOutputChannels(int channels) const;
+
+		/*! Return the time in milliseconds taken to recover from the last
+		 * lost connection, or -1 if it has never been lost.
+		 */
+		qint64 lastRecoveryTime() const;
+
+		/*! Return the number of times the connection has been recovered. */
+		int recoveryCount() const;
+
+		/*! Connect to the BLDS. The result is reported by connected(). */
+		void connectToServer();
+
+		/*! Disconnect from the BLDS, without attempting to reconnect.
+		 * The handlers of requests in flight are not called.
+		 */
+		void disconnectFromServer();
+
+		/*! Request that the BLDS create a data source.
+		 *
+		 * \param type The type of the source.
+		 * \param location The location of the source.
+		 */
+		void createSource(const QString& type, const QString& location);
+
+		/*! Request that the BLDS delete the data source. */
+		void deleteSource();
+
+		/*! Request that the BLDS start recording data. */
+		void startRecording();
+
+		/*! Request that the BLDS stop recording data. */
+		void stopRecording();
+
+		/*! Request the value of a server parameter.
+		 *
+		 * Replies carry no request ID, so a request which timed out stays
+		 * in its queue, and its reply is dropped when it arrives rather
+		 * than taken as the reply to a later request. Expired requests
+		 * the server never answers are forgotten when the connection is
+		 * lost, or once a status request sent after them is answered.
+		 * The same holds for set(), setSource() and canceled requests.
+		 *
+		 * \param param The name of the parameter.
+		 * \param handler Function called with the reply.
+		 * \param timeout Time in milliseconds after which the handler is
+		 * 	called with an invalid reply, if the server has not answered.
+		 * \return The ID of the request.
+		 */
+		RequestId get(const QString& param, GetHandler handler = nullptr,
+				int timeout = NoTimeout);
+
+		/*! Request that the server set a parameter.
+		 *
+		 * \param param The name of the parameter.
+		 * \param value The new value of the parameter.
+		 * \param handler Function called with the reply.
+		 * \param timeout Time in milliseconds after which the handler is
+		 * 	called with a failure, if the server has not answered.
+		 * \return The ID of the request.
+		 */
+		RequestId set(const QString& param, const QVariant& value,
+				SetHandler handler = nullptr, int timeout = NoTimeout);
+
+		/*! Request that the server set a parameter of the data source.
+		 *
+		 * \param param The name of the parameter.
+		 * \param value The new value of the parameter. The analog
+		 * 	output is given as a WaveformView, which is only copied
+		 * 	into a message when it is sent.
+		 * \param handler Function called with the reply.
+		 * \param timeout Time in milliseconds after which the handler is
+		 * 	called with a failure, if the server has not answered.
+		 * \return The ID of the request.
+		 */
+		RequestId setSource(const QString& param, const QVariant& value,
+				SetHandler handler = nullptr, int timeout = NoTimeout);
+
+		/*! Cancel a request. Its handler will not be called, and its
+		 * reply is dropped when it arrives.
+		 *
+		 * \param id The ID of the request.
+		 * \return True if the request was in flight, else false.
+		 */
+		bool cancel(RequestId id);
+
+		/*! Return the number of requests awaiting a reply. */
+		int pendingRequestCount() const;
+
+		/*! Request the full status of the server.
+		 *
+		 * \param handler Function called with the status reply.
+		 */
+		void requestServerStatus(StatusHandler handler);
+
+		/*! Request the values of several server parameters in one round trip.
+		 *
+		 * The BLDS's status reply contains the values of all of the
+		 * server's parameters. All such requests made within the same pass
+		 * through the event loop are collapsed into one status request, and
+		 * each handler is given only the values it asked for.
+		 *
+		 * \param params The names of the parameters to retrieve.
+		 * \param handler Function called with the values of the parameters.
+		 */
+		void getMany(const QStringList& params, ValuesHandler handler);
+
+		/*! Request the status of the data source, refreshing the cache.
+		 *
+		 * \param handler Function called with the status reply.
+		 */
+		void requestSourceStatus(SourceStatusHandler handler = nullptr);
+
+		/*! Request the data recorded over a span of time.
+		 *
+		 * The BLDS answers data requests in order, so each reply goes to
+		 * the oldest request. The samples are copied out of the client's
+		 * frame once, on the worker thread, into a DataChunk which can be
+		 * passed to other threads without copying again.
+		 *
+		 * \param start The start of the span, in seconds from the start
+		 * 	of the recording.
+		 * \param stop The end of the span.
+		 * \param handler Function called with the data, or with a failure
+		 * 	if the server rejects the request or the connection is lost.
+		 */
+		void requestData(float start, float stop, DataHandler handler);
+
+		/*! Return true if the status of the data source is cached. */
+		bool hasSourceStatus() const;
+
+		/*! Return the cached status of the data source. This is empty if
+		 * the status is not known, or there is no source. The cache is
+		 * updated with each source status reply and each change to a
+		 * source parameter the server accepts, so that windows can show
+		 * the source's settings without a round trip.
+		 */
+		QJsonObject sourceStatus() const;
+
+	public slots:
+
+		/*! Discard the cached status of the data source, e.g., after
+		 * it has been created or deleted.
+		 */
+		void invalidateSourceStatus();
+
+	signals:
+
+		/*! Emitted after the initial attempt to connect to the BLDS.
+		 *
+		 * \param made True if the connection was made.
+		 */
+		void connected(bool made);
+
+		/*! Emitted when a connection is lost, before reconnecting.
+		 *
+		 * \param reason Describes why the connection was lost.
+		 */
+		void connectionLost(const QString& reason);
+
+		/*! Emitted before each attempt to reconnect.
+		 *
+		 * \param attempt The number of the attempt, starting at 1.
+		 * \param delay Time in milliseconds until the attempt is made.
+		 */
+		void reconnecting(int attempt, int delay);
+
+		/*! Emitted once reconnected and resynchronized with the server.
+		 *
+		 * \param recoveryTime Time in milliseconds since the connection
+		 * 	was lost.
+		 * \param status The status of the server after reconnecting.
+		 */
+		void reconnected(qint64 recoveryTime, const QJsonObject& status);
+
+		/*! Emitted when the session gives up reconnecting.
+		 *
+		 * \param reason Describes why the connection was lost.
+		 */
+		void reconnectFailed(const QString& reason);
+
+		/*! Forwarded from the client, see BldsClient. */
+		void sourceCreated(bool success, const QString& msg);
+		void sourceDeleted(bool success, const QString& msg);
+		void recordingStarted(bool success, const QString& msg);
+		void recordingStopped(bool success, const QString& msg);
+
+		/*! Emitted with the value of a server parameter which was not
+		 * requested through the session, e.g., one pushed by the server.
+		 * A burst of such values handled in one pass through the event
+		 * loop is coalesced, so that only the latest value of each
+		 * parameter is emitted.
+		 *
+		 * \param param The name of the parameter.
+		 * \param valid True if the value is valid.
+		 * \param data The value of the parameter.
+		 */
+		void valuePushed(const QString& param, bool valid, const QVariant& data);
+
+		/*! Emitted when the cached status of the data source changes.
+		 * Changes made in one pass through the event loop are announced
+		 * once, with the latest status.
+		 *
+		 * \param status The new status of the source.
+		 */
+		void sourceStatusChanged(const QJsonObject& status);
+
+		/*! Emitted to make a call on a client, on its own thread. Only
+		 * the target client makes the call. This is only emitted by the
+		 * session.
+		 */
+		void clientCallPosted(BldsClient* target, const BldsSession::ClientCall& call,
+				QPrivateSignal);
+
+		/*! Emitted on the worker thread with each frame of data received,
+		 * copied into a chunk. This is only emitted by the session.
+		 */
+		void dataChunkReceived(bool valid, const QString& msg,
+				const DataChunk& chunk, QPrivateSignal);
+
+	private slots:
+
+		/* Handle the result of an attempt to connect or reconnect. */
+		void handleClientConnected(bool made);
+
+		/* Handle an error or disconnection of the client. */
+		void handleConnectionLost(const QString& reason);
+
+		/* Make the next attempt to reconnect. */
+		void attemptReconnect();
+
+		/* Route replies to the continuation of their request. */
+		void handleGetResponse(const QString& param, bool valid, const QVariant& data);
+		void handleSetResponse(const QString& param, bool success, const QString& msg);
+		void handleSetSourceResponse(const QString& param, bool success,
+				const QString& msg);
+
+		/* Send a single status request on behalf of all callers which
+		 * asked for the status since the last one was sent.
+		 */
+		void flushStatusRequests();
+
+		/* Dispatch a status reply to the callers of the oldest request. */
+		void handleServerStatus(const QJsonObject& json);
+
+		/* Update the cache from a source status reply, and dispatch it
+		 * to the caller of the oldest request.
+		 */
+		void handleSourceStatus(bool exists, const QJsonObject& json);
+
+		/* Dispatch a data reply to the caller of the oldest request. */
+		void handleData(bool valid, const QString& msg, const DataChunk& chunk);
+
+		/* Announce the values pushed, and the changes to the cached
+		 * source status, since the last pass through the event loop.
+		 */
+		void flushStateUpdates();
+
+	private:
+
+		/*! Types of requests whose replies are routed by the session. */
+		enum class RequestType {
+			Get,
+			Set,
+			SetSource
+		};
+
+		/*! The command and send time of a request, in nanoseconds. */
+		struct SentRequest {
+			QString command;
+			qint64 sentAt;
+		};
+
+		/*! A request awaiting its reply. */
+		struct PendingRequest {
+			RequestType type;
+			QString param;
+			QVariant value;
+			GetHandler onGet;
+			SetHandler onSet;
+		};
+
+		/*! A status request which has been sent, with the ID of the
+		 * next request made after it.
+		 */
+		struct StatusRequest {
+			QList<StatusHandler> handlers;
+			RequestId sentBefore;
+		};
+
+		/* Record a new request, returning its ID. */
+		RequestId track(RequestType type, const QString& param,
+				const QVariant& value, GetHandler onGet, SetHandler onSet,
+				int timeout);
+
+		/* Record a source parameter accepted by the server in the cache. */
+		void updateSourceStatus(const QString& param, const QVariant& value);
+
+		/* Make a call on the client, on its thread, after any calls
+		 * made before it.
+		 */
+		void post(ClientCall call);
+
+		/* Announce a change to the cached source status, once the
+		 * current pass through the event loop is done.
+		 */
+		void notifySourceStatusChanged();
+
+		/* Schedule flushStateUpdates(), if it is not already. */
+		void scheduleStateFlush();
+
+		/* Create a new client and connect its signals. */
+		void createClient();
+
+		/* Delete the current client, if any. */
+		void destroyClient();
+
+		/* Forget every request awaiting a reply, without calling any
+		 * handler.
+		 */
+		void forgetPendingRequests();
+
+		/* Fail every get, set and data request awaiting a reply, and
+		 * forget status requests, whose handlers cannot be told of a
+		 * failure.
+		 */
+		void failPendingRequests(const QString& msg);
+
+		/* Wait before the next attempt to reconnect. */
+		void scheduleReconnect();
+
+		/* Fail a request which has not been answered, e.g., because it
+		 * timed out, calling its handler with the given message.
+		 */
+		void fail(RequestId id, const QString& msg);
+
+		/* Mark a request which has not been answered as expired, so
+		 * that its reply is dropped.
+		 */
+		void expire(RequestId id);
+
+		/* Forget the expired requests sent before the given request,
+		 * which the server will not answer.
+		 */
+		void dropExpired(RequestId before);
+
+		/* Return true if connected and able to make requests. */
+		bool isConnected() const;
+
+		/* Remove and return the ID of the oldest request matching a reply,
+		 * or 0 if there is none.
+		 */
+		RequestId takeOldest(RequestType type, const QString& param);
+
+		/* Return the name of a command, as recorded by the latency recorder. */
+		static QString commandName(RequestType type, const QString& param);
+
+		/* Note the time a command without a request ID was sent. */
+		void markSent(const QString& command);
+
+		/* Record the latency of the oldest command of a kind sent. */
+		void markReplied(const QString& command);
+
+		/* Record the latency of a request, whose reply has arrived. */
+		void recordLatency(RequestId id);
+
+		/* Return the key of the queue of requests for a type and parameter. */
+		static QString queueKey(RequestType type, const QString& param);
+
+		/* Dispatch the reply to a set or setSource request. */
+		void dispatchSetReply(RequestType type, const QString& param,
+				bool success, const QString& msg);
+
+		/*! Client for communication with the BLDS. */
+		QPointer<BldsClient> bldsClient;
+
+		/*! Thread on which the client runs. */
+		QThread* networkThread;
+
+		/*! Hostname or IP address of the BLDS. */
+		QString host;
+
+		/*! State of the connection to the BLDS. */
+		State connectionState;
+
+		/*! Number of reconnection attempts since the connection was lost. */
+		int reconnectAttempts;
+
+		/*! Describes why the connection was last lost. */
+		QString lostReason;
+
+		/*! Recorder of the round trip time of each request. */
+		QPointer<LatencyRecorder> latency;
+
+		/*! Cache of analog output signals read from files. */
+		QPointer<StimulusCache> stimuli;
+
+		/*! Hash of the analog output signal the server holds, if known. */
+		QByteArray serverAnalogOutputHash;
+
+		/*! Clock used to timestamp requests and replies. */
+		QElapsedTimer clock;
+
+		/*! Command and send time of each request awaiting its reply. */
+		QHash<RequestId, SentRequest> sentRequests;
+
+		/*! Send times of commands without request IDs, such as
+		 * start-recording, oldest first.
+		 */
+		QHash<QString, QQueue<qint64>> sentCommands;
+
+		/*! Timer which fires when the next reconnection attempt is due. */
+		QTimer* reconnectTimer;
+
+		/*! Measures the time since the connection was lost. */
+		QElapsedTimer recoveryTimer;
+
+		/*! Time taken to recover the last lost connection. */
+		qint64 lastRecovery;
+
+		/*! Number of times the connection has been recovered. */
+		int recoveries;
+
+		/*! ID given to the next request. IDs start at 1, so that 0
+		 * may be used to indicate no request.
+		 */
+		RequestId nextRequestId;
+
+		/*! All requests awaiting a reply, by ID. */
+		QHash<RequestId, PendingRequest> pendingRequests;
+
+		/*! IDs of requests awaiting a reply, oldest first, keyed by
+		 * the request type and parameter. This includes expired requests.
+		 */
+		QHash<QString, QQueue<RequestId>> requestQueues;
+
+		/*! Requests which timed out or were canceled, whose replies are
+		 * still to be dropped.
+		 */
+		QSet<RequestId> expiredRequests;
+
+		/*! Handlers waiting for the next status request to be sent. */
+		QList<StatusHandler> unsentStatusHandlers;
+
+		/*! Handlers for each status request which has been sent but
+		 * not yet answered, oldest first. Replies arrive in the order
+		 * in which the requests were made.
+		 */
+		QQueue<StatusRequest> pendingStatusRequests;
+
+		/*! True if a status request will be sent on the next pass
+		 * through the event loop.
+		 */
+		bool statusFlushScheduled;
+
+		/*! Handlers for each source status request not yet answered. */
+		QQueue<SourceStatusHandler> pendingSourceStatusRequests;
+
+		/*! Handlers for each data request not yet answered. */
+		QQueue<DataHandler> pendingDataRequests;
+
+		/*! Cached status of the data source. */
+		QJsonObject cachedSourceStatus;
+
+		/*! True if the cached status of the source is known. */
+		bool sourceStatusKnown;
+
+		/*! Latest value pushed for each parameter since the last flush,
+		 * and the names of the parameters in the order first pushed.
+		 */
+		QHash<QString, QPair<bool, QVariant>> pushedValues;
+		QStringList pushedOrder;
+
+		/*! True if the cached source status changed since the last flush. */
+		bool sourceStatusDirty;
+
+		/*! True if flushStateUpdates() will run on the next pass through
+		 * the event loop.
+		 */
+		bool stateFlushScheduled;
+};
+
+Q_DECLARE_METATYPE(BldsSession::ClientCall)
+
+#endif
+
@@ -0,0 +1,130 @@
+/*! \file channel-heatmap.h
+ *
+ * Header for the ChannelHeatmap class, which shows a value for every
+ * channel of the array as a color.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_CHANNEL_HEATMAP_H
+#define MEACTL_CHANNEL_HEATMAP_H
+
+#include <QtCore>
+#include <QtGui>
+#include <QtWidgets>
+
+/*! \class ChannelHeatmap
+ *
+ * The ChannelHeatmap shows one value for each channel as the color of a
+ * square cell, with the channels laid out in a grid in the order of
+ * their indices, as near to square as possible. Values are mapped from
+ * the range set with setRange() onto a black, red, yellow and white
+ * scale, and values outside it take the color of the nearer end.
+ *
+ * The colors are kept in an image with one pixel per channel, which is
+ * scaled to fill the widget. Setting new values only recolors the cells
+ * whose colors changed, and only repaints them, so it may be done many
+ * times each second on large arrays. Hovering over a cell shows its
+ * channel and value.
+ */
+class ChannelHeatmap : public QWidget {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a ChannelHeatmap.
+		 *
+		 * \param parent The parent widget.
+		 */
+		ChannelHeatmap(QWidget* parent = nullptr);
+
+		/*! Destroy a ChannelHeatmap. */
+		~ChannelHeatmap();
+
+		/* Copying is not allowed. */
+		ChannelHeatmap(const ChannelHeatmap&) = delete;
+		ChannelHeatmap(ChannelHeatmap&&) = delete;
+		ChannelHeatmap& operator=(const ChannelHeatmap&) = delete;
+
+		/*! Set the number of channels, laying them out anew, with every
+		 * value at the low end of the range.
+		 */
+		void setChannelCount(int count);
+
+		/*! Return the number of channels. */
+		int channelCount() const;
+
+		/*! Set the values mapped onto the ends of the color scale. */
+		void setRange(float minimum, float maximum);
+
+		/*! Set the unit of the values, shown after them. */
+		void setUnit(const QString& unit);
+
+		/*! Set the value of every channel, recoloring only the cells
+		 * which change. Extra values are ignored.
+		 */
+		void setValues(const QVector<float>& values);
+
+		/*! Return the value of a channel. */
+		float value(int channel) const;
+
+		/*! Return the color of a fraction of the way along the scale. */
+		static QRgb color(float fraction);
+
+		/*! Return the preferred size of the widget. */
+		QSize sizeHint() const override;
+
+	signals:
+
+		/*! Emitted when the cell of a channel is clicked. */
+		void channelClicked(int channel);
+
+	protected:
+
+		/* Draw the cells intersecting the updated region. */
+		void paintEvent(QPaintEvent* event) override;
+
+		/* Report the channel clicked, if any. */
+		void mousePressEvent(QMouseEvent* event) override;
+
+		/* Show the channel and value under the cursor. */
+		bool event(QEvent* event) override;
+
+	private:
+
+		/* Return the color of a value in the current range. */
+		QRgb colorOf(float value) const;
+
+		/* Recolor every cell from the current values. */
+		void recolor();
+
+		/* Return the side of each cell, in pixels. */
+		int cellSize() const;
+
+		/* Return the area covered by a channel. */
+		QRect cellRect(int channel) const;
+
+		/* Return the channel at a point, or -1 if none. */
+		int channelAt(const QPoint& point) const;
+
+		/*! Number of channels, and of columns and rows of the grid. */
+		int nchannels;
+		int columns;
+		int rows;
+
+		/*! Values mapped onto the ends of the color scale. */
+		float low;
+		float high;
+
+		/*! Unit of the values. */
+		QString unit;
+
+		/*! Current value of each channel. */
+		QVector<float> values;
+
+		/*! Color of each cell, one pixel per channel. */
+		QImage cells;
+};
+
+#endif
+
@@ -0,0 +1,163 @@
+/*! \file channel-statistics-window.h
+ *
+ * Header for the ChannelStatisticsWindow class, which shows the noise on
+ * every channel as it is recorded.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_CHANNEL_STATISTICS_WINDOW_H
+#define MEACTL_CHANNEL_STATISTICS_WINDOW_H
+
+#include "channel-heatmap.h"
+#include "channel-statistics.h"
+#include "live-data-feed.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QtWidgets>
+
+#include <memory>
+
+/*! \class ChannelStatisticsWindow
+ *
+ * The ChannelStatisticsWindow shows the offset, RMS noise, peak-to-peak
+ * range and fraction of saturated samples of every channel over the
+ * last few seconds, so that a noisy rig is noticed before a recording
+ * rather than after it. The statistics are listed in a table, which
+ * may be sorted by any of them, and one of them is shown for the whole
+ * array by a ChannelHeatmap. Clicking a channel in the map selects it
+ * in the table.
+ *
+ * Chunks from the LiveDataFeed are added to a ChannelStatistics on one
+ * worker thread, one batch at a time, as in the SpikeActivityWindow.
+ * The table and map show the latest statistics UpdateInterval
+ * milliseconds apart, however often chunks arrive. The time taken to
+ * compute the statistics, as a fraction of the time spanned by the data,
+ * is shown as well.
+ *
+ * The statistics start afresh when the shape of the data changes, a new
+ * recording begins or the window is changed. The window only takes data
+ * from the feed while it is shown.
+ */
+class ChannelStatisticsWindow : public QWidget {
+	Q_OBJECT
+
+		/*! Time in milliseconds between updates of the table and map. */
+		const int UpdateInterval = 250;
+
+	public:
+
+		/*! Construct a ChannelStatisticsWindow.
+		 *
+		 * \param feed The feed of live data from the BLDS.
+		 * \param parent The parent widget.
+		 */
+		ChannelStatisticsWindow(LiveDataFeed* feed, QWidget* parent = nullptr);
+
+		/*! Destroy a ChannelStatisticsWindow, waiting for any batch
+		 * being processed.
+		 */
+		~ChannelStatisticsWindow();
+
+		/* Copying is not allowed. */
+		ChannelStatisticsWindow(const ChannelStatisticsWindow&) = delete;
+		ChannelStatisticsWindow(ChannelStatisticsWindow&&) = delete;
+		ChannelStatisticsWindow& operator=(const ChannelStatisticsWindow&) = delete;
+
+	protected:
+
+		/* Start or stop taking data from the feed. */
+		void showEvent(QShowEvent* event) override;
+		void hideEvent(QHideEvent* event) override;
+
+	private slots:
+
+		/* Queue a chunk of data to be processed with the next batch. */
+		void handleChunk(const DataChunk& chunk);
+
+		/* Start processing the queued chunks on a worker thread. */
+		void processChunks();
+
+		/* Show the latest statistics in the table and map. */
+		void showStatistics();
+
+		/* Select the row of a channel in the table. */
+		void selectChannel(int channel);
+
+	private:
+
+		/*! Statistics, only used by one worker at a time. */
+		struct State {
+			ChannelStatistics statistics;
+			double window = 0.;
+			float lastStop = -1.f;
+		};
+
+		/*! The result of processing a batch of chunks. */
+		struct Result {
+			QVector<ChannelStatistics::Summary> summaries;
+			double sampleRate = 0.;
+			double seconds = 0.;
+			qint64 nsecs = 0;
+		};
+
+		/* Add a batch of chunks to the statistics, and summarize them. */
+		static Result accumulate(State* state, const QList<DataChunk>& chunks,
+				double window);
+
+		/* Make a row of the table for every channel. */
+		void setChannelCount(int count);
+
+		/*! Feed of live data. */
+		QPointer<LiveDataFeed> feed;
+
+		/*! Layout of the window. */
+		QGridLayout* layout;
+
+		/*! Chooses the number of seconds of data summarized. */
+		QLabel* windowLabel;
+		QComboBox* windowBox;
+
+		/*! Chooses the statistic shown by the map. */
+		QLabel* mapLabel;
+		QComboBox* mapBox;
+
+		/*! Shows the shape of the data and the load of the statistics. */
+		QLabel* statusLabel;
+
+		/*! Divides the window between the table and the map. */
+		QSplitter* splitter;
+
+		/*! Lists the statistics of every channel. */
+		QTableWidget* table;
+
+		/*! Shows one statistic of every channel. */
+		ChannelHeatmap* heatmap;
+
+		/*! Statistics. */
+		std::shared_ptr<State> state;
+
+		/*! Chunks received since the last batch was started. */
+		QList<DataChunk> pendingChunks;
+
+		/*! Batch being processed, if any. */
+		QFuture<Result> worker;
+
+		/*! Latest result, and whether it has been shown. */
+		Result latest;
+		bool fresh;
+
+		/*! Shows the latest statistics periodically. */
+		QTimer* updateTimer;
+
+		/*! Time spent computing statistics, and the time spanned by the
+		 * data processed, since the status was last shown.
+		 */
+		qint64 busyNsecs;
+		double processedSeconds;
+		QElapsedTimer statusTimer;
+};
+
+#endif
+
@@ -0,0 +1,147 @@
+/*! \file channel-statistics.h
+ *
+ * Header for the ChannelStatistics class, which keeps running statistics
+ * of the noise on every channel.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_CHANNEL_STATISTICS_H
+#define MEACTL_CHANNEL_STATISTICS_H
+
+#include "data-chunk.h"
+
+#include <QtCore>
+
+#include <vector>
+
+/*! \class ChannelStatistics
+ *
+ * The ChannelStatistics keeps the mean, RMS about the mean, peak-to-peak
+ * range and fraction of saturated samples of every channel, over a
+ * sliding window of the most recent samples.
+ *
+ * Samples are summarized in blocks of BlockTime seconds. The moments of
+ * each piece of a channel within a block are computed in two passes
+ * while it is in cache, the first finding its sum, range and saturated
+ * samples, the second the sum of squared deviations from its mean, and
+ * are merged into the block's moments with the update of Welford and
+ * Chan et al., which is exact and stable however the data is split. The
+ * window is a ring of the last blocks, which are merged the same way by
+ * summarize(). Both passes use SSE2 where available, and nothing is
+ * allocated once the statistics have been reset.
+ *
+ * A sample is saturated if its magnitude is at least SaturationLevel.
+ */
+class ChannelStatistics {
+
+	public:
+
+		/*! Length of each block, in seconds. */
+		static constexpr double BlockTime = 0.1;
+
+		/*! Smallest magnitude of a saturated sample. */
+		static const int SaturationLevel = 32767;
+
+		/*! Largest number of samples in a block, so the sums of the
+		 * first pass cannot overflow.
+		 */
+		static const int MaxBlockFrames = 65536;
+
+		/*! Statistics of one channel over the window. */
+		struct Summary {
+			qint64 count = 0;
+			double mean = 0.;
+			double rms = 0.;
+			int minimum = 0;
+			int maximum = 0;
+			double saturation = 0.;
+
+			/*! Return the peak-to-peak range. */
+			int peakToPeak() const
+			{
+				return maximum - minimum;
+			}
+		};
+
+		/*! Construct a ChannelStatistics.
+		 *
+		 * \param channels The number of channels.
+		 * \param sampleRate The sample rate of the data, in Hz.
+		 * \param window The length of the window, in seconds.
+		 */
+		ChannelStatistics(int channels = 0, double sampleRate = 0.,
+				double window = 1.);
+
+		/*! Forget all data, and set the shape of the data and the
+		 * length of the window.
+		 */
+		void reset(int channels, double sampleRate, double window);
+
+		/*! Return the number of channels. */
+		int channels() const;
+
+		/*! Return the sample rate, in Hz. */
+		double sampleRate() const;
+
+		/*! Return the length of the window, in seconds. */
+		double window() const;
+
+		/*! Add a chunk of data, which must have channels() channels.
+		 *
+		 * \return True if the chunk was added.
+		 */
+		bool append(const DataChunk& chunk);
+
+		/*! Compute the statistics of every channel over the window.
+		 *
+		 * \param summaries Receives the statistics, one per channel.
+		 */
+		void summarize(QVector<Summary>* summaries) const;
+
+	private:
+
+		/*! Moments of a run of samples. */
+		struct Moments {
+			qint64 count = 0;
+			double mean = 0.;
+			double m2 = 0.;
+			int minimum = 0;
+			int maximum = 0;
+			qint64 saturated = 0;
+		};
+
+		/* Compute the moments of a run of samples. */
+		static Moments measure(const qint16* x, qint64 count);
+
+		/* Merge the moments of a run into those of another. */
+		static void merge(Moments& into, const Moments& from);
+
+		/*! Number of channels. */
+		int nchannels;
+
+		/*! Sample rate, in Hz. */
+		double rate;
+
+		/*! Number of samples in each block. */
+		qint64 blockFrames;
+
+		/*! Number of blocks in the window, including the one being
+		 * filled.
+		 */
+		int blocks;
+
+		/*! Moments of each block of each channel, one block after
+		 * another.
+		 */
+		std::vector<Moments> ring;
+
+		/*! Number of blocks begun since the reset. */
+		qint64 begun;
+
+		/*! Number of samples in the block being filled. */
+		qint64 filled;
+};
+
+#endif
+
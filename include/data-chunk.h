@@ -0,0 +1,54 @@
+/*! \file data-chunk.h
+ *
+ * Header for the DataChunk struct, which holds a chunk of recorded data
+ * received from the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_DATA_CHUNK_H
+#define MEACTL_DATA_CHUNK_H
+
+#include <QtCore>
+
+/*! \struct DataChunk
+ *
+ * A DataChunk holds the samples of every channel of the data source over
+ * a span of time, as received from the BLDS. The samples are stored one
+ * channel after another, so that each channel is contiguous, as the
+ * BLDS sends them.
+ */
+struct DataChunk {
+
+	/*! Time of the first sample and just after the last, in seconds
+	 * from the start of the recording.
+	 */
+	float start = 0.;
+	float stop = 0.;
+
+	/*! Number of channels. */
+	int channels = 0;
+
+	/*! Number of samples in each channel. */
+	qint64 frames = 0;
+
+	/*! The samples, one channel after another. */
+	QVector<qint16> samples;
+
+	/*! Return the samples of one channel. */
+	const qint16* channel(int index) const
+	{
+		return samples.constData() + index * frames;
+	}
+
+	/*! Return the sample rate in Hz, or 0 if the chunk is empty. */
+	double sampleRate() const
+	{
+		return (stop > start) ? frames / static_cast<double>(stop - start) : 0.;
+	}
+};
+
+Q_DECLARE_METATYPE(DataChunk)
+
+#endif
+
@@ -0,0 +1,153 @@
+/*! \file data-preview-window.h
+ *
+ * Header for the DataPreviewWindow class, which shows the data being
+ * recorded on every channel as it arrives.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_DATA_PREVIEW_WINDOW_H
+#define MEACTL_DATA_PREVIEW_WINDOW_H
+
+#include "decimation-pyramid.h"
+#include "live-data-feed.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QtWidgets>
+
+#include <memory>
+
+/*! \class DataPreviewWindow
+ *
+ * The DataPreviewWindow shows the last few seconds of every channel of
+ * the data source in a grid, so that one can see whether the array is
+ * producing signal while recording.
+ *
+ * Chunks from the LiveDataFeed are added to a DecimationPyramid, and the
+ * grid is drawn from it into an image, both on a worker thread. Each
+ * column of each trace is drawn as a line from the minimum to the
+ * maximum of the samples it covers, so no spike is lost however many
+ * samples fall in a pixel, and drawing takes the same time whatever the
+ * span shown. Only one frame is drawn at a time, and at most MaxFrameRate
+ * frames each second. Chunks which arrive meanwhile are added with the
+ * next frame, so a slow machine shows fewer frames rather than falling
+ * behind the data.
+ *
+ * Traces which reach the limit of the vertical range are drawn in a
+ * different color. The window only takes data from the feed while it
+ * is shown.
+ */
+class DataPreviewWindow : public QWidget {
+	Q_OBJECT
+
+		/*! Largest number of frames drawn each second. */
+		const int MaxFrameRate = 30;
+
+		/*! Number of seconds of data kept for display. */
+		const double History = 10.;
+
+	public:
+
+		/*! Construct a DataPreviewWindow.
+		 *
+		 * \param feed The feed of live data from the BLDS.
+		 * \param parent The parent widget.
+		 */
+		DataPreviewWindow(LiveDataFeed* feed, QWidget* parent = nullptr);
+
+		/*! Destroy a DataPreviewWindow, waiting for any frame being drawn. */
+		~DataPreviewWindow();
+
+		/* Copying is not allowed. */
+		DataPreviewWindow(const DataPreviewWindow&) = delete;
+		DataPreviewWindow(DataPreviewWindow&&) = delete;
+		DataPreviewWindow& operator=(const DataPreviewWindow&) = delete;
+
+	protected:
+
+		/* Start or stop taking data from the feed. */
+		void showEvent(QShowEvent* event) override;
+		void hideEvent(QHideEvent* event) override;
+
+		/* Redraw the grid at the new size. */
+		void resizeEvent(QResizeEvent* event) override;
+
+	private slots:
+
+		/* Queue a chunk of data to be added with the next frame. */
+		void handleChunk(const DataChunk& chunk);
+
+		/* Draw a frame as soon as the frame rate allows. */
+		void scheduleFrame();
+
+		/* Start drawing a frame on a worker thread. */
+		void drawFrame();
+
+	private:
+
+		/*! Data kept for display, only used by one worker at a time. */
+		struct State {
+			DecimationPyramid pyramid;
+			double sampleRate = 0.;
+			float lastStop = -1.f;
+		};
+
+		/*! A frame drawn on a worker thread. */
+		struct Frame {
+			QImage image;
+			int channels = 0;
+			double sampleRate = 0.;
+		};
+
+		/* Add chunks to the pyramid, and draw the grid from it. */
+		static Frame render(State* state, const QList<DataChunk>& chunks,
+				QSize size, double span, int range, double history);
+
+		/*! Feed of live data. */
+		QPointer<LiveDataFeed> feed;
+
+		/*! Layout of the window. */
+		QGridLayout* layout;
+
+		/*! Chooses the number of seconds shown. */
+		QLabel* spanLabel;
+		QComboBox* spanBox;
+
+		/*! Chooses the vertical range of each trace, in ADC counts. */
+		QLabel* rangeLabel;
+		QSpinBox* rangeBox;
+
+		/*! Shows the shape of the data and the frame rate. */
+		QLabel* statusLabel;
+
+		/*! Shows the last frame drawn. */
+		QLabel* canvas;
+
+		/*! Data kept for display. */
+		std::shared_ptr<State> state;
+
+		/*! Chunks received since the last frame was started. */
+		QList<DataChunk> pendingChunks;
+
+		/*! Frame being drawn, if any. */
+		QFuture<Frame> worker;
+
+		/*! True if another frame is needed once the current one is drawn. */
+		bool dirty;
+
+		/*! Delays a frame until the frame rate allows it. */
+		QTimer* frameTimer;
+
+		/*! Time since the last frame was started. */
+		QElapsedTimer sinceFrame;
+
+		/*! Number of frames drawn, and the time since counting began,
+		 * used to show the frame rate.
+		 */
+		int frameCount;
+		QElapsedTimer rateTimer;
+};
+
+#endif
+
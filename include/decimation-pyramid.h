@@ -0,0 +1,119 @@
+/*! \file decimation-pyramid.h
+ *
+ * Header for the DecimationPyramid class, which keeps the recent range
+ * of every channel at several time scales.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_DECIMATION_PYRAMID_H
+#define MEACTL_DECIMATION_PYRAMID_H
+
+#include "data-chunk.h"
+
+#include <QtCore>
+
+/*! \class DecimationPyramid
+ *
+ * The DecimationPyramid summarizes the most recent samples of each
+ * channel by the minimum and maximum of each bucket of consecutive
+ * samples. Level 0 has buckets of BaseBucket samples, and each level
+ * after it combines Factor buckets of the level before. Drawing a trace
+ * from the level whose buckets best fit a pixel column shows every peak
+ * of the raw signal while reading a bounded number of buckets, whatever
+ * the time scale.
+ *
+ * Each level is a ring of buckets holding at least the last capacity()
+ * samples. Samples which do not yet fill a bucket are carried over to
+ * the next chunk. Chunks are summarized one channel per task on the
+ * global thread pool, with SSE2 where available.
+ *
+ * A pyramid is not safe to use from several threads at once, except
+ * that append() itself uses the thread pool.
+ */
+class DecimationPyramid {
+
+	public:
+
+		/*! Number of samples in each bucket of level 0. */
+		static const int BaseBucket = 16;
+
+		/*! Number of buckets of each level combined by the next. */
+		static const int Factor = 4;
+
+		/*! Number of levels. */
+		static const int Levels = 6;
+
+		/*! Construct an empty DecimationPyramid.
+		 *
+		 * \param channels The number of channels.
+		 * \param capacity The number of recent samples of each channel
+		 * 	which are kept.
+		 */
+		DecimationPyramid(int channels = 0, qint64 capacity = 0);
+
+		/*! Remove all samples, and set the shape of the pyramid. */
+		void reset(int channels, qint64 capacity);
+
+		/*! Return the number of channels. */
+		int channels() const;
+
+		/*! Return the number of recent samples of each channel kept. */
+		qint64 capacity() const;
+
+		/*! Return the number of samples of each channel appended since
+		 * the pyramid was reset.
+		 */
+		qint64 size() const;
+
+		/*! Append a chunk of data, which must have channels() channels. */
+		void append(const DataChunk& chunk);
+
+		/*! Return the range of a channel in evenly spaced columns.
+		 *
+		 * \param channel The channel.
+		 * \param first The index of the first sample of the first column,
+		 * 	counted since the pyramid was reset.
+		 * \param samplesPerColumn The number of samples in each column.
+		 * \param count The number of columns.
+		 * \param mins Receives the minimum of each column.
+		 * \param maxs Receives the maximum of each column. A column with
+		 * 	no samples kept has a maximum less than its minimum.
+		 */
+		void columns(int channel, double first, double samplesPerColumn,
+				int count, qint16* mins, qint16* maxs) const;
+
+	private:
+
+		/* Return the number of samples in a bucket of a level. */
+		static qint64 bucketSize(int level);
+
+		/* Summarize the samples of one channel just appended. */
+		void appendChannel(int channel, const qint16* samples, qint64 count,
+				const qint64* before);
+
+		/*! Number of channels. */
+		int nchannels;
+
+		/*! Number of recent samples kept. */
+		qint64 maxSamples;
+
+		/*! Number of samples appended. */
+		qint64 total;
+
+		/*! Number of buckets in the ring of each level. */
+		qint64 ringSize[Levels];
+
+		/*! Number of buckets completed at each level. */
+		qint64 completed[Levels];
+
+		/*! Minimum and maximum of each bucket, channel by channel. */
+		QVector<qint16> mins[Levels];
+		QVector<qint16> maxs[Levels];
+
+		/*! Samples of each channel not yet filling a bucket. */
+		QVector<qint16> carry;
+};
+
+#endif
+
@@ -0,0 +1,231 @@
+/*! \file headless-controller.h
+ *
+ * Header for the HeadlessController class, which runs a script of
+ * commands against the BLDS without any user interface.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_HEADLESS_CONTROLLER_H
+#define MEACTL_HEADLESS_CONTROLLER_H
+
+#include "blds-session.h"
+#include "recording-status-monitor.h"
+#include "recording-queue.h"
+
+#include <QtCore>
+
+#include <memory>
+
+/*! \class HeadlessController
+ *
+ * The HeadlessController drives the BLDS from a list of commands, for
+ * running recordings from scripts on machines without a display. It
+ * needs only a QCoreApplication.
+ *
+ * Commands are taken one per line, with arguments separated by whitespace,
+ * either from the command line or from standard input. Each command is
+ * run only once the previous one has finished. The supported commands are:
+ *
+ * 	connect <host>
+ * 	disconnect
+ * 	create-source <type> [<location>]
+ * 	delete-source
+ * 	set <param> <value>
+ * 	set-source <param> <value>
+ * 	get <param>
+ * 	status
+ * 	start-recording
+ * 	stop-recording
+ * 	wait [<timeout>]
+ * 	queue <file>
+ * 	latency
+ * 	quit
+ *
+ * `wait` returns once the current recording has ended, or fails after
+ * the optional timeout, given in seconds. `queue` runs the recordings
+ * listed in a file back to back, see RecordingQueue::readEntries(), and
+ * returns the gap between each pair of recordings once all have ended.
+ * `latency` returns the round trip times of all requests so far, as
+ * described by LatencyRecorder::toJson(). Blank lines and lines starting
+ * with `#` are ignored. Every other command fails if the server has not
+ * replied within RequestTimeout.
+ *
+ * The result of each command, and events such as the position of the
+ * recording, are written to standard output as single-line JSON objects,
+ * e.g.:
+ *
+ * 	{"command":"set","args":["recording-length","600"],"success":true}
+ * 	{"event":"recording-position","position":12.5}
+ *
+ * The controller stops at the first failed command, unless told to
+ * keep going, and reports the outcome through finished().
+ *
+ * Standard input is read on a thread of its own, which hands each line
+ * to the controller through its event queue, so that waiting for the
+ * next command never blocks the replies to earlier ones.
+ */
+class HeadlessController : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds to wait for the reply to a request. */
+		const int RequestTimeout = 10000;
+
+		/*! Shortest interval in milliseconds between reports of the
+		 * position of the recording.
+		 */
+		const int PositionReportInterval = 1000;
+
+	public:
+
+		/*! Construct a HeadlessController.
+		 *
+		 * \param commands The commands to run. If this is empty, commands
+		 * 	are read from standard input until it is closed.
+		 * \param keepGoing If true, keep running commands after one fails.
+		 * \param parent The parent object.
+		 */
+		HeadlessController(const QStringList& commands, bool keepGoing = false,
+				QObject* parent = nullptr);
+
+		/*! Destroy a HeadlessController. */
+		~HeadlessController();
+
+		/* Copying is not allowed. */
+		HeadlessController(const HeadlessController&) = delete;
+		HeadlessController(HeadlessController&&) = delete;
+		HeadlessController& operator=(const HeadlessController&) = delete;
+
+	public slots:
+
+		/*! Start running commands. */
+		void start();
+
+	signals:
+
+		/*! Emitted when all commands have run, or one has failed.
+		 *
+		 * \param exitCode 0 if every command succeeded, else 1.
+		 */
+		void finished(int exitCode);
+
+	protected:
+
+		/* Run the next command once a line arrives from standard input,
+		 * if it is awaited.
+		 */
+		void customEvent(QEvent* event) override;
+
+	private:
+
+		/*! Lines read from standard input, shared with the thread
+		 * reading them.
+		 */
+		struct InputLines {
+			QMutex mutex;
+			HeadlessController* receiver = nullptr;
+			QStringList lines;
+			bool closed = false;
+		};
+
+		/* Start reading standard input on a thread of its own. */
+		void startReading();
+
+		/* Run the next command, if any. */
+		void runNext();
+
+		/* Return the next command, or a null string if there are none.
+		 * When reading standard input, an empty string means that the
+		 * next line has not yet arrived.
+		 */
+		QString nextCommand();
+
+		/* Run a single command. */
+		void run(const QString& command, const QStringList& args);
+
+		/* Report the result of the current command and move to the next. */
+		void complete(bool success, const QString& msg = QString(),
+				const QJsonValue& value = QJsonValue());
+
+		/* Write one JSON object as a line on standard output. */
+		void write(const QJsonObject& json);
+
+		/* Report an event which is not the result of a command. */
+		void writeEvent(const QString& event, const QJsonObject& data = QJsonObject());
+
+		/* Return a handler completing the current command with a set reply. */
+		BldsSession::SetHandler completion();
+
+		/* Complete the current command if it is the given one. */
+		void completeIf(const QString& command, bool success, const QString& msg,
+				const QJsonValue& value = QJsonValue());
+
+		/* Stop all commands, and notify. */
+		void stop(int exitCode);
+
+		/* Connect to the BLDS at the given host. */
+		void connectToServer(const QString& host);
+
+		/* Create the monitor following the recording, if needed. */
+		void setupStatusMonitor();
+
+		/* Run the recordings listed in a file back to back. */
+		void runQueue(const QString& file);
+
+		/* Wait for the current recording to end. */
+		void waitForRecording(int timeout);
+
+		/* Convert a command-line argument to the value of the given
+		 * parameter, with the type the server expects for it.
+		 */
+		static QVariant parseValue(const QString& param, const QString& arg);
+
+		/*! Commands given on the command line, not yet run. */
+		QStringList pendingCommands;
+
+		/*! True if commands are read from standard input. */
+		bool readStdin;
+
+		/*! Lines read from standard input but not yet run. */
+		std::shared_ptr<InputLines> input;
+
+		/*! True if the next command waits for a line of standard input. */
+		bool awaitingInput;
+
+		/*! Stream writing results to standard output. */
+		QTextStream output;
+
+		/*! True if commands are run after one has failed. */
+		bool keepGoing;
+
+		/*! True if any command has failed. */
+		bool anyFailed;
+
+		/*! True while stopping, when no more results are reported. */
+		bool stopping;
+
+		/*! Name and arguments of the command being run. */
+		QString currentCommand;
+		QStringList currentArgs;
+
+		/*! Session used to communicate with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Monitor following the current recording. */
+		QPointer<RecordingStatusMonitor> statusMonitor;
+
+		/*! Measures the time since the position was last reported. */
+		QElapsedTimer positionReportTimer;
+
+		/*! Records the round trip time of every request. */
+		LatencyRecorder* latencyRecorder;
+
+		/*! Fails a `wait` command which has run out of time. */
+		QTimer* waitTimer;
+
+		/*! Fails a source or recording command whose reply never came. */
+		QTimer* requestTimer;
+};
+
+#endif
+
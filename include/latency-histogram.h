@@ -0,0 +1,100 @@
+/*! \file latency-histogram.h
+ *
+ * Header for the LatencyHistogram class, which records a distribution
+ * of latencies with bounded relative error.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_LATENCY_HISTOGRAM_H
+#define MEACTL_LATENCY_HISTOGRAM_H
+
+#include <QtCore>
+
+/*! \class LatencyHistogram
+ *
+ * The LatencyHistogram records latencies in microseconds into buckets
+ * whose width grows with the value, in the manner of an HDR histogram.
+ * Values below 2 * SubBucketHalfCount are recorded exactly. Larger values
+ * fall into one of SubBucketHalfCount linear buckets within each power of
+ * two, so that any recorded value is known to within about 3%, however
+ * large it is. Recording a value is constant-time, and the histogram
+ * needs only a few kilobytes however many values it holds.
+ */
+class LatencyHistogram {
+
+	public:
+
+		/*! Base-2 logarithm of SubBucketHalfCount. */
+		static const int SubBucketHalfBits = 5;
+
+		/*! Number of linear buckets within each power of two. */
+		static const int SubBucketHalfCount = 1 << SubBucketHalfBits;
+
+		/*! Largest value which can be recorded, in microseconds. Larger
+		 * values are recorded as this value.
+		 */
+		static const qint64 MaxValue = Q_INT64_C(1) << 36;
+
+		/*! Construct an empty histogram. */
+		LatencyHistogram();
+
+		/*! Record a single latency.
+		 *
+		 * \param usec The latency in microseconds.
+		 */
+		void record(qint64 usec);
+
+		/*! Remove all recorded values. */
+		void reset();
+
+		/*! Return the number of recorded values. */
+		qint64 count() const;
+
+		/*! Return the smallest recorded value, or 0 if there are none. */
+		qint64 min() const;
+
+		/*! Return the largest recorded value, or 0 if there are none. */
+		qint64 max() const;
+
+		/*! Return the mean of the recorded values, or 0 if there are none. */
+		double mean() const;
+
+		/*! Return the value at a percentile of the recorded values.
+		 *
+		 * \param percentile The percentile, between 0 and 100.
+		 * \return The largest value equivalent to the recorded value at
+		 * 	the percentile, or 0 if there are none.
+		 */
+		qint64 valueAtPercentile(double percentile) const;
+
+		/*! Return the non-empty buckets, as pairs of the largest value
+		 * in the bucket and the number of values recorded in it.
+		 */
+		QList<QPair<qint64, qint64>> buckets() const;
+
+	private:
+
+		/* Return the index of the bucket holding a value. */
+		static int bucketIndex(qint64 value);
+
+		/* Return the smallest and largest values in a bucket. */
+		static qint64 bucketLowest(int index);
+		static qint64 bucketHighest(int index);
+
+		/*! Number of values recorded in each bucket. */
+		QVector<qint64> counts;
+
+		/*! Number of recorded values. */
+		qint64 total;
+
+		/*! Sum of recorded values, for the mean. */
+		double sum;
+
+		/*! Smallest and largest recorded values. */
+		qint64 minimum;
+		qint64 maximum;
+};
+
+#endif
+
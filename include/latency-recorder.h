@@ -0,0 +1,91 @@
+/*! \file latency-recorder.h
+ *
+ * Header for the LatencyRecorder class, which keeps a latency histogram
+ * for each kind of request made to the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_LATENCY_RECORDER_H
+#define MEACTL_LATENCY_RECORDER_H
+
+#include "latency-histogram.h"
+
+#include <QtCore>
+
+/*! \class LatencyRecorder
+ *
+ * The LatencyRecorder collects the round trip times of requests to the
+ * BLDS, keeping a LatencyHistogram for each command. Commands are named
+ * by the kind of request and, for parameters, the parameter's name, e.g.
+ * `start-recording`, `get recording-position` or
+ * `set-source configuration-file`.
+ *
+ * The session timestamps each request as it is sent and its reply as it
+ * arrives, and records the difference here. The recorder outlives any
+ * single session, so histograms accumulate across connections until
+ * reset, and can be exported as JSON or CSV.
+ */
+class LatencyRecorder : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a LatencyRecorder. */
+		LatencyRecorder(QObject* parent = nullptr);
+
+		/*! Destroy a LatencyRecorder. */
+		~LatencyRecorder();
+
+		/* Copying is not allowed. */
+		LatencyRecorder(const LatencyRecorder&) = delete;
+		LatencyRecorder(LatencyRecorder&&) = delete;
+		LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+		/*! Record the round trip time of one request.
+		 *
+		 * \param command The name of the command.
+		 * \param usec The round trip time in microseconds.
+		 */
+		void record(const QString& command, qint64 usec);
+
+		/*! Return the names of all commands with recorded latencies. */
+		QStringList commands() const;
+
+		/*! Return the histogram of a command's latencies. This is empty
+		 * if none have been recorded.
+		 */
+		LatencyHistogram histogram(const QString& command) const;
+
+		/*! Return the latencies of all commands as a JSON object, with
+		 * summary statistics and the non-empty buckets of each command.
+		 */
+		QJsonObject toJson() const;
+
+		/*! Return the summary statistics of all commands as CSV text,
+		 * with one row per command and all values in microseconds.
+		 */
+		QString toCsv() const;
+
+	public slots:
+
+		/*! Remove all recorded latencies. */
+		void reset();
+
+	signals:
+
+		/*! Emitted when a latency is recorded.
+		 *
+		 * \param command The name of the command.
+		 * \param usec The round trip time in microseconds.
+		 */
+		void recorded(const QString& command, qint64 usec);
+
+	private:
+
+		/*! Histogram of the latencies of each command. */
+		QMap<QString, LatencyHistogram> histograms;
+};
+
+#endif
+
@@ -0,0 +1,84 @@
+/*! \file latency-window.h
+ *
+ * Header for the LatencyWindow class, which shows the latencies of
+ * requests to the BLDS by command.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_LATENCY_WINDOW_H
+#define MEACTL_LATENCY_WINDOW_H
+
+#include "latency-recorder.h"
+
+#include <QtCore>
+#include <QtGui>
+#include <QtWidgets>
+
+/*! \class LatencyWindow
+ *
+ * The LatencyWindow shows a table of the round trip times of requests
+ * to the BLDS, with one row per command, as recorded by a LatencyRecorder.
+ * The table is refreshed periodically while the window is shown. The
+ * latencies can be exported to a JSON or CSV file, or reset.
+ */
+class LatencyWindow : public QWidget {
+	Q_OBJECT
+
+		/*! Interval in milliseconds at which the table is refreshed. */
+		const int RefreshInterval = 1000;
+
+	public:
+
+		/*! Construct a LatencyWindow.
+		 *
+		 * \param recorder The recorder whose latencies are shown.
+		 * \param parent The parent widget.
+		 */
+		LatencyWindow(LatencyRecorder* recorder, QWidget* parent = nullptr);
+
+		/*! Destroy a LatencyWindow. */
+		~LatencyWindow();
+
+		/* Copying is not allowed. */
+		LatencyWindow(const LatencyWindow&) = delete;
+		LatencyWindow(LatencyWindow&&) = delete;
+		LatencyWindow& operator=(const LatencyWindow&) = delete;
+
+	public slots:
+
+		/*! Refresh the table from the recorder. */
+		void refresh();
+
+		/*! Choose a file, and export the latencies to it as JSON or CSV,
+		 * depending on the file's extension.
+		 */
+		void exportLatencies();
+
+	protected:
+
+		/* Refresh periodically only while shown. */
+		void showEvent(QShowEvent* event) override;
+		void hideEvent(QHideEvent* event) override;
+
+	private:
+
+		/*! Recorder whose latencies are shown. */
+		QPointer<LatencyRecorder> recorder;
+
+		/*! Layout of the window. */
+		QGridLayout* layout;
+
+		/*! Table of latencies, one row per command. */
+		QTableWidget* table;
+
+		/*! Buttons for exporting and resetting latencies. */
+		QPushButton* exportButton;
+		QPushButton* resetButton;
+
+		/*! Timer driving refreshes of the table. */
+		QTimer* refreshTimer;
+};
+
+#endif
+
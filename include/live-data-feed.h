@@ -0,0 +1,133 @@
+/*! \file live-data-feed.h
+ *
+ * Header for the LiveDataFeed class, which follows the data being
+ * recorded by the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_LIVE_DATA_FEED_H
+#define MEACTL_LIVE_DATA_FEED_H
+
+#include "blds-session.h"
+#include "data-chunk.h"
+
+#include <QtCore>
+
+/*! \class LiveDataFeed
+ *
+ * The LiveDataFeed requests the data recorded since its last request,
+ * every PollInterval milliseconds, and emits each chunk it receives.
+ * Each poll asks for the position of the recording with the session's
+ * getMany(), so that it shares a status request with anything else
+ * polling the server, and then requests the data up to that position.
+ *
+ * Only one data request is in flight at a time, and each covers at most
+ * MaxSpan seconds, so a slow display or connection falls behind by
+ * skipping data rather than by queueing requests. When the feed starts,
+ * or a new recording starts, it begins InitialSpan seconds before the
+ * current position.
+ *
+ * The feed only polls while it has consumers, which are added with
+ * addConsumer() and removed when destroyed, so a single feed can be
+ * shared by every view of the live data.
+ */
+class LiveDataFeed : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds between polls. */
+		const int PollInterval = 100;
+
+		/*! Longest span of data requested at once, in seconds. */
+		const float MaxSpan = 1.0f;
+
+		/*! Span of data requested first, in seconds. */
+		const float InitialSpan = 0.5f;
+
+		/*! Time in milliseconds after which a request which has not been
+		 * answered is forgotten, and polling resumes.
+		 */
+		const int RequestTimeout = 2000;
+
+	public:
+
+		/*! Construct a LiveDataFeed.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param parent The parent object.
+		 */
+		LiveDataFeed(BldsSession* session, QObject* parent = nullptr);
+
+		/*! Destroy a LiveDataFeed. */
+		~LiveDataFeed();
+
+		/* Copying is not allowed. */
+		LiveDataFeed(const LiveDataFeed&) = delete;
+		LiveDataFeed(LiveDataFeed&&) = delete;
+		LiveDataFeed& operator=(const LiveDataFeed&) = delete;
+
+		/*! Add a consumer of the feed, starting to poll if it is the
+		 * first. The consumer is removed when it is destroyed.
+		 */
+		void addConsumer(QObject* consumer);
+
+		/*! Remove a consumer of the feed, stopping polling if it is the
+		 * last.
+		 */
+		void removeConsumer(QObject* consumer);
+
+		/*! Return true while the feed is polling. */
+		bool isActive() const;
+
+	signals:
+
+		/*! Emitted with each chunk of data received.
+		 *
+		 * \param chunk The data.
+		 */
+		void chunkReceived(const DataChunk& chunk);
+
+		/*! Emitted when a data request fails.
+		 *
+		 * \param msg Describes the error.
+		 */
+		void requestFailed(const QString& msg);
+
+	private slots:
+
+		/* Request the data recorded since the last request. */
+		void poll();
+
+	private:
+
+		/* Request the data between the last request and a position. */
+		void requestUpTo(float position);
+
+		/*! Session used to communicate with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Drives polling. */
+		QTimer* pollTimer;
+
+		/*! Objects using the feed. */
+		QSet<QObject*> consumers;
+
+		/*! End of the last span requested, or a negative number if
+		 * nothing has been requested from the current recording.
+		 */
+		float lastStop;
+
+		/*! True while a request is in flight. */
+		bool requesting;
+
+		/*! Number of requests made, used to ignore replies to requests
+		 * which have been forgotten.
+		 */
+		quint64 generation;
+
+		/*! Time since the request in flight was made. */
+		QElapsedTimer requestTimer;
+};
+
+#endif
+
@@ -10,6 +10,17 @@
 
 #include "libblds-client/include/blds-client.h"
 
+#include "blds-session.h"
+#include "recording-status-monitor.h"
+#include "recording-queue.h"
+#include "latency-recorder.h"
+#include "source-settings-window.h"
+#include "live-data-feed.h"
+#include "data-preview-window.h"
+#include "spike-activity-window.h"
+#include "channel-statistics-window.h"
+#include "notification-center.h"
+
 #include <QtCore>
 #include <QtWidgets>
 
@@ -23,11 +34,6 @@
 class MeactlWidget : public QWidget {
 	Q_OBJECT
 
-		/*! The time in milliseconds at which the application performs
-		 * periodic checks that the recording and source still exist.
-		 */
-		const int RecordingPositionUpdateInterval = 1000;
-
 	public:
 
 		/*! Construct a MeactlWidget
@@ -44,6 +50,16 @@ class MeactlWidget : public QWidget {
 		MeactlWidget(MeactlWidget&&) = delete;
 		MeactlWidget& operator=(const MeactlWidget&) = delete;
 
+		/*! Set the recorder of the round trip time of each request,
+		 * used by every session made from now on.
+		 */
+		void setLatencyRecorder(LatencyRecorder* recorder);
+
+		/*! Set the cache of analog output signals read from files,
+		 * used by every session made from now on.
+		 */
+		void setStimulusCache(StimulusCache* cache);
+
 	private slots:
 
 		/*! Connect to the Baccus Lab Data Server. */
@@ -91,6 +107,14 @@ class MeactlWidget : public QWidget {
 		 */
 		void onServerError(const QString& msg);
 
+		/*! Slot called when the session has recovered a lost connection,
+		 * which brings the UI in line with the server's status.
+		 *
+		 * \param recoveryTime Time in milliseconds taken to recover.
+		 * \param json The status of the server after reconnecting.
+		 */
+		void onServerReconnected(qint64 recoveryTime, const QJsonObject& json);
+
 		/*! Slot called when a response to create a source is received.
 		 *
 		 * \param success True if the source was created, false otherwise.
@@ -128,7 +152,7 @@ class MeactlWidget : public QWidget {
 		 *
 		 * \param json The response data containing the server's status.
 		 */
-		void handleInitialStatusReply(QJsonObject json);
+		void handleInitialStatusReply(const QJsonObject& json);
 
 		/*! Choose a directory in which to save a recording. */
 		void chooseRecordingDirectory();
@@ -136,16 +160,34 @@ class MeactlWidget : public QWidget {
 		/*! Slot called to cancel a pending connection to the BLDS. */
 		void cancelPendingServerConnection();
 
-		/*! Slot called upon receipt of periodic replies for the recording
-		 * status, e.g., whether or not it still exists.
-		 */
-		void handleRecordingExistsReply(bool exists);
-
 		/*! Slot called to show the settings for the source and
 		 * change them.
 		 */
 		void showSettingsWindow();
 
+		/*! Slot called to show the data recorded on every channel
+		 * as it arrives.
+		 */
+		void showPreviewWindow();
+
+		/*! Slot called to show the spike rate on every electrode of
+		 * a HiDens array.
+		 */
+		void showActivityWindow();
+
+		/*! Slot called to show the noise on every channel. */
+		void showNoiseWindow();
+
+		/*! Slot called to choose a file listing recordings, and run
+		 * them back to back.
+		 */
+		void runRecordingQueue();
+
+		/*! Enable running a queue of recordings only when no recording
+		 * or queue is running.
+		 */
+		void updateQueueButton();
+
 	signals:
 
 		/*! Emitted after an attempt to connect to the BLDS.
@@ -197,6 +239,34 @@ class MeactlWidget : public QWidget {
 		 */
 		void recordingStopped(bool success, const QString& msg);
 
+		/*! Emitted when the connection to the BLDS is lost, while the
+		 * session attempts to recover it.
+		 *
+		 * \param reason Describes why the connection was lost.
+		 */
+		void connectionLost(const QString& reason);
+
+		/*! Emitted when a lost connection to the BLDS has been recovered.
+		 *
+		 * \param recoveryTime Time in milliseconds taken to recover.
+		 */
+		void reconnected(qint64 recoveryTime);
+
+		/*! Emitted when a recording of a queue has started.
+		 *
+		 * \param index The index of the recording in the queue.
+		 * \param count The number of recordings in the queue.
+		 */
+		void recordingQueueAdvanced(int index, int count);
+
+		/*! Emitted when a recording of a queue has started after the
+		 * previous one ended.
+		 *
+		 * \param index The index of the recording in the queue.
+		 * \param gap Time in milliseconds between the recordings.
+		 */
+		void recordingQueueTransition(int index, qint64 gap);
+
 		/*! Emitted when a pending request to connect to the BLDS is canceled. */
 		void serverConnectionCanceled();
 
@@ -217,8 +287,10 @@ class MeactlWidget : public QWidget {
 		/*! Emitted when a new Neurolizer plug has been successfully set. */
 		void plugChanged(const QString& plug);
 
-		/*! Emitted when the analog output is set from a file. */
-		void analogOutputChanged(const QString& file);
+		/*! Emitted when the analog output is set from a file, with its
+		 * number of channels and the samples in each.
+		 */
+		void analogOutputChanged(const QString& file, int channels, qint64 frames);
 
 		/*! Emitted when the configuration is set from a file. */
 		void configurationChanged(const QString& config);
@@ -234,11 +306,14 @@ class MeactlWidget : public QWidget {
 		/* Get the status of the server and any data source after initially connecting. */
 		void getInitialStatus();
 
-		/* Setup a heartbeat HTTP request to the server to get the status
-		 * of the recording, and connect slots to handle the response.
+		/* Start monitoring the status of the recording, creating the
+		 * monitor and connecting slots to handle its updates if needed.
 		 */
 		void setupRecordingStatusHeartbeat();
 
+		/* Create the monitor of the recording's status, if needed. */
+		void createStatusMonitor();
+
 		/* Handler which implements changes to the control widget in response
 		 * to a successful connection to the server.
 		 */
@@ -269,8 +344,17 @@ class MeactlWidget : public QWidget {
 		 */
 		void handleRecordingStopped();
 
-		/* Setup signals/slots needed to create the source settings window. */
-		void setupSettingsWindow();
+		/* Close and destroy the source settings window, if it exists. */
+		void closeSettingsWindow();
+
+		/* Close and destroy the data preview window, if it exists. */
+		void closePreviewWindow();
+
+		/* Close and destroy the spike activity window, if it exists. */
+		void closeActivityWindow();
+
+		/* Close and destroy the channel noise window, if it exists. */
+		void closeNoiseWindow();
 
 		/*! Main widget layout. */
 		QGridLayout* mainLayout;
@@ -315,9 +399,34 @@ class MeactlWidget : public QWidget {
 		QPushButton* showSettingsButton;
 
 		/*! Sub-window which can be used to show/manipulate the data
-		 * source settings.
+		 * source settings. Only one is ever created per connection.
 		 */
-		//QPointer<SourceSettingsWindow> settingsWindow;
+		QPointer<SourceSettingsWindow> settingsWindow;
+
+		/*! Button for showing the live data. */
+		QPushButton* showPreviewButton;
+
+		/*! Sub-window showing the data recorded on every channel. */
+		QPointer<DataPreviewWindow> previewWindow;
+
+		/*! Button for showing the spike rate on every electrode,
+		 * enabled only for HiDens sources.
+		 */
+		QPushButton* showActivityButton;
+
+		/*! Sub-window showing the spike rate on every electrode. */
+		QPointer<SpikeActivityWindow> activityWindow;
+
+		/*! Button for showing the noise on every channel. */
+		QPushButton* showNoiseButton;
+
+		/*! Sub-window showing the noise on every channel. */
+		QPointer<ChannelStatisticsWindow> noiseWindow;
+
+		/*! Feed of live data from the BLDS, shared by every view of
+		 * it and owned by the session.
+		 */
+		QPointer<LiveDataFeed> dataFeed;
 
 		/*! Group of widgets related to a recording. */
 		QGroupBox* recordingGroup;
@@ -349,23 +458,27 @@ class MeactlWidget : public QWidget {
 		/*! Button for starting/stopping the recording. */
 		QPushButton* startRecordingButton;
 
-		/*! Client for communication with BLDS. */
-		QPointer<BldsClient> client;
+		/*! Button for running a queue of recordings. */
+		QPushButton* runQueueButton;
 
-		/*! Timer for making periodic requests about the status of the
-		 * server/source
+		/*! Session which owns the connection to the BLDS, and routes
+		 * each reply to the handler of the request which caused it.
 		 */
-		QTimer* recordingStatusTimer;
+		QPointer<BldsSession> session;
 
-		/*! Storage for connection objects used for later cleanup.
-		 * 
-		 * Throughout this class's implementation, functors are connected
-		 * to various signals (rather than standalone class methods). Sometimes
-		 * multiple functors are connected to the same slot. This method
-		 * stores connections, so that specific connections can be removed
-		 * later, without removing all of those for the given slot.
+		/*! Monitor which follows the position of the current recording,
+		 * either through updates pushed by the server or by polling it.
 		 */
-		QMap<QString, QMetaObject::Connection> connections;
+		QPointer<RecordingStatusMonitor> statusMonitor;
+
+		/*! Recorder of the round trip time of each request. */
+		QPointer<LatencyRecorder> latencyRecorder;
+
+		/*! Cache of analog output signals read from files. */
+		QPointer<StimulusCache> stimulusCache;
+
+		/*! Queue of recordings run back to back, if any. */
+		QPointer<RecordingQueue> recordingQueue;
 };
 
 #endif
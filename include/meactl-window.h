@@ -9,6 +9,12 @@
 #define MEACTL_WINDOW_H
 
 #include "meactl-widget.h"
+#include "latency-recorder.h"
+#include "latency-window.h"
+#include "stimulus-cache.h"
+#include "notification-center.h"
+#include "notification-toasts.h"
+#include "notification-button.h"
 
 #include <QtCore>
 #include <QtGui>
@@ -20,6 +26,14 @@
  * It is little more than a status bar and a container for a
  * MeactlWidget, which does the vast majority of the heavy lifting for
  * the application.
+ *
+ * The window also records the round trip time of every request to the
+ * BLDS. The latest is shown next to the status bar, and all of them can
+ * be shown by command, and exported, in a LatencyWindow.
+ *
+ * Errors and warnings posted to the NotificationCenter are shown as
+ * toasts beside the window. The number unread is shown in the status
+ * bar, by a button which shows all of them.
  */
 class MeactlWindow : public QMainWindow {
 	Q_OBJECT
@@ -95,6 +109,30 @@ class MeactlWindow : public QMainWindow {
 		 */
 		void handleSaveDirectoryChanged(const QString& name);
 
+		/*! Slot called when the connection to the BLDS is lost, while
+		 * it is being recovered.
+		 */
+		void handleConnectionLost(const QString& reason);
+
+		/*! Slot called when a lost connection to the BLDS is recovered,
+		 * with the time in milliseconds taken to recover it.
+		 */
+		void handleReconnected(qint64 recoveryTime);
+
+		/*! Slot called when a recording of a queue has started. */
+		void handleRecordingQueueAdvanced(int index, int count);
+
+		/*! Slot called when a recording of a queue has started after the
+		 * previous one, with the gap in milliseconds between them.
+		 */
+		void handleRecordingQueueTransition(int index, qint64 gap);
+
+		/*! Slot called when the round trip time of a request is recorded. */
+		void handleLatencyRecorded(const QString& command, qint64 usec);
+
+		/*! Slot called to show the latencies of all requests. */
+		void showLatencyWindow();
+
 		/*! Slot called when a pending connection to the BLDS is canceled. */
 		void handleServerConnectionCanceled();
 
@@ -105,7 +143,8 @@ class MeactlWindow : public QMainWindow {
 		void handleConfigurationChanged(const QString& file);
 
 		/*! Slot called when analog output is changed. */
-		void handleAnalogOutputChanged(const QString& file);
+		void handleAnalogOutputChanged(const QString& file, int channels,
+				qint64 frames);
 
 		/*! Slot called when triggering mechanism is changed. */
 		void handleTriggerChanged(const QString& trigger);
@@ -118,6 +157,27 @@ class MeactlWindow : public QMainWindow {
 		/* The actual controller widget, which does all the work. */
 		MeactlWidget* controller;
 
+		/* Records the round trip time of every request to the BLDS. */
+		LatencyRecorder* latencyRecorder;
+
+		/* Keeps recently used analog output signals in memory. */
+		StimulusCache* stimulusCache;
+
+		/* Shows the latest round trip time, next to the status bar. */
+		QLabel* latencyLabel;
+
+		/* Button for showing the latencies of all requests. */
+		QToolButton* latencyButton;
+
+		/* Window showing the latencies of all requests, if shown. */
+		QPointer<LatencyWindow> latencyWindow;
+
+		/* Shows new notifications beside the window. */
+		NotificationToasts* toasts;
+
+		/* Button for showing all notifications, with the number unread. */
+		NotificationButton* notificationButton;
+
 };
 
 #endif
@@ -0,0 +1,181 @@
+/*! \file multi-rig-window.h
+ *
+ * Header for the MultiRigWindow class, which controls several BLDS
+ * servers at once.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_MULTI_RIG_WINDOW_H
+#define MEACTL_MULTI_RIG_WINDOW_H
+
+#include "blds-session.h"
+#include "rig-status-scheduler.h"
+#include "notification-center.h"
+#include "notification-toasts.h"
+#include "notification-button.h"
+
+#include <QtCore>
+#include <QtGui>
+#include <QtWidgets>
+
+/*! \class MultiRigWindow
+ *
+ * The MultiRigWindow controls several rigs, each with its own BLDS, from
+ * a single process. Each rig has its own session, and is shown as one row
+ * of a table with the state of its connection, source and recording. The
+ * status of all rigs is polled by a single RigStatusScheduler.
+ *
+ * The window can start or stop the recording on all rigs at once. To
+ * minimize the skew between rigs, the request to each rig is delayed by
+ * the difference between its one-way trip time and that of the slowest
+ * rig, estimated from the status polls, so that all requests reach their
+ * servers at about the same time. The skew is then measured as the spread
+ * of the midpoints between sending each request and receiving its reply,
+ * and shown once all rigs have replied.
+ */
+class MultiRigWindow : public QMainWindow {
+	Q_OBJECT
+
+		/*! Timeout for status bar messages */
+		const int StatusMessageTimeout = 5000;
+
+		/*! Columns of the table of rigs. */
+		enum Column {
+			HostColumn,
+			ConnectionColumn,
+			SourceColumn,
+			RecordingColumn,
+			PositionColumn,
+			ColumnCount
+		};
+
+	public:
+
+		/*! Construct a MultiRigWindow.
+		 *
+		 * \param hosts The hostnames of the rigs' servers, to which the
+		 * 	window connects immediately.
+		 * \param parent The parent widget.
+		 */
+		MultiRigWindow(const QStringList& hosts = {}, QWidget* parent = nullptr);
+
+		/*! Destroy a MultiRigWindow. */
+		~MultiRigWindow();
+
+		/* Copying is not allowed. */
+		MultiRigWindow(const MultiRigWindow&) = delete;
+		MultiRigWindow(MultiRigWindow&&) = delete;
+		MultiRigWindow& operator=(const MultiRigWindow&) = delete;
+
+	public slots:
+
+		/*! Add a rig, and connect to its server.
+		 *
+		 * \param host The hostname or IP address of the rig's BLDS.
+		 */
+		void addRig(const QString& host);
+
+		/*! Disconnect from and remove the selected rigs. */
+		void removeSelectedRigs();
+
+		/*! Start recording on every rig which is ready to record. */
+		void startAll();
+
+		/*! Stop recording on every rig which is recording. */
+		void stopAll();
+
+	signals:
+
+		/*! Emitted when all rigs have replied to a request to start or
+		 * stop recording.
+		 *
+		 * \param action Either "start" or "stop".
+		 * \param skew Estimated spread in milliseconds of the times at
+		 * 	which the servers handled the request.
+		 * \param failures Number of rigs which rejected the request.
+		 */
+		void fanOutFinished(const QString& action, double skew, int failures);
+
+	private:
+
+		/*! A rig controlled by the window. */
+		struct Rig {
+			QPointer<BldsSession> session;
+			bool sourceExists;
+			bool recordingExists;
+		};
+
+		/*! A request sent to several rigs at once. */
+		struct FanOut {
+			QString action;
+			QElapsedTimer clock;
+			QHash<BldsSession*, double> sent;
+			QList<double> midpoints;
+			int outstanding;
+			QStringList errors;
+		};
+
+		/* Initialize the user interface. */
+		void setupLayout();
+
+		/* Return the row of a rig's session, or -1. */
+		int rowOf(BldsSession* session) const;
+
+		/* Set the text of one cell of the table. */
+		void setCell(BldsSession* session, Column column, const QString& text);
+
+		/* Update a rig's row from the reply to a status poll. */
+		void handleStatus(BldsSession* session, const QVariantMap& values);
+
+		/* Send a request to start or stop recording to the given rigs,
+		 * lined up by their round trip times.
+		 */
+		void fanOut(const QString& action, const QList<BldsSession*>& sessions);
+
+		/* Handle the reply of one rig to a request sent to all. */
+		void handleFanOutReply(BldsSession* session, const QString& action,
+				bool success, const QString& msg);
+
+		/*! All rigs, in the order of the table's rows. */
+		QList<Rig> rigs;
+
+		/*! Polls the status of all rigs. */
+		RigStatusScheduler* scheduler;
+
+		/*! The request being sent to several rigs, if any. */
+		FanOut fanOutState;
+
+		/*! True while a request is being sent to several rigs. */
+		bool fanOutActive;
+
+		/*! Central widget and its layout. */
+		QWidget* central;
+		QGridLayout* layout;
+
+		/*! Table showing one rig per row. */
+		QTableWidget* rigTable;
+
+		/*! Line for entering the hostname of a new rig. */
+		QLineEdit* hostLine;
+
+		/*! Buttons for adding and removing rigs. */
+		QPushButton* addRigButton;
+		QPushButton* removeRigButton;
+
+		/*! Buttons for starting and stopping all recordings. */
+		QPushButton* startAllButton;
+		QPushButton* stopAllButton;
+
+		/*! Shows the skew of the last request sent to all rigs. */
+		QLabel* skewLabel;
+
+		/*! Shows new notifications beside the window. */
+		NotificationToasts* toasts;
+
+		/*! Button for showing all notifications, with the number unread. */
+		NotificationButton* notificationButton;
+};
+
+#endif
+
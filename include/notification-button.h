@@ -0,0 +1,66 @@
+/*! \file notification-button.h
+ *
+ * Header for the NotificationButton class, which shows the number of
+ * unread notifications and opens their history.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_NOTIFICATION_BUTTON_H
+#define MEACTL_NOTIFICATION_BUTTON_H
+
+#include "notification-center.h"
+#include "notification-window.h"
+
+#include <QtCore>
+#include <QtWidgets>
+
+/*! \class NotificationButton
+ *
+ * The NotificationButton is a tool button, meant for a status bar, which
+ * shows the number of unread notifications of a NotificationCenter, and
+ * shows all of them in a NotificationWindow when clicked.
+ */
+class NotificationButton : public QToolButton {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a NotificationButton.
+		 *
+		 * \param center The center whose notifications are shown.
+		 * \param parent The parent widget, which also parents the window.
+		 */
+		NotificationButton(NotificationCenter* center, QWidget* parent = nullptr);
+
+		/*! Destroy a NotificationButton. */
+		~NotificationButton();
+
+		/* Copying is not allowed. */
+		NotificationButton(const NotificationButton&) = delete;
+		NotificationButton(NotificationButton&&) = delete;
+		NotificationButton& operator=(const NotificationButton&) = delete;
+
+	public slots:
+
+		/*! Show all notifications, selecting the one with the given ID,
+		 * if any.
+		 */
+		void showNotifications(quint64 id = 0);
+
+	private slots:
+
+		/* Show the number of unread notifications. */
+		void showUnreadCount(int count);
+
+	private:
+
+		/*! Center whose notifications are shown. */
+		QPointer<NotificationCenter> center;
+
+		/*! Window showing all notifications, if shown. */
+		QPointer<NotificationWindow> window;
+};
+
+#endif
+
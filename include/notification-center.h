@@ -0,0 +1,161 @@
+/*! \file notification-center.h
+ *
+ * Header for the NotificationCenter class, which collects the errors and
+ * warnings of the application without blocking it.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_NOTIFICATION_CENTER_H
+#define MEACTL_NOTIFICATION_CENTER_H
+
+#include <QtCore>
+
+/*! \class NotificationCenter
+ *
+ * The NotificationCenter collects notifications, i.e., errors, warnings
+ * and other messages for the operator, in place of modal message boxes.
+ * A message box runs a nested event loop until it is dismissed, so that
+ * a cascade of failures could keep the operator from stopping a
+ * recording. Posting a notification instead returns at once, and the
+ * notification is shown by whatever views follow the center, such as
+ * a NotificationToasts or a NotificationWindow.
+ *
+ * A notification with the same severity, title and message as one
+ * posted within DedupInterval milliseconds is counted as a repeat of it,
+ * rather than added again, so that a failure repeated by every poll
+ * shows up once. The center keeps a history of the last MaxHistory
+ * notifications, and counts those which have not been read.
+ *
+ * A single center is shared by the whole application, and returned by
+ * instance(). It must only be used from the GUI thread.
+ */
+class NotificationCenter : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds within which a repeated notification is
+		 * counted as a repeat of the earlier one.
+		 */
+		const int DedupInterval = 10000;
+
+		/*! Number of notifications kept in the history. */
+		const int MaxHistory = 500;
+
+	public:
+
+		/*! Severity of a notification. */
+		enum class Severity {
+			Info,
+			Warning,
+			Error
+		};
+
+		/*! A notification, and how often it was repeated. */
+		struct Notification {
+			quint64 id = 0;
+			Severity severity = Severity::Info;
+			QString title;
+			QString message;
+			QDateTime first;
+			QDateTime last;
+			int count = 0;
+			bool read = false;
+		};
+
+		/*! Return the center shared by the application. */
+		static NotificationCenter* instance();
+
+		/*! Construct a NotificationCenter. Most code should use the
+		 * shared instance() instead.
+		 */
+		NotificationCenter(QObject* parent = nullptr);
+
+		/*! Destroy a NotificationCenter. */
+		~NotificationCenter();
+
+		/* Copying is not allowed. */
+		NotificationCenter(const NotificationCenter&) = delete;
+		NotificationCenter(NotificationCenter&&) = delete;
+		NotificationCenter& operator=(const NotificationCenter&) = delete;
+
+		/*! Post a notification, returning at once.
+		 *
+		 * \param severity The severity of the notification.
+		 * \param title A short summary.
+		 * \param message A description of what happened.
+		 * \return The ID of the notification, or of the earlier one
+		 * 	it repeats.
+		 */
+		quint64 notify(Severity severity, const QString& title,
+				const QString& message);
+
+		/*! Post a notification of each severity. */
+		quint64 info(const QString& title, const QString& message);
+		quint64 warning(const QString& title, const QString& message);
+		quint64 error(const QString& title, const QString& message);
+
+		/*! Return the notification with the given ID, or one with an ID
+		 * of 0 if it is no longer in the history.
+		 */
+		Notification notification(quint64 id) const;
+
+		/*! Return the notifications in the history, oldest first. */
+		QList<Notification> history() const;
+
+		/*! Return the number of notifications which have not been read. */
+		int unreadCount() const;
+
+		/*! Return the name of a severity. */
+		static QString severityName(Severity severity);
+
+	public slots:
+
+		/*! Mark every notification as read. */
+		void markAllRead();
+
+		/*! Remove every notification from the history. */
+		void clear();
+
+	signals:
+
+		/*! Emitted when a new notification is posted. */
+		void posted(const NotificationCenter::Notification& notification);
+
+		/*! Emitted when a notification is repeated. */
+		void repeated(const NotificationCenter::Notification& notification);
+
+		/*! Emitted when the number of unread notifications changes. */
+		void unreadCountChanged(int count);
+
+		/*! Emitted when the history is cleared. */
+		void cleared();
+
+	private:
+
+		/* Return the index in the history of the notification with an
+		 * ID, or -1 if there is none.
+		 */
+		int indexOf(quint64 id) const;
+
+		/* Count the unread notifications, announcing any change. */
+		void updateUnreadCount();
+
+		/*! Notifications, oldest first. */
+		QList<Notification> notifications;
+
+		/*! ID of the latest notification with each severity, title and
+		 * message, used to find repeats.
+		 */
+		QHash<QString, quint64> latestByKey;
+
+		/*! ID given to the next notification. */
+		quint64 nextId;
+
+		/*! Number of unread notifications. */
+		int unread;
+};
+
+Q_DECLARE_METATYPE(NotificationCenter::Notification)
+
+#endif
+
@@ -0,0 +1,122 @@
+/*! \file notification-toasts.h
+ *
+ * Header for the NotificationToasts class, which shows each new
+ * notification briefly beside a window.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_NOTIFICATION_TOASTS_H
+#define MEACTL_NOTIFICATION_TOASTS_H
+
+#include "notification-center.h"
+
+#include <QtCore>
+#include <QtGui>
+#include <QtWidgets>
+
+/*! \class NotificationToasts
+ *
+ * The NotificationToasts show each notification posted to a
+ * NotificationCenter as a small frameless window, or toast, stacked
+ * beside the bottom right corner of a host window. Toasts never take
+ * the focus, so the operator can keep using the host window while they
+ * are shown. Each toast hides itself after a time which grows with its
+ * severity, or when clicked.
+ *
+ * At most MaxVisible toasts are shown at once, and later notifications
+ * wait their turn. A repeated notification updates its toast, if shown,
+ * and restarts its time, or is shown again if its toast has gone.
+ */
+class NotificationToasts : public QObject {
+	Q_OBJECT
+
+		/*! Largest number of toasts shown at once. */
+		const int MaxVisible = 3;
+
+		/*! Width of each toast, in pixels. */
+		const int ToastWidth = 320;
+
+		/*! Space between toasts, and between toasts and the host. */
+		const int Spacing = 6;
+
+	public:
+
+		/*! Construct NotificationToasts.
+		 *
+		 * \param center The center whose notifications are shown.
+		 * \param host The window beside which toasts are shown.
+		 */
+		NotificationToasts(NotificationCenter* center, QWidget* host);
+
+		/*! Destroy NotificationToasts, hiding any toasts. */
+		~NotificationToasts();
+
+		/* Copying is not allowed. */
+		NotificationToasts(const NotificationToasts&) = delete;
+		NotificationToasts(NotificationToasts&&) = delete;
+		NotificationToasts& operator=(const NotificationToasts&) = delete;
+
+		/*! Return the time in milliseconds for which a toast of a
+		 * severity is shown.
+		 */
+		static int timeout(NotificationCenter::Severity severity);
+
+	signals:
+
+		/*! Emitted when a toast is clicked, e.g., to show the history. */
+		void activated(quint64 id);
+
+	protected:
+
+		/* Dismiss clicked toasts, and follow the host as it moves. */
+		bool eventFilter(QObject* object, QEvent* event) override;
+
+	private slots:
+
+		/* Show a new notification, or queue it. */
+		void handlePosted(const NotificationCenter::Notification& notification);
+
+		/* Update the toast of a repeated notification. */
+		void handleRepeated(const NotificationCenter::Notification& notification);
+
+		/* Remove every toast, shown or queued. */
+		void dismissAll();
+
+	private:
+
+		/*! A toast being shown. */
+		struct Toast {
+			quint64 id;
+			QPointer<QLabel> label;
+			QTimer* timer;
+		};
+
+		/* Show queued notifications while there is room. */
+		void showQueued();
+
+		/* Hide and remove the toast of a notification. */
+		void dismiss(quint64 id);
+
+		/* Set the text and color of a toast. */
+		void describe(QLabel* label,
+				const NotificationCenter::Notification& notification);
+
+		/* Place the toasts beside the host. */
+		void arrange();
+
+		/*! Center whose notifications are shown. */
+		QPointer<NotificationCenter> center;
+
+		/*! Window beside which toasts are shown. */
+		QPointer<QWidget> host;
+
+		/*! Toasts being shown, oldest first. */
+		QList<Toast> toasts;
+
+		/*! IDs of notifications waiting to be shown, oldest first. */
+		QQueue<quint64> queued;
+};
+
+#endif
+
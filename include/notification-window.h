@@ -0,0 +1,90 @@
+/*! \file notification-window.h
+ *
+ * Header for the NotificationWindow class, which shows the history of
+ * notifications.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_NOTIFICATION_WINDOW_H
+#define MEACTL_NOTIFICATION_WINDOW_H
+
+#include "notification-center.h"
+
+#include <QtCore>
+#include <QtGui>
+#include <QtWidgets>
+
+/*! \class NotificationWindow
+ *
+ * The NotificationWindow lists the notifications kept by a
+ * NotificationCenter, newest first, with the time each was last posted
+ * and how many times it was repeated. The list follows the center as
+ * notifications are posted. Every notification is marked as read while
+ * the window is shown.
+ */
+class NotificationWindow : public QWidget {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a NotificationWindow.
+		 *
+		 * \param center The center whose notifications are shown.
+		 * \param parent The parent widget.
+		 */
+		NotificationWindow(NotificationCenter* center, QWidget* parent = nullptr);
+
+		/*! Destroy a NotificationWindow. */
+		~NotificationWindow();
+
+		/* Copying is not allowed. */
+		NotificationWindow(const NotificationWindow&) = delete;
+		NotificationWindow(NotificationWindow&&) = delete;
+		NotificationWindow& operator=(const NotificationWindow&) = delete;
+
+	public slots:
+
+		/*! Show the whole history again. */
+		void refresh();
+
+		/*! Select the notification with the given ID, if listed. */
+		void select(quint64 id);
+
+	protected:
+
+		/* Mark notifications read while shown. */
+		void showEvent(QShowEvent* event) override;
+
+	private slots:
+
+		/* Add a new notification to the top of the list. */
+		void handlePosted(const NotificationCenter::Notification& notification);
+
+		/* Update the row of a repeated notification. */
+		void handleRepeated(const NotificationCenter::Notification& notification);
+
+	private:
+
+		/* Set the cells of a row from a notification. */
+		void describe(QTreeWidgetItem* item,
+				const NotificationCenter::Notification& notification);
+
+		/*! Center whose notifications are shown. */
+		QPointer<NotificationCenter> center;
+
+		/*! Layout of the window. */
+		QGridLayout* layout;
+
+		/*! List of notifications, newest first. */
+		QTreeWidget* list;
+
+		/*! Button for removing every notification. */
+		QPushButton* clearButton;
+
+		/*! Row of each notification listed, by ID. */
+		QHash<quint64, QTreeWidgetItem*> items;
+};
+
+#endif
+
@@ -0,0 +1,113 @@
+/*! \file parameter-coalescer.h
+ *
+ * Header for the ParameterCoalescer class, which collapses rapid
+ * changes to a parameter into as few requests as possible.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_PARAMETER_COALESCER_H
+#define MEACTL_PARAMETER_COALESCER_H
+
+#include <QtCore>
+
+#include <functional>
+
+/*! \class ParameterCoalescer
+ *
+ * The ParameterCoalescer class sits between a widget producing a stream
+ * of values for a continuous parameter, such as a spin box, and the
+ * request which sends the value to the BLDS.
+ *
+ * Each new value replaces any value not yet sent. A value is sent only
+ * once no newer value has arrived for the quiet period, and only one
+ * request is ever in flight. When a request is acknowledged, the latest
+ * waiting value is sent immediately if its quiet period has passed. Holding
+ * down an arrow key or spinning the mouse wheel thus results in a handful
+ * of requests, the last of which carries the final value.
+ */
+class ParameterCoalescer : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Default quiet period in milliseconds. */
+		static const int DefaultQuietPeriod = 150;
+
+		/*! Function which sends a value, and calls the given function
+		 * once the request has been answered, whether or not it succeeded.
+		 */
+		using Sender = std::function<void(const QVariant& value,
+				std::function<void()> done)>;
+
+		/*! Construct a ParameterCoalescer.
+		 *
+		 * \param sender Function used to send each value.
+		 * \param quietPeriod Time in milliseconds without a new value
+		 * 	after which the latest value is sent.
+		 * \param parent The parent object.
+		 */
+		ParameterCoalescer(Sender sender, int quietPeriod = DefaultQuietPeriod,
+				QObject* parent = nullptr);
+
+		/*! Destroy a ParameterCoalescer. */
+		~ParameterCoalescer();
+
+		/* Copying is not allowed. */
+		ParameterCoalescer(const ParameterCoalescer&) = delete;
+		ParameterCoalescer(ParameterCoalescer&&) = delete;
+		ParameterCoalescer& operator=(const ParameterCoalescer&) = delete;
+
+		/*! Return the quiet period, in milliseconds. */
+		int quietPeriod() const;
+
+		/*! Set the quiet period, in milliseconds. */
+		void setQuietPeriod(int ms);
+
+		/*! Return true if a value is waiting to be sent. */
+		bool hasPendingValue() const;
+
+		/*! Return true if a request is awaiting its reply. */
+		bool isInFlight() const;
+
+	public slots:
+
+		/*! Submit a new value, replacing any value not yet sent.
+		 *
+		 * \param value The new value.
+		 */
+		void submit(const QVariant& value);
+
+		/*! Send the waiting value as soon as no request is in flight,
+		 * without waiting for the quiet period.
+		 */
+		void flush();
+
+		/*! Discard any value not yet sent. */
+		void discard();
+
+	private slots:
+
+		/* Send the waiting value, if no request is in flight. */
+		void sendPending();
+
+	private:
+
+		/*! Function used to send values. */
+		Sender sender;
+
+		/*! Timer measuring the quiet period since the last value. */
+		QTimer* quietTimer;
+
+		/*! The latest value not yet sent. */
+		QVariant pendingValue;
+
+		/*! True if a value is waiting to be sent. */
+		bool hasPending;
+
+		/*! True if a request is awaiting its reply. */
+		bool inFlight;
+};
+
+#endif
+
@@ -0,0 +1,243 @@
+/*! \file recording-queue.h
+ *
+ * Header for the RecordingQueue class, which runs a list of recordings
+ * back to back.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_RECORDING_QUEUE_H
+#define MEACTL_RECORDING_QUEUE_H
+
+#include "analog-output-loader.h"
+#include "blds-session.h"
+#include "recording-status-monitor.h"
+#include "source-config-transaction.h"
+#include "stimulus-cache.h"
+
+#include <QtCore>
+
+/*! \class RecordingQueue
+ *
+ * The RecordingQueue runs a list of recordings one after the other, each
+ * with its own filename, length and source settings, such as the analog
+ * output.
+ *
+ * While a recording runs, the queue prepares the next one, so that none
+ * of that work is done between recordings. In particular, the analog
+ * output is read from its file ahead of time, on a worker thread. If it
+ * has not been read by the time the next recording is due, the queue
+ * waits for it. When the recording is seen
+ * to end, either by the status monitor or by a confirmed request to stop
+ * it, the next entry's parameters are all sent at once, without waiting
+ * for each reply, and the next recording is started as soon as the
+ * server has accepted them.
+ *
+ * The gap between the end of one recording and the confirmed start of
+ * the next is measured for each transition, and reported through
+ * transition().
+ */
+class RecordingQueue : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds to wait for the reply to each request. */
+		const int RequestTimeout = 5000;
+
+	public:
+
+		/*! A single recording in the queue. */
+		struct Entry {
+
+			/*! Name of the file to which the recording is saved. */
+			QString filename;
+
+			/*! Length of the recording in seconds. */
+			int length;
+
+			/*! Parameters of the source set before the recording, by
+			 * name. The `analog-output` parameter is given as the name
+			 * of the file from which it is read, or an empty string to
+			 * clear it.
+			 */
+			QVariantMap sourceSettings;
+		};
+
+		/*! Construct a RecordingQueue.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param monitor The monitor following the recording's status,
+		 * 	used to notice when each recording ends.
+		 * \param parent The parent object.
+		 */
+		RecordingQueue(BldsSession* session, RecordingStatusMonitor* monitor,
+				QObject* parent = nullptr);
+
+		/*! Destroy a RecordingQueue. */
+		~RecordingQueue();
+
+		/* Copying is not allowed. */
+		RecordingQueue(const RecordingQueue&) = delete;
+		RecordingQueue(RecordingQueue&&) = delete;
+		RecordingQueue& operator=(const RecordingQueue&) = delete;
+
+		/*! Read a list of entries from a JSON file.
+		 *
+		 * The file contains an array of objects, each with the keys
+		 * `filename`, `length` and optionally `source`, an object of
+		 * source parameters.
+		 *
+		 * \param path The path to the file.
+		 * \param error Set to a message describing any error.
+		 * \return The entries, which are empty on error.
+		 */
+		static QList<Entry> readEntries(const QString& path, QString* error);
+
+		/*! Add an entry to the end of the queue. */
+		void append(const Entry& entry);
+
+		/*! Remove all entries. This has no effect while running. */
+		void clear();
+
+		/*! Return all entries in the queue. */
+		QList<Entry> entries() const;
+
+		/*! Return the index of the entry being recorded, or -1. */
+		int currentIndex() const;
+
+		/*! Return true while the queue is running. */
+		bool isRunning() const;
+
+		/*! Return the gap in milliseconds of each transition so far. */
+		QList<qint64> transitionGaps() const;
+
+	public slots:
+
+		/*! Start the first entry. No recording may be running. */
+		void start();
+
+		/*! Stop the queue after the current recording. The recording
+		 * itself is not stopped.
+		 */
+		void stop();
+
+	signals:
+
+		/*! Emitted when the recording for an entry has started.
+		 *
+		 * \param index The index of the entry.
+		 * \param filename The file to which it is saved.
+		 */
+		void entryStarted(int index, const QString& filename);
+
+		/*! Emitted when the recording for an entry has ended. */
+		void entryFinished(int index);
+
+		/*! Emitted when a recording has started after the previous one.
+		 *
+		 * \param index The index of the entry which started.
+		 * \param gap Time in milliseconds between the end of the previous
+		 * 	recording and the confirmed start of this one.
+		 */
+		void transition(int index, qint64 gap);
+
+		/*! Emitted when an entry could not be recorded, which stops the queue.
+		 *
+		 * \param index The index of the entry.
+		 * \param msg Describes the error.
+		 */
+		void failed(int index, const QString& msg);
+
+		/*! Emitted when the queue has stopped, after the last entry or
+		 * after being stopped or failing.
+		 */
+		void finished();
+
+	private:
+
+		/*! States of the queue. */
+		enum class State {
+			Idle,
+			Loading,
+			Configuring,
+			Starting,
+			Recording
+		};
+
+		/*! Settings of an entry, ready to be sent to the server. */
+		struct Prepared {
+			int index;
+			QVariantMap sourceSettings;
+			QString error;
+			bool loading;
+			QByteArray analogOutputHash;
+			int analogOutputChannels;
+		};
+
+		/* Prepare the settings of an entry, reading any analog output. */
+		void prepare(int index);
+
+		/* Send the parameters of an entry, and start its recording. */
+		void begin(int index);
+
+		/* Handle the analog output of the prepared entry being read. */
+		void handleAnalogOutputLoaded(const WaveformView& aout,
+				const QByteArray& hash);
+		void handleAnalogOutputFailed(const QString& file, const QString& msg);
+
+		/* Handle the reply to one of the parameters of an entry. */
+		void handleConfigurationReply(bool success, const QString& msg);
+
+		/* Handle the reply to a request to start recording. */
+		void handleRecordingStarted(bool success, const QString& msg);
+
+		/* Handle the end of the current recording. */
+		void handleRecordingEnded();
+
+		/* Stop the queue with an error. */
+		void fail(const QString& msg);
+
+		/* Stop the queue, and notify. */
+		void finish();
+
+		/*! Session used to communicate with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Monitor following the status of the recording. */
+		QPointer<RecordingStatusMonitor> monitor;
+
+		/*! Transaction applying the source settings of each entry. */
+		SourceConfigTransaction* transaction;
+
+		/*! Reads the analog output of each entry on a worker thread. */
+		AnalogOutputLoader* loader;
+
+		/*! All entries in the queue. */
+		QList<Entry> queue;
+
+		/*! The next entry, prepared while the current one is recorded. */
+		Prepared prepared;
+
+		/*! Index of the current entry, or -1. */
+		int current;
+
+		/*! State of the queue. */
+		State state;
+
+		/*! True until the queue is stopped. */
+		bool running;
+
+		/*! Number of replies awaited while configuring an entry. */
+		int outstanding;
+
+		/*! Errors from configuring the current entry. */
+		QStringList configurationErrors;
+
+		/*! Measures the time since the previous recording ended. */
+		QElapsedTimer gapTimer;
+
+		/*! Gap in milliseconds of each transition. */
+		QList<qint64> gaps;
+};
+
+#endif
+
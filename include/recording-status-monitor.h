@@ -0,0 +1,157 @@
+/*! \file recording-status-monitor.h
+ *
+ * Header for the RecordingStatusMonitor class, which tracks the
+ * position and existence of the BLDS's current recording.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_RECORDING_STATUS_MONITOR_H
+#define MEACTL_RECORDING_STATUS_MONITOR_H
+
+#include "blds-session.h"
+
+#include <QtCore>
+
+/*! \class RecordingStatusMonitor
+ *
+ * The RecordingStatusMonitor follows a running recording on the BLDS,
+ * reporting its position and noticing when it ends.
+ *
+ * The monitor first asks the server to push status updates to it, by
+ * setting the `recording-status-subscription` parameter to the desired
+ * update interval. A server supporting this replies to the request
+ * successfully, and then sends unsolicited `get` replies for the
+ * `recording-position` and `recording-exists` parameters as they change,
+ * which the session emits through BldsSession::valuePushed().
+ *
+ * If the server rejects the subscription, or the pushed updates stop
+ * arriving, the monitor falls back to polling: it periodically requests
+ * `recording-exists`, `recording-position` and `source-exists` together,
+ * in a single round trip through BldsSession::getMany().
+ */
+class RecordingStatusMonitor : public QObject {
+	Q_OBJECT
+
+		/*! Name of the server parameter used to subscribe to updates. */
+		const QString SubscriptionParameter = "recording-status-subscription";
+
+		/*! Interval in milliseconds at which the server is asked to push
+		 * status updates when subscribed.
+		 */
+		const int PushInterval = 100;
+
+		/*! Time in milliseconds without a pushed update after which the
+		 * subscription is considered dead, and the monitor starts polling.
+		 */
+		const int SubscriptionTimeout = 2000;
+
+		/*! Interval in milliseconds at which the server is polled for
+		 * the recording status, if it cannot push updates.
+		 */
+		const int PollInterval = 1000;
+
+	public:
+
+		/*! The ways in which the monitor receives updates. */
+		enum class Mode {
+			Idle,
+			Subscribing,
+			Subscribed,
+			Polling
+		};
+
+		/*! Construct a RecordingStatusMonitor.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param parent The parent object.
+		 */
+		RecordingStatusMonitor(BldsSession* session, QObject* parent = nullptr);
+
+		/*! Destroy a RecordingStatusMonitor. */
+		~RecordingStatusMonitor();
+
+		/* Copying is not allowed. */
+		RecordingStatusMonitor(const RecordingStatusMonitor&) = delete;
+		RecordingStatusMonitor(RecordingStatusMonitor&&) = delete;
+		RecordingStatusMonitor& operator=(const RecordingStatusMonitor&) = delete;
+
+		/*! Return the current mode of the monitor. */
+		Mode mode() const;
+
+	public slots:
+
+		/*! Start monitoring the current recording. This first attempts
+		 * to subscribe to updates, falling back to polling if needed.
+		 */
+		void start();
+
+		/*! Stop monitoring the recording, cancelling any subscription. */
+		void stop();
+
+	signals:
+
+		/*! Emitted with the current position of the recording.
+		 *
+		 * \param position The position in the recording, in seconds.
+		 */
+		void positionChanged(double position);
+
+		/*! Emitted when the recording is found to no longer exist. The
+		 * monitor stops itself before emitting this.
+		 */
+		void recordingEnded();
+
+		/*! Emitted if the data source is found to have been deleted
+		 * after the recording ended.
+		 */
+		void sourceRemoved();
+
+		/*! Emitted when the monitor changes the way it receives updates.
+		 *
+		 * \param mode The new mode.
+		 */
+		void modeChanged(Mode mode);
+
+	private slots:
+
+		/* Handle status updates pushed by the server. */
+		void handlePushedValue(const QString& param, bool valid, const QVariant& data);
+
+		/* Request the recording status, when polling. */
+		void poll();
+
+		/* Abandon any subscription and start polling the server. */
+		void fallBackToPolling();
+
+	private:
+
+		/* Change the mode, and notify. */
+		void setMode(Mode mode);
+
+		/* Handle the reply to a request to subscribe to updates. */
+		void handleSubscriptionReply(bool success, const QString& msg);
+
+		/* Handle the batched reply to a poll of the recording status. */
+		void handlePollReply(const QVariantMap& values);
+
+		/* Stop all updates, notify that the recording ended, and check
+		 * whether the source still exists if that is not yet known.
+		 */
+		void finish(const QVariantMap& values = {});
+
+		/*! Session used for communication with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Current way in which updates are received. */
+		Mode currentMode;
+
+		/*! Timer used to periodically poll the server. */
+		QTimer* pollTimer;
+
+		/*! Timer which fires if pushed updates stop arriving. */
+		QTimer* subscriptionWatchdog;
+};
+
+#endif
+
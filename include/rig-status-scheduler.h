@@ -0,0 +1,115 @@
+/*! \file rig-status-scheduler.h
+ *
+ * Header for the RigStatusScheduler class, which polls the status of
+ * several BLDS servers from a single timer.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_RIG_STATUS_SCHEDULER_H
+#define MEACTL_RIG_STATUS_SCHEDULER_H
+
+#include "blds-session.h"
+
+#include <QtCore>
+
+/*! \class RigStatusScheduler
+ *
+ * The RigStatusScheduler polls the status of any number of sessions, each
+ * connected to a different BLDS, from a single timer. On each tick, every
+ * connected session which is not still waiting on its previous poll is
+ * asked for the status of its source and recording, in one round trip
+ * through BldsSession::getMany().
+ *
+ * The scheduler also keeps a smoothed estimate of each session's round
+ * trip time, measured from these polls, which is used to line up requests
+ * sent to several servers at once.
+ */
+class RigStatusScheduler : public QObject {
+	Q_OBJECT
+
+		/*! Default interval between polls in milliseconds. */
+		const int DefaultInterval = 1000;
+
+		/*! Number of intervals after which an unanswered poll is
+		 * considered lost, and the session is polled again.
+		 */
+		const int LostPollIntervals = 5;
+
+		/*! Weight of each new measurement in the smoothed round trip time. */
+		const double RoundTripWeight = 0.25;
+
+	public:
+
+		/*! Construct a RigStatusScheduler. Polling starts with the
+		 * first session added.
+		 *
+		 * \param parent The parent object.
+		 */
+		RigStatusScheduler(QObject* parent = nullptr);
+
+		/*! Destroy a RigStatusScheduler. */
+		~RigStatusScheduler();
+
+		/* Copying is not allowed. */
+		RigStatusScheduler(const RigStatusScheduler&) = delete;
+		RigStatusScheduler(RigStatusScheduler&&) = delete;
+		RigStatusScheduler& operator=(const RigStatusScheduler&) = delete;
+
+		/*! Add a session to be polled. */
+		void addSession(BldsSession* session);
+
+		/*! Stop polling a session. */
+		void removeSession(BldsSession* session);
+
+		/*! Return the interval between polls in milliseconds. */
+		int interval() const;
+
+		/*! Set the interval between polls in milliseconds. */
+		void setInterval(int ms);
+
+		/*! Return the smoothed round trip time to a session's server in
+		 * milliseconds, or -1 if it has not been measured.
+		 */
+		double roundTripTime(BldsSession* session) const;
+
+	signals:
+
+		/*! Emitted with the reply to each poll.
+		 *
+		 * \param session The session which was polled.
+		 * \param values The values of `source-exists`, `recording-exists`
+		 * 	and `recording-position`.
+		 */
+		void statusUpdated(BldsSession* session, const QVariantMap& values);
+
+	private slots:
+
+		/* Poll every session not waiting on a reply. */
+		void poll();
+
+	private:
+
+		/*! A polled session. */
+		struct Rig {
+			QPointer<BldsSession> session;
+			bool inFlight;
+			QElapsedTimer sent;
+			double roundTrip;
+		};
+
+		/* Handle the reply to a poll. */
+		void handleReply(BldsSession* session, const QVariantMap& values);
+
+		/* Return the index of the entry for a session, or -1. */
+		int indexOf(BldsSession* session) const;
+
+		/*! All polled sessions. */
+		QList<Rig> rigs;
+
+		/*! Timer driving all polls. */
+		QTimer* pollTimer;
+};
+
+#endif
+
@@ -0,0 +1,151 @@
+/*! \file source-config-transaction.h
+ *
+ * Header for the SourceConfigTransaction class, which applies a set of
+ * changes to the data source's parameters all at once.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_SOURCE_CONFIG_TRANSACTION_H
+#define MEACTL_SOURCE_CONFIG_TRANSACTION_H
+
+#include "blds-session.h"
+
+#include <QtCore>
+
+/*! \class SourceConfigTransaction
+ *
+ * The SourceConfigTransaction class collects changes to the parameters of
+ * the data source, and applies them together.
+ *
+ * Changes are first staged, with the value the parameter had before the
+ * change. Applying the transaction sends every staged change to the BLDS
+ * at once, without waiting for each reply before sending the next, so the
+ * whole configuration costs about one round trip. Parameters are sent in
+ * a fixed order, with the chip configuration first, since the server
+ * handles requests in the order received.
+ *
+ * Once every reply has arrived, the transaction is committed if all
+ * changes were accepted. If any was rejected, each accepted change is
+ * rolled back by sending its previous value, so that the source is never
+ * left half-configured.
+ */
+class SourceConfigTransaction : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a SourceConfigTransaction.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param parent The parent object.
+		 */
+		SourceConfigTransaction(BldsSession* session, QObject* parent = nullptr);
+
+		/*! Destroy a SourceConfigTransaction. */
+		~SourceConfigTransaction();
+
+		/* Copying is not allowed. */
+		SourceConfigTransaction(const SourceConfigTransaction&) = delete;
+		SourceConfigTransaction(SourceConfigTransaction&&) = delete;
+		SourceConfigTransaction& operator=(const SourceConfigTransaction&) = delete;
+
+		/*! Stage a change to a parameter, replacing any earlier staged
+		 * change to the same parameter.
+		 *
+		 * \param param The name of the parameter.
+		 * \param value The new value of the parameter.
+		 * \param previous The current value of the parameter, sent to roll
+		 * 	back the change. If this is invalid, the change cannot be
+		 * 	rolled back.
+		 */
+		void stage(const QString& param, const QVariant& value,
+				const QVariant& previous);
+
+		/*! Return the names of all parameters with staged changes. */
+		QStringList stagedParameters() const;
+
+		/*! Return true if no changes are staged. */
+		bool isEmpty() const;
+
+		/*! Return true while the transaction is being applied. */
+		bool isApplying() const;
+
+		/*! Discard all staged changes. This has no effect while applying. */
+		void clear();
+
+		/*! Send all staged changes to the BLDS.
+		 *
+		 * \param timeout Time in milliseconds to wait for each reply.
+		 */
+		void apply(int timeout = BldsSession::NoTimeout);
+
+	signals:
+
+		/*! Emitted with the server's reply to each staged change.
+		 *
+		 * \param param The name of the parameter.
+		 * \param success True if the server accepted the change.
+		 * \param msg If the change was rejected, an error message.
+		 */
+		void parameterApplied(const QString& param, bool success, const QString& msg);
+
+		/*! Emitted with the server's reply to the rollback of a change.
+		 *
+		 * \param param The name of the parameter.
+		 * \param success True if the previous value was restored.
+		 */
+		void parameterRolledBack(const QString& param, bool success);
+
+		/*! Emitted when the transaction is complete, including any rollback.
+		 *
+		 * \param committed True if every change was accepted.
+		 * \param errors Error message of each rejected change, by parameter.
+		 */
+		void finished(bool committed, const QMap<QString, QString>& errors);
+
+	private:
+
+		/*! A change to a parameter. */
+		struct Change {
+			QString param;
+			QVariant value;
+			QVariant previous;
+		};
+
+		/* Handle the reply to a staged change. */
+		void handleReply(const Change& change, bool success, const QString& msg);
+
+		/* Roll back all accepted changes. */
+		void rollBack();
+
+		/* Finish the transaction, and notify. */
+		void finish();
+
+		/* Return the order in which a parameter is sent. */
+		static int sendOrder(const QString& param);
+
+		/*! Session used to communicate with the BLDS. */
+		QPointer<BldsSession> session;
+
+		/*! Staged changes, in the order given to stage(). */
+		QList<Change> staged;
+
+		/*! Changes accepted by the server while applying. */
+		QList<Change> accepted;
+
+		/*! Error messages for changes rejected while applying. */
+		QMap<QString, QString> errors;
+
+		/*! Number of replies still expected while applying or rolling back. */
+		int outstanding;
+
+		/*! True while the transaction is being applied. */
+		bool applying;
+
+		/*! Time in milliseconds to wait for each reply. */
+		int replyTimeout;
+};
+
+#endif
+
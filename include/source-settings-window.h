@@ -12,6 +12,13 @@
 #include <QtWidgets>
 
 #include "blds-client.h"
+#include "blds-session.h"
+#include "analog-output-loader.h"
+#include "analog-output-upload.h"
+#include "parameter-coalescer.h"
+#include "source-config-transaction.h"
+#include "stimulus-generator-panel.h"
+#include "notification-center.h"
 
 /*! \class SourceSettingsWindow
  *
@@ -19,13 +26,28 @@
  * the settings of a data source managed by the BLDS. Users are
  * given widgets for manipulating the ADC range, triggering 
  * mechanism, analog output, and HiDens chip configuration.
+ *
+ * The window makes its requests through the session shared with the
+ * rest of the application, and shows the source status cached by
+ * that session, so that it can be shown without connecting to the
+ * server or waiting for a status reply.
  */
 class SourceSettingsWindow : public QWidget {
 	Q_OBJECT
+
+		/*! Time in milliseconds to wait for the BLDS to accept or reject
+		 * a change to one of the source's parameters.
+		 */
+		const int SourceRequestTimeout = 5000;
+
 	public:
 
-		/*! Construct a SourceSettingsWindow. */
-		SourceSettingsWindow(const QString& host, QWidget* parent = nullptr);
+		/*! Construct a SourceSettingsWindow.
+		 *
+		 * \param session The session used to communicate with the BLDS.
+		 * \param parent The parent widget.
+		 */
+		SourceSettingsWindow(BldsSession* session, QWidget* parent = nullptr);
 
 		/*! Destruct a SourceSettingsWindow. */
 		~SourceSettingsWindow();
@@ -52,8 +74,10 @@ class SourceSettingsWindow : public QWidget {
 		/*! Emitted when the user selects a new analog output file.
 		 *
 		 * \param file The file from which the analog output was read.
+		 * \param channels The number of channels in the signal.
+		 * \param frames The number of samples in each channel.
 		 */
-		void analogOutputChanged(const QString& file);
+		void analogOutputChanged(const QString& file, int channels, qint64 frames);
 
 		/*! Emitted when the user selects a new trigger.
 		 *
@@ -70,12 +94,10 @@ class SourceSettingsWindow : public QWidget {
 		 */
 		void chooseConfiguration();
 
-		/* Handle the initial request for the status of the data
-		 * source, collecting the current values for the parameters
-		 * that can be manipulated via the provided widgets. Also
-		 * connect slots for responding to user selections.
+		/* Show the status of the data source, updating the widgets
+		 * for any parameter without a change staged or in flight.
 		 */
-		void handleSourceStatus(bool exists, QJsonObject json);
+		void showSourceStatus(const QJsonObject& status);
 
 		/* Slot called when the trigger changes, sending the new
 		 * value to the BLDS.
@@ -88,27 +110,97 @@ class SourceSettingsWindow : public QWidget {
 		void onAdcRangeChanged(double value);
 
 		/* Slot called when the analog output changes, sending the
-		 * new value to the BLDS.
+		 * new value to the BLDS unless it already holds it.
+		 */
+		void onAnalogOutputChanged(const QString& file, const WaveformView& aout,
+				const QByteArray& hash);
+
+		/* Slot called with a generated signal, which is sent, or
+		 * staged, as the analog output.
 		 */
-		void onAnalogOutputChanged(const QString& file, const QVector<double>& aout);
+		void useGeneratedAnalogOutput(const QString& name,
+				const WaveformView& signal, const QByteArray& hash);
+
+		/* Show the analog output the server now holds, and notify. */
+		void showAnalogOutput(const QString& file, int channels, qint64 frames);
 
-		/* Slot called to actually choose a file and read data from it. */
+		/* Slot called to choose a file, and start loading or sending
+		 * data from it.
+		 */
 		void chooseAnalogOutput();
 
+		/* Show the summary of the analog output being sent. */
+		void showAnalogOutputSummary(const QString& file,
+				const StimulusValidator::Summary& summary);
+
+		/* Show the progress of loading or sending the analog output. */
+		void showAnalogOutputProgress(qint64 read, qint64 total);
+
+		/* Show or hide the progress of loading or sending the analog output. */
+		void setAnalogOutputLoading(bool loading);
+
 		/* Slot called which simply clears analog output. */
 		void clearAnalogOutput();
 
 		void onPlugChanged(const QString& plug);
 
+		/* Send all staged changes to the BLDS together. */
+		void applyStagedChanges();
+
+		/* Discard all staged changes, restoring the widgets. */
+		void discardStagedChanges();
+
+		/* Handle the end of applying staged changes, reporting any
+		 * which were rejected.
+		 */
+		void handleTransactionFinished(bool committed,
+				const QMap<QString, QString>& errors);
+
 	private:
 
-		/* Method which actually reads data from the given file. */
-		QVector<double> readAnalogOutputFromFile(const QString& file);
+		/* Request that the BLDS set a parameter of the source. Requests
+		 * for any number of parameters may be in flight at once, each with
+		 * its own timeout. If a request fails or times out, the widgets are
+		 * restored to the value last accepted by the server.
+		 *
+		 * \param param The name of the parameter.
+		 * \param value The new value of the parameter.
+		 * \param description Describes the parameter in error messages.
+		 * \param onSuccess Called if the server accepts the value.
+		 * \param onReply Called when the request is answered or times out,
+		 * 	or immediately if the change is only staged.
+		 */
+		void setSourceParameter(const QString& param, const QVariant& value,
+				const QString& description, std::function<void()> onSuccess,
+				std::function<void()> onReply = nullptr);
+
+		/* Return the options used to check analog output signals for
+		 * the source.
+		 */
+		StimulusValidator::Options analogOutputOptions() const;
+
+		/* Show the last value of a parameter accepted by the server. */
+		void restoreConfirmedValue(const QString& param);
+
+		/* Show the number of source requests awaiting a reply. */
+		void updatePendingIndicator();
+
+		/* Create the transaction used to stage changes, and connect
+		 * its signals.
+		 */
+		void setupTransaction();
+
+		/* Show the number of staged changes, and enable applying them. */
+		void updateStagedIndicator();
+
+		/* Create coalescers for the continuous-valued parameters. */
+		void setupCoalescers();
 
 		/* Initialize the widget layout. */
 		void setupLayout();
 
-		QJsonObject status;
+		/* Connect slots for responding to user selections. */
+		void connectWidgets();
 
 		/*! Main layout manager */
 		QGridLayout* layout;
@@ -143,10 +235,93 @@ class SourceSettingsWindow : public QWidget {
 		QPushButton* selectAnalogOutputButton;
 		QPushButton* clearAnalogOutputButton;
 
-		/*! The window uses its own client to get and set the values
-		 * of the parameters corresponding to the provided widgets.
+		/*! Shows the stimulus generator, which makes analog output
+		 * signals without files.
+		 */
+		QPushButton* generateAnalogOutputButton;
+		StimulusGeneratorPanel* generatorPanel;
+
+		/*! Shows the summary of the last analog output checked. */
+		QLabel* analogOutputSummary;
+
+		/*! Selects clipping analog output to the limits of the DAC,
+		 * rather than rejecting it.
+		 */
+		QCheckBox* clipAnalogOutputBox;
+
+		/*! Shows the progress of loading or sending the analog output,
+		 * in place of the line showing its file.
+		 */
+		QProgressBar* analogOutputProgress;
+
+		/*! Cancels loading or sending the analog output, in place of
+		 * clearing it.
+		 */
+		QPushButton* cancelAnalogOutputButton;
+
+		/*! Reads analog output files on a worker thread, for staged changes. */
+		AnalogOutputLoader* analogOutputLoader;
+
+		/*! Streams analog output files to the BLDS in chunks. */
+		AnalogOutputUpload* analogOutputUpload;
+
+		/*! Session shared with the rest of the application, used to get
+		 * and set the values of the parameters corresponding to the
+		 * provided widgets.
+		 */
+		QPointer<BldsSession> session;
+
+		/*! Count of requests made for each source parameter, used to
+		 * tell whether a reply is for the most recent request.
+		 */
+		QHash<QString, quint64> sourceRequestGenerations;
+
+		/*! Number of requests to set source parameters awaiting a reply. */
+		int pendingSourceRequests;
+
+		/*! Number of requests awaiting a reply, for each parameter. */
+		QHash<QString, int> inFlightParameters;
+
+		/*! Check box which selects staging changes rather than sending
+		 * them immediately.
+		 */
+		QCheckBox* stageChangesBox;
+
+		/*! Button to send all staged changes. */
+		QPushButton* applyChangesButton;
+
+		/*! Button to discard all staged changes. */
+		QPushButton* discardChangesButton;
+
+		/*! Coalesces the stream of values from the ADC range spin box. */
+		ParameterCoalescer* adcRangeCoalescer;
+
+		/*! Transaction collecting staged changes. */
+		SourceConfigTransaction* transaction;
+
+		/*! Functions called for each staged change the server accepts. */
+		QMap<QString, std::function<void()>> stagedChangeHandlers;
+
+		/*! New value of each staged change. */
+		QMap<QString, QVariant> stagedValues;
+
+		/*! Staged changes accepted by the server and not rolled back. */
+		QSet<QString> acceptedStagedChanges;
+
+		/*! Number of requests sent by the transaction being applied. */
+		int applyingRequests;
+
+		/*! A change made while the staged changes are being applied. */
+		struct DeferredChange {
+			QVariant value;
+			QString description;
+			std::function<void()> onSuccess;
+		};
+
+		/*! Changes to be staged once the transaction being applied
+		 * finishes, by parameter.
 		 */
-		QPointer<BldsClient> client;
+		QMap<QString, DeferredChange> deferredChanges;
 };
 
 #endif
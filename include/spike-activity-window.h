@@ -0,0 +1,141 @@
+/*! \file spike-activity-window.h
+ *
+ * Header for the SpikeActivityWindow class, which shows the rate of
+ * spikes on every electrode of the array as it is recorded.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_SPIKE_ACTIVITY_WINDOW_H
+#define MEACTL_SPIKE_ACTIVITY_WINDOW_H
+
+#include "channel-heatmap.h"
+#include "live-data-feed.h"
+#include "spike-detector.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QtWidgets>
+
+#include <memory>
+
+/*! \class SpikeActivityWindow
+ *
+ * The SpikeActivityWindow shows which electrodes of the array are
+ * active, so that one can judge a preparation before committing to a
+ * long recording. Chunks from the LiveDataFeed are passed through a
+ * SpikeDetector, and the rate of spikes on each channel, averaged over
+ * about RateTimeConstant seconds, is shown by a ChannelHeatmap.
+ *
+ * Detection runs on one worker thread, one batch of chunks at a time.
+ * Chunks which arrive while a batch is being processed make up the
+ * next batch, so none is dropped while the detector keeps up. The time
+ * taken to detect spikes, as a fraction of the time spanned by the data,
+ * is shown, to tell whether it does.
+ *
+ * The detector and rates start afresh when the shape of the data
+ * changes or a new recording begins. The window only takes data from
+ * the feed while it is shown.
+ */
+class SpikeActivityWindow : public QWidget {
+	Q_OBJECT
+
+		/*! Time constant of the average spike rate, in seconds. */
+		const double RateTimeConstant = 1.;
+
+	public:
+
+		/*! Construct a SpikeActivityWindow.
+		 *
+		 * \param feed The feed of live data from the BLDS.
+		 * \param parent The parent widget.
+		 */
+		SpikeActivityWindow(LiveDataFeed* feed, QWidget* parent = nullptr);
+
+		/*! Destroy a SpikeActivityWindow, waiting for any batch being
+		 * processed.
+		 */
+		~SpikeActivityWindow();
+
+		/* Copying is not allowed. */
+		SpikeActivityWindow(const SpikeActivityWindow&) = delete;
+		SpikeActivityWindow(SpikeActivityWindow&&) = delete;
+		SpikeActivityWindow& operator=(const SpikeActivityWindow&) = delete;
+
+	protected:
+
+		/* Start or stop taking data from the feed. */
+		void showEvent(QShowEvent* event) override;
+		void hideEvent(QHideEvent* event) override;
+
+	private slots:
+
+		/* Queue a chunk of data to be processed with the next batch. */
+		void handleChunk(const DataChunk& chunk);
+
+		/* Start processing the queued chunks on a worker thread. */
+		void processChunks();
+
+	private:
+
+		/*! Detector and rates, only used by one worker at a time. */
+		struct State {
+			SpikeDetector detector;
+			QVector<float> rates;
+			float lastStop = -1.f;
+		};
+
+		/*! The result of processing a batch of chunks. */
+		struct Result {
+			QVector<float> rates;
+			int channels = 0;
+			double sampleRate = 0.;
+			double seconds = 0.;
+			qint64 nsecs = 0;
+		};
+
+		/* Detect the spikes in a batch of chunks, and update the rates. */
+		static Result detect(State* state, const QList<DataChunk>& chunks,
+				float factor, double timeConstant);
+
+		/*! Feed of live data. */
+		QPointer<LiveDataFeed> feed;
+
+		/*! Layout of the window. */
+		QGridLayout* layout;
+
+		/*! Chooses the threshold, as a multiple of the noise. */
+		QLabel* thresholdLabel;
+		QDoubleSpinBox* thresholdBox;
+
+		/*! Chooses the spike rate shown brightest. */
+		QLabel* scaleLabel;
+		QSpinBox* scaleBox;
+
+		/*! Shows the shape of the data, the total spike rate and the
+		 * load of the detector.
+		 */
+		QLabel* statusLabel;
+
+		/*! Shows the spike rate of each channel. */
+		ChannelHeatmap* heatmap;
+
+		/*! Detector and rates. */
+		std::shared_ptr<State> state;
+
+		/*! Chunks received since the last batch was started. */
+		QList<DataChunk> pendingChunks;
+
+		/*! Batch being processed, if any. */
+		QFuture<Result> worker;
+
+		/*! Time spent detecting, and the time spanned by the data
+		 * processed, since the status was last shown.
+		 */
+		qint64 busyNsecs;
+		double processedSeconds;
+		QElapsedTimer statusTimer;
+};
+
+#endif
+
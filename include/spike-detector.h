@@ -0,0 +1,173 @@
+/*! \file spike-detector.h
+ *
+ * Header for the SpikeDetector class, which detects spikes in live data
+ * as it arrives.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_SPIKE_DETECTOR_H
+#define MEACTL_SPIKE_DETECTOR_H
+
+#include "data-chunk.h"
+
+#include <QtCore>
+
+#include <vector>
+
+/*! \class SpikeDetector
+ *
+ * The SpikeDetector counts the spikes on every channel of a stream of
+ * DataChunks. Each channel is filtered to the band of spikes, from
+ * LowCutoff to HighCutoff, by a second-order high-pass and a
+ * second-order low-pass Butterworth section. A spike is a sample of the
+ * filtered signal below the negative of the channel's threshold, which
+ * is not within RefractoryPeriod of the last spike on that channel.
+ *
+ * The threshold of each channel is a multiple of a robust estimate of
+ * its noise, the median absolute value of the filtered signal divided
+ * by 0.6745. The median is taken over up to MadSamples samples of each
+ * chunk, evenly spaced, and is smoothed across chunks. The samples of a
+ * chunk are tested against the threshold estimated from the chunks
+ * before it, so the data is read only once, and no spike is reported
+ * until the first chunk has been seen.
+ *
+ * Chunks are processed on the calling thread, with no allocation once
+ * the detector has been reset. With SSE2, four channels are filtered and
+ * tested at once, four samples at a time.
+ */
+class SpikeDetector {
+
+	public:
+
+		/*! Lower edge of the pass band, in Hz. */
+		static const int LowCutoff = 300;
+
+		/*! Upper edge of the pass band, in Hz. It is lowered for sample
+		 * rates too low to pass it.
+		 */
+		static const int HighCutoff = 3000;
+
+		/*! Number of channels filtered at once. */
+		static const int Lanes = 4;
+
+		/*! Largest number of samples of each chunk in the estimate of the
+		 * noise of each channel.
+		 */
+		static const int MadSamples = 512;
+
+		/*! Time after each spike, in seconds, during which no other spike
+		 * is reported on the same channel.
+		 */
+		static constexpr double RefractoryPeriod = 0.001;
+
+		/*! Time after a reset, in seconds, during which no spike is
+		 * reported, while the filters settle.
+		 */
+		static constexpr double SettlingTime = 0.01;
+
+		/*! Weight of each chunk's estimate of the noise in the smoothed
+		 * estimate.
+		 */
+		static constexpr float NoiseSmoothing = 0.2f;
+
+		/*! Construct a SpikeDetector.
+		 *
+		 * \param channels The number of channels.
+		 * \param sampleRate The sample rate of the data, in Hz.
+		 */
+		SpikeDetector(int channels = 0, double sampleRate = 0.);
+
+		/*! Forget all data, and set the shape of the data. */
+		void reset(int channels, double sampleRate);
+
+		/*! Return the number of channels. */
+		int channels() const;
+
+		/*! Return the sample rate, in Hz. */
+		double sampleRate() const;
+
+		/*! Set the threshold, as a multiple of the estimated noise. */
+		void setThresholdFactor(float factor);
+
+		/*! Return the threshold, as a multiple of the estimated noise. */
+		float thresholdFactor() const;
+
+		/*! Return the threshold of a channel in ADC counts, or 0 if no
+		 * data has been seen.
+		 */
+		float threshold(int channel) const;
+
+		/*! Detect the spikes in a chunk of data, which must have
+		 * channels() channels.
+		 *
+		 * \return True if the chunk was processed.
+		 */
+		bool process(const DataChunk& chunk);
+
+		/*! Return the number of spikes on each channel in the last
+		 * chunk processed.
+		 */
+		const QVector<int>& counts() const;
+
+	private:
+
+		/* Filter and test the samples of one channel from the given
+		 * sample, without SIMD.
+		 */
+		void processChannel(int channel, const qint16* x, qint64 from,
+				qint64 frames, qint64 stride, float limit);
+
+		/* Set the thresholds from the samples of the last chunk. */
+		void updateThresholds(int sampled);
+
+		/* Return the index of an item of a channel in the arrays laid
+		 * out one group of Lanes channels after another.
+		 */
+		static int laneIndex(int channel, int item, int items);
+
+		/*! Number of channels. */
+		int nchannels;
+
+		/*! Number of channels rounded up to a whole number of groups. */
+		int padded;
+
+		/*! Sample rate, in Hz. */
+		double rate;
+
+		/*! Threshold as a multiple of the noise. */
+		float factor;
+
+		/*! Coefficients of the high-pass and low-pass sections, as
+		 * b0, b1, b2, a1 and a2, with a0 equal to 1.
+		 */
+		float coefficients[2][5];
+
+		/*! Delay state of the sections, four values per channel. */
+		std::vector<float> state;
+
+		/*! Number of samples each channel must wait before another
+		 * spike may be reported.
+		 */
+		std::vector<qint32> refractory;
+
+		/*! Number of samples in the refractory period. */
+		qint32 refractorySamples;
+
+		/*! Smoothed noise of each channel, or 0 if not yet known. */
+		std::vector<float> noise;
+
+		/*! Absolute values of the filtered samples of the last chunk
+		 * used to estimate the noise, MadSamples per channel.
+		 */
+		std::vector<float> magnitudes;
+
+		/*! Scratch space for the median of one channel. */
+		std::vector<float> scratch;
+
+		/*! Spikes on each channel in the last chunk. */
+		QVector<int> spikeCounts;
+};
+
+#endif
+
@@ -0,0 +1,206 @@
+/*! \file stimulus-cache.h
+ *
+ * Header for the StimulusCache class, which keeps recently used analog
+ * output signals in memory.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_STIMULUS_CACHE_H
+#define MEACTL_STIMULUS_CACHE_H
+
+#include "waveform-view.h"
+
+#include <QtCore>
+
+#include <functional>
+
+/*! \class StimulusCache
+ *
+ * The StimulusCache keeps the analog output signals most recently read
+ * from files, so that reselecting a stimulus does not read its file again.
+ *
+ * Each signal is keyed by its file's canonical path, modification time
+ * and size, so that an entry is never used once its file has changed.
+ * A signal which was changed before being sent, such as by clipping or
+ * resampling, is also keyed by a variant describing the change (see
+ * StimulusValidator::Options::fingerprint()), so that it is only used
+ * when the same change is wanted. Only one variant of a file is held.
+ * Each signal is also identified by a hash of its samples and number of
+ * channels, which is compared with the hash of the signal the server
+ * holds (see BldsSession::analogOutputHash()) to avoid sending a signal
+ * the server already has.
+ *
+ * The cache holds at most capacity() bytes of samples, evicting the
+ * least recently used signals first but keeping their hashes. A signal
+ * larger than the capacity is not cached. Signals mapped from files
+ * count against the capacity too, although their pages belong to the
+ * page cache and may be reclaimed by the system.
+ *
+ * A signal streamed from its file is never held in memory as a whole,
+ * so only its hash is kept, see insertHash(). Such a signal is read from
+ * its file again when it is next needed, but is not sent again if the
+ * server already holds it. The hashes take no part in the capacity.
+ */
+class StimulusCache : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Default capacity of the cache in bytes. */
+		static const qint64 DefaultCapacity = 512LL * 1024 * 1024;
+
+		/*! A cached signal. */
+		struct Entry {
+
+			/*! Hash of the samples of the signal. */
+			QByteArray hash;
+
+			/*! The samples of the signal. */
+			WaveformView samples;
+		};
+
+		/*! Construct a StimulusCache.
+		 *
+		 * \param capacity The largest number of bytes of samples held.
+		 * \param parent The parent object.
+		 */
+		StimulusCache(qint64 capacity = DefaultCapacity, QObject* parent = nullptr);
+
+		/*! Destroy a StimulusCache. */
+		~StimulusCache();
+
+		/* Copying is not allowed. */
+		StimulusCache(const StimulusCache&) = delete;
+		StimulusCache(StimulusCache&&) = delete;
+		StimulusCache& operator=(const StimulusCache&) = delete;
+
+		/*! Return the hash identifying a signal.
+		 *
+		 * \param samples The signal.
+		 * \param progress If given, called with the number of samples
+		 * 	hashed so far and the total, returning false to cancel.
+		 * \return The hash, or an empty array if canceled.
+		 */
+		static QByteArray hash(const WaveformView& samples,
+				std::function<bool(qint64, qint64)> progress = nullptr);
+
+		/*! Return true if the current contents of a file are cached,
+		 * in the given variant.
+		 */
+		bool contains(const QString& file, const QString& variant = QString()) const;
+
+		/*! Return the cached signal read from a file, marking it as the
+		 * most recently used.
+		 *
+		 * \param file The name of the file.
+		 * \param entry Set to the cached signal, if any.
+		 * \param variant The variant of the signal wanted.
+		 * \return True if the current contents of the file are cached.
+		 */
+		bool lookup(const QString& file, Entry* entry,
+				const QString& variant = QString());
+
+		/*! Cache a signal read from a file, replacing any earlier entry
+		 * for the file, and evicting others as needed.
+		 *
+		 * \param file The name of the file.
+		 * \param samples The signal read from the file.
+		 * \param hash The hash of the signal, computed if not given.
+		 * \param variant The variant of the signal.
+		 */
+		void insert(const QString& file, const WaveformView& samples,
+				const QByteArray& hash = QByteArray(),
+				const QString& variant = QString());
+
+		/*! Remember only the hash of a signal read from a file, replacing
+		 * any earlier entry for the file.
+		 *
+		 * \param file The name of the file.
+		 * \param hash The hash of the signal.
+		 * \param variant The variant of the signal.
+		 */
+		void insertHash(const QString& file, const QByteArray& hash,
+				const QString& variant = QString());
+
+		/*! Return the hash of the signal read from a file, whether its
+		 * samples are cached or only its hash.
+		 *
+		 * \param file The name of the file.
+		 * \param variant The variant of the signal wanted.
+		 * \return The hash, or an empty array if the current contents
+		 * 	of the file are not known.
+		 */
+		QByteArray lookupHash(const QString& file,
+				const QString& variant = QString()) const;
+
+		/*! Return the largest number of bytes of samples held. */
+		qint64 capacity() const;
+
+		/*! Set the largest number of bytes of samples held, evicting
+		 * signals as needed.
+		 */
+		void setCapacity(qint64 capacity);
+
+		/*! Return the number of bytes of samples held. */
+		qint64 size() const;
+
+		/*! Return the number of signals held. */
+		int count() const;
+
+		/*! Return the number of lookups which found, or did not find,
+		 * a cached signal.
+		 */
+		int hits() const;
+		int misses() const;
+
+	public slots:
+
+		/*! Remove all cached signals. */
+		void clear();
+
+	private:
+
+		/* Return the key of a variant of the current contents of a file,
+		 * or an empty string if the file does not exist.
+		 */
+		static QString key(const QString& file, const QString& variant);
+
+		/* Forget any signal or hash cached for a file. */
+		void remove(const QString& path);
+
+		/* Evict the least recently used signals until the cache holds
+		 * no more than its capacity, keeping only their hashes.
+		 */
+		void evict();
+
+		/* Return the number of bytes of samples in a signal. */
+		static qint64 bytes(const WaveformView& samples);
+
+		/*! Cached signals, by key. */
+		QHash<QString, Entry> entries;
+
+		/*! Keys of all cached signals, least recently used first. */
+		QStringList order;
+
+		/*! Hashes of signals whose samples are not held, by key. */
+		QHash<QString, QByteArray> hashes;
+
+		/*! Key of the cached signal or hash of each file, by canonical
+		 * path.
+		 */
+		QHash<QString, QString> fileKeys;
+
+		/*! Largest number of bytes of samples held. */
+		qint64 maxBytes;
+
+		/*! Number of bytes of samples held. */
+		qint64 usedBytes;
+
+		/*! Number of lookups which found, or did not find, a signal. */
+		int hitCount;
+		int missCount;
+};
+
+#endif
+
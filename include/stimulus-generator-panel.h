@@ -0,0 +1,105 @@
+/*! \file stimulus-generator-panel.h
+ *
+ * Header for the StimulusGeneratorPanel class, which lets the user
+ * describe a signal and generate it.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_STIMULUS_GENERATOR_PANEL_H
+#define MEACTL_STIMULUS_GENERATOR_PANEL_H
+
+#include "stimulus-generator.h"
+
+#include <QtCore>
+#include <QtConcurrent>
+#include <QtWidgets>
+
+/*! \class StimulusGeneratorPanel
+ *
+ * The StimulusGeneratorPanel shows the parameters of a StimulusGenerator
+ * signal, enabling only those used by the chosen waveform. Generating
+ * the signal, and hashing it, is done on a worker thread, and the result
+ * is reported by generated() to be sent like a signal read from a file.
+ */
+class StimulusGeneratorPanel : public QGroupBox {
+	Q_OBJECT
+
+	public:
+
+		/*! Construct a StimulusGeneratorPanel. */
+		StimulusGeneratorPanel(QWidget* parent = nullptr);
+
+		/*! Destroy a StimulusGeneratorPanel, waiting for any signal
+		 * being generated.
+		 */
+		~StimulusGeneratorPanel();
+
+		/* Copying is not allowed. */
+		StimulusGeneratorPanel(const StimulusGeneratorPanel&) = delete;
+		StimulusGeneratorPanel(StimulusGeneratorPanel&&) = delete;
+		StimulusGeneratorPanel& operator=(const StimulusGeneratorPanel&) = delete;
+
+		/*! Return the parameters currently shown. */
+		StimulusGenerator::Parameters parameters() const;
+
+	public slots:
+
+		/*! Generate the signal described by the current parameters. */
+		void generate();
+
+	signals:
+
+		/*! Emitted when a signal has been generated.
+		 *
+		 * \param name Describes the signal, in place of a file name.
+		 * \param signal The signal.
+		 * \param hash The hash of the signal, see StimulusCache::hash().
+		 */
+		void generated(const QString& name, const WaveformView& signal,
+				const QByteArray& hash);
+
+	private:
+
+		/*! A generated signal and its hash. */
+		struct Result {
+			WaveformView signal;
+			QByteArray hash;
+		};
+
+		/* Enable the parameters used by the chosen waveform. */
+		void updateEnabledParameters();
+
+		/* Add a labeled spin box to the layout. */
+		QDoubleSpinBox* addParameter(const QString& label, double min,
+				double max, double value, const QString& suffix, int decimals = 2);
+
+		/*! Layout of the panel. */
+		QFormLayout* layout;
+
+		/*! Chooses the waveform. */
+		QComboBox* waveformBox;
+
+		/*! Parameters of the signal. */
+		QDoubleSpinBox* sampleRateBox;
+		QDoubleSpinBox* durationBox;
+		QDoubleSpinBox* amplitudeBox;
+		QDoubleSpinBox* offsetBox;
+		QDoubleSpinBox* frequencyBox;
+		QDoubleSpinBox* endFrequencyBox;
+		QDoubleSpinBox* periodBox;
+		QDoubleSpinBox* dutyCycleBox;
+		QSpinBox* seedBox;
+
+		/*! Shows the number of samples the signal will have. */
+		QLabel* lengthLabel;
+
+		/*! Starts generating the signal. */
+		QPushButton* generateButton;
+
+		/*! Signal being generated, if any. */
+		QFuture<Result> worker;
+};
+
+#endif
+
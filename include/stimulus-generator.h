@@ -0,0 +1,125 @@
+/*! \file stimulus-generator.h
+ *
+ * Header for the StimulusGenerator class, which synthesizes analog
+ * output signals from a few parameters.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_STIMULUS_GENERATOR_H
+#define MEACTL_STIMULUS_GENERATOR_H
+
+#include "waveform-view.h"
+
+#include <QtCore>
+
+/*! \class StimulusGenerator
+ *
+ * The StimulusGenerator synthesizes common analog output signals, so that
+ * they need not be written to files first. A signal is described by a
+ * Parameters value, and generating it twice from the same parameters
+ * always gives the same samples, including white noise, which is drawn
+ * from a generator seeded by the parameters.
+ *
+ * The signal is generated in blocks of BlockSize samples on the global
+ * thread pool. Each block is computed from its position alone, so the
+ * result does not depend on how blocks are scheduled. Sines are computed
+ * with a polynomial, and noise with a counter-based generator, so that
+ * minutes of signal take milliseconds. Where SSE2 is available, every
+ * waveform is computed two samples at a time, giving the same samples as
+ * without it.
+ */
+class StimulusGenerator {
+
+	public:
+
+		/*! Number of samples generated by each task. */
+		static const int BlockSize = 1 << 14;
+
+		/*! Shapes of signal which can be generated. */
+		enum class Waveform {
+
+			/*! A sine of constant frequency. */
+			Sine,
+
+			/*! A sine sweeping linearly from frequency to endFrequency. */
+			Chirp,
+
+			/*! Gaussian white noise, with standard deviation amplitude. */
+			Noise,
+
+			/*! Pulses of height amplitude, every period, lasting
+			 * dutyCycle of it.
+			 */
+			Flash,
+
+			/*! A ramp from offset to offset + amplitude, repeated every
+			 * period, or over the whole signal if period is zero.
+			 */
+			Ramp
+		};
+
+		/*! Parameters describing a signal. */
+		struct Parameters {
+
+			/*! Shape of the signal. */
+			Waveform waveform = Waveform::Sine;
+
+			/*! Sample rate of the analog output, in Hz. */
+			double sampleRate = 10000.;
+
+			/*! Length of the signal, in seconds. */
+			double duration = 10.;
+
+			/*! Amplitude of the signal, in volts. */
+			double amplitude = 1.;
+
+			/*! Value added to every sample, in volts. */
+			double offset = 0.;
+
+			/*! Frequency of a sine, or starting frequency of a chirp, in Hz. */
+			double frequency = 1.;
+
+			/*! Ending frequency of a chirp, in Hz. */
+			double endFrequency = 100.;
+
+			/*! Period of flashes or ramps, in seconds. */
+			double period = 1.;
+
+			/*! Fraction of each period for which a flash is on. */
+			double dutyCycle = 0.5;
+
+			/*! Seed of the noise generator. */
+			quint64 seed = 0;
+		};
+
+		/*! Return the names of the waveforms, in the order they are
+		 * declared.
+		 */
+		static QStringList waveformNames();
+
+		/*! Return the number of samples a signal will have. */
+		static qint64 sampleCount(const Parameters& params);
+
+		/*! Generate a signal.
+		 *
+		 * \param params The parameters of the signal.
+		 * \return The signal, or an empty signal if the parameters are
+		 * 	not valid.
+		 */
+		static WaveformView generate(const Parameters& params);
+
+		/*! Return a short description of a signal, used in place of the
+		 * name of a file.
+		 */
+		static QString describe(const Parameters& params);
+
+	private:
+
+		/* Generate the samples from first up to last. */
+		static void generateBlock(const Parameters& params, qint64 first,
+				qint64 last, double* out);
+};
+
+#endif
+
@@ -0,0 +1,175 @@
+/*! \file stimulus-validator.h
+ *
+ * Header for the StimulusValidator class, which checks analog output
+ * signals before they are sent, and prepares them for the source.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_STIMULUS_VALIDATOR_H
+#define MEACTL_STIMULUS_VALIDATOR_H
+
+#include "waveform-view.h"
+
+#include <QtCore>
+
+#include <limits>
+
+/*! \class StimulusValidator
+ *
+ * The StimulusValidator checks an analog output signal before it is
+ * sent, so that a bad signal is reported before an experiment starts
+ * rather than by the server, or not at all. It:
+ *
+ * 	- resamples the signal to the sample rate of the source, if both
+ * 	rates are known and they differ, with a polyphase windowed-sinc
+ * 	filter;
+ * 	- scans the signal for NaN and infinite samples, which are always
+ * 	rejected;
+ * 	- checks every sample against the limits of the DAC, and either
+ * 	rejects the signal or clips it to the limits; and
+ * 	- summarizes the signal's range, RMS and duration.
+ *
+ * The signal is processed in blocks of BlockSize samples on the global
+ * thread pool, two samples at a time where SSE2 is available. A signal
+ * which needs no change is returned as it was, so a mapped signal is
+ * never copied just to check it.
+ */
+class StimulusValidator {
+
+	public:
+
+		/*! Number of samples processed by each task. */
+		static const int BlockSize = 1 << 16;
+
+		/*! Number of filter taps applied for each resampled sample. */
+		static const int TapsPerPhase = 32;
+
+		/*! Largest upsampling factor, which bounds the filter's size. */
+		static const int MaxInterpolation = 1024;
+
+		/*! Default limits of the DAC, in volts. */
+		static constexpr double DefaultMinimum = -10.;
+		static constexpr double DefaultMaximum = 10.;
+
+		/*! How a signal is checked. */
+		struct Options {
+
+			/*! Limits of the DAC, in volts. */
+			double minimum = DefaultMinimum;
+			double maximum = DefaultMaximum;
+
+			/*! If true, samples beyond the limits are clipped rather
+			 * than rejected.
+			 */
+			bool clip = false;
+
+			/*! Sample rate of the source in Hz, or 0 if not known. */
+			double sampleRate = 0.;
+
+			/*! Return a string which differs whenever the options would
+			 * change a signal, used to cache processed signals.
+			 */
+			QString fingerprint() const;
+		};
+
+		/*! A summary of a signal. */
+		struct Summary {
+
+			/*! Number of samples, and of channels. */
+			qint64 samples = 0;
+			int channels = 1;
+
+			/*! Sample rate in Hz, or 0 if not known. */
+			double sampleRate = 0.;
+
+			/*! Smallest and largest finite samples. */
+			double minimum = std::numeric_limits<double>::infinity();
+			double maximum = -std::numeric_limits<double>::infinity();
+
+			/*! Sum of the squares of the finite samples. */
+			double sumSquares = 0.;
+
+			/*! Number of NaN or infinite samples. */
+			qint64 nonFinite = 0;
+
+			/*! Number of finite samples beyond the limits. */
+			qint64 outOfRange = 0;
+
+			/*! Number of samples clipped to the limits. */
+			qint64 clipped = 0;
+
+			/*! Sample rate the signal was resampled from, or 0. */
+			double resampledFrom = 0.;
+
+			/*! Return the RMS of the finite samples. */
+			double rms() const;
+
+			/*! Return the duration in seconds, or 0 if not known. */
+			double duration() const;
+
+			/*! Combine the summary of the samples which follow. */
+			void merge(const Summary& other);
+
+			/*! Return why the signal cannot be sent, or an empty string
+			 * if it can.
+			 */
+			QString error(const Options& options) const;
+
+			/*! Return a description of the signal for display. */
+			QString describe() const;
+		};
+
+		/*! Return the options for a source, as reported by its status.
+		 *
+		 * \param status The status of the source.
+		 * \param clip Whether samples beyond the limits are clipped.
+		 */
+		static Options optionsFor(const QJsonObject& status, bool clip);
+
+		/*! Return true if a signal with the given sample rate would be
+		 * resampled, because both it and the source's rate are known and
+		 * they differ.
+		 */
+		static bool needsResampling(double sampleRate, const Options& options);
+
+		/*! Summarize some samples. */
+		static Summary scan(const double* samples, qint64 count,
+				const Options& options);
+
+		/*! Summarize a signal. */
+		static Summary scan(const WaveformView& signal, const Options& options);
+
+		/*! Clip samples to the limits in place, returning the number
+		 * clipped.
+		 */
+		static qint64 clip(double* samples, qint64 count, const Options& options);
+
+		/*! Resample a signal.
+		 *
+		 * \param signal The signal.
+		 * \param fromRate The sample rate of the signal in Hz.
+		 * \param toRate The new sample rate in Hz.
+		 * \return The resampled signal, or a null view if the ratio of
+		 * 	the rates needs too large a filter.
+		 */
+		static WaveformView resample(const WaveformView& signal,
+				double fromRate, double toRate);
+
+		/*! Resample, check and clip a signal as the options require.
+		 *
+		 * \param signal The signal.
+		 * \param options How to check the signal.
+		 * \param summary Receives the summary of the signal returned.
+		 * \return The signal to send, which is the given one if nothing
+		 * 	needed to change. The signal cannot be sent if
+		 * 	summary->error() is not empty.
+		 */
+		static WaveformView process(const WaveformView& signal,
+				const Options& options, Summary* summary);
+};
+
+Q_DECLARE_METATYPE(StimulusValidator::Summary)
+
+#endif
+
@@ -0,0 +1,142 @@
+/*! \file waveform-view.h
+ *
+ * Header for the WaveformView class, a read-only view of the samples
+ * of an analog output signal.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_WAVEFORM_VIEW_H
+#define MEACTL_WAVEFORM_VIEW_H
+
+#include <QtCore>
+
+#include <memory>
+
+/*! \class WaveformView
+ *
+ * The WaveformView gives read-only access to the samples of a signal,
+ * wherever they are stored. The samples are either held in a QVector,
+ * or are part of a file mapped into memory, in which case they are read
+ * straight from the page cache and are never copied.
+ *
+ * A signal may have several channels, in which case its samples are
+ * interleaved in frames, holding one sample of each channel, as the data
+ * source expects them. interleave() packs separate channels into frames.
+ *
+ * Views are cheap to copy, and copies share the same samples. A mapped
+ * file stays mapped until the last view of it is destroyed. The file
+ * must not be truncated while it is mapped; replacing it, as editors and
+ * most programs writing HDF5 files do, is safe.
+ */
+class WaveformView {
+
+	public:
+
+		/*! Construct an empty view. */
+		WaveformView();
+
+		/*! Construct a view of samples held in memory.
+		 *
+		 * \param samples The samples, interleaved in frames.
+		 * \param channels The number of channels.
+		 * \param sampleRate The sample rate in Hz, or 0 if not known.
+		 */
+		WaveformView(const QVector<double>& samples, int channels = 1,
+				double sampleRate = 0.);
+
+		/*! Map part of a file into memory, and return a view of it.
+		 *
+		 * \param file The name of the file.
+		 * \param offset Offset in bytes of the first sample in the file.
+		 * \param count Number of samples, each a native double.
+		 * \return The view of a single channel, or a null view if the
+		 * 	file could not be mapped, or the samples would not be
+		 * 	aligned in memory.
+		 */
+		static WaveformView map(const QString& file, qint64 offset, qint64 count);
+
+		/*! Pack separate channels into interleaved frames.
+		 *
+		 * \param planar The samples of each channel in turn, each
+		 * 	channel holding frames samples.
+		 * \param channels The number of channels.
+		 * \param frames The number of samples of each channel.
+		 * \param out Receives channels * frames samples, interleaved.
+		 */
+		static void interleave(const double* planar, int channels,
+				qint64 frames, double* out);
+
+		/*! Return true for a view constructed empty, or which could not
+		 * be mapped.
+		 */
+		bool isNull() const;
+
+		/*! Return true if the view has no samples. */
+		bool isEmpty() const;
+
+		/*! Return true if the samples are read from a mapped file. */
+		bool isMapped() const;
+
+		/*! Return the number of samples, in all channels. */
+		qint64 size() const;
+
+		/*! Return the number of channels. */
+		int channels() const;
+
+		/*! Return the number of frames, the length of each channel. */
+		qint64 frames() const;
+
+		/*! Return the sample rate in Hz, or 0 if it is not known. */
+		double sampleRate() const;
+
+		/*! Set the sample rate in Hz. */
+		void setSampleRate(double rate);
+
+		/*! Return the samples. */
+		const double* constData() const;
+
+		/*! Return one sample. */
+		double at(qint64 index) const;
+
+		/*! Return a copy of some of the samples.
+		 *
+		 * \param offset Index of the first sample.
+		 * \param count Number of samples. Fewer are returned if the view
+		 * 	ends first.
+		 */
+		QVector<double> mid(qint64 offset, qint64 count) const;
+
+		/*! Return a copy of all of the samples. A view of samples held in
+		 * memory returns them without copying.
+		 */
+		QVector<double> toVector() const;
+
+	private:
+
+		/*! Samples held in memory, if not mapped. */
+		QVector<double> samples;
+
+		/*! Mapped file, if any, unmapped when closed. */
+		std::shared_ptr<QFile> mappedFile;
+
+		/*! First mapped sample, if any. */
+		const double* mapped;
+
+		/*! Number of mapped samples. */
+		qint64 mappedCount;
+
+		/*! Number of interleaved channels. */
+		int channelCount;
+
+		/*! Sample rate in Hz, or 0 if not known. */
+		double rate;
+
+		/*! True unless constructed empty. */
+		bool valid;
+};
+
+Q_DECLARE_METATYPE(WaveformView)
+
+#endif
+
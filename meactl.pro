@@ -14,7 +14,7 @@ linux {
 	INCLUDEPATH += /usr/include/hdf5/serial
 }
 
-QT += gui widgets network 
+QT += gui widgets network concurrent
 CONFIG += c++11 debug_and_release
 CONFIG -= app_bundle
 
@@ -38,9 +38,70 @@ LIBS += -lhdf5_cpp -lhdf5
 
 # Input
 HEADERS += include/meactl-window.h \
+		include/blds-session.h \
 		include/source-settings-window.h \
-		include/meactl-widget.h
+		include/meactl-widget.h \
+		include/parameter-coalescer.h \
+		include/recording-status-monitor.h \
+		include/source-config-transaction.h \
+		include/headless-controller.h \
+		include/recording-queue.h \
+		include/rig-status-scheduler.h \
+		include/multi-rig-window.h \
+		include/latency-histogram.h \
+		include/latency-recorder.h \
+		include/latency-window.h \
+		include/analog-output-loader.h \
+		include/analog-output-upload.h \
+		include/stimulus-cache.h \
+		include/waveform-view.h \
+		include/stimulus-generator.h \
+		include/stimulus-generator-panel.h \
+		include/stimulus-validator.h \
+		include/data-chunk.h \
+		include/live-data-feed.h \
+		include/decimation-pyramid.h \
+		include/data-preview-window.h \
+		include/notification-center.h \
+		include/notification-toasts.h \
+		include/notification-window.h \
+		include/notification-button.h \
+		include/spike-detector.h \
+		include/channel-heatmap.h \
+		include/spike-activity-window.h \
+		include/channel-statistics.h \
+		include/channel-statistics-window.h
 SOURCES += src/meactl-window.cc \
+		src/blds-session.cc \
 		src/source-settings-window.cc \
-		src/meactl-widget.cc \ 
+		src/meactl-widget.cc \
+		src/parameter-coalescer.cc \
+		src/recording-status-monitor.cc \
+		src/source-config-transaction.cc \
+		src/headless-controller.cc \
+		src/recording-queue.cc \
+		src/rig-status-scheduler.cc \
+		src/multi-rig-window.cc \
+		src/latency-histogram.cc \
+		src/latency-recorder.cc \
+		src/latency-window.cc \
+		src/analog-output-loader.cc \
+		src/analog-output-upload.cc \
+		src/stimulus-cache.cc \
+		src/waveform-view.cc \
+		src/stimulus-generator.cc \
+		src/stimulus-generator-panel.cc \
+		src/stimulus-validator.cc \
+		src/live-data-feed.cc \
+		src/decimation-pyramid.cc \
+		src/data-preview-window.cc \
+		src/notification-center.cc \
+		src/notification-toasts.cc \
+		src/notification-window.cc \
+		src/notification-button.cc \
+		src/spike-detector.cc \
+		src/channel-heatmap.cc \
+		src/spike-activity-window.cc \
+		src/channel-statistics.cc \
+		src/channel-statistics-window.cc \
 		src/main.cc
@@ -0,0 +1,368 @@
+/*! \file analog-output-loader.cc
+ *
+ * Implementation of the AnalogOutputLoader class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "H5Cpp.h"
+
+#include "analog-output-loader.h"
+#include "stimulus-cache.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+/* Serializes use of the HDF5 library by all loaders. */
+static QMutex hdf5Mutex;
+
+AnalogOutputLoader::AnalogOutputLoader(QObject* parent) :
+	QObject(parent),
+	loading(false),
+	generation(0)
+{
+}
+
+AnalogOutputLoader::~AnalogOutputLoader()
+{
+	cancel();
+	for (auto& worker : workers)
+		worker.waitForFinished();
+}
+
+/* Open the analog output dataset of a file, checking that it has one
+ * dimension, or two shaped (channels, samples). The caller must hold
+ * hdf5Mutex.
+ */
+static H5::DataSet openAnalogOutput(const QString& fname, H5::H5File& f)
+{
+	auto name = fname.toStdString();
+	if (!H5::H5File::isHdf5(name)) {
+		throw std::invalid_argument("The selected file is not in valid HDF5 format.");
+	}
+
+	f.openFile(name, H5F_ACC_RDONLY);
+	H5::DataSet dset;
+	try {
+		dset = f.openDataSet("analog-output");
+	} catch (...) {
+		f.close();
+		throw std::invalid_argument("The file doesn't have a dataset called 'analog-output'");
+	}
+
+	auto space = dset.getSpace();
+	auto rank = space.getSimpleExtentNdims();
+	if ((rank != 1) && (rank != 2)) {
+		f.close();
+		throw std::invalid_argument("The selected file has a dataset with "
+				"more than 2 dimensions. Analog output signals must be specified with "
+				"a single dimension, or two shaped (channels, samples), and with "
+				"double-precision data");
+	}
+	if (rank == 2) {
+		hsize_t dims[2] = { 0, 0 };
+		space.getSimpleExtentDims(dims);
+		if ((dims[0] == 0) ||
+				(dims[0] > static_cast<hsize_t>(AnalogOutputLoader::MaxChannels))) {
+			f.close();
+			throw std::invalid_argument(QString("The selected file has an analog "
+					"output signal with %1 channels, but there must be between 1 "
+					"and %2. Signals must be shaped (channels, samples).").arg(
+					static_cast<qulonglong>(dims[0])).arg(
+					AnalogOutputLoader::MaxChannels).toStdString());
+		}
+	}
+	return dset;
+}
+
+/* Return the shape of an analog output dataset, and its sample rate
+ * if it has a `sample-rate` attribute.
+ */
+static AnalogOutputLoader::Shape datasetShape(const H5::DataSet& dset)
+{
+	auto space = dset.getSpace();
+	hsize_t dims[2] = { 1, 0 };
+	if (space.getSimpleExtentNdims() == 1)
+		space.getSimpleExtentDims(dims + 1);
+	else
+		space.getSimpleExtentDims(dims);
+	AnalogOutputLoader::Shape shape;
+	shape.channels = static_cast<int>(dims[0]);
+	shape.frames = static_cast<qint64>(dims[1]);
+	shape.sampleRate = 0.;
+	try {
+		if (dset.attrExists("sample-rate")) {
+			auto attr = dset.openAttribute("sample-rate");
+			attr.read(H5::PredType::NATIVE_DOUBLE, &shape.sampleRate);
+		}
+	} catch (H5::Exception&) {
+		shape.sampleRate = 0.;
+	}
+	return shape;
+}
+
+/* Read a range of frames from an analog output dataset, interleaving
+ * the channels into out. Several channels are read side by side into
+ * planar, and then packed.
+ */
+static void readFrames(const H5::DataSet& dset, const AnalogOutputLoader::Shape& shape,
+		hsize_t offset, hsize_t count, double* out, QVector<double>& planar)
+{
+	try {
+		auto space = dset.getSpace();
+		if (space.getSimpleExtentNdims() == 1) {
+			space.selectHyperslab(H5S_SELECT_SET, &count, &offset);
+			H5::DataSpace memspace(1, &count);
+			dset.read(out, H5::PredType::IEEE_F64LE, memspace, space);
+			return;
+		}
+		hsize_t counts[2] = { static_cast<hsize_t>(shape.channels), count };
+		hsize_t offsets[2] = { 0, offset };
+		space.selectHyperslab(H5S_SELECT_SET, counts, offsets);
+		H5::DataSpace memspace(2, counts);
+		if (shape.channels == 1) {
+			dset.read(out, H5::PredType::IEEE_F64LE, memspace, space);
+			return;
+		}
+		planar.resize(static_cast<int>(shape.channels * count));
+		dset.read(planar.data(), H5::PredType::IEEE_F64LE, memspace, space);
+	} catch (H5::Exception& err) {
+		throw std::invalid_argument("Could not read the analog output: " +
+				err.getDetailMsg());
+	}
+	WaveformView::interleave(planar.constData(), shape.channels, count, out);
+}
+
+WaveformView AnalogOutputLoader::read(const QString& fname,
+		ProgressFunction progress)
+{
+	QMutexLocker lock(&hdf5Mutex);
+	H5::H5File f;
+	auto dset = openAnalogOutput(fname, f);
+	auto shape = datasetShape(dset);
+	auto length = shape.channels * shape.frames;
+	QVector<double> vec(static_cast<int>(length));
+	QVector<double> planar;
+
+	/* Read about ChunkSize samples at a time, so that progress can be
+	 * reported and the read canceled partway through.
+	 */
+	auto step = static_cast<qint64>(qMax(ChunkSize / shape.channels, 1));
+	qint64 offset = 0;
+	while (offset < shape.frames) {
+		auto count = qMin(step, shape.frames - offset);
+		readFrames(dset, shape, offset, count,
+				vec.data() + offset * shape.channels, planar);
+		offset += count;
+		if (progress && !progress(offset * shape.channels, length))
+			return WaveformView(QVector<double>(), shape.channels, shape.sampleRate);
+	}
+	return WaveformView(vec, shape.channels, shape.sampleRate);
+}
+
+WaveformView AnalogOutputLoader::map(const QString& fname)
+{
+	haddr_t offset = HADDR_UNDEF;
+	Shape shape;
+	{
+		QMutexLocker lock(&hdf5Mutex);
+		H5::H5File f;
+		auto dset = openAnalogOutput(fname, f);
+		shape = datasetShape(dset);
+		try {
+			/* Only raw doubles in the file itself are laid out as they
+			 * would be in memory, and only a single channel is already
+			 * laid out in frames.
+			 */
+			auto plist = dset.getCreatePlist();
+			if ((Q_BYTE_ORDER != Q_LITTLE_ENDIAN) ||
+					(shape.channels != 1) ||
+					(plist.getLayout() != H5D_CONTIGUOUS) ||
+					(plist.getNfilters() != 0) ||
+					(plist.getExternalCount() != 0) ||
+					!(dset.getDataType() == H5::PredType::IEEE_F64LE))
+				return WaveformView();
+			offset = dset.getOffset();
+		} catch (H5::Exception&) {
+			return WaveformView();
+		}
+	}
+
+	/* Storage is not allocated for a dataset which was never written. */
+	if ((offset == HADDR_UNDEF) || (shape.frames == 0))
+		return WaveformView();
+	auto view = WaveformView::map(fname, static_cast<qint64>(offset), shape.frames);
+	view.setSampleRate(shape.sampleRate);
+	return view;
+}
+
+AnalogOutputLoader::Shape AnalogOutputLoader::shape(const QString& fname)
+{
+	QMutexLocker lock(&hdf5Mutex);
+	H5::H5File f;
+	return datasetShape(openAnalogOutput(fname, f));
+}
+
+struct AnalogOutputLoader::Reader::Handle {
+	H5::H5File file;
+	H5::DataSet dataset;
+};
+
+AnalogOutputLoader::Reader::Reader(const QString& fname) :
+	handle(new Handle)
+{
+	QMutexLocker lock(&hdf5Mutex);
+	handle->dataset = openAnalogOutput(fname, handle->file);
+	dims = datasetShape(handle->dataset);
+}
+
+AnalogOutputLoader::Reader::~Reader()
+{
+	/* The file is closed while no other thread uses the library. */
+	QMutexLocker lock(&hdf5Mutex);
+	try {
+		handle->dataset.close();
+		handle->file.close();
+	} catch (H5::Exception&) {
+	}
+}
+
+AnalogOutputLoader::Shape AnalogOutputLoader::Reader::shape() const
+{
+	return dims;
+}
+
+QVector<double> AnalogOutputLoader::Reader::read(qint64 offset, qint64 count)
+{
+	if ((offset < 0) || (offset >= dims.frames))
+		return {};
+	count = qMin(count, dims.frames - offset);
+	QVector<double> chunk(static_cast<int>(count * dims.channels));
+	QMutexLocker lock(&hdf5Mutex);
+	readFrames(handle->dataset, dims, offset, count, chunk.data(), planar);
+	return chunk;
+}
+
+bool AnalogOutputLoader::isLoading() const
+{
+	return loading;
+}
+
+QString AnalogOutputLoader::file() const
+{
+	return currentFile;
+}
+
+StimulusValidator::Options AnalogOutputLoader::options() const
+{
+	return validatorOptions;
+}
+
+void AnalogOutputLoader::setOptions(const StimulusValidator::Options& options)
+{
+	validatorOptions = options;
+}
+
+AnalogOutputLoader::Result AnalogOutputLoader::check(const WaveformView& signal,
+		const QByteArray& hash, const StimulusValidator::Options& options,
+		ProgressFunction progress)
+{
+	Result result;
+	result.data = StimulusValidator::process(signal, options, &result.summary);
+	result.error = result.summary.error(options);
+	if (!result.error.isEmpty())
+		return result;
+	if (!hash.isEmpty() && (result.data.constData() == signal.constData()))
+		result.hash = hash;
+	else
+		result.hash = StimulusCache::hash(result.data, progress);
+	return result;
+}
+
+void AnalogOutputLoader::load(const QString& fname)
+{
+	auto options = validatorOptions;
+	run(fname, [fname, options](ProgressFunction report) -> Result {
+				try {
+					/* A mapped signal is read only to check and hash it,
+					 * which is when its pages are faulted in.
+					 */
+					auto data = map(fname);
+					if (!data.isNull())
+						return check(data, QByteArray(), options, report);
+					return check(read(fname, report), QByteArray(), options, nullptr);
+				} catch (std::invalid_argument& err) {
+					Result result;
+					result.error = err.what();
+					return result;
+				}
+			});
+}
+
+void AnalogOutputLoader::load(const QString& name, const WaveformView& signal,
+		const QByteArray& hash)
+{
+	auto options = validatorOptions;
+	run(name, [signal, hash, options](ProgressFunction report) -> Result {
+				return check(signal, hash, options, report);
+			});
+}
+
+void AnalogOutputLoader::run(const QString& fname,
+		std::function<Result(ProgressFunction)> work)
+{
+	cancel();
+
+	/* Forget workers which have stopped. */
+	workers.erase(std::remove_if(workers.begin(), workers.end(),
+				[](const QFuture<Result>& worker) -> bool {
+					return worker.isFinished();
+				}), workers.end());
+
+	currentFile = fname;
+	loading = true;
+	auto flag = std::make_shared<QAtomicInt>(0);
+	cancelFlag = flag;
+
+	/* The worker only emits progress, which is queued to receivers
+	 * on other threads. The destructor waits for it to stop.
+	 */
+	auto worker = QtConcurrent::run([this, flag, work]() -> Result {
+				return work([this, flag](qint64 done, qint64 total) -> bool {
+							if (flag->load())
+								return false;
+							emit progress(done, total);
+							return true;
+						});
+			});
+	workers.append(worker);
+
+	auto id = ++generation;
+	auto watcher = new QFutureWatcher<Result>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher, fname, id]() -> void {
+				watcher->deleteLater();
+				if (id != generation)
+					return;
+				loading = false;
+				auto result = watcher->result();
+				if (result.summary.samples > 0)
+					emit validated(fname, result.summary);
+				if (!result.error.isEmpty())
+					emit failed(fname, result.error);
+				else
+					emit loaded(fname, result.data, result.hash);
+			});
+	watcher->setFuture(worker);
+}
+
+void AnalogOutputLoader::cancel()
+{
+	if (!loading)
+		return;
+	cancelFlag->store(1);
+	loading = false;
+	generation++;
+	emit canceled(currentFile);
+}
+
@@ -0,0 +1,477 @@
+/*! \file analog-output-upload.cc
+ *
+ * Implementation of the AnalogOutputUpload class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "analog-output-upload.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+AnalogOutputUpload::AnalogOutputUpload(BldsSession* s, QObject* parent) :
+	QObject(parent),
+	session(s),
+	resampling(false),
+	running(false),
+	reading(false),
+	generation(0),
+	total(0),
+	channels(1),
+	readCount(0),
+	ackedCount(0),
+	inFlight(0),
+	fromCache(false),
+	hasher(QCryptographicHash::Sha1)
+{
+	loader = new AnalogOutputLoader(this);
+	QObject::connect(loader, &AnalogOutputLoader::progress,
+			this, [this](qint64 read, qint64 samples) -> void {
+				if (running)
+					emit progress(read, samples);
+			});
+	QObject::connect(loader, &AnalogOutputLoader::validated,
+			this, [this](const QString&, const StimulusValidator::Summary& s) -> void {
+				if (running)
+					emit validated(currentFile, s);
+			});
+	QObject::connect(loader, &AnalogOutputLoader::failed,
+			this, [this](const QString&, const QString& msg) -> void {
+				if (running)
+					finish(false, msg);
+			});
+	QObject::connect(loader, &AnalogOutputLoader::loaded,
+			this, [this](const QString& fname, const WaveformView& aout,
+					const QByteArray& hash) -> void {
+				if (!running || !session)
+					return;
+				if (session->stimulusCache())
+					session->stimulusCache()->insert(fname, aout, hash,
+							validatorOptions.fingerprint());
+
+				/* A resampled signal is streamed like any other. */
+				if (resampling) {
+					resampling = false;
+					sendFromMemory(aout, hash);
+					return;
+				}
+				digest = hash;
+				auto id = generation;
+				session->setSource("analog-output", QVariant::fromValue(aout),
+						[this, id](bool success, const QString& msg) -> void {
+							if (id == generation)
+								finish(success, msg);
+						}, RequestTimeout);
+			});
+}
+
+AnalogOutputUpload::~AnalogOutputUpload()
+{
+	running = false;
+	generation++;
+	for (auto& worker : workers)
+		worker.waitForFinished();
+}
+
+bool AnalogOutputUpload::isRunning() const
+{
+	return running;
+}
+
+QString AnalogOutputUpload::file() const
+{
+	return currentFile;
+}
+
+AnalogOutputLoader::Shape AnalogOutputUpload::shape() const
+{
+	AnalogOutputLoader::Shape s;
+	s.channels = channels;
+	s.frames = total / channels;
+	s.sampleRate = summary.sampleRate;
+	return s;
+}
+
+StimulusValidator::Options AnalogOutputUpload::options() const
+{
+	return validatorOptions;
+}
+
+void AnalogOutputUpload::setOptions(const StimulusValidator::Options& options)
+{
+	validatorOptions = options;
+	loader->setOptions(options);
+}
+
+void AnalogOutputUpload::start(const QString& fname)
+{
+	cancel();
+	if (!session)
+		return;
+	reset(fname);
+
+	/* A cached signal is sent from memory, or not at all if the server
+	 * already holds it.
+	 */
+	StimulusCache::Entry entry;
+	auto cache = session->stimulusCache();
+	auto variant = validatorOptions.fingerprint();
+	if (cache && cache->lookup(fname, &entry, variant)) {
+		checkAndSend(entry.samples, entry.hash);
+		return;
+	}
+
+	/* A signal streamed before is read again, but its hash is known. */
+	auto known = cache ? cache->lookupHash(fname, variant) : QByteArray();
+
+	/* Map the signal if possible, learn its length, and announce the
+	 * upload. A mapped signal is checked, which faults its pages in, and
+	 * then sent straight from the page cache unless it was changed. Any
+	 * other signal is read from the dataset opened here.
+	 */
+	auto options = validatorOptions;
+	runWorker([fname, options]() -> Chunk {
+				Chunk chunk;
+				try {
+					auto file = std::make_shared<AnalogOutputLoader::Reader>(fname);
+					auto shape = file->shape();
+					chunk.channels = shape.channels;
+					chunk.total = shape.channels * shape.frames;
+					chunk.sampleRate = shape.sampleRate;
+					auto mapped = AnalogOutputLoader::map(fname);
+					if (!mapped.isNull()) {
+						chunk.view = StimulusValidator::process(mapped,
+								options, &chunk.summary);
+						chunk.error = chunk.summary.error(options);
+					} else {
+						chunk.reader = file;
+					}
+				} catch (std::invalid_argument& err) {
+					chunk.error = err.what();
+				}
+				return chunk;
+			}, [this, known](const Chunk& chunk) -> void {
+				if (chunk.summary.samples > 0)
+					emit validated(currentFile, chunk.summary);
+				if (!chunk.error.isEmpty()) {
+					finish(false, chunk.error);
+					return;
+				}
+				if (chunk.view.isNull() && StimulusValidator::needsResampling(
+							chunk.sampleRate, validatorOptions)) {
+					resampling = true;
+					loader->load(currentFile);
+					return;
+				}
+				total = chunk.view.isNull() ? chunk.total : chunk.view.size();
+				channels = chunk.channels;
+				source = chunk.view;
+				reader = chunk.reader;
+				summary = chunk.summary;
+				summary.channels = channels;
+				summary.sampleRate = source.isNull() ? chunk.sampleRate :
+						source.sampleRate();
+				if (source.isNull() && !known.isEmpty()) {
+					fromCache = true;
+					digest = known;
+					if (digest == session->analogOutputHash()) {
+						emit progress(total, total);
+						finish(true, QString());
+						return;
+					}
+				}
+				begin();
+			});
+}
+
+void AnalogOutputUpload::start(const QString& name, const WaveformView& signal,
+		const QByteArray& hash)
+{
+	cancel();
+	if (!session)
+		return;
+	reset(name);
+	checkAndSend(signal, hash);
+}
+
+void AnalogOutputUpload::checkAndSend(const WaveformView& signal,
+		const QByteArray& hash)
+{
+	auto options = validatorOptions;
+	runWorker([signal, options]() -> Chunk {
+				Chunk chunk;
+				chunk.view = StimulusValidator::process(signal, options, &chunk.summary);
+				chunk.error = chunk.summary.error(options);
+				return chunk;
+			}, [this, signal, hash](const Chunk& chunk) -> void {
+				emit validated(currentFile, chunk.summary);
+				if (!chunk.error.isEmpty()) {
+					finish(false, chunk.error);
+					return;
+				}
+
+				/* The hash is only of the signal as given. */
+				auto unchanged = (chunk.view.constData() == signal.constData());
+				summary = chunk.summary;
+				sendFromMemory(chunk.view, unchanged ? hash : QByteArray());
+			});
+}
+
+void AnalogOutputUpload::reset(const QString& name)
+{
+	/* Forget reads which have stopped. */
+	workers.erase(std::remove_if(workers.begin(), workers.end(),
+				[](const QFuture<Chunk>& worker) -> bool {
+					return worker.isFinished();
+				}), workers.end());
+
+	currentFile = name;
+	running = true;
+	reading = false;
+	total = 0;
+	channels = 1;
+	readCount = 0;
+	ackedCount = 0;
+	inFlight = 0;
+	generation++;
+	source = WaveformView();
+	reader.reset();
+	digest.clear();
+	hasher.reset();
+	fromCache = false;
+	resampling = false;
+	summary = StimulusValidator::Summary();
+}
+
+void AnalogOutputUpload::sendFromMemory(const WaveformView& signal,
+		const QByteArray& hash)
+{
+	/* Without a hash, the signal is hashed as it is sent. */
+	fromCache = !hash.isEmpty();
+	source = signal;
+	digest = hash;
+	total = source.size();
+	channels = source.channels();
+	summary.channels = channels;
+	summary.sampleRate = source.sampleRate();
+	if (fromCache && (digest == session->analogOutputHash())) {
+		auto id = generation;
+		QTimer::singleShot(0, this, [this, id]() -> void {
+					if (id == generation) {
+						emit progress(total, total);
+						finish(true, QString());
+					}
+				});
+	} else {
+		begin();
+	}
+}
+
+void AnalogOutputUpload::begin()
+{
+	/* The server checks the length of the signal against its number of
+	 * channels, so that is sent first if it changes.
+	 */
+	if (!session->needsAnalogOutputChannels(channels)) {
+		sendBegin();
+		return;
+	}
+	auto id = generation;
+	session->setSource("analog-output-channels", static_cast<quint32>(channels),
+			[this, id](bool success, const QString& msg) -> void {
+				if (id != generation)
+					return;
+				if (success)
+					sendBegin();
+				else
+					finish(false, QString("The server did not accept an analog "
+							"output with %1 channels: %2").arg(channels).arg(msg));
+			}, RequestTimeout);
+}
+
+void AnalogOutputUpload::sendBegin()
+{
+	auto id = generation;
+	session->setSource("analog-output-begin", total,
+			[this, id](bool success, const QString& msg) -> void {
+				if (id != generation)
+					return;
+
+				/* Only a server which answered can be an older one. */
+				if (success)
+					readNext();
+				else if ((msg == BldsSession::TimeoutMessage) ||
+						(msg == BldsSession::ConnectionLostMessage))
+					finish(false, msg);
+				else
+					fallBack();
+			}, RequestTimeout);
+}
+
+void AnalogOutputUpload::cancel()
+{
+	if (!running)
+		return;
+	running = false;
+	generation++;
+	reader.reset();
+	loader->cancel();
+	emit canceled(currentFile);
+}
+
+void AnalogOutputUpload::runWorker(std::function<Chunk()> read,
+		std::function<void(const Chunk&)> done)
+{
+	auto id = generation;
+	auto worker = QtConcurrent::run(read);
+	workers.append(worker);
+	auto watcher = new QFutureWatcher<Chunk>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher, id, done]() -> void {
+				watcher->deleteLater();
+				if ((id == generation) && running && session)
+					done(watcher->result());
+			});
+	watcher->setFuture(worker);
+}
+
+void AnalogOutputUpload::readNext()
+{
+	if (!running || reading)
+		return;
+	if (readCount >= total) {
+		if (inFlight == 0)
+			sendEnd();
+		return;
+	}
+	if (inFlight >= Window)
+		return;
+
+	/* Each chunk holds whole frames. */
+	auto frames = static_cast<qint64>(qMax(ChunkSize / channels, 1));
+	if (!source.isNull()) {
+		sendChunk(source.mid(readCount, frames * channels));
+		return;
+	}
+
+	/* Chunks are read one at a time, so they are sent in order. */
+	reading = true;
+	auto file = reader;
+	auto offset = readCount / channels;
+	auto count = frames;
+	auto width = channels;
+	auto options = validatorOptions;
+	runWorker([file, offset, count, width, options]() -> Chunk {
+				Chunk chunk;
+				try {
+					chunk.samples = StimulusValidator::process(WaveformView(
+								file->read(offset, count), width),
+							options, &chunk.summary).toVector();
+					chunk.error = chunk.summary.error(options);
+				} catch (std::invalid_argument& err) {
+					chunk.error = err.what();
+				}
+				return chunk;
+			}, [this](const Chunk& chunk) -> void {
+				reading = false;
+				summary.merge(chunk.summary);
+				if (!chunk.error.isEmpty()) {
+					finish(false, chunk.error);
+				} else if (chunk.samples.isEmpty()) {
+					finish(false, "The analog output ended before it was expected to");
+				} else {
+					sendChunk(chunk.samples);
+				}
+			});
+}
+
+void AnalogOutputUpload::sendChunk(const QVector<double>& chunk)
+{
+	auto id = generation;
+	qint64 count = chunk.size();
+	readCount += count;
+	if (!fromCache)
+		hasher.addData(reinterpret_cast<const char*>(chunk.constData()),
+				count * sizeof(double));
+	inFlight++;
+	session->setSource("analog-output-chunk", QVariant::fromValue(chunk),
+			[this, id, count](bool success, const QString& msg) -> void {
+				if (id == generation)
+					handleChunkReply(count, success, msg);
+			}, RequestTimeout);
+
+	/* Keep reading while the window has room. */
+	readNext();
+}
+
+void AnalogOutputUpload::handleChunkReply(qint64 count, bool success,
+		const QString& msg)
+{
+	inFlight--;
+	if (!success) {
+		finish(false, "A chunk of the analog output was rejected: " + msg);
+		return;
+	}
+	ackedCount += count;
+	emit progress(ackedCount, total);
+	readNext();
+}
+
+void AnalogOutputUpload::sendEnd()
+{
+	/* A signal read chunk by chunk has now been checked in full. */
+	if (source.isNull())
+		emit validated(currentFile, summary);
+	auto id = generation;
+	session->setSource("analog-output-end", total,
+			[this, id](bool success, const QString& msg) -> void {
+				if (id == generation)
+					finish(success, msg);
+			}, RequestTimeout);
+}
+
+void AnalogOutputUpload::fallBack()
+{
+	if (!source.isNull()) {
+		auto id = generation;
+		session->setSource("analog-output", QVariant::fromValue(source),
+				[this, id](bool success, const QString& msg) -> void {
+					if (id == generation)
+						finish(success, msg);
+				}, RequestTimeout);
+		return;
+	}
+	reader.reset();
+	loader->load(currentFile);
+}
+
+void AnalogOutputUpload::finish(bool success, const QString& msg)
+{
+	running = false;
+	generation++;
+	if (success && session) {
+		/* The hash is known only if every sample was hashed as sent.
+		 * It covers the number of channels too, as StimulusCache::hash()
+		 * does.
+		 */
+		if (digest.isEmpty() && (readCount == total)) {
+			if (channels != 1)
+				hasher.addData(QByteArray::number(channels));
+			digest = hasher.result();
+		}
+		auto cache = session->stimulusCache();
+		if (cache && !fromCache && !digest.isEmpty()) {
+			auto variant = validatorOptions.fingerprint();
+			if (!source.isNull())
+				cache->insert(currentFile, source, digest, variant);
+			else
+				cache->insertHash(currentFile, digest, variant);
+		}
+		session->setAnalogOutputHash(digest);
+	}
+	source = WaveformView();
+	reader.reset();
+	emit finished(currentFile, success, msg);
+}
+
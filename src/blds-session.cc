@@ -0,0 +1,808 @@
+/*! \file blds-session.cc
+ *
+ * Implementation of the BldsSession class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "blds-session.h"
+#include "waveform-view.h"
+
+#include <cstring>
+
+const char* BldsSession::TimeoutMessage = "The BLDS did not reply in time.";
+const char* BldsSession::ConnectionLostMessage = "The connection to the BLDS was lost.";
+
+BldsSession::BldsSession(const QString& hostname, QObject* parent) :
+	QObject(parent),
+	host(hostname),
+	connectionState(State::Disconnected),
+	reconnectAttempts(0),
+	lastRecovery(-1),
+	recoveries(0),
+	nextRequestId(1),
+	statusFlushScheduled(false),
+	sourceStatusKnown(false),
+	sourceStatusDirty(false),
+	stateFlushScheduled(false)
+{
+	qRegisterMetaType<BldsSession::ClientCall>();
+	qRegisterMetaType<DataChunk>();
+	networkThread = new QThread(this);
+	networkThread->setObjectName("blds-network");
+	networkThread->start();
+	QObject::connect(this, &BldsSession::dataChunkReceived,
+			this, &BldsSession::handleData);
+
+	clock.start();
+	reconnectTimer = new QTimer(this);
+	reconnectTimer->setSingleShot(true);
+	QObject::connect(reconnectTimer, &QTimer::timeout,
+			this, &BldsSession::attemptReconnect);
+}
+
+BldsSession::~BldsSession()
+{
+	/* A client whose deletion is still queued is deleted as its
+	 * thread exits.
+	 */
+	destroyClient();
+	networkThread->quit();
+	networkThread->wait();
+}
+
+BldsClient* BldsSession::client() const
+{
+	return bldsClient;
+}
+
+QString BldsSession::hostname() const
+{
+	return host;
+}
+
+BldsSession::State BldsSession::state() const
+{
+	return connectionState;
+}
+
+qint64 BldsSession::lastRecoveryTime() const
+{
+	return lastRecovery;
+}
+
+int BldsSession::recoveryCount() const
+{
+	return recoveries;
+}
+
+void BldsSession::post(ClientCall call)
+{
+	emit clientCallPosted(bldsClient, call, QPrivateSignal());
+}
+
+/* Copy the samples of a frame, which holds a column of samples for
+ * each channel.
+ */
+static DataChunk toChunk(const DataFrame& frame)
+{
+	DataChunk chunk;
+	auto& data = frame.data();
+	chunk.start = frame.start();
+	chunk.stop = frame.stop();
+	chunk.channels = static_cast<int>(data.n_cols);
+	chunk.frames = static_cast<qint64>(data.n_rows);
+	chunk.samples.resize(static_cast<int>(data.n_elem));
+	std::memcpy(chunk.samples.data(), data.memptr(), data.n_elem * sizeof(qint16));
+	return chunk;
+}
+
+void BldsSession::createClient()
+{
+	/* The client and its socket live on the worker thread. Calls are
+	 * posted to it through a queued connection whose context is the
+	 * client, so they run there, in order, and are dropped once it is
+	 * gone. Its signals reach the session through queued connections.
+	 * A client still alive when the thread exits is deleted with it.
+	 */
+	bldsClient = new BldsClient(host);
+	bldsClient->moveToThread(networkThread);
+	auto client = bldsClient.data();
+	QObject::connect(this, &BldsSession::clientCallPosted,
+			client, [client](BldsClient* target, const ClientCall& call) -> void {
+				if (target == client)
+					call(client);
+			});
+	QObject::connect(networkThread, &QThread::finished,
+			client, &QObject::deleteLater);
+	QObject::connect(bldsClient, &BldsClient::connected,
+			this, [this](bool made) -> void {
+				markReplied("connect");
+				handleClientConnected(made);
+			});
+	QObject::connect(bldsClient, &BldsClient::error,
+			this, &BldsSession::handleConnectionLost);
+	QObject::connect(bldsClient, &BldsClient::disconnected,
+			this, [this]() -> void {
+				handleConnectionLost("The BLDS closed the connection.");
+			});
+
+	QObject::connect(bldsClient, &BldsClient::getResponse,
+			this, &BldsSession::handleGetResponse);
+	QObject::connect(bldsClient, &BldsClient::setResponse,
+			this, &BldsSession::handleSetResponse);
+	QObject::connect(bldsClient, &BldsClient::setSourceResponse,
+			this, &BldsSession::handleSetSourceResponse);
+	QObject::connect(bldsClient, &BldsClient::serverStatus,
+			this, &BldsSession::handleServerStatus);
+	QObject::connect(bldsClient, &BldsClient::sourceStatus,
+			this, &BldsSession::handleSourceStatus);
+
+	/* Frames are copied on the worker thread, and only the copy is
+	 * passed to the session.
+	 */
+	QObject::connect(bldsClient, &BldsClient::dataFrameReceived,
+			client, [this](bool valid, const QString& msg,
+					const DataFrame& frame) -> void {
+				emit dataChunkReceived(valid, msg,
+						valid ? toChunk(frame) : DataChunk(), QPrivateSignal());
+			});
+
+	/* The source's settings are unknown once it is replaced or removed. */
+	QObject::connect(bldsClient, &BldsClient::sourceCreated,
+			this, [this](bool success, const QString& msg) -> void {
+				markReplied("create-source");
+				if (success) {
+					invalidateSourceStatus();
+					serverAnalogOutputHash.clear();
+				}
+				emit sourceCreated(success, msg);
+			});
+	QObject::connect(bldsClient, &BldsClient::sourceDeleted,
+			this, [this](bool success, const QString& msg) -> void {
+				markReplied("delete-source");
+				if (success) {
+					invalidateSourceStatus();
+					serverAnalogOutputHash.clear();
+				}
+				emit sourceDeleted(success, msg);
+			});
+	QObject::connect(bldsClient, &BldsClient::recordingStarted,
+			this, [this](bool success, const QString& msg) -> void {
+				markReplied("start-recording");
+				emit recordingStarted(success, msg);
+			});
+	QObject::connect(bldsClient, &BldsClient::recordingStopped,
+			this, [this](bool success, const QString& msg) -> void {
+				markReplied("stop-recording");
+				emit recordingStopped(success, msg);
+			});
+}
+
+void BldsSession::destroyClient()
+{
+	if (!bldsClient)
+		return;
+	QObject::disconnect(bldsClient, 0, this, 0);
+	QObject::disconnect(bldsClient, &BldsClient::dataFrameReceived, 0, 0);
+	post([](BldsClient* client) -> void {
+				client->disconnect();
+				client->deleteLater();
+			});
+	bldsClient.clear();
+}
+
+void BldsSession::connectToServer()
+{
+	if (connectionState != State::Disconnected)
+		return;
+	connectionState = State::Connecting;
+	createClient();
+	markSent("connect");
+	post([](BldsClient* client) -> void { client->connect(); });
+}
+
+void BldsSession::disconnectFromServer()
+{
+	/* Requests of every kind in flight are dropped without calling
+	 * their handlers, since the disconnection was asked for.
+	 */
+	connectionState = State::Disconnected;
+	reconnectTimer->stop();
+	forgetPendingRequests();
+	destroyClient();
+}
+
+void BldsSession::handleClientConnected(bool made)
+{
+	if (connectionState == State::Connecting) {
+		if (made) {
+			connectionState = State::Connected;
+		} else {
+			connectionState = State::Disconnected;
+			destroyClient();
+		}
+		emit connected(made);
+	} else if (connectionState == State::Reconnecting) {
+		if (!made) {
+			scheduleReconnect();
+			return;
+		}
+
+		/* Resynchronize with a single status request, and report the
+		 * time to recover once the status is known.
+		 */
+		connectionState = State::Connected;
+		reconnectAttempts = 0;
+		invalidateSourceStatus();
+		requestServerStatus([this](const QJsonObject& json) -> void {
+					lastRecovery = recoveryTimer.elapsed();
+					recoveries++;
+					emit reconnected(lastRecovery, json);
+				});
+	}
+}
+
+void BldsSession::handleConnectionLost(const QString& reason)
+{
+	/* An attempt to connect which ends in an error is never answered,
+	 * so its send time is dropped rather than charged to the next one.
+	 */
+	sentCommands.remove("connect");
+	switch (connectionState) {
+		case State::Connecting:
+			handleClientConnected(false);
+			break;
+		case State::Connected:
+			connectionState = State::Reconnecting;
+			lostReason = reason;
+			reconnectAttempts = 0;
+			recoveryTimer.start();
+			serverAnalogOutputHash.clear();
+			failPendingRequests(ConnectionLostMessage);
+			emit connectionLost(reason);
+			scheduleReconnect();
+			break;
+		case State::Reconnecting:
+			scheduleReconnect();
+			break;
+		case State::Disconnected:
+			break;
+	}
+}
+
+void BldsSession::scheduleReconnect()
+{
+	/* Removing the failed client ensures each attempt is only
+	 * counted once, even if it reports both an error and a failure.
+	 */
+	destroyClient();
+	if (reconnectAttempts >= MaxReconnectAttempts) {
+		connectionState = State::Disconnected;
+		emit reconnectFailed(lostReason);
+		return;
+	}
+	auto delay = qMin(InitialReconnectDelay << reconnectAttempts,
+			static_cast<int>(MaxReconnectDelay));
+	reconnectAttempts++;
+	emit reconnecting(reconnectAttempts, delay);
+	reconnectTimer->start(delay);
+}
+
+void BldsSession::attemptReconnect()
+{
+	if (connectionState != State::Reconnecting)
+		return;
+	createClient();
+	markSent("connect");
+	post([](BldsClient* client) -> void { client->connect(); });
+}
+
+void BldsSession::forgetPendingRequests()
+{
+	pendingRequests.clear();
+	requestQueues.clear();
+	expiredRequests.clear();
+	unsentStatusHandlers.clear();
+	pendingStatusRequests.clear();
+	pendingSourceStatusRequests.clear();
+	pendingDataRequests.clear();
+	sentRequests.clear();
+	sentCommands.clear();
+}
+
+void BldsSession::failPendingRequests(const QString& msg)
+{
+	auto requests = pendingRequests;
+	auto dataRequests = pendingDataRequests;
+	forgetPendingRequests();
+	for (auto& request : requests) {
+		if (request.onGet)
+			request.onGet(false, QVariant());
+		if (request.onSet)
+			request.onSet(false, msg);
+	}
+	for (auto& handler : dataRequests)
+		handler(false, msg, DataChunk());
+}
+
+bool BldsSession::isConnected() const
+{
+	return (connectionState == State::Connected) && bldsClient;
+}
+
+void BldsSession::createSource(const QString& type, const QString& location)
+{
+	if (isConnected()) {
+		markSent("create-source");
+		post([type, location](BldsClient* client) -> void {
+					client->createSource(type, location);
+				});
+	} else {
+		QTimer::singleShot(0, this, [this]() -> void {
+					emit sourceCreated(false, ConnectionLostMessage);
+				});
+	}
+}
+
+void BldsSession::deleteSource()
+{
+	if (isConnected()) {
+		markSent("delete-source");
+		post([](BldsClient* client) -> void { client->deleteSource(); });
+	} else {
+		QTimer::singleShot(0, this, [this]() -> void {
+					emit sourceDeleted(false, ConnectionLostMessage);
+				});
+	}
+}
+
+void BldsSession::startRecording()
+{
+	if (isConnected()) {
+		markSent("start-recording");
+		post([](BldsClient* client) -> void { client->startRecording(); });
+	} else {
+		QTimer::singleShot(0, this, [this]() -> void {
+					emit recordingStarted(false, ConnectionLostMessage);
+				});
+	}
+}
+
+void BldsSession::stopRecording()
+{
+	if (isConnected()) {
+		markSent("stop-recording");
+		post([](BldsClient* client) -> void { client->stopRecording(); });
+	} else {
+		QTimer::singleShot(0, this, [this]() -> void {
+					emit recordingStopped(false, ConnectionLostMessage);
+				});
+	}
+}
+
+LatencyRecorder* BldsSession::latencyRecorder() const
+{
+	return latency;
+}
+
+void BldsSession::setLatencyRecorder(LatencyRecorder* recorder)
+{
+	latency = recorder;
+}
+
+StimulusCache* BldsSession::stimulusCache() const
+{
+	return stimuli;
+}
+
+void BldsSession::setStimulusCache(StimulusCache* cache)
+{
+	stimuli = cache;
+}
+
+QByteArray BldsSession::analogOutputHash() const
+{
+	return serverAnalogOutputHash;
+}
+
+void BldsSession::setAnalogOutputHash(const QByteArray& hash)
+{
+	serverAnalogOutputHash = hash;
+}
+
+bool BldsSession::needsAnalogOutputChannels(int channels) const
+{
+	return channels != cachedSourceStatus.value("analog-output-channels").toInt(1);
+}
+
+QString BldsSession::commandName(RequestType type, const QString& param)
+{
+	switch (type) {
+		case RequestType::Get:
+			return "get " + param;
+		case RequestType::Set:
+			return "set " + param;
+		case RequestType::SetSource:
+			return "set-source " + param;
+	}
+	return param;
+}
+
+void BldsSession::markSent(const QString& command)
+{
+	sentCommands[command].enqueue(clock.nsecsElapsed());
+}
+
+void BldsSession::markReplied(const QString& command)
+{
+	/* Replies to each command arrive in the order the commands were
+	 * sent, so the oldest send time is the one being answered.
+	 */
+	auto it = sentCommands.find(command);
+	if (it == sentCommands.end())
+		return;
+	auto sentAt = it->dequeue();
+	if (it->isEmpty())
+		sentCommands.erase(it);
+	if (latency)
+		latency->record(command, (clock.nsecsElapsed() - sentAt) / 1000);
+}
+
+void BldsSession::recordLatency(RequestId id)
+{
+	auto it = sentRequests.find(id);
+	if (it == sentRequests.end())
+		return;
+	if (latency)
+		latency->record(it->command, (clock.nsecsElapsed() - it->sentAt) / 1000);
+	sentRequests.erase(it);
+}
+
+QString BldsSession::queueKey(RequestType type, const QString& param)
+{
+	return QString("%1/%2").arg(static_cast<int>(type)).arg(param);
+}
+
+BldsSession::RequestId BldsSession::track(RequestType type,
+		const QString& param, const QVariant& value, GetHandler onGet,
+		SetHandler onSet, int timeout)
+{
+	auto id = nextRequestId++;
+	pendingRequests.insert(id, { type, param, value, onGet, onSet });
+
+	/* Requests made without a connection fail once control returns to
+	 * the event loop, and are never queued for a reply.
+	 */
+	if (!isConnected()) {
+		QTimer::singleShot(0, this, [this,id]() -> void {
+					fail(id, ConnectionLostMessage);
+				});
+		return id;
+	}
+	requestQueues[queueKey(type, param)].enqueue(id);
+	sentRequests.insert(id, { commandName(type, param), clock.nsecsElapsed() });
+	if (timeout > NoTimeout) {
+		QTimer::singleShot(timeout, this, [this,id]() -> void {
+					fail(id, TimeoutMessage);
+				});
+	}
+	return id;
+}
+
+void BldsSession::fail(RequestId id, const QString& msg)
+{
+	if (!pendingRequests.contains(id))
+		return;
+	auto request = pendingRequests.take(id);
+	expire(id);
+	if (request.onGet)
+		request.onGet(false, QVariant());
+	if (request.onSet)
+		request.onSet(false, msg);
+}
+
+void BldsSession::expire(RequestId id)
+{
+	/* The ID stays in its queue, so that a late reply is taken by it
+	 * and dropped, rather than given to the next request for the same
+	 * parameter. Requests never sent were never queued.
+	 */
+	if (sentRequests.remove(id) > 0)
+		expiredRequests.insert(id);
+}
+
+void BldsSession::dropExpired(RequestId before)
+{
+	/* The server answers requests in order, so an expired request sent
+	 * before a reply which has arrived will never be answered. Queues
+	 * hold IDs in increasing order, so only their fronts are checked.
+	 */
+	for (auto it = requestQueues.begin(); it != requestQueues.end(); ) {
+		while (!it->isEmpty() && (it->head() < before) &&
+				expiredRequests.remove(it->head()))
+			it->dequeue();
+		if (it->isEmpty())
+			it = requestQueues.erase(it);
+		else
+			++it;
+	}
+}
+
+BldsSession::RequestId BldsSession::takeOldest(RequestType type,
+		const QString& param)
+{
+	auto it = requestQueues.find(queueKey(type, param));
+	if (it == requestQueues.end())
+		return 0;
+	auto id = it->dequeue();
+	if (it->isEmpty())
+		requestQueues.erase(it);
+	return id;
+}
+
+BldsSession::RequestId BldsSession::get(const QString& param,
+		GetHandler handler, int timeout)
+{
+	auto id = track(RequestType::Get, param, QVariant(), handler, nullptr, timeout);
+	if (isConnected())
+		post([param](BldsClient* client) -> void { client->get(param); });
+	return id;
+}
+
+BldsSession::RequestId BldsSession::set(const QString& param,
+		const QVariant& value, SetHandler handler, int timeout)
+{
+	auto id = track(RequestType::Set, param, value, nullptr, handler, timeout);
+	if (isConnected())
+		post([param, value](BldsClient* client) -> void { client->set(param, value); });
+	return id;
+}
+
+/* Return a value as the client sends it. A signal is carried as a
+ * WaveformView until here, so one mapped from a file is copied into
+ * its message once, on the client's thread.
+ */
+static QVariant toMessage(const QVariant& value)
+{
+	if (value.userType() == qMetaTypeId<WaveformView>())
+		return QVariant::fromValue(value.value<WaveformView>().toVector());
+	return value;
+}
+
+BldsSession::RequestId BldsSession::setSource(const QString& param,
+		const QVariant& value, SetHandler handler, int timeout)
+{
+	auto id = track(RequestType::SetSource, param, value, nullptr, handler, timeout);
+	if (isConnected()) {
+		post([param, value](BldsClient* client) -> void {
+					client->setSource(param, toMessage(value));
+				});
+	}
+	return id;
+}
+
+bool BldsSession::cancel(RequestId id)
+{
+	if (!pendingRequests.remove(id))
+		return false;
+	expire(id);
+	return true;
+}
+
+int BldsSession::pendingRequestCount() const
+{
+	return pendingRequests.size();
+}
+
+void BldsSession::handleGetResponse(const QString& param, bool valid,
+		const QVariant& data)
+{
+	auto id = takeOldest(RequestType::Get, param);
+	if (id == 0) {
+		if (!pushedValues.contains(param))
+			pushedOrder.append(param);
+		pushedValues.insert(param, qMakePair(valid, data));
+		scheduleStateFlush();
+		return;
+	}
+	if (expiredRequests.remove(id))
+		return;
+	recordLatency(id);
+	auto request = pendingRequests.take(id);
+	if (request.onGet)
+		request.onGet(valid, data);
+}
+
+void BldsSession::handleSetResponse(const QString& param, bool success,
+		const QString& msg)
+{
+	dispatchSetReply(RequestType::Set, param, success, msg);
+}
+
+void BldsSession::handleSetSourceResponse(const QString& param, bool success,
+		const QString& msg)
+{
+	dispatchSetReply(RequestType::SetSource, param, success, msg);
+}
+
+void BldsSession::dispatchSetReply(RequestType type, const QString& param,
+		bool success, const QString& msg)
+{
+	auto id = takeOldest(type, param);
+	if ((id == 0) || expiredRequests.remove(id))
+		return;
+	recordLatency(id);
+	auto request = pendingRequests.take(id);
+	if (success && (type == RequestType::SetSource))
+		updateSourceStatus(request.param, request.value);
+	if (request.onSet)
+		request.onSet(success, msg);
+}
+
+void BldsSession::requestServerStatus(StatusHandler handler)
+{
+	unsentStatusHandlers.append(handler);
+	if (!statusFlushScheduled) {
+		statusFlushScheduled = true;
+		QTimer::singleShot(0, this, &BldsSession::flushStatusRequests);
+	}
+}
+
+void BldsSession::getMany(const QStringList& params, ValuesHandler handler)
+{
+	requestServerStatus([params,handler](const QJsonObject& json) -> void {
+				QVariantMap values;
+				for (auto& param : params) {
+					if (json.contains(param))
+						values.insert(param, json[param].toVariant());
+				}
+				handler(values);
+			});
+}
+
+void BldsSession::flushStatusRequests()
+{
+	statusFlushScheduled = false;
+	if (!isConnected()) {
+		unsentStatusHandlers.clear();
+		return;
+	}
+	if (unsentStatusHandlers.isEmpty())
+		return;
+	pendingStatusRequests.enqueue({ unsentStatusHandlers, nextRequestId });
+	unsentStatusHandlers.clear();
+	markSent("server-status");
+	post([](BldsClient* client) -> void { client->requestServerStatus(); });
+}
+
+void BldsSession::handleServerStatus(const QJsonObject& json)
+{
+	if (pendingStatusRequests.isEmpty())
+		return;
+	markReplied("server-status");
+	auto request = pendingStatusRequests.dequeue();
+	dropExpired(request.sentBefore);
+	for (auto& handler : request.handlers)
+		handler(json);
+}
+
+void BldsSession::requestSourceStatus(SourceStatusHandler handler)
+{
+	if (!isConnected())
+		return;
+	pendingSourceStatusRequests.enqueue(handler);
+	markSent("source-status");
+	post([](BldsClient* client) -> void { client->requestSourceStatus(); });
+}
+
+void BldsSession::requestData(float start, float stop, DataHandler handler)
+{
+	if (!isConnected()) {
+		QTimer::singleShot(0, this, [handler]() -> void {
+					handler(false, ConnectionLostMessage, DataChunk());
+				});
+		return;
+	}
+	pendingDataRequests.enqueue(handler);
+	markSent("get-data");
+	post([start, stop](BldsClient* client) -> void {
+				client->requestData(start, stop);
+			});
+}
+
+void BldsSession::handleData(bool valid, const QString& msg, const DataChunk& chunk)
+{
+	if (pendingDataRequests.isEmpty())
+		return;
+	markReplied("get-data");
+	auto handler = pendingDataRequests.dequeue();
+	handler(valid, valid ? QString() : msg, chunk);
+}
+
+bool BldsSession::hasSourceStatus() const
+{
+	return sourceStatusKnown;
+}
+
+QJsonObject BldsSession::sourceStatus() const
+{
+	return cachedSourceStatus;
+}
+
+void BldsSession::invalidateSourceStatus()
+{
+	sourceStatusKnown = false;
+	cachedSourceStatus = QJsonObject();
+}
+
+void BldsSession::handleSourceStatus(bool exists, const QJsonObject& json)
+{
+	sourceStatusKnown = exists;
+	cachedSourceStatus = exists ? json : QJsonObject();
+	if (!cachedSourceStatus.value("has-analog-output").toBool())
+		serverAnalogOutputHash.clear();
+	notifySourceStatusChanged();
+	if (pendingSourceStatusRequests.isEmpty())
+		return;
+	markReplied("source-status");
+	auto handler = pendingSourceStatusRequests.dequeue();
+	if (handler)
+		handler(exists, json);
+}
+
+void BldsSession::updateSourceStatus(const QString& param, const QVariant& value)
+{
+	/* Whoever changed the analog output records its new hash. */
+	if (param.startsWith("analog-output"))
+		serverAnalogOutputHash.clear();
+	if (!sourceStatusKnown)
+		return;
+
+	/* The analog output itself is not kept, only whether there is one.
+	 * When it is uploaded in chunks, only the completed upload counts.
+	 */
+	if (param == "analog-output") {
+		cachedSourceStatus["has-analog-output"] =
+			!value.value<WaveformView>().isEmpty();
+	} else if (param == "analog-output-end") {
+		cachedSourceStatus["has-analog-output"] = (value.toLongLong() > 0);
+	} else if (param.startsWith("analog-output-") &&
+			(param != "analog-output-channels")) {
+		return;
+	} else {
+		cachedSourceStatus[param] = QJsonValue::fromVariant(value);
+	}
+	notifySourceStatusChanged();
+}
+
+void BldsSession::notifySourceStatusChanged()
+{
+	sourceStatusDirty = true;
+	scheduleStateFlush();
+}
+
+void BldsSession::scheduleStateFlush()
+{
+	if (!stateFlushScheduled) {
+		stateFlushScheduled = true;
+		QTimer::singleShot(0, this, &BldsSession::flushStateUpdates);
+	}
+}
+
+void BldsSession::flushStateUpdates()
+{
+	stateFlushScheduled = false;
+	auto values = pushedValues;
+	auto order = pushedOrder;
+	pushedValues.clear();
+	pushedOrder.clear();
+	for (auto& param : order) {
+		auto value = values.value(param);
+		emit valuePushed(param, value.first, value.second);
+	}
+	if (sourceStatusDirty) {
+		sourceStatusDirty = false;
+		emit sourceStatusChanged(cachedSourceStatus);
+	}
+}
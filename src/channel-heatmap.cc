@@ -0,0 +1,188 @@
+/*! \file channel-heatmap.cc
+ *
+ * Implementation of the ChannelHeatmap class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "channel-heatmap.h"
+
+#include <cmath>
+
+/* Color of the area not covered by any cell. */
+static const QRgb BackgroundColor = qRgb(64, 64, 64);
+
+/* Number of changed cells above which the whole widget is repainted,
+ * rather than each cell.
+ */
+static const int MaxCellUpdates = 64;
+
+ChannelHeatmap::ChannelHeatmap(QWidget* parent) :
+	QWidget(parent),
+	nchannels(0),
+	columns(0),
+	rows(0),
+	low(0.f),
+	high(1.f)
+{
+	setMouseTracking(true);
+	setMinimumSize(64, 64);
+	setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+}
+
+ChannelHeatmap::~ChannelHeatmap()
+{
+}
+
+void ChannelHeatmap::setChannelCount(int count)
+{
+	nchannels = qMax(count, 0);
+	columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(nchannels))));
+	rows = (columns > 0) ? (nchannels + columns - 1) / columns : 0;
+	values.fill(low, nchannels);
+	if (nchannels > 0) {
+		cells = QImage(columns, rows, QImage::Format_RGB32);
+		cells.fill(BackgroundColor);
+	} else {
+		cells = QImage();
+	}
+	recolor();
+}
+
+int ChannelHeatmap::channelCount() const
+{
+	return nchannels;
+}
+
+void ChannelHeatmap::setRange(float minimum, float maximum)
+{
+	if ((minimum == low) && (maximum == high))
+		return;
+	low = minimum;
+	high = maximum;
+	recolor();
+}
+
+void ChannelHeatmap::setUnit(const QString& u)
+{
+	unit = u;
+}
+
+void ChannelHeatmap::setValues(const QVector<float>& v)
+{
+	QRegion changed;
+	int count = 0;
+	auto n = qMin(nchannels, v.size());
+	for (int channel = 0; channel < n; channel++) {
+		values[channel] = v[channel];
+		auto color = colorOf(v[channel]);
+		auto x = channel % columns;
+		auto y = channel / columns;
+		if (cells.pixel(x, y) == color)
+			continue;
+		cells.setPixel(x, y, color);
+		if (++count <= MaxCellUpdates)
+			changed += cellRect(channel);
+	}
+	if (count > MaxCellUpdates)
+		update();
+	else if (count > 0)
+		update(changed);
+}
+
+float ChannelHeatmap::value(int channel) const
+{
+	return values.value(channel);
+}
+
+QRgb ChannelHeatmap::color(float fraction)
+{
+	auto t = qBound(0.f, fraction, 1.f) * 3.f;
+	auto level = [t](float offset) -> int {
+		return static_cast<int>(255 * qBound(0.f, t - offset, 1.f));
+	};
+	return qRgb(level(0.f), level(1.f), level(2.f));
+}
+
+QRgb ChannelHeatmap::colorOf(float value) const
+{
+	if (!(high > low))
+		return color(0.f);
+	return color((value - low) / (high - low));
+}
+
+void ChannelHeatmap::recolor()
+{
+	for (int channel = 0; channel < nchannels; channel++)
+		cells.setPixel(channel % columns, channel / columns, colorOf(values[channel]));
+	update();
+}
+
+QSize ChannelHeatmap::sizeHint() const
+{
+	return QSize(400, 400);
+}
+
+int ChannelHeatmap::cellSize() const
+{
+	if (nchannels == 0)
+		return 0;
+	return qMax(1, qMin(width() / columns, height() / rows));
+}
+
+QRect ChannelHeatmap::cellRect(int channel) const
+{
+	auto size = cellSize();
+	return QRect((channel % columns) * size, (channel / columns) * size, size, size);
+}
+
+int ChannelHeatmap::channelAt(const QPoint& point) const
+{
+	auto size = cellSize();
+	if ((size == 0) || (point.x() < 0) || (point.y() < 0))
+		return -1;
+	auto x = point.x() / size;
+	auto y = point.y() / size;
+	if ((x >= columns) || (y >= rows))
+		return -1;
+	auto channel = y * columns + x;
+	return (channel < nchannels) ? channel : -1;
+}
+
+void ChannelHeatmap::paintEvent(QPaintEvent* event)
+{
+	QPainter painter(this);
+	painter.fillRect(event->rect(), QColor(BackgroundColor));
+	if (nchannels == 0)
+		return;
+
+	/* Pixels past the last channel keep the background color. */
+	auto size = cellSize();
+	painter.drawImage(QRect(0, 0, columns * size, rows * size), cells);
+}
+
+void ChannelHeatmap::mousePressEvent(QMouseEvent* event)
+{
+	auto channel = channelAt(event->pos());
+	if (channel >= 0)
+		emit channelClicked(channel);
+	QWidget::mousePressEvent(event);
+}
+
+bool ChannelHeatmap::event(QEvent* event)
+{
+	if (event->type() == QEvent::ToolTip) {
+		auto help = static_cast<QHelpEvent*>(event);
+		auto channel = channelAt(help->pos());
+		if (channel >= 0) {
+			QToolTip::showText(help->globalPos(), QString("Channel %1: %2 %3")
+					.arg(channel).arg(values[channel], 0, 'g', 3).arg(unit),
+					this, cellRect(channel));
+		} else {
+			QToolTip::hideText();
+			event->ignore();
+		}
+		return true;
+	}
+	return QWidget::event(event);
+}
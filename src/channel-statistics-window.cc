@@ -0,0 +1,310 @@
+/*! \file channel-statistics-window.cc
+ *
+ * Implementation of the ChannelStatisticsWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "channel-statistics-window.h"
+
+#include <cmath>
+
+/* Columns of the table. */
+static const int ChannelColumn = 0;
+static const int OffsetColumn = 1;
+static const int RmsColumn = 2;
+static const int RangeColumn = 3;
+static const int SaturationColumn = 4;
+
+/* Color of saturated channels in the table. */
+static const QRgb SaturatedColor = qRgb(200, 0, 0);
+
+/* A cell of the table showing a number, which sorts by its value
+ * rather than its text.
+ */
+class NumericItem : public QTableWidgetItem {
+	public:
+		NumericItem() :
+			QTableWidgetItem(QTableWidgetItem::UserType)
+		{
+			setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+			setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled);
+		}
+
+		void setValue(double value, const QString& text)
+		{
+			setData(Qt::UserRole, value);
+			setText(text);
+		}
+
+		bool operator<(const QTableWidgetItem& other) const override
+		{
+			return data(Qt::UserRole).toDouble() < other.data(Qt::UserRole).toDouble();
+		}
+};
+
+/* Return the smallest power of two at least as large as a value, so that
+ * the scale of the map changes only when the values change a lot.
+ */
+static double scaleFor(double value)
+{
+	return (value > 0) ? std::pow(2., std::ceil(std::log2(value))) : 1.;
+}
+
+ChannelStatisticsWindow::ChannelStatisticsWindow(LiveDataFeed* f, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	feed(f),
+	state(std::make_shared<State>()),
+	fresh(false),
+	busyNsecs(0),
+	processedSeconds(0.)
+{
+	layout = new QGridLayout(this);
+
+	windowLabel = new QLabel("Window:", this);
+	windowLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	windowBox = new QComboBox(this);
+	for (auto window : { 1, 5, 10, 30 })
+		windowBox->addItem(QString("%1 s").arg(window), window);
+	windowBox->setToolTip("Seconds of data over which the statistics are computed");
+
+	mapLabel = new QLabel("Map:", this);
+	mapLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	mapBox = new QComboBox(this);
+	mapBox->addItems({ "RMS", "Peak-to-peak", "Saturated", "Offset" });
+	mapBox->setToolTip("Statistic shown on the map of the array");
+
+	statusLabel = new QLabel("Waiting for data", this);
+
+	table = new QTableWidget(0, 5, this);
+	table->setHorizontalHeaderLabels({ "Channel", "Offset", "RMS",
+			"Peak-to-peak", "Saturated (%)" });
+	table->verticalHeader()->hide();
+	table->setSelectionBehavior(QAbstractItemView::SelectRows);
+	table->setSelectionMode(QAbstractItemView::SingleSelection);
+	table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+	table->setSortingEnabled(true);
+	table->sortByColumn(ChannelColumn, Qt::AscendingOrder);
+
+	heatmap = new ChannelHeatmap(this);
+	heatmap->setUnit("counts");
+
+	splitter = new QSplitter(Qt::Horizontal, this);
+	splitter->addWidget(table);
+	splitter->addWidget(heatmap);
+
+	layout->addWidget(windowLabel, 0, 0);
+	layout->addWidget(windowBox, 0, 1);
+	layout->addWidget(mapLabel, 0, 2);
+	layout->addWidget(mapBox, 0, 3);
+	layout->addWidget(statusLabel, 0, 4);
+	layout->addWidget(splitter, 1, 0, 1, 5);
+	layout->setColumnStretch(4, 1);
+	layout->setRowStretch(1, 1);
+	setLayout(layout);
+	setWindowTitle("Channel noise");
+	resize(1000, 600);
+
+	updateTimer = new QTimer(this);
+	updateTimer->setInterval(UpdateInterval);
+	QObject::connect(updateTimer, &QTimer::timeout,
+			this, &ChannelStatisticsWindow::showStatistics);
+	QObject::connect(mapBox, static_cast<void(QComboBox::*)(int)>(
+				&QComboBox::currentIndexChanged),
+			this, [this]() -> void {
+				fresh = true;
+				showStatistics();
+			});
+	QObject::connect(heatmap, &ChannelHeatmap::channelClicked,
+			this, &ChannelStatisticsWindow::selectChannel);
+	if (feed) {
+		QObject::connect(feed, &LiveDataFeed::chunkReceived,
+				this, &ChannelStatisticsWindow::handleChunk);
+		QObject::connect(feed, &LiveDataFeed::requestFailed,
+				this, [this](const QString& msg) -> void {
+					statusLabel->setText(QString("Could not get data: %1").arg(msg));
+				});
+	}
+	statusTimer.start();
+}
+
+ChannelStatisticsWindow::~ChannelStatisticsWindow()
+{
+	worker.waitForFinished();
+}
+
+void ChannelStatisticsWindow::showEvent(QShowEvent* event)
+{
+	if (feed)
+		feed->addConsumer(this);
+	updateTimer->start();
+	QWidget::showEvent(event);
+}
+
+void ChannelStatisticsWindow::hideEvent(QHideEvent* event)
+{
+	if (feed)
+		feed->removeConsumer(this);
+	updateTimer->stop();
+	pendingChunks.clear();
+	QWidget::hideEvent(event);
+}
+
+void ChannelStatisticsWindow::handleChunk(const DataChunk& chunk)
+{
+	if (!isVisible())
+		return;
+	pendingChunks.append(chunk);
+	if (!worker.isRunning())
+		processChunks();
+}
+
+void ChannelStatisticsWindow::processChunks()
+{
+	if (worker.isRunning() || pendingChunks.isEmpty())
+		return;
+
+	auto chunks = pendingChunks;
+	pendingChunks.clear();
+	auto shared = state;
+	auto window = windowBox->currentData().toDouble();
+	worker = QtConcurrent::run([shared, chunks, window]() -> Result {
+				return accumulate(shared.get(), chunks, window);
+			});
+	auto watcher = new QFutureWatcher<Result>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher]() -> void {
+				watcher->deleteLater();
+				latest = watcher->result();
+				fresh = true;
+
+				busyNsecs += latest.nsecs;
+				processedSeconds += latest.seconds;
+				if ((statusTimer.elapsed() >= 1000) && (processedSeconds > 0)) {
+					statusLabel->setText(QString("%1 channels at %2 Hz, "
+								"statistics use %3% of a core")
+							.arg(latest.summaries.size())
+							.arg(latest.sampleRate, 0, 'f', 0)
+							.arg(100. * busyNsecs / (processedSeconds * 1e9), 0, 'f', 1));
+					busyNsecs = 0;
+					processedSeconds = 0.;
+					statusTimer.restart();
+				}
+				processChunks();
+			});
+	watcher->setFuture(worker);
+}
+
+ChannelStatisticsWindow::Result ChannelStatisticsWindow::accumulate(State* state,
+		const QList<DataChunk>& chunks, double window)
+{
+	QElapsedTimer timer;
+	timer.start();
+	Result result;
+	auto& statistics = state->statistics;
+
+	/* Start afresh when the shape of the data or the window changes,
+	 * or a new recording begins.
+	 */
+	for (auto& chunk : chunks) {
+		if ((chunk.channels <= 0) || (chunk.frames <= 0))
+			continue;
+		if ((chunk.channels != statistics.channels()) ||
+				(chunk.start < state->lastStop) || (window != state->window)) {
+			statistics.reset(chunk.channels, chunk.sampleRate(), window);
+			state->window = window;
+		}
+		if (statistics.append(chunk)) {
+			state->lastStop = chunk.stop;
+			result.seconds += chunk.stop - chunk.start;
+		}
+	}
+
+	statistics.summarize(&result.summaries);
+	result.sampleRate = statistics.sampleRate();
+	result.nsecs = timer.nsecsElapsed();
+	return result;
+}
+
+void ChannelStatisticsWindow::setChannelCount(int count)
+{
+	table->setSortingEnabled(false);
+	table->setRowCount(count);
+	for (int row = 0; row < count; row++) {
+		for (int column = 0; column < table->columnCount(); column++)
+			table->setItem(row, column, new NumericItem);
+		static_cast<NumericItem*>(table->item(row, ChannelColumn))->setValue(
+				row, QString::number(row));
+	}
+	table->setSortingEnabled(true);
+	heatmap->setChannelCount(count);
+}
+
+void ChannelStatisticsWindow::showStatistics()
+{
+	if (!fresh)
+		return;
+	fresh = false;
+	const auto& summaries = latest.summaries;
+	if (summaries.size() != table->rowCount())
+		setChannelCount(summaries.size());
+
+	/* Rows are updated in place, and sorted again once all are. */
+	table->setSortingEnabled(false);
+	for (int row = 0; row < table->rowCount(); row++) {
+		auto channel = table->item(row, ChannelColumn)->data(Qt::UserRole).toInt();
+		auto& summary = summaries[channel];
+		auto cell = [this, row](int column) -> NumericItem* {
+			return static_cast<NumericItem*>(table->item(row, column));
+		};
+		cell(OffsetColumn)->setValue(summary.mean,
+				QString::number(summary.mean, 'f', 1));
+		cell(RmsColumn)->setValue(summary.rms,
+				QString::number(summary.rms, 'f', 1));
+		cell(RangeColumn)->setValue(summary.peakToPeak(),
+				QString::number(summary.peakToPeak()));
+		cell(SaturationColumn)->setValue(summary.saturation,
+				QString::number(100. * summary.saturation, 'f', 3));
+		cell(SaturationColumn)->setForeground((summary.saturation > 0) ?
+				QBrush(QColor(SaturatedColor)) : QBrush());
+	}
+	table->setSortingEnabled(true);
+
+	/* The offset is shown on a scale centered on zero, the others on
+	 * scales starting at zero.
+	 */
+	QVector<float> values(summaries.size());
+	double largest = 0.;
+	auto statistic = mapBox->currentIndex();
+	for (int channel = 0; channel < summaries.size(); channel++) {
+		auto& summary = summaries[channel];
+		double value = 0.;
+		if (statistic == 0)
+			value = summary.rms;
+		else if (statistic == 1)
+			value = summary.peakToPeak();
+		else if (statistic == 2)
+			value = 100. * summary.saturation;
+		else
+			value = summary.mean;
+		values[channel] = static_cast<float>(value);
+		largest = qMax(largest, std::abs(value));
+	}
+	auto scale = static_cast<float>(scaleFor(largest));
+	heatmap->setUnit((statistic == 2) ? "%" : "counts");
+	heatmap->setRange((statistic == 3) ? -scale : 0.f, scale);
+	heatmap->setValues(values);
+}
+
+void ChannelStatisticsWindow::selectChannel(int channel)
+{
+	for (int row = 0; row < table->rowCount(); row++) {
+		auto item = table->item(row, ChannelColumn);
+		if (item->data(Qt::UserRole).toInt() == channel) {
+			table->selectRow(row);
+			table->scrollToItem(item);
+			return;
+		}
+	}
+}
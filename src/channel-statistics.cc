@@ -0,0 +1,206 @@
+/*! \file channel-statistics.cc
+ *
+ * Implementation of the ChannelStatistics class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "channel-statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Return true if a sample is saturated. */
+static inline bool saturated(int x)
+{
+	return (x >= ChannelStatistics::SaturationLevel) ||
+		(x <= -ChannelStatistics::SaturationLevel);
+}
+
+ChannelStatistics::ChannelStatistics(int channels, double sampleRate, double window)
+{
+	reset(channels, sampleRate, window);
+}
+
+void ChannelStatistics::reset(int channels, double sampleRate, double window)
+{
+	nchannels = qMax(channels, 0);
+	rate = sampleRate;
+	blockFrames = qBound(static_cast<qint64>(1),
+			static_cast<qint64>(std::ceil(BlockTime * rate)),
+			static_cast<qint64>(MaxBlockFrames));
+	blocks = qMax(1, static_cast<int>(std::ceil(window / BlockTime))) + 1;
+	ring.assign(nchannels * blocks, Moments());
+	begun = 0;
+	filled = 0;
+}
+
+int ChannelStatistics::channels() const
+{
+	return nchannels;
+}
+
+double ChannelStatistics::sampleRate() const
+{
+	return rate;
+}
+
+double ChannelStatistics::window() const
+{
+	return (blocks - 1) * BlockTime;
+}
+
+bool ChannelStatistics::append(const DataChunk& chunk)
+{
+	if ((chunk.channels != nchannels) || (nchannels == 0))
+		return false;
+
+	/* The chunk is split at the edges of blocks, and each piece of a
+	 * channel is measured while it is in cache.
+	 */
+	qint64 offset = 0;
+	while (offset < chunk.frames) {
+		if ((begun == 0) || (filled == blockFrames)) {
+			auto first = ring.begin() + (begun % blocks) * nchannels;
+			std::fill(first, first + nchannels, Moments());
+			begun++;
+			filled = 0;
+		}
+		auto count = qMin(chunk.frames - offset, blockFrames - filled);
+		auto block = ring.data() + ((begun - 1) % blocks) * nchannels;
+		for (int channel = 0; channel < nchannels; channel++)
+			merge(block[channel], measure(chunk.channel(channel) + offset, count));
+		filled += count;
+		offset += count;
+	}
+	return true;
+}
+
+void ChannelStatistics::summarize(QVector<Summary>* summaries) const
+{
+	summaries->resize(nchannels);
+	auto used = static_cast<int>(qMin(begun, static_cast<qint64>(blocks)));
+	for (int channel = 0; channel < nchannels; channel++) {
+		Moments total;
+		for (int block = 0; block < used; block++)
+			merge(total, ring[block * nchannels + channel]);
+		auto& summary = (*summaries)[channel];
+		summary = Summary();
+		summary.count = total.count;
+		if (total.count > 0) {
+			summary.mean = total.mean;
+			summary.rms = std::sqrt(total.m2 / total.count);
+			summary.minimum = total.minimum;
+			summary.maximum = total.maximum;
+			summary.saturation = static_cast<double>(total.saturated) / total.count;
+		}
+	}
+}
+
+void ChannelStatistics::merge(Moments& into, const Moments& from)
+{
+	if (from.count == 0)
+		return;
+	if (into.count == 0) {
+		into = from;
+		return;
+	}
+	auto count = into.count + from.count;
+	auto delta = from.mean - into.mean;
+	into.mean += delta * from.count / count;
+	into.m2 += from.m2 + delta * delta * into.count * from.count / count;
+	into.minimum = qMin(into.minimum, from.minimum);
+	into.maximum = qMax(into.maximum, from.maximum);
+	into.saturated += from.saturated;
+	into.count = count;
+}
+
+ChannelStatistics::Moments ChannelStatistics::measure(const qint16* x, qint64 count)
+{
+	Moments moments;
+	if (count <= 0)
+		return moments;
+
+	/* First pass: the sum, range and number of saturated samples. */
+	qint64 i = 0;
+	qint64 sum = 0;
+	qint64 clipped = 0;
+	int lo = x[0];
+	int hi = x[0];
+#ifdef __SSE2__
+	const auto ones = _mm_set1_epi16(1);
+	const auto top = _mm_set1_epi16(SaturationLevel - 1);
+	const auto bottom = _mm_set1_epi16(-SaturationLevel + 1);
+	auto vlo = _mm_set1_epi16(x[0]);
+	auto vhi = vlo;
+	auto vsum = _mm_setzero_si128();
+	auto vclipped = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+		vlo = _mm_min_epi16(vlo, v);
+		vhi = _mm_max_epi16(vhi, v);
+		vsum = _mm_add_epi32(vsum, _mm_madd_epi16(v, ones));
+		auto out = _mm_or_si128(_mm_cmpgt_epi16(v, top), _mm_cmplt_epi16(v, bottom));
+		vclipped = _mm_sub_epi32(vclipped, _mm_madd_epi16(out, ones));
+	}
+	qint16 los[8], his[8];
+	qint32 sums[4], clips[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(los), vlo);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(his), vhi);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(sums), vsum);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(clips), vclipped);
+	for (int lane = 0; lane < 8; lane++) {
+		lo = qMin(lo, static_cast<int>(los[lane]));
+		hi = qMax(hi, static_cast<int>(his[lane]));
+	}
+	for (int lane = 0; lane < 4; lane++) {
+		sum += sums[lane];
+		clipped += clips[lane];
+	}
+#endif
+	for (; i < count; i++) {
+		lo = qMin(lo, static_cast<int>(x[i]));
+		hi = qMax(hi, static_cast<int>(x[i]));
+		sum += x[i];
+		clipped += saturated(x[i]) ? 1 : 0;
+	}
+	auto mean = static_cast<double>(sum) / count;
+
+	/* Second pass: the sum of squared deviations from the mean. */
+	i = 0;
+	double m2 = 0.;
+#ifdef __SSE2__
+	const auto vmean = _mm_set1_ps(static_cast<float>(mean));
+	auto low = _mm_setzero_ps();
+	auto high = _mm_setzero_ps();
+	for (; i + 8 <= count; i += 8) {
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+		auto d0 = _mm_sub_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), vmean);
+		auto d1 = _mm_sub_ps(_mm_cvtepi32_ps(
+					_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), vmean);
+		low = _mm_add_ps(low, _mm_mul_ps(d0, d0));
+		high = _mm_add_ps(high, _mm_mul_ps(d1, d1));
+	}
+	float squares[4];
+	_mm_storeu_ps(squares, _mm_add_ps(low, high));
+	for (int lane = 0; lane < 4; lane++)
+		m2 += squares[lane];
+#endif
+	for (; i < count; i++) {
+		auto d = x[i] - mean;
+		m2 += d * d;
+	}
+
+	moments.count = count;
+	moments.mean = mean;
+	moments.m2 = m2;
+	moments.minimum = lo;
+	moments.maximum = hi;
+	moments.saturated = clipped;
+	return moments;
+}
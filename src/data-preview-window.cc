@@ -0,0 +1,289 @@
+/*! \file data-preview-window.cc
+ *
+ * Implementation of the DataPreviewWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "data-preview-window.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+/* Colors of the grid. */
+static const QRgb BorderColor = qRgb(64, 64, 64);
+static const QRgb BackgroundColor = qRgb(0, 0, 0);
+static const QRgb TraceColor = qRgb(96, 224, 96);
+static const QRgb ClippedColor = qRgb(240, 64, 64);
+static const QRgb LabelColor = qRgb(160, 160, 160);
+
+/* Preferred ratio of the width of each cell of the grid to its height. */
+static const double CellAspect = 2.;
+
+/* Smallest cells which are labelled with their channel. */
+static const int MinLabelWidth = 24;
+static const int MinLabelHeight = 14;
+
+DataPreviewWindow::DataPreviewWindow(LiveDataFeed* f, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	feed(f),
+	state(std::make_shared<State>()),
+	dirty(false),
+	frameCount(0)
+{
+	layout = new QGridLayout(this);
+
+	spanLabel = new QLabel("Span:", this);
+	spanLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	spanBox = new QComboBox(this);
+	for (auto span : { 0.25, 0.5, 1., 2., 5., 10. })
+		spanBox->addItem(QString("%1 s").arg(span), span);
+	spanBox->setCurrentIndex(2);
+	spanBox->setToolTip("Seconds of data shown for each channel");
+
+	rangeLabel = new QLabel("Range:", this);
+	rangeLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	rangeBox = new QSpinBox(this);
+	rangeBox->setRange(16, 32768);
+	rangeBox->setSingleStep(256);
+	rangeBox->setValue(2048);
+	rangeBox->setSuffix(" counts");
+	rangeBox->setToolTip("Vertical range of each channel, in ADC counts");
+
+	statusLabel = new QLabel("Waiting for data", this);
+
+	canvas = new QLabel(this);
+	canvas->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
+	canvas->setMinimumSize(64, 64);
+	canvas->setAlignment(Qt::AlignLeft | Qt::AlignTop);
+
+	layout->addWidget(spanLabel, 0, 0);
+	layout->addWidget(spanBox, 0, 1);
+	layout->addWidget(rangeLabel, 0, 2);
+	layout->addWidget(rangeBox, 0, 3);
+	layout->addWidget(statusLabel, 0, 4);
+	layout->addWidget(canvas, 1, 0, 1, 5);
+	layout->setColumnStretch(4, 1);
+	layout->setRowStretch(1, 1);
+	setLayout(layout);
+	setWindowTitle("Live data");
+	resize(900, 600);
+
+	frameTimer = new QTimer(this);
+	frameTimer->setSingleShot(true);
+	QObject::connect(frameTimer, &QTimer::timeout,
+			this, &DataPreviewWindow::drawFrame);
+	QObject::connect(spanBox, static_cast<void(QComboBox::*)(int)>(
+				&QComboBox::currentIndexChanged),
+			this, &DataPreviewWindow::scheduleFrame);
+	QObject::connect(rangeBox, static_cast<void(QSpinBox::*)(int)>(
+				&QSpinBox::valueChanged),
+			this, &DataPreviewWindow::scheduleFrame);
+	if (feed) {
+		QObject::connect(feed, &LiveDataFeed::chunkReceived,
+				this, &DataPreviewWindow::handleChunk);
+		QObject::connect(feed, &LiveDataFeed::requestFailed,
+				this, [this](const QString& msg) -> void {
+					statusLabel->setText(QString("Could not get data: %1").arg(msg));
+				});
+	}
+	sinceFrame.start();
+	rateTimer.start();
+}
+
+DataPreviewWindow::~DataPreviewWindow()
+{
+	worker.waitForFinished();
+}
+
+void DataPreviewWindow::showEvent(QShowEvent* event)
+{
+	if (feed)
+		feed->addConsumer(this);
+	QWidget::showEvent(event);
+}
+
+void DataPreviewWindow::hideEvent(QHideEvent* event)
+{
+	if (feed)
+		feed->removeConsumer(this);
+	pendingChunks.clear();
+	QWidget::hideEvent(event);
+}
+
+void DataPreviewWindow::resizeEvent(QResizeEvent* event)
+{
+	QWidget::resizeEvent(event);
+	scheduleFrame();
+}
+
+void DataPreviewWindow::handleChunk(const DataChunk& chunk)
+{
+	if (!isVisible())
+		return;
+	pendingChunks.append(chunk);
+	scheduleFrame();
+}
+
+void DataPreviewWindow::scheduleFrame()
+{
+	if (worker.isRunning()) {
+		dirty = true;
+		return;
+	}
+	auto wait = 1000 / MaxFrameRate - sinceFrame.elapsed();
+	if (wait > 0) {
+		if (!frameTimer->isActive())
+			frameTimer->start(static_cast<int>(wait));
+		return;
+	}
+	drawFrame();
+}
+
+void DataPreviewWindow::drawFrame()
+{
+	if (worker.isRunning()) {
+		dirty = true;
+		return;
+	}
+	frameTimer->stop();
+	dirty = false;
+	sinceFrame.restart();
+
+	auto chunks = pendingChunks;
+	pendingChunks.clear();
+	auto shared = state;
+	auto size = canvas->size();
+	auto span = spanBox->currentData().toDouble();
+	auto range = rangeBox->value();
+	auto history = History;
+	worker = QtConcurrent::run([shared, chunks, size, span, range, history]() -> Frame {
+				return render(shared.get(), chunks, size, span, range, history);
+			});
+	auto watcher = new QFutureWatcher<Frame>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher]() -> void {
+				watcher->deleteLater();
+				auto frame = watcher->result();
+				canvas->setPixmap(QPixmap::fromImage(frame.image));
+
+				frameCount++;
+				auto elapsed = rateTimer.elapsed();
+				if (elapsed >= 1000) {
+					if (frame.channels > 0) {
+						statusLabel->setText(QString("%1 channels at %2 Hz, %3 frames/s")
+								.arg(frame.channels)
+								.arg(frame.sampleRate, 0, 'f', 0)
+								.arg(1000. * frameCount / elapsed, 0, 'f', 1));
+					}
+					frameCount = 0;
+					rateTimer.restart();
+				}
+				if (dirty)
+					scheduleFrame();
+			});
+	watcher->setFuture(worker);
+}
+
+DataPreviewWindow::Frame DataPreviewWindow::render(State* state,
+		const QList<DataChunk>& chunks, QSize size, double span,
+		int range, double history)
+{
+	/* Add the new data, starting afresh when the shape of the data
+	 * changes or a new recording begins.
+	 */
+	auto& pyramid = state->pyramid;
+	for (auto& chunk : chunks) {
+		if ((chunk.channels <= 0) || (chunk.frames <= 0))
+			continue;
+		if ((chunk.channels != pyramid.channels()) ||
+				(chunk.start < state->lastStop)) {
+			state->sampleRate = chunk.sampleRate();
+			pyramid.reset(chunk.channels,
+					static_cast<qint64>(std::ceil(history * state->sampleRate)));
+		}
+		pyramid.append(chunk);
+		state->lastStop = chunk.stop;
+	}
+
+	Frame frame;
+	frame.channels = pyramid.channels();
+	frame.sampleRate = state->sampleRate;
+	frame.image = QImage(size, QImage::Format_RGB32);
+	frame.image.fill(BorderColor);
+	auto nchannels = frame.channels;
+	if ((nchannels == 0) || (state->sampleRate <= 0) || size.isEmpty())
+		return frame;
+
+	/* Lay the channels out in a grid of cells of about CellAspect, each
+	 * with a border of one pixel on the right and bottom.
+	 */
+	auto width = size.width();
+	auto height = size.height();
+	auto cols = qBound(1, static_cast<int>(std::ceil(std::sqrt(
+					nchannels * width / (CellAspect * height)))), nchannels);
+	auto rows = (nchannels + cols - 1) / cols;
+	auto cellWidth = width / cols;
+	auto cellHeight = height / rows;
+	if ((cellWidth < 2) || (cellHeight < 2))
+		return frame;
+	auto traceWidth = cellWidth - 1;
+	auto traceHeight = cellHeight - 1;
+
+	auto samplesShown = qMin(span * state->sampleRate,
+			static_cast<double>(pyramid.capacity()));
+	auto first = pyramid.size() - samplesShown;
+	auto samplesPerColumn = samplesShown / traceWidth;
+	auto scale = (traceHeight - 1) / (2. * range);
+	auto middle = (traceHeight - 1) / 2.;
+
+	/* Each channel writes only the pixels of its own cell, so the cells
+	 * are drawn in parallel, directly into the image.
+	 */
+	auto bits = reinterpret_cast<QRgb*>(frame.image.bits());
+	auto stride = frame.image.bytesPerLine() / static_cast<int>(sizeof(QRgb));
+	QVector<int> channels(nchannels);
+	std::iota(channels.begin(), channels.end(), 0);
+	QtConcurrent::blockingMap(channels, [&](const int& channel) -> void {
+				auto x0 = (channel % cols) * cellWidth;
+				auto y0 = (channel / cols) * cellHeight;
+				for (int y = 0; y < traceHeight; y++) {
+					auto line = bits + (y0 + y) * stride + x0;
+					std::fill(line, line + traceWidth, BackgroundColor);
+				}
+
+				std::vector<qint16> mins(traceWidth), maxs(traceWidth);
+				pyramid.columns(channel, first, samplesPerColumn, traceWidth,
+						mins.data(), maxs.data());
+				for (int x = 0; x < traceWidth; x++) {
+					if (maxs[x] < mins[x])
+						continue;
+					auto clipped = (maxs[x] >= range) || (mins[x] <= -range);
+					auto color = clipped ? ClippedColor : TraceColor;
+					auto top = qBound(0, static_cast<int>(
+								std::floor(middle - maxs[x] * scale)), traceHeight - 1);
+					auto bottom = qBound(0, static_cast<int>(
+								std::ceil(middle - mins[x] * scale)), traceHeight - 1);
+					auto pixel = bits + (y0 + top) * stride + x0 + x;
+					for (int y = top; y <= bottom; y++, pixel += stride)
+						*pixel = color;
+				}
+			});
+
+	if ((cellWidth >= MinLabelWidth) && (cellHeight >= MinLabelHeight)) {
+		QPainter painter(&frame.image);
+		auto font = painter.font();
+		font.setPixelSize(qMin(10, cellHeight - 4));
+		painter.setFont(font);
+		painter.setPen(QColor(LabelColor));
+		for (int channel = 0; channel < nchannels; channel++) {
+			painter.drawText((channel % cols) * cellWidth + 2,
+					(channel / cols) * cellHeight + font.pixelSize() + 1,
+					QString::number(channel));
+		}
+	}
+	return frame;
+}
+
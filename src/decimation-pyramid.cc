@@ -0,0 +1,199 @@
+/*! \file decimation-pyramid.cc
+ *
+ * Implementation of the DecimationPyramid class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "decimation-pyramid.h"
+
+#include <QtConcurrent>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Find the minimum and maximum of a bucket of samples. */
+static inline void reduce(const qint16* x, qint16* min, qint16* max)
+{
+#ifdef __SSE2__
+	static_assert(DecimationPyramid::BaseBucket == 16,
+			"The SSE2 kernel reduces buckets of two vectors");
+	auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x));
+	auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + 8));
+	auto lo = _mm_min_epi16(a, b);
+	auto hi = _mm_max_epi16(a, b);
+	lo = _mm_min_epi16(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epi16(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	lo = _mm_min_epi16(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epi16(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	lo = _mm_min_epi16(lo, _mm_srli_epi32(lo, 16));
+	hi = _mm_max_epi16(hi, _mm_srli_epi32(hi, 16));
+	*min = static_cast<qint16>(_mm_cvtsi128_si32(lo));
+	*max = static_cast<qint16>(_mm_cvtsi128_si32(hi));
+#else
+	auto lo = x[0];
+	auto hi = x[0];
+	for (int i = 1; i < DecimationPyramid::BaseBucket; i++) {
+		lo = qMin(lo, x[i]);
+		hi = qMax(hi, x[i]);
+	}
+	*min = lo;
+	*max = hi;
+#endif
+}
+
+DecimationPyramid::DecimationPyramid(int channels, qint64 capacity)
+{
+	reset(channels, capacity);
+}
+
+qint64 DecimationPyramid::bucketSize(int level)
+{
+	qint64 size = BaseBucket;
+	for (int i = 0; i < level; i++)
+		size *= Factor;
+	return size;
+}
+
+void DecimationPyramid::reset(int channels, qint64 capacity)
+{
+	nchannels = channels;
+	maxSamples = capacity;
+	total = 0;
+
+	/* Each ring has room for the buckets of a whole capacity of new
+	 * samples, and for the older children of the next level's buckets.
+	 */
+	for (int level = 0; level < Levels; level++) {
+		ringSize[level] = capacity / bucketSize(level) + Factor + 2;
+		completed[level] = 0;
+		mins[level].fill(0, static_cast<int>(channels * ringSize[level]));
+		maxs[level].fill(0, static_cast<int>(channels * ringSize[level]));
+	}
+	carry.fill(0, channels * BaseBucket);
+}
+
+int DecimationPyramid::channels() const
+{
+	return nchannels;
+}
+
+qint64 DecimationPyramid::capacity() const
+{
+	return maxSamples;
+}
+
+qint64 DecimationPyramid::size() const
+{
+	return total;
+}
+
+void DecimationPyramid::append(const DataChunk& chunk)
+{
+	if ((chunk.channels != nchannels) || (nchannels == 0))
+		return;
+
+	/* No more than a capacity of samples is added at once, so that no
+	 * ring wraps around buckets which are still to be combined.
+	 */
+	QVector<int> indices(nchannels);
+	std::iota(indices.begin(), indices.end(), 0);
+	auto piece = qMax(maxSamples, static_cast<qint64>(BaseBucket));
+	for (qint64 offset = 0; offset < chunk.frames; offset += piece) {
+		auto count = qMin(piece, chunk.frames - offset);
+		qint64 before[Levels];
+		std::memcpy(before, completed, sizeof(completed));
+		total += count;
+		completed[0] = total / BaseBucket;
+		for (int level = 1; level < Levels; level++)
+			completed[level] = completed[level - 1] / Factor;
+		QtConcurrent::blockingMap(indices,
+				[this, &chunk, offset, count, &before](const int& channel) -> void {
+					appendChannel(channel, chunk.channel(channel) + offset,
+							count, before);
+				});
+	}
+}
+
+void DecimationPyramid::appendChannel(int channel, const qint16* x,
+		qint64 count, const qint64* before)
+{
+	auto previous = total - count;
+	auto carried = previous - before[0] * BaseBucket;
+	auto buffer = carry.data() + channel * BaseBucket;
+	auto ring = ringSize[0];
+	auto mn = mins[0].data() + channel * ring;
+	auto mx = maxs[0].data() + channel * ring;
+	auto bucket = before[0];
+
+	/* Finish the bucket begun by the last chunk, if any. */
+	qint64 k = 0;
+	if (carried > 0) {
+		k = qMin(count, BaseBucket - carried);
+		std::memcpy(buffer + carried, x, k * sizeof(qint16));
+		if (carried + k < BaseBucket)
+			return;
+		reduce(buffer, mn + (bucket % ring), mx + (bucket % ring));
+		bucket++;
+	}
+	for (; k + BaseBucket <= count; k += BaseBucket, bucket++)
+		reduce(x + k, mn + (bucket % ring), mx + (bucket % ring));
+	std::memcpy(buffer, x + k, (count - k) * sizeof(qint16));
+
+	/* Combine the buckets of each level into those of the next. */
+	for (int level = 1; level < Levels; level++) {
+		auto childRing = ringSize[level - 1];
+		auto cmn = mins[level - 1].constData() + channel * childRing;
+		auto cmx = maxs[level - 1].constData() + channel * childRing;
+		ring = ringSize[level];
+		mn = mins[level].data() + channel * ring;
+		mx = maxs[level].data() + channel * ring;
+		for (auto j = before[level]; j < completed[level]; j++) {
+			auto lo = std::numeric_limits<qint16>::max();
+			auto hi = std::numeric_limits<qint16>::min();
+			for (auto child = j * Factor; child < (j + 1) * Factor; child++) {
+				lo = qMin(lo, cmn[child % childRing]);
+				hi = qMax(hi, cmx[child % childRing]);
+			}
+			mn[j % ring] = lo;
+			mx[j % ring] = hi;
+		}
+	}
+}
+
+void DecimationPyramid::columns(int channel, double first, double samplesPerColumn,
+		int count, qint16* colMins, qint16* colMaxs) const
+{
+	/* Use the coarsest level whose buckets fit in a column. */
+	int level = 0;
+	while ((level + 1 < Levels) && (bucketSize(level + 1) <= samplesPerColumn))
+		level++;
+	auto size = bucketSize(level);
+	auto ring = ringSize[level];
+	auto mn = mins[level].constData() + channel * ring;
+	auto mx = maxs[level].constData() + channel * ring;
+	auto oldest = qMax(completed[level] - ring, static_cast<qint64>(0));
+	auto newest = completed[level];
+
+	for (int i = 0; i < count; i++) {
+		auto lo = first + i * samplesPerColumn;
+		auto b0 = qMax(static_cast<qint64>(std::floor(lo / size)), oldest);
+		auto b1 = qMin(static_cast<qint64>(std::ceil((lo + samplesPerColumn) / size)),
+				newest);
+		auto cmin = std::numeric_limits<qint16>::max();
+		auto cmax = std::numeric_limits<qint16>::min();
+		for (auto b = b0; b < b1; b++) {
+			cmin = qMin(cmin, mn[b % ring]);
+			cmax = qMax(cmax, mx[b % ring]);
+		}
+		colMins[i] = cmin;
+		colMaxs[i] = cmax;
+	}
+}
+
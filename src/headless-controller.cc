@@ -0,0 +1,494 @@
+/*! \file headless-controller.cc
+ *
+ * Implementation of the HeadlessController class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "headless-controller.h"
+
+#include <cstdio>
+#include <thread>
+
+/* Type of the events announcing lines read from standard input. */
+static const QEvent::Type InputEvent =
+		static_cast<QEvent::Type>(QEvent::registerEventType());
+
+HeadlessController::HeadlessController(const QStringList& commands,
+		bool keep, QObject* parent) :
+	QObject(parent),
+	pendingCommands(commands),
+	readStdin(commands.isEmpty()),
+	input(std::make_shared<InputLines>()),
+	awaitingInput(false),
+	output(stdout, QIODevice::WriteOnly),
+	keepGoing(keep),
+	anyFailed(false),
+	stopping(false)
+{
+	latencyRecorder = new LatencyRecorder(this);
+	waitTimer = new QTimer(this);
+	waitTimer->setSingleShot(true);
+	QObject::connect(waitTimer, &QTimer::timeout,
+			this, [this]() -> void {
+				if (statusMonitor)
+					statusMonitor->stop();
+				completeIf("wait", false, "Timed out waiting for the recording to end.");
+			});
+	requestTimer = new QTimer(this);
+	requestTimer->setSingleShot(true);
+	QObject::connect(requestTimer, &QTimer::timeout,
+			this, [this]() -> void {
+				complete(false, BldsSession::TimeoutMessage);
+			});
+}
+
+HeadlessController::~HeadlessController()
+{
+	/* The reader may be blocked on standard input until the process
+	 * exits, so it is only told to stop handing lines over.
+	 */
+	QMutexLocker locker(&input->mutex);
+	input->receiver = nullptr;
+}
+
+void HeadlessController::start()
+{
+	if (readStdin)
+		startReading();
+	runNext();
+}
+
+void HeadlessController::startReading()
+{
+	input->receiver = this;
+	auto shared = input;
+	std::thread([shared]() -> void {
+				QTextStream stream(stdin, QIODevice::ReadOnly);
+				auto closed = false;
+				while (!closed) {
+					auto line = stream.readLine();
+					closed = line.isNull();
+					QMutexLocker locker(&shared->mutex);
+					if (closed)
+						shared->closed = true;
+					else
+						shared->lines.append(line);
+					if (!shared->receiver)
+						return;
+					QCoreApplication::postEvent(shared->receiver, new QEvent(InputEvent));
+				}
+			}).detach();
+}
+
+void HeadlessController::customEvent(QEvent* event)
+{
+	if (event->type() != InputEvent) {
+		QObject::customEvent(event);
+		return;
+	}
+	if (awaitingInput) {
+		awaitingInput = false;
+		runNext();
+	}
+}
+
+QString HeadlessController::nextCommand()
+{
+	/* Commands read from standard input are run in the order they
+	 * arrive, each once the one before has finished, so that a script
+	 * may decide what to send based on earlier results.
+	 */
+	while (true) {
+		QString line;
+		if (readStdin) {
+			QMutexLocker locker(&input->mutex);
+			if (input->lines.isEmpty())
+				return input->closed ? QString() : QString("");
+			line = input->lines.takeFirst();
+		} else {
+			if (pendingCommands.isEmpty())
+				return QString();
+			line = pendingCommands.takeFirst();
+		}
+		line = line.trimmed();
+		if (!line.isEmpty() && !line.startsWith('#'))
+			return line;
+	}
+}
+
+void HeadlessController::runNext()
+{
+	if (stopping)
+		return;
+	auto line = nextCommand();
+	if (line.isNull()) {
+		stop(anyFailed ? 1 : 0);
+		return;
+	}
+	if (line.isEmpty()) {
+		awaitingInput = true;
+		return;
+	}
+	auto args = line.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+	auto command = args.takeFirst();
+	currentCommand = command;
+	currentArgs = args;
+	run(command, args);
+}
+
+void HeadlessController::run(const QString& command, const QStringList& args)
+{
+	if (command == "quit") {
+		complete(true);
+		stop(anyFailed ? 1 : 0);
+		return;
+	} else if (command == "latency") {
+		complete(true, QString(), latencyRecorder->toJson());
+		return;
+	} else if (command == "connect") {
+		if (args.size() != 1) {
+			complete(false, "Usage: connect <host>");
+		} else if (session) {
+			complete(false, "Already connected.");
+		} else {
+			connectToServer(args.at(0));
+		}
+		return;
+	}
+
+	/* Every other command needs a connection. */
+	if (!session) {
+		complete(false, "Not connected.");
+		return;
+	}
+
+	if (command == "disconnect") {
+		QObject::disconnect(session, 0, this, 0);
+		session->disconnectFromServer();
+		session->deleteLater();
+		session.clear();
+		complete(true);
+	} else if (command == "create-source") {
+		if ((args.size() < 1) || (args.size() > 2)) {
+			complete(false, "Usage: create-source <type> [<location>]");
+		} else {
+			session->createSource(args.at(0), args.value(1));
+			requestTimer->start(RequestTimeout);
+		}
+	} else if (command == "delete-source") {
+		session->deleteSource();
+		requestTimer->start(RequestTimeout);
+	} else if (command == "start-recording") {
+		session->startRecording();
+		requestTimer->start(RequestTimeout);
+	} else if (command == "stop-recording") {
+		session->stopRecording();
+		requestTimer->start(RequestTimeout);
+	} else if (command == "set") {
+		if (args.size() != 2) {
+			complete(false, "Usage: set <param> <value>");
+		} else {
+			session->set(args.at(0), parseValue(args.at(0), args.at(1)),
+					completion(), RequestTimeout);
+		}
+	} else if (command == "set-source") {
+		if (args.size() != 2) {
+			complete(false, "Usage: set-source <param> <value>");
+		} else {
+			session->setSource(args.at(0), parseValue(args.at(0), args.at(1)),
+					completion(), RequestTimeout);
+		}
+	} else if (command == "get") {
+		if (args.size() != 1) {
+			complete(false, "Usage: get <param>");
+		} else {
+			QPointer<HeadlessController> self(this);
+			session->get(args.at(0),
+					[self](bool valid, const QVariant& data) -> void {
+						if (self)
+							self->complete(valid, valid ? QString() :
+									"The parameter is not valid.",
+									QJsonValue::fromVariant(data));
+					}, RequestTimeout);
+		}
+	} else if (command == "status") {
+		QPointer<HeadlessController> self(this);
+		session->requestServerStatus([self](const QJsonObject& json) -> void {
+					if (self)
+						self->completeIf("status", true, QString(), json);
+				});
+	} else if (command == "queue") {
+		if (args.size() != 1) {
+			complete(false, "Usage: queue <file>");
+		} else {
+			runQueue(args.at(0));
+		}
+	} else if (command == "wait") {
+		bool ok = true;
+		auto timeout = args.isEmpty() ? 0. : args.at(0).toDouble(&ok);
+		if (!ok || (timeout < 0)) {
+			complete(false, "Usage: wait [<timeout>]");
+		} else {
+			waitForRecording(static_cast<int>(timeout * 1000));
+		}
+	} else {
+		complete(false, "Unknown command: " + command);
+	}
+}
+
+void HeadlessController::connectToServer(const QString& host)
+{
+	session = new BldsSession(host, this);
+	session->setLatencyRecorder(latencyRecorder);
+	QObject::connect(session, &BldsSession::connected,
+			this, [this](bool made) -> void {
+				if (!made) {
+					session->deleteLater();
+					session.clear();
+				}
+				completeIf("connect", made, made ? QString() :
+						"Could not connect to the BLDS.");
+			});
+	QObject::connect(session, &BldsSession::sourceCreated,
+			this, [this](bool success, const QString& msg) -> void {
+				completeIf("create-source", success, msg);
+			});
+	QObject::connect(session, &BldsSession::sourceDeleted,
+			this, [this](bool success, const QString& msg) -> void {
+				completeIf("delete-source", success, msg);
+			});
+	QObject::connect(session, &BldsSession::recordingStarted,
+			this, [this](bool success, const QString& msg) -> void {
+				completeIf("start-recording", success, msg);
+			});
+	QObject::connect(session, &BldsSession::recordingStopped,
+			this, [this](bool success, const QString& msg) -> void {
+				completeIf("stop-recording", success, msg);
+			});
+
+	/* Report the state of the connection, which is recovered by
+	 * the session if it is lost.
+	 */
+	QObject::connect(session, &BldsSession::connectionLost,
+			this, [this](const QString& reason) -> void {
+				writeEvent("connection-lost", {{ "reason", reason }});
+
+				/* The replies to these are lost with the connection, so
+				 * whether they took effect is not known.
+				 */
+				static const QStringList actions = {
+					"create-source", "delete-source", "start-recording", "stop-recording"
+				};
+				if (actions.contains(currentCommand))
+					complete(false, reason);
+			});
+	QObject::connect(session, &BldsSession::reconnected,
+			this, [this](qint64 recoveryTime, const QJsonObject&) -> void {
+				writeEvent("reconnected", {{ "recovery-time", recoveryTime }});
+				if (statusMonitor && (statusMonitor->mode() !=
+							RecordingStatusMonitor::Mode::Idle)) {
+					statusMonitor->stop();
+					statusMonitor->start();
+				} else if (currentCommand == "wait") {
+					waitForRecording(0);
+				} else if (currentCommand == "status") {
+					run(currentCommand, currentArgs);
+				}
+			});
+	QObject::connect(session, &BldsSession::reconnectFailed,
+			this, [this](const QString& reason) -> void {
+				writeEvent("reconnect-failed", {{ "reason", reason }});
+				anyFailed = true;
+				if (!currentCommand.isEmpty()) {
+					complete(false, reason);
+				} else if (!keepGoing) {
+					stop(1);
+				}
+			});
+	session->connectToServer();
+}
+
+void HeadlessController::setupStatusMonitor()
+{
+	if (statusMonitor)
+		return;
+	statusMonitor = new RecordingStatusMonitor(session, session);
+	QObject::connect(statusMonitor, &RecordingStatusMonitor::positionChanged,
+			this, [this](double position) -> void {
+				if (positionReportTimer.isValid() &&
+						(positionReportTimer.elapsed() < PositionReportInterval)) {
+					return;
+				}
+				positionReportTimer.start();
+				writeEvent("recording-position", {{ "position", position }});
+			});
+	QObject::connect(statusMonitor, &RecordingStatusMonitor::recordingEnded,
+			this, [this]() -> void {
+				writeEvent("recording-ended");
+				waitTimer->stop();
+				completeIf("wait", true, QString());
+			});
+	QObject::connect(statusMonitor, &RecordingStatusMonitor::sourceRemoved,
+			this, [this]() -> void {
+				writeEvent("source-removed");
+			});
+}
+
+void HeadlessController::runQueue(const QString& file)
+{
+	QString error;
+	auto entries = RecordingQueue::readEntries(file, &error);
+	if (entries.isEmpty()) {
+		complete(false, error.isEmpty() ? "The file contains no recordings." : error);
+		return;
+	}
+
+	setupStatusMonitor();
+	auto queue = new RecordingQueue(session, statusMonitor, session);
+	for (auto& entry : entries)
+		queue->append(entry);
+	QObject::connect(queue, &RecordingQueue::entryStarted,
+			this, [this](int index, const QString& filename) -> void {
+				writeEvent("queue-recording-started",
+						{{ "index", index }, { "filename", filename }});
+			});
+	QObject::connect(queue, &RecordingQueue::transition,
+			this, [this](int index, qint64 gap) -> void {
+				writeEvent("queue-transition", {{ "index", index }, { "gap", gap }});
+			});
+	QObject::connect(queue, &RecordingQueue::failed,
+			this, [this](int index, const QString& msg) -> void {
+				completeIf("queue", false, QString("Recording %1 failed. %2").arg(
+							index + 1).arg(msg));
+			});
+	QObject::connect(queue, &RecordingQueue::finished,
+			this, [this,queue]() -> void {
+				QJsonArray gaps;
+				for (auto gap : queue->transitionGaps())
+					gaps.append(gap);
+				completeIf("queue", true, QString(), gaps);
+				queue->deleteLater();
+			});
+	queue->start();
+}
+
+void HeadlessController::waitForRecording(int timeout)
+{
+	/* Check that there is a recording to wait for, since the monitor
+	 * only notices a recording ending.
+	 */
+	QPointer<HeadlessController> self(this);
+	session->getMany({ "recording-exists" },
+			[self,timeout](const QVariantMap& values) -> void {
+				if (!self || !self->session)
+					return;
+				if (!values.value("recording-exists").toBool()) {
+					self->completeIf("wait", true, "No recording is running.");
+					return;
+				}
+				self->setupStatusMonitor();
+				self->positionReportTimer.invalidate();
+				self->statusMonitor->start();
+				if (timeout > 0)
+					self->waitTimer->start(timeout);
+			});
+}
+
+BldsSession::SetHandler HeadlessController::completion()
+{
+	QPointer<HeadlessController> self(this);
+	return [self](bool success, const QString& msg) -> void {
+		if (self)
+			self->complete(success, msg);
+	};
+}
+
+void HeadlessController::completeIf(const QString& command,
+		bool success, const QString& msg, const QJsonValue& value)
+{
+	if (currentCommand == command)
+		complete(success, msg, value);
+}
+
+void HeadlessController::complete(bool success, const QString& msg,
+		const QJsonValue& value)
+{
+	if (stopping || currentCommand.isEmpty())
+		return;
+
+	QJsonObject result {
+		{ "command", currentCommand },
+		{ "args", QJsonArray::fromStringList(currentArgs) },
+		{ "success", success }
+	};
+	if (!msg.isEmpty())
+		result.insert("message", msg);
+	if (!value.isNull() && !value.isUndefined())
+		result.insert("value", value);
+	write(result);
+	requestTimer->stop();
+	currentCommand.clear();
+	currentArgs.clear();
+
+	if (!success) {
+		anyFailed = true;
+		if (!keepGoing) {
+			stop(1);
+			return;
+		}
+	}
+
+	/* Run the next command once control returns to the event loop,
+	 * rather than from within the handler of this one's reply.
+	 */
+	QTimer::singleShot(0, this, &HeadlessController::runNext);
+}
+
+void HeadlessController::write(const QJsonObject& json)
+{
+	output << QJsonDocument(json).toJson(QJsonDocument::Compact) << endl;
+}
+
+void HeadlessController::writeEvent(const QString& event, const QJsonObject& data)
+{
+	if (stopping)
+		return;
+	auto json = data;
+	json.insert("event", event);
+	write(json);
+}
+
+void HeadlessController::stop(int exitCode)
+{
+	if (stopping)
+		return;
+	stopping = true;
+	waitTimer->stop();
+	requestTimer->stop();
+	if (statusMonitor)
+		statusMonitor->stop();
+	if (session)
+		session->disconnectFromServer();
+	emit finished(exitCode);
+}
+
+QVariant HeadlessController::parseValue(const QString& param, const QString& arg)
+{
+	if (param == "plug")
+		return static_cast<quint32>(arg.toInt());
+	if (param == "adc-range")
+		return arg.toDouble();
+
+	bool ok = false;
+	auto integer = arg.toInt(&ok);
+	if (ok)
+		return integer;
+	auto real = arg.toDouble(&ok);
+	if (ok)
+		return real;
+	if ((arg == "true") || (arg == "false"))
+		return (arg == "true");
+	return arg;
+}
+
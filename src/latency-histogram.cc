@@ -0,0 +1,121 @@
+/*! \file latency-histogram.cc
+ *
+ * Implementation of the LatencyHistogram class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "latency-histogram.h"
+
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram() :
+	total(0),
+	sum(0),
+	minimum(0),
+	maximum(0)
+{
+}
+
+int LatencyHistogram::bucketIndex(qint64 value)
+{
+	/* Values below two half-counts each have their own bucket. Above,
+	 * keep only the most significant bits of the value, and index the
+	 * buckets by how far the value was shifted and what remains.
+	 */
+	if (value < 2 * SubBucketHalfCount)
+		return static_cast<int>(value);
+	int msb = 0;
+	for (auto v = value; v > 1; v >>= 1)
+		msb++;
+	int shift = msb - SubBucketHalfBits;
+	auto mantissa = static_cast<int>(value >> shift);
+	return 2 * SubBucketHalfCount + (shift - 1) * SubBucketHalfCount +
+		(mantissa - SubBucketHalfCount);
+}
+
+qint64 LatencyHistogram::bucketLowest(int index)
+{
+	if (index < 2 * SubBucketHalfCount)
+		return index;
+	auto offset = index - 2 * SubBucketHalfCount;
+	auto shift = offset / SubBucketHalfCount + 1;
+	qint64 mantissa = offset % SubBucketHalfCount + SubBucketHalfCount;
+	return mantissa << shift;
+}
+
+qint64 LatencyHistogram::bucketHighest(int index)
+{
+	return bucketLowest(index + 1) - 1;
+}
+
+void LatencyHistogram::record(qint64 usec)
+{
+	usec = qBound(Q_INT64_C(0), usec, static_cast<qint64>(MaxValue));
+	auto index = bucketIndex(usec);
+	if (index >= counts.size())
+		counts.resize(index + 1);
+	counts[index]++;
+	if ((total == 0) || (usec < minimum))
+		minimum = usec;
+	if ((total == 0) || (usec > maximum))
+		maximum = usec;
+	total++;
+	sum += usec;
+}
+
+void LatencyHistogram::reset()
+{
+	counts.clear();
+	total = 0;
+	sum = 0;
+	minimum = 0;
+	maximum = 0;
+}
+
+qint64 LatencyHistogram::count() const
+{
+	return total;
+}
+
+qint64 LatencyHistogram::min() const
+{
+	return minimum;
+}
+
+qint64 LatencyHistogram::max() const
+{
+	return maximum;
+}
+
+double LatencyHistogram::mean() const
+{
+	return (total == 0) ? 0 : sum / total;
+}
+
+qint64 LatencyHistogram::valueAtPercentile(double percentile) const
+{
+	if (total == 0)
+		return 0;
+	auto target = static_cast<qint64>(std::ceil(
+				qBound(0.0, percentile, 100.0) / 100 * total));
+	target = qMax(target, Q_INT64_C(1));
+	qint64 seen = 0;
+	for (int i = 0; i < counts.size(); i++) {
+		seen += counts.at(i);
+		if (seen >= target)
+			return qMin(bucketHighest(i), maximum);
+	}
+	return maximum;
+}
+
+QList<QPair<qint64, qint64>> LatencyHistogram::buckets() const
+{
+	QList<QPair<qint64, qint64>> nonEmpty;
+	for (int i = 0; i < counts.size(); i++) {
+		if (counts.at(i) > 0)
+			nonEmpty.append(qMakePair(bucketHighest(i), counts.at(i)));
+	}
+	return nonEmpty;
+}
+
@@ -0,0 +1,83 @@
+/*! \file latency-recorder.cc
+ *
+ * Implementation of the LatencyRecorder class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "latency-recorder.h"
+
+LatencyRecorder::LatencyRecorder(QObject* parent) :
+	QObject(parent)
+{
+}
+
+LatencyRecorder::~LatencyRecorder()
+{
+}
+
+void LatencyRecorder::record(const QString& command, qint64 usec)
+{
+	histograms[command].record(usec);
+	emit recorded(command, usec);
+}
+
+QStringList LatencyRecorder::commands() const
+{
+	return histograms.keys();
+}
+
+LatencyHistogram LatencyRecorder::histogram(const QString& command) const
+{
+	return histograms.value(command);
+}
+
+void LatencyRecorder::reset()
+{
+	histograms.clear();
+}
+
+QJsonObject LatencyRecorder::toJson() const
+{
+	QJsonObject json;
+	for (auto it = histograms.cbegin(); it != histograms.cend(); ++it) {
+		auto& hist = it.value();
+		QJsonArray buckets;
+		for (auto& bucket : hist.buckets())
+			buckets.append(QJsonArray{ bucket.first, bucket.second });
+		json.insert(it.key(), QJsonObject {
+				{ "count", hist.count() },
+				{ "min", hist.min() },
+				{ "mean", hist.mean() },
+				{ "p50", hist.valueAtPercentile(50) },
+				{ "p90", hist.valueAtPercentile(90) },
+				{ "p99", hist.valueAtPercentile(99) },
+				{ "p999", hist.valueAtPercentile(99.9) },
+				{ "max", hist.max() },
+				{ "buckets", buckets }
+			});
+	}
+	return QJsonObject {
+		{ "unit", "us" },
+		{ "commands", json }
+	};
+}
+
+QString LatencyRecorder::toCsv() const
+{
+	QString csv = "command,count,min,mean,p50,p90,p99,p999,max\n";
+	for (auto it = histograms.cbegin(); it != histograms.cend(); ++it) {
+		auto& hist = it.value();
+		csv += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9\n").arg(it.key())
+			.arg(hist.count())
+			.arg(hist.min())
+			.arg(hist.mean(), 0, 'f', 1)
+			.arg(hist.valueAtPercentile(50))
+			.arg(hist.valueAtPercentile(90))
+			.arg(hist.valueAtPercentile(99))
+			.arg(hist.valueAtPercentile(99.9))
+			.arg(hist.max());
+	}
+	return csv;
+}
+
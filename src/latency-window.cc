@@ -0,0 +1,120 @@
+/*! \file latency-window.cc
+ *
+ * Implementation of the LatencyWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "latency-window.h"
+#include "notification-center.h"
+
+LatencyWindow::LatencyWindow(LatencyRecorder* r, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	recorder(r)
+{
+	setWindowTitle("Request latencies");
+	layout = new QGridLayout(this);
+
+	table = new QTableWidget(0, 8, this);
+	table->setHorizontalHeaderLabels({ "Command", "Count", "Min (ms)",
+			"Mean (ms)", "p50 (ms)", "p99 (ms)", "p99.9 (ms)", "Max (ms)" });
+	table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	table->verticalHeader()->setVisible(false);
+	table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+	exportButton = new QPushButton("Export", this);
+	exportButton->setToolTip("Save the latencies as JSON or CSV");
+	resetButton = new QPushButton("Reset", this);
+	resetButton->setToolTip("Discard all recorded latencies");
+	layout->addWidget(table, 0, 0, 1, 3);
+	layout->addWidget(exportButton, 1, 1);
+	layout->addWidget(resetButton, 1, 2);
+
+	QObject::connect(exportButton, &QPushButton::clicked,
+			this, &LatencyWindow::exportLatencies);
+	QObject::connect(resetButton, &QPushButton::clicked,
+			this, [this]() -> void {
+				if (recorder)
+					recorder->reset();
+				refresh();
+			});
+
+	refreshTimer = new QTimer(this);
+	refreshTimer->setInterval(RefreshInterval);
+	QObject::connect(refreshTimer, &QTimer::timeout,
+			this, &LatencyWindow::refresh);
+}
+
+LatencyWindow::~LatencyWindow()
+{
+}
+
+void LatencyWindow::showEvent(QShowEvent* event)
+{
+	refresh();
+	refreshTimer->start();
+	QWidget::showEvent(event);
+}
+
+void LatencyWindow::hideEvent(QHideEvent* event)
+{
+	refreshTimer->stop();
+	QWidget::hideEvent(event);
+}
+
+void LatencyWindow::refresh()
+{
+	if (!recorder)
+		return;
+	auto commands = recorder->commands();
+	table->setRowCount(commands.size());
+	auto ms = [](qint64 usec) -> QString {
+		return QString::number(usec / 1000., 'f', 2);
+	};
+	for (int row = 0; row < commands.size(); row++) {
+		auto hist = recorder->histogram(commands.at(row));
+		QStringList cells = {
+			commands.at(row),
+			QString::number(hist.count()),
+			ms(hist.min()),
+			QString::number(hist.mean() / 1000., 'f', 2),
+			ms(hist.valueAtPercentile(50)),
+			ms(hist.valueAtPercentile(99)),
+			ms(hist.valueAtPercentile(99.9)),
+			ms(hist.max())
+		};
+		for (int col = 0; col < cells.size(); col++) {
+			auto item = table->item(row, col);
+			if (!item) {
+				item = new QTableWidgetItem;
+				if (col > 0)
+					item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+				table->setItem(row, col, item);
+			}
+			item->setText(cells.at(col));
+		}
+	}
+}
+
+void LatencyWindow::exportLatencies()
+{
+	if (!recorder)
+		return;
+	auto fname = QFileDialog::getSaveFileName(this, "Export latencies",
+			QDir::homePath(), "JSON files (*.json);;CSV files (*.csv)");
+	if (fname.isNull() || fname.size() == 0)
+		return;
+
+	QFile file(fname);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+		NotificationCenter::instance()->warning("Could not export latencies",
+				"The file could not be opened. " + file.errorString());
+		return;
+	}
+	if (fname.endsWith(".csv", Qt::CaseInsensitive)) {
+		file.write(recorder->toCsv().toUtf8());
+	} else {
+		file.write(QJsonDocument(recorder->toJson()).toJson());
+	}
+}
+
@@ -0,0 +1,108 @@
+/*! \file live-data-feed.cc
+ *
+ * Implementation of the LiveDataFeed class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "live-data-feed.h"
+
+LiveDataFeed::LiveDataFeed(BldsSession* s, QObject* parent) :
+	QObject(parent),
+	session(s),
+	lastStop(-1.f),
+	requesting(false),
+	generation(0)
+{
+	pollTimer = new QTimer(this);
+	pollTimer->setInterval(PollInterval);
+	QObject::connect(pollTimer, &QTimer::timeout,
+			this, &LiveDataFeed::poll);
+}
+
+LiveDataFeed::~LiveDataFeed()
+{
+}
+
+void LiveDataFeed::addConsumer(QObject* consumer)
+{
+	if (consumers.contains(consumer))
+		return;
+	consumers.insert(consumer);
+	QObject::connect(consumer, &QObject::destroyed,
+			this, [this](QObject* object) -> void {
+				removeConsumer(object);
+			});
+	if (!pollTimer->isActive()) {
+		lastStop = -1.f;
+		pollTimer->start();
+	}
+}
+
+void LiveDataFeed::removeConsumer(QObject* consumer)
+{
+	if (!consumers.remove(consumer))
+		return;
+	QObject::disconnect(consumer, &QObject::destroyed, this, 0);
+	if (consumers.isEmpty())
+		pollTimer->stop();
+}
+
+bool LiveDataFeed::isActive() const
+{
+	return pollTimer->isActive();
+}
+
+void LiveDataFeed::poll()
+{
+	if (!session || !session->isConnected())
+		return;
+
+	/* A request which was never answered is forgotten. */
+	if (requesting && (requestTimer.elapsed() < RequestTimeout))
+		return;
+	requesting = true;
+	requestTimer.start();
+	auto id = ++generation;
+	session->getMany({ "recording-exists", "recording-position" },
+			[this, id](const QVariantMap& values) -> void {
+				if (id != generation)
+					return;
+				if (!values.value("recording-exists").toBool()) {
+					requesting = false;
+					lastStop = -1.f;
+					return;
+				}
+				requestUpTo(values.value("recording-position").toFloat());
+			});
+}
+
+void LiveDataFeed::requestUpTo(float position)
+{
+	/* Start afresh with each new recording. */
+	if ((lastStop < 0) || (position < lastStop))
+		lastStop = qMax(position - InitialSpan, 0.f);
+	if (position <= lastStop) {
+		requesting = false;
+		return;
+	}
+
+	/* Skip ahead rather than fall further behind. */
+	auto start = qMax(lastStop, position - MaxSpan);
+	auto stop = position;
+	auto id = generation;
+	session->requestData(start, stop,
+			[this, id, stop](bool valid, const QString& msg,
+					const DataChunk& chunk) -> void {
+				if (id != generation)
+					return;
+				requesting = false;
+				if (!valid) {
+					emit requestFailed(msg);
+					return;
+				}
+				lastStop = stop;
+				emit chunkReceived(chunk);
+			});
+}
+
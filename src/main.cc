@@ -4,14 +4,84 @@
  */
 
 #include "meactl-window.h"
+#include "headless-controller.h"
+#include "multi-rig-window.h"
+
+#include <cstring>
+
+/* Return true if the given option is among the arguments. This is
+ * checked before the application exists, since it decides which
+ * kind of application to create.
+ */
+static bool hasOption(int argc, char* argv[], const char* option)
+{
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], option) == 0)
+			return true;
+	}
+	return false;
+}
+
+/* Run commands against the BLDS without a user interface. */
+static int runHeadless(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("meactl");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Control the BLDS and its data source.");
+	parser.addHelpOption();
+	parser.addOption({ "headless", "Run without a user interface." });
+	parser.addOption({ { "k", "keep-going" },
+			"Keep running commands after one fails." });
+	parser.addPositionalArgument("commands",
+			"Commands to run, e.g. \"connect localhost\". If none are given, "
+			"commands are read from standard input, one per line.",
+			"[commands...]");
+	parser.process(app);
+
+	HeadlessController controller(parser.positionalArguments(),
+			parser.isSet("keep-going"));
+	QObject::connect(&controller, &HeadlessController::finished,
+			&app, &QCoreApplication::exit, Qt::QueuedConnection);
+	QTimer::singleShot(0, &controller, &HeadlessController::start);
+	return app.exec();
+}
+
+/* Control several rigs at once, each with its own BLDS. */
+static int runMultiRig(int argc, char* argv[])
+{
+	QApplication app(argc, argv);
+	QApplication::setApplicationName("meactl");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Control several BLDS servers at once.");
+	parser.addHelpOption();
+	parser.addOption({ "multi", "Control several rigs at once." });
+	parser.addPositionalArgument("hosts",
+			"Hostnames of the rigs' servers, to which to connect.", "[hosts...]");
+	parser.process(app);
+
+	MultiRigWindow win(parser.positionalArguments());
+	win.show();
+	return app.exec();
+}
 
 /*! \fn * Main entry point for the meactl application.
  *
  * This creates a Qt application and a MeactlWindow object, which
- * handles all the remote interaction with the BLDS.
+ * handles all the remote interaction with the BLDS. If run with
+ * `--headless`, it instead runs a script of commands without any
+ * user interface, see HeadlessController. With `--multi`, it controls
+ * several rigs at once, see MultiRigWindow.
  */
 int main(int argc, char *argv[])
 {
+	if (hasOption(argc, argv, "--headless"))
+		return runHeadless(argc, argv);
+	if (hasOption(argc, argv, "--multi"))
+		return runMultiRig(argc, argv);
+
 	QApplication app(argc, argv);
 	MeactlWindow win;
 	win.show();
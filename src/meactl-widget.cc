@@ -8,23 +8,31 @@
 
 #include "meactl-widget.h"
 
-#include "source-settings-window.h"
-
 MeactlWidget::MeactlWidget(QWidget* parent) :
 	QWidget(parent)
 {
 	setupLayout();
 	initSignals();
-
-	/* Create timer for status heartbeats during a recording. */
-	recordingStatusTimer = new QTimer(this);
-	recordingStatusTimer->setInterval(RecordingPositionUpdateInterval);
 }
 
 MeactlWidget::~MeactlWidget()
 {
 }
 
+void MeactlWidget::setLatencyRecorder(LatencyRecorder* recorder)
+{
+	latencyRecorder = recorder;
+	if (session)
+		session->setLatencyRecorder(recorder);
+}
+
+void MeactlWidget::setStimulusCache(StimulusCache* cache)
+{
+	stimulusCache = cache;
+	if (session)
+		session->setStimulusCache(cache);
+}
+
 void MeactlWidget::setupLayout()
 {
 	/* Create overall layout for widget. */
@@ -60,12 +68,24 @@ void MeactlWidget::setupLayout()
 	createSourceButton->setEnabled(false);
 	showSettingsButton = new QPushButton("Settings", sourceGroup);
 	showSettingsButton->setEnabled(false);
+	showPreviewButton = new QPushButton("Preview", sourceGroup);
+	showPreviewButton->setToolTip("Show the data recorded on every channel");
+	showPreviewButton->setEnabled(false);
+	showActivityButton = new QPushButton("Activity", sourceGroup);
+	showActivityButton->setToolTip("Show the spike rate on every electrode of a HiDens array");
+	showActivityButton->setEnabled(false);
+	showNoiseButton = new QPushButton("Noise", sourceGroup);
+	showNoiseButton->setToolTip("Show the noise on every channel");
+	showNoiseButton->setEnabled(false);
 	sourceLayout->addWidget(sourceTypeLabel, 0, 0);
 	sourceLayout->addWidget(sourceTypeBox, 0, 1);
 	sourceLayout->addWidget(createSourceButton, 0, 2);
 	sourceLayout->addWidget(showSettingsButton, 0, 3);
 	sourceLayout->addWidget(sourceLocationLabel, 1, 0);
 	sourceLayout->addWidget(sourceLocationLine, 1, 1, 1, 3);
+	sourceLayout->addWidget(showNoiseButton, 2, 1);
+	sourceLayout->addWidget(showActivityButton, 2, 2);
+	sourceLayout->addWidget(showPreviewButton, 2, 3);
 
 	/* Widgets related to the actual recording. */
 	recordingGroup = new QGroupBox("Recording", this);
@@ -93,6 +113,9 @@ void MeactlWidget::setupLayout()
 	startRecordingButton = new QPushButton("Start", recordingGroup);
 	startRecordingButton->setToolTip("Start the recording");
 	startRecordingButton->setEnabled(false);
+	runQueueButton = new QPushButton("Queue", recordingGroup);
+	runQueueButton->setToolTip("Run a list of recordings back to back");
+	runQueueButton->setEnabled(false);
 	recordingLayout->addWidget(recordingPositionLabel, 0, 0);
 	recordingLayout->addWidget(recordingPositionLine, 0, 1);
 	recordingLayout->addWidget(recordingLengthLabel, 0, 2);
@@ -101,6 +124,7 @@ void MeactlWidget::setupLayout()
 	recordingLayout->addWidget(recordingFileLine, 1, 1);
 	recordingLayout->addWidget(recordingPathButton, 1, 2);
 	recordingLayout->addWidget(startRecordingButton, 1, 3);
+	recordingLayout->addWidget(runQueueButton, 2, 3);
 
 	/* Place all widgets in main layout. */
 	mainLayout->addWidget(serverGroup, 0, 0);
@@ -114,6 +138,14 @@ void MeactlWidget::initSignals()
 			this, &MeactlWidget::connectToServer);
 	QObject::connect(showSettingsButton, &QPushButton::clicked,
 			this, &MeactlWidget::showSettingsWindow);
+	QObject::connect(showPreviewButton, &QPushButton::clicked,
+			this, &MeactlWidget::showPreviewWindow);
+	QObject::connect(showActivityButton, &QPushButton::clicked,
+			this, &MeactlWidget::showActivityWindow);
+	QObject::connect(showNoiseButton, &QPushButton::clicked,
+			this, &MeactlWidget::showNoiseWindow);
+	QObject::connect(runQueueButton, &QPushButton::clicked,
+			this, &MeactlWidget::runRecordingQueue);
 
 	/* Simple handler to auto-populate the location line. */
 	QObject::connect(sourceTypeBox, &QComboBox::currentTextChanged,
@@ -138,17 +170,22 @@ void MeactlWidget::connectToServer()
 	connectToServerButton->setToolTip("Cancel pending connection to the BLDS");
 	serverHostLine->setReadOnly(true);
 
-	/* Connect handler for the result of a connection attempt. */
-	client = new BldsClient(serverHostLine->text());
-	QObject::connect(client, &BldsClient::connected,
+	/* Create the session through which all requests are made, and
+	 * connect handler for the result of a connection attempt. The
+	 * session owns the connection, and recovers it if it is lost.
+	 */
+	session = new BldsSession(serverHostLine->text(), this);
+	session->setLatencyRecorder(latencyRecorder);
+	session->setStimulusCache(stimulusCache);
+	QObject::connect(session, &BldsSession::connected,
 			this, &MeactlWidget::onServerConnection);
-	client->connect();
+	session->connectToServer();
 }
 
 void MeactlWidget::onServerConnection(bool made)
 {
 	/* Disconnect this handler */
-	QObject::disconnect(client, &BldsClient::connected, 0, 0);
+	QObject::disconnect(session, &BldsSession::connected, 0, 0);
 
 	if (made) {
 		handleServerConnection();
@@ -157,7 +194,7 @@ void MeactlWidget::onServerConnection(bool made)
 		QObject::connect(connectToServerButton, &QPushButton::clicked,
 				this, &MeactlWidget::connectToServer);
 		connectToServerButton->setText("Connect");
-		client->deleteLater();
+		session->deleteLater();
 	}
 
 	/* Notify. */
@@ -171,24 +208,24 @@ void MeactlWidget::handleServerConnection()
 			this, &MeactlWidget::cancelPendingServerConnection);
 	QObject::connect(connectToServerButton, &QPushButton::clicked,
 			this, &MeactlWidget::disconnectFromServer);
-	QObject::connect(client, &BldsClient::disconnected,
-			[this]() -> void {
-				handleServerDisconnection();
-				client->deleteLater();
-				emit disconnectedFromServer();
-			});
 	connectToServerButton->setText("Disconnect");
 
-	/* Connect signals of the client. */
-	QObject::connect(client, &BldsClient::sourceCreated,
+	/* Connect signals of the session. A lost connection is only an
+	 * error once the session has given up recovering it.
+	 */
+	QObject::connect(session, &BldsSession::sourceCreated,
 			this, &MeactlWidget::onSourceCreated);
-	QObject::connect(client, &BldsClient::sourceDeleted,
+	QObject::connect(session, &BldsSession::sourceDeleted,
 			this, &MeactlWidget::onSourceDeleted);
-	QObject::connect(client, &BldsClient::recordingStarted,
+	QObject::connect(session, &BldsSession::recordingStarted,
 			this, &MeactlWidget::onRecordingStarted);
-	QObject::connect(client, &BldsClient::recordingStopped,
+	QObject::connect(session, &BldsSession::recordingStopped,
 			this, &MeactlWidget::onRecordingStopped);
-	QObject::connect(client, &BldsClient::error,
+	QObject::connect(session, &BldsSession::connectionLost,
+			this, &MeactlWidget::connectionLost);
+	QObject::connect(session, &BldsSession::reconnected,
+			this, &MeactlWidget::onServerReconnected);
+	QObject::connect(session, &BldsSession::reconnectFailed,
 			this, &MeactlWidget::onServerError);
 
 	/* Setup choosing the recording path. */
@@ -198,73 +235,76 @@ void MeactlWidget::handleServerConnection()
 	/* Connect functor for sending a new recording filename. */
 	QObject::connect(recordingFileLine, &QLineEdit::returnPressed,
 			[this]() -> void {
-				client->set("save-file", recordingFileLine->text());
+				setRecordingFilename(recordingFileLine->text());
 			});
 	recordingPathButton->setEnabled(true);
-
-	/* Connect functor for handling a response to a request
-	 * to change the length of a recording.
-	 */
 	recordingLengthLine->setEnabled(true);
-	connections.insert("recording-length-response",
-			QObject::connect(client, &BldsClient::setResponse,
-			[this](const QString& param, bool success, const QString& msg) -> void {
-				if (param != "recording-length") {
-					return;
-				}
-				if (success) {
-					emit recordingLengthChanged(recordingLengthLine->text());
-				} else {
-					QMessageBox::warning(parentWidget(), 
-							"Could not change recording length",
-							"An error occurred changing the recording length: " + msg);
-				}
-			})
-	);
-
-	/* Connect functor for handling a response to a request
-	 * to change the save filename.
-	 */
 	recordingFileLine->setEnabled(true);
-	connections.insert("recording-filename-response",
-			QObject::connect(client, &BldsClient::setResponse,
-			[this](const QString& param, bool success, const QString& msg) -> void {
-				if (param != "save-file") {
-					return;
-				}
-				if (success) {
-					emit recordingFilenameChanged(recordingFileLine->text());
-				} else {
-					QMessageBox::warning(parentWidget(), "Could not set filename",
-							"The recording filename could not be set. " + msg);
-				}
-			})
-	);
 
-	/* Connect the handler for the initial status reply from the
-	 * BLDS, and request that status.
-	 */
-	QObject::connect(client, &BldsClient::serverStatus,
-			this, &MeactlWidget::handleInitialStatusReply);
-	client->requestServerStatus();
+	/* Request the initial status of the BLDS. */
+	session->requestServerStatus([this](const QJsonObject& json) -> void {
+				handleInitialStatusReply(json);
+			});
 }
 
 void MeactlWidget::onServerError(const QString& err)
 {
 	handleServerDisconnection();
-	client->deleteLater();
-	QMessageBox::critical(parentWidget(), "Server error", 
-			"An error occurred communicating with the BLDS:\n\n" + err);
+	session->disconnectFromServer();
+	session->deleteLater();
+	NotificationCenter::instance()->error("Server error",
+			"An error occurred communicating with the BLDS: " + err);
 	emit serverError(err);
 }
 
+void MeactlWidget::onServerReconnected(qint64 recoveryTime, const QJsonObject& json)
+{
+	/* Bring the UI in line with the server, which may have changed
+	 * while the connection was down, touching only what differs.
+	 */
+	auto sourceShown = (createSourceButton->text() == "Delete");
+	auto recordingShown = (startRecordingButton->text() == "Stop");
+	auto sourceExists = json["source-exists"].toBool();
+	auto recordingExists = json["recording-exists"].toBool();
+
+	if (recordingShown && !recordingExists)
+		handleRecordingStopped();
+	if (sourceShown && !sourceExists) {
+		handleSourceDeleted();
+	} else if (!sourceShown && sourceExists) {
+		sourceTypeBox->setCurrentText(json["source-type"].toString());
+		sourceLocationLine->setText(json["source-location"].toString());
+		handleSourceCreated();
+	} else if (sourceExists) {
+		session->requestSourceStatus();
+	}
+
+	if (recordingExists) {
+		recordingPositionLine->setText(QString::number(
+					json["recording-position"].toDouble(), 'f', 1));
+		if (!recordingShown) {
+			handleRecordingStarted();
+		} else if (statusMonitor) {
+
+			/* Resume following the recording, subscribing again since
+			 * the server forgets subscriptions with the connection.
+			 */
+			statusMonitor->stop();
+			statusMonitor->start();
+		}
+	}
+
+	/* Notify. */
+	emit reconnected(recoveryTime);
+}
+
 void MeactlWidget::disconnectFromServer()
 {
 	handleServerDisconnection();
 
-	/* Disconnect and delete the client. */
-	client->disconnect();
-	client->deleteLater();
+	/* Disconnect and delete the session. */
+	session->disconnectFromServer();
+	session->deleteLater();
 
 	/* Notify. */
 	emit disconnectedFromServer();
@@ -282,20 +322,28 @@ void MeactlWidget::handleServerDisconnection()
 	QObject::disconnect(startRecordingButton, &QPushButton::clicked, 0, 0);
 	QObject::disconnect(recordingFileLine, &QLineEdit::returnPressed, 0, 0);
 
-	/* Remove any residual other functors. */
-	for (auto& each : connections)
-		QObject::disconnect(each);
-	connections.clear();
+	/* The settings window, the views of the live data and the status
+	 * monitor are tied to the session, so remove them as well.
+	 */
+	closeSettingsWindow();
+	closePreviewWindow();
+	closeActivityWindow();
+	closeNoiseWindow();
+	if (recordingQueue) {
+		QObject::disconnect(recordingQueue, 0, 0, 0);
+		recordingQueue->deleteLater();
+		recordingQueue.clear();
+	}
+	if (statusMonitor) {
+		QObject::disconnect(statusMonitor, 0, 0, 0);
+		statusMonitor->deleteLater();
+		statusMonitor.clear();
+	}
 
 	/* Re-connect slot to connect to the server. */
 	QObject::connect(connectToServerButton, &QPushButton::clicked,
 			this, &MeactlWidget::connectToServer);
 
-	/* Disconnect functor for manipulating the recording filename. */
-	QObject::disconnect(recordingFileLine, &QLineEdit::returnPressed, 0, 0);
-	if (connections.contains("recording-filename-response"))
-		QObject::disconnect(connections.take("recording-filename-response"));
-
 	/* Reset most of the UI. */
 	connectToServerButton->setText("Connect");
 	serverHostLine->setReadOnly(false);
@@ -305,18 +353,22 @@ void MeactlWidget::handleServerDisconnection()
 	sourceLocationLine->setReadOnly(false);
 	createSourceButton->setEnabled(false);
 	showSettingsButton->setEnabled(false);
+	showPreviewButton->setEnabled(false);
+	showNoiseButton->setEnabled(false);
+	showActivityButton->setEnabled(false);
 	startRecordingButton->setEnabled(false);
 	recordingPathButton->setEnabled(false);
 
 	recordingPositionLine->setText("0");
 	sourceTypeBox->setEnabled(true);
+	updateQueueButton();
 }
 
 void MeactlWidget::createDataSource()
 {
 	auto type = sourceTypeBox->currentText();
 	auto location = (type == "mcs") ? "" : sourceLocationLine->text();
-	client->createSource(type, location);
+	session->createSource(type, location);
 }
 
 void MeactlWidget::onSourceCreated(bool success, const QString& msg)
@@ -346,13 +398,22 @@ void MeactlWidget::handleSourceCreated()
 			this, &MeactlWidget::startRecording);
 
 	showSettingsButton->setEnabled(true);
+	showPreviewButton->setEnabled(true);
+	showNoiseButton->setEnabled(true);
+	showActivityButton->setEnabled(sourceTypeBox->currentText() == "hidens");
 	sourceLocationLine->setReadOnly(true);
 	sourceTypeBox->setEnabled(false);
+
+	/* Fetch the new source's settings now, so the settings window
+	 * can be shown immediately.
+	 */
+	session->requestSourceStatus();
+	updateQueueButton();
 }
 
 void MeactlWidget::deleteDataSource()
 {
-	client->deleteSource();
+	session->deleteSource();
 }
 
 void MeactlWidget::onSourceDeleted(bool success, const QString& msg)
@@ -366,13 +427,6 @@ void MeactlWidget::onSourceDeleted(bool success, const QString& msg)
 
 void MeactlWidget::handleSourceDeleted()
 {
-	/* Disconnect functor for checking if the source has been deleted
-	 * in the situation when the recording is stopped by a client different
-	 * from ourselves.
-	 */
-	if (connections.contains("source-exists-connection"))
-		QObject::disconnect(connections.take("source-exists-connection"));
-
 	/* Disconnect this slot, and change the "delete" button 
 	 * back to a "create" button.
 	 */
@@ -383,6 +437,13 @@ void MeactlWidget::handleSourceDeleted()
 	createSourceButton->setText("Create");
 	createSourceButton->setToolTip("Create a data source of the selected type");
 	showSettingsButton->setEnabled(false);
+	showPreviewButton->setEnabled(false);
+	showNoiseButton->setEnabled(false);
+	showActivityButton->setEnabled(false);
+	closeSettingsWindow();
+	closePreviewWindow();
+	closeActivityWindow();
+	closeNoiseWindow();
 
 	/* Disable starting the recording. */
 	startRecordingButton->setEnabled(false);
@@ -390,11 +451,12 @@ void MeactlWidget::handleSourceDeleted()
 			this, &MeactlWidget::startRecording);
 	sourceLocationLine->setReadOnly(false);
 	sourceTypeBox->setEnabled(true);
+	updateQueueButton();
 }
 
 void MeactlWidget::startRecording()
 {
-	client->startRecording();
+	session->startRecording();
 }
 
 void MeactlWidget::onRecordingStarted(bool success, const QString& msg)
@@ -422,29 +484,26 @@ void MeactlWidget::handleRecordingStarted()
 	 * may have changed it and it changes each time a recording
 	 * is started/stopped unless the client explicitly sets it.
 	 */
-	if (connections.contains("recording-filename-response"))
-		QObject::disconnect(connections.take("recording-filename-response"));
-	connections.insert("recording-filename-response",
-			QObject::connect(client, &BldsClient::getResponse,
-			[this](const QString& param, bool, const QVariant& data) -> void {
-				if (param == "save-file") {
-					recordingFileLine->setText(data.toString());
-					if (connections.contains("recording-filename-response"))
-						QObject::disconnect(connections.take("recording-filename-response"));
-				}
-			})
-	);
-	client->get("save-file");
+	QPointer<QLineEdit> fileLine(recordingFileLine);
+	session->getMany({ "save-file" },
+			[fileLine](const QVariantMap& values) -> void {
+				if (fileLine && values.contains("save-file"))
+					fileLine->setText(values["save-file"].toString());
+			});
 
 	/* Disable creating a data source. */
 	createSourceButton->setEnabled(false);
 
 	setupRecordingStatusHeartbeat();
+	updateQueueButton();
 }
 
 void MeactlWidget::stopRecording()
 {
-	client->stopRecording();
+	/* Stopping by hand also stops any queue of recordings. */
+	if (recordingQueue)
+		recordingQueue->stop();
+	session->stopRecording();
 }
 
 void MeactlWidget::onRecordingStopped(bool success, const QString& msg)
@@ -458,13 +517,11 @@ void MeactlWidget::onRecordingStopped(bool success, const QString& msg)
 
 void MeactlWidget::handleRecordingStopped()
 {
-	/* Disconnect functors which periodically check that the recording
-	 * exists. These are connected in setupRecordingStatusHearbeat().
+	/* Stop following the recording's status. The monitor is created
+	 * in setupRecordingStatusHeartbeat().
 	 */
-	if (connections.contains("recording-exists-connection"))
-		QObject::disconnect(connections.take("recording-exists-connection"));
-	if (connections.contains("recording-position-connections"))
-		QObject::disconnect(connections.take("recording-position-connections"));
+	if (statusMonitor)
+		statusMonitor->stop();
 	QObject::disconnect(startRecordingButton, &QPushButton::clicked,
 			this, &MeactlWidget::stopRecording);
 
@@ -474,29 +531,9 @@ void MeactlWidget::handleRecordingStopped()
 	recordingLengthLine->setReadOnly(false);
 	recordingPositionLine->setText("0");
 
-	/* Reconnect setting the filename. Here we reconnect the signal
-	 * because when starting a recording a different one is connected
-	 * in case other clients set the filename before we start.
-	 */
+	/* Re-enable setting the filename. */
 	recordingFileLine->setReadOnly(false);
 	recordingFileLine->setText("");
-	if (connections.contains("recording-filename-response"))
-		QObject::disconnect(connections.take("recording-filename-response"));
-	connections.insert("recording-filename-response",
-			QObject::connect(client, &BldsClient::setResponse,
-			[this](const QString& param, bool success, const QString& msg) -> void {
-				if (param != "save-file") {
-					return;
-				}
-				if (success) {
-					emit recordingFilenameChanged(recordingFileLine->text());
-				} else {
-					QMessageBox::warning(parentWidget(), "Could not set filename",
-							"The recording filename could not be set. " + msg);
-				}
-			})
-	);
-
 
 	/* Re-enable starting the recording. */
 	QObject::connect(startRecordingButton, &QPushButton::clicked,
@@ -508,25 +545,41 @@ void MeactlWidget::handleRecordingStopped()
 	 * for deleting at this point.
 	 */
 	createSourceButton->setEnabled(true);
-
-	/* Disable the periodic requests to the server for the status. */
-	QObject::disconnect(recordingStatusTimer, &QTimer::timeout, 0, 0);
-	recordingStatusTimer->stop();
+	updateQueueButton();
 }
 
 void MeactlWidget::setRecordingLength(int len)
 {
-	if (client)
-		client->set("recording-length", len);
+	if (!session)
+		return;
+	session->set("recording-length", len,
+			[this,len](bool success, const QString& msg) -> void {
+				if (success) {
+					emit recordingLengthChanged(QString::number(len));
+				} else {
+					NotificationCenter::instance()->warning(
+							"Could not change recording length",
+							"An error occurred changing the recording length: " + msg);
+				}
+			});
 }
 
 void MeactlWidget::setRecordingFilename(const QString& name)
 {
-	if (client)
-		client->set("save-file", name);
+	if (!session)
+		return;
+	session->set("save-file", name,
+			[this,name](bool success, const QString& msg) -> void {
+				if (success) {
+					emit recordingFilenameChanged(name);
+				} else {
+					NotificationCenter::instance()->warning("Could not set filename",
+							"The recording filename could not be set. " + msg);
+				}
+			});
 }
 
-void MeactlWidget::handleInitialStatusReply(QJsonObject json)
+void MeactlWidget::handleInitialStatusReply(const QJsonObject& json)
 {
 	/* Determine basic information about the server and source. */
 	auto sourceExists = json["source-exists"].toBool();
@@ -558,8 +611,14 @@ void MeactlWidget::handleInitialStatusReply(QJsonObject json)
 		QObject::connect(createSourceButton, &QPushButton::clicked,
 				this, &MeactlWidget::deleteDataSource);
 
-		/* Enable showing the source settings. */
+		/* Enable showing the source settings, and fetch them now so
+		 * the settings window can be shown immediately.
+		 */
 		showSettingsButton->setEnabled(true);
+		showPreviewButton->setEnabled(true);
+		showNoiseButton->setEnabled(true);
+		showActivityButton->setEnabled(sourceTypeBox->currentText() == "hidens");
+		session->requestSourceStatus();
 
 		if (recordingExists) {
 
@@ -602,6 +661,9 @@ void MeactlWidget::handleInitialStatusReply(QJsonObject json)
 		/* No source, enable creating one. */
 		createSourceButton->setEnabled(true);
 		showSettingsButton->setEnabled(false);
+		showPreviewButton->setEnabled(false);
+		showNoiseButton->setEnabled(false);
+		showActivityButton->setEnabled(false);
 		QObject::connect(createSourceButton, &QPushButton::clicked,
 				this, &MeactlWidget::createDataSource);
 
@@ -610,6 +672,8 @@ void MeactlWidget::handleInitialStatusReply(QJsonObject json)
 		QObject::connect(recordingLengthLine, &QLineEdit::returnPressed,
 				onLengthUpdate);
 	}
+
+	updateQueueButton();
 }
 
 void MeactlWidget::chooseRecordingDirectory()
@@ -620,100 +684,100 @@ void MeactlWidget::chooseRecordingDirectory()
 	if (dir.isNull() || dir.size() == 0)
 		return;
 
-	if (client) {
-		/* Connect handler to the response to set the directory. */
-		connections.insert("save-directory-connection", 
-				QObject::connect(client, &BldsClient::setResponse,
-				[this,dir](const QString& param, bool success, 
-						const QString& msg) -> void {
-					if (param == "save-directory") {
-						
-						/* Disconnect this slot. */
-						QObject::disconnect(client, &BldsClient::setResponse, 0, 0);
-
-						/* Notify, just a status bar message if successful, else
-						 * a full warning dialog.
-						 */
-						if (success) {
-							emit recordingDirectoryChanged(dir);
-						} else {
-							QMessageBox::warning(parentWidget(), "Could not set save path",
-									QString("Could not set the save directory. %1").arg(msg));
-						}
-						connections.remove("save-directory-connection");
+	if (session) {
+
+		/* Request to set the directory. Notify with just a status bar
+		 * message if successful, else a full warning dialog.
+		 */
+		session->set("save-directory", dir,
+				[this,dir](bool success, const QString& msg) -> void {
+					if (success) {
+						emit recordingDirectoryChanged(dir);
+					} else {
+						NotificationCenter::instance()->warning("Could not set save path",
+								QString("Could not set the save directory. %1").arg(msg));
 					}
-				})
-			);
-
-		/* Actually request to set the directory.*/
-		client->set("save-directory", dir);
+				});
 	}
 }
 
 void MeactlWidget::setupRecordingStatusHeartbeat()
 {
-	/* Periodically check that the recording still exists. */
-	QObject::connect(recordingStatusTimer, &QTimer::timeout, 
-			[this]() -> void {
-				if (client) {
-					client->get("recording-exists");
-				}
-			});
-
-	/* Functor for handling replies to the periodic recording-exists request */
-	connections.insert("recording-exists-connection", 
-			QObject::connect(client, &BldsClient::getResponse, 
-			[this](const QString& param, bool, 
-					const QVariant& data) -> void {
-				if (param != "recording-exists") {
-					return;
-				}
-				handleRecordingExistsReply(data.toBool());
-			})
-	);
+	createStatusMonitor();
+	statusMonitor->start();
+}
 
-	/* Functor for handling periodic requests for the recording position.
-	 * Note that these requests are actually made inside the method
-	 * handleRecordingExistsReply().
+void MeactlWidget::createStatusMonitor()
+{
+	/* Create the monitor the first time a recording is followed on
+	 * this client. It subscribes to updates pushed from the server,
+	 * or polls it if the server cannot push them.
 	 */
-	connections.insert("recording-position-connection", 
-			QObject::connect(client, &BldsClient::getResponse,
-			this, [this](const QString& param, bool, 
-					const QVariant& value) -> void {
-				if (param != "recording-position") {
-					return;
-				}
-				recordingPositionLine->setText(QString::number(value.toFloat(), 'f', 1));
-			})
-	);
+	if (!statusMonitor) {
+		statusMonitor = new RecordingStatusMonitor(session, this);
+		QObject::connect(statusMonitor, &RecordingStatusMonitor::positionChanged,
+				this, [this](double position) -> void {
+					recordingPositionLine->setText(QString::number(position, 'f', 1));
+				});
+
+		/* Handle the recording being stopped, possibly by a client
+		 * different from ourselves, and the source being deleted with it.
+		 */
+		QObject::connect(statusMonitor, &RecordingStatusMonitor::recordingEnded,
+				this, &MeactlWidget::handleRecordingStopped);
+		QObject::connect(statusMonitor, &RecordingStatusMonitor::sourceRemoved,
+				this, &MeactlWidget::handleSourceDeleted);
+	}
+}
 
-	/* In the case that the recording has been stopped, that handler
-	 * then checks if the source still exists as well. This functor
-	 * handles those responses.
-	 */
-	connections.insert("source-exists-connection", 
-			QObject::connect(client, &BldsClient::getResponse,
-			[this](const QString& param, bool, const QVariant& data) -> void {
-				if (param != "source-exists") {
-					return;
-				}
-				if (!data.toBool()) {
-					handleSourceDeleted();
-				}
-			})
-	);
+void MeactlWidget::runRecordingQueue()
+{
+	auto fname = QFileDialog::getOpenFileName(this, "Choose recording queue",
+			QDir::homePath(), "JSON files (*.json)");
+	if (fname.isNull() || fname.size() == 0)
+		return;
+	QString error;
+	auto entries = RecordingQueue::readEntries(fname, &error);
+	if (entries.isEmpty()) {
+		NotificationCenter::instance()->warning("Could not read recording queue",
+				error.isEmpty() ? "The file contains no recordings." : error);
+		return;
+	}
 
-	recordingStatusTimer->start();
+	/* The queue shares the status monitor, so that it sees each
+	 * recording end at the same time as this widget.
+	 */
+	createStatusMonitor();
+	if (recordingQueue)
+		recordingQueue->deleteLater();
+	recordingQueue = new RecordingQueue(session, statusMonitor, this);
+	for (auto& entry : entries)
+		recordingQueue->append(entry);
+	auto count = entries.size();
+	QObject::connect(recordingQueue, &RecordingQueue::entryStarted,
+			this, [this,count](int index, const QString&) -> void {
+				emit recordingQueueAdvanced(index, count);
+			});
+	QObject::connect(recordingQueue, &RecordingQueue::transition,
+			this, &MeactlWidget::recordingQueueTransition);
+	QObject::connect(recordingQueue, &RecordingQueue::failed,
+			this, [this](int index, const QString& msg) -> void {
+				NotificationCenter::instance()->error("Recording queue stopped",
+						QString("Recording %1 of the queue failed. %2").arg(
+							index + 1).arg(msg));
+			});
+	QObject::connect(recordingQueue, &RecordingQueue::finished,
+			this, &MeactlWidget::updateQueueButton);
+	recordingQueue->start();
+	updateQueueButton();
 }
 
-void MeactlWidget::handleRecordingExistsReply(bool exists)
+void MeactlWidget::updateQueueButton()
 {
-	if (exists) {
-		client->get("recording-position");
-	} else {
-		handleRecordingStopped();
-		client->get("source-exists");
-	}
+	auto idle = startRecordingButton->isEnabled() &&
+		(startRecordingButton->text() == "Start");
+	auto queueRunning = recordingQueue && recordingQueue->isRunning();
+	runQueueButton->setEnabled(session && idle && !queueRunning);
 }
 
 void MeactlWidget::cancelPendingServerConnection()
@@ -729,28 +793,115 @@ void MeactlWidget::cancelPendingServerConnection()
 	serverHostLine->setReadOnly(false);
 	emit serverConnectionCanceled();
 
-	/* Delete the client. */
-	if (client) {
-		QObject::disconnect(client, 0, 0, 0);
-		client->deleteLater();
+	/* Delete the session. */
+	if (session) {
+		QObject::disconnect(session, 0, 0, 0);
+		session->disconnectFromServer();
+		session->deleteLater();
 	}
 }
 
 void MeactlWidget::showSettingsWindow()
 {
-	if (!client)
+	if (!session)
+		return;
+
+	/* The window shares our session and its cached source status,
+	 * so it is shown without any connection or status round trip.
+	 */
+	if (!settingsWindow) {
+		settingsWindow = new SourceSettingsWindow(session, this);
+		QObject::connect(settingsWindow, &SourceSettingsWindow::adcRangeChanged,
+				this, &MeactlWidget::adcRangeChanged);
+		QObject::connect(settingsWindow, &SourceSettingsWindow::configurationChanged,
+				this, &MeactlWidget::configurationChanged);
+		QObject::connect(settingsWindow, &SourceSettingsWindow::analogOutputChanged,
+				this, &MeactlWidget::analogOutputChanged);
+		QObject::connect(settingsWindow, &SourceSettingsWindow::triggerChanged,
+				this, &MeactlWidget::triggerChanged);
+		QObject::connect(settingsWindow, &SourceSettingsWindow::plugChanged,
+				this, &MeactlWidget::plugChanged);
+	}
+	settingsWindow->show();
+	settingsWindow->raise();
+	settingsWindow->activateWindow();
+}
+
+void MeactlWidget::closeSettingsWindow()
+{
+	if (settingsWindow) {
+		settingsWindow->close();
+		settingsWindow->deleteLater();
+		settingsWindow.clear();
+	}
+}
+
+void MeactlWidget::showPreviewWindow()
+{
+	if (!session)
+		return;
+
+	/* The feed belongs to the session, so that every view of the live
+	 * data shares its requests, and it goes away with the connection.
+	 */
+	if (!dataFeed)
+		dataFeed = new LiveDataFeed(session, session);
+	if (!previewWindow)
+		previewWindow = new DataPreviewWindow(dataFeed, this);
+	previewWindow->show();
+	previewWindow->raise();
+	previewWindow->activateWindow();
+}
+
+void MeactlWidget::closePreviewWindow()
+{
+	if (previewWindow) {
+		previewWindow->close();
+		previewWindow->deleteLater();
+		previewWindow.clear();
+	}
+}
+
+void MeactlWidget::showActivityWindow()
+{
+	if (!session)
 		return;
-	auto win = new SourceSettingsWindow(client->hostname(), this);
-	QObject::connect(win, &SourceSettingsWindow::adcRangeChanged,
-			this, &MeactlWidget::adcRangeChanged);
-	QObject::connect(win, &SourceSettingsWindow::configurationChanged,
-			this, &MeactlWidget::configurationChanged);
-	QObject::connect(win, &SourceSettingsWindow::analogOutputChanged,
-			this, &MeactlWidget::analogOutputChanged);
-	QObject::connect(win, &SourceSettingsWindow::triggerChanged,
-			this, &MeactlWidget::triggerChanged);
-	QObject::connect(win, &SourceSettingsWindow::plugChanged,
-			this, &MeactlWidget::plugChanged);
-	win->show();
+	if (!dataFeed)
+		dataFeed = new LiveDataFeed(session, session);
+	if (!activityWindow)
+		activityWindow = new SpikeActivityWindow(dataFeed, this);
+	activityWindow->show();
+	activityWindow->raise();
+	activityWindow->activateWindow();
 }
 
+void MeactlWidget::closeActivityWindow()
+{
+	if (activityWindow) {
+		activityWindow->close();
+		activityWindow->deleteLater();
+		activityWindow.clear();
+	}
+}
+
+void MeactlWidget::showNoiseWindow()
+{
+	if (!session)
+		return;
+	if (!dataFeed)
+		dataFeed = new LiveDataFeed(session, session);
+	if (!noiseWindow)
+		noiseWindow = new ChannelStatisticsWindow(dataFeed, this);
+	noiseWindow->show();
+	noiseWindow->raise();
+	noiseWindow->activateWindow();
+}
+
+void MeactlWidget::closeNoiseWindow()
+{
+	if (noiseWindow) {
+		noiseWindow->close();
+		noiseWindow->deleteLater();
+		noiseWindow.clear();
+	}
+}
@@ -11,6 +11,12 @@ MeactlWindow::MeactlWindow(QWidget* parent) :
 	QMainWindow(parent)
 {
 	controller = new MeactlWidget(this);
+	latencyRecorder = new LatencyRecorder(this);
+	controller->setLatencyRecorder(latencyRecorder);
+	stimulusCache = new StimulusCache(StimulusCache::DefaultCapacity, this);
+	controller->setStimulusCache(stimulusCache);
+	QObject::connect(latencyRecorder, &LatencyRecorder::recorded,
+			this, &MeactlWindow::handleLatencyRecorded);
 	QObject::connect(controller, &MeactlWidget::connectedToServer,
 			this, &MeactlWindow::handleServerConnection);
 	QObject::connect(controller, &MeactlWidget::disconnectedFromServer,
@@ -19,6 +25,14 @@ MeactlWindow::MeactlWindow(QWidget* parent) :
 			this, &MeactlWindow::handleSourceCreated);
 	QObject::connect(controller, &MeactlWidget::sourceDeleted,
 			this, &MeactlWindow::handleSourceDeleted);
+	QObject::connect(controller, &MeactlWidget::connectionLost,
+			this, &MeactlWindow::handleConnectionLost);
+	QObject::connect(controller, &MeactlWidget::reconnected,
+			this, &MeactlWindow::handleReconnected);
+	QObject::connect(controller, &MeactlWidget::recordingQueueAdvanced,
+			this, &MeactlWindow::handleRecordingQueueAdvanced);
+	QObject::connect(controller, &MeactlWidget::recordingQueueTransition,
+			this, &MeactlWindow::handleRecordingQueueTransition);
 	QObject::connect(controller, &MeactlWidget::serverConnectionCanceled,
 			this, &MeactlWindow::handleServerConnectionCanceled);
 	QObject::connect(controller, &MeactlWidget::recordingStarted,
@@ -44,6 +58,27 @@ MeactlWindow::MeactlWindow(QWidget* parent) :
 
 	setWindowTitle("MEA controller");
 	setCentralWidget(controller);
+
+	/* Show the latest latency next to the status bar. */
+	latencyLabel = new QLabel("", this);
+	latencyLabel->setToolTip("Round trip time of the latest request to the BLDS");
+	latencyButton = new QToolButton(this);
+	latencyButton->setText("Latency");
+	latencyButton->setToolTip("Show the round trip times of all requests");
+	QObject::connect(latencyButton, &QToolButton::clicked,
+			this, &MeactlWindow::showLatencyWindow);
+	statusBar()->addPermanentWidget(latencyLabel);
+	statusBar()->addPermanentWidget(latencyButton);
+
+	/* Errors are shown as toasts beside the window rather than in
+	 * message boxes, so they never hold up the controls, and kept in
+	 * a history shown from the status bar.
+	 */
+	toasts = new NotificationToasts(NotificationCenter::instance(), this);
+	notificationButton = new NotificationButton(NotificationCenter::instance(), this);
+	QObject::connect(toasts, &NotificationToasts::activated,
+			notificationButton, &NotificationButton::showNotifications);
+	statusBar()->addPermanentWidget(notificationButton);
 	statusBar()->showMessage("Ready", StatusMessageTimeout);
 }
 
@@ -67,7 +102,7 @@ void MeactlWindow::handleSourceCreated(bool success, const QString& msg)
 	QString status = success ? "Data source created" : "Could not create source";
 	statusBar()->showMessage(status, StatusMessageTimeout);
 	if (!success) {
-		QMessageBox::critical(this, "Could not create source", msg);
+		NotificationCenter::instance()->error("Could not create source", msg);
 	}
 }
 
@@ -76,7 +111,7 @@ void MeactlWindow::handleSourceDeleted(bool success, const QString& msg)
 	QString status = success ? "Data source deleted" : "Could not delete source";
 	statusBar()->showMessage(status, StatusMessageTimeout);
 	if (!success) {
-		QMessageBox::critical(this, "Could not delete data source", msg);
+		NotificationCenter::instance()->error("Could not delete data source", msg);
 	}
 }
 
@@ -85,7 +120,7 @@ void MeactlWindow::handleRecordingStarted(bool success, const QString& msg)
 	QString status = success ? "Recording started" : "Could not start recording";
 	statusBar()->showMessage(status, StatusMessageTimeout);
 	if (!success) {
-		QMessageBox::critical(this, "Could not start recording", msg);
+		NotificationCenter::instance()->error("Could not start recording", msg);
 	}
 }
 
@@ -94,7 +129,7 @@ void MeactlWindow::handleRecordingStopped(bool success, const QString& msg)
 	QString status = success ? "Recording stopped" : "Could not stop recording";
 	statusBar()->showMessage(status, StatusMessageTimeout);
 	if (!success) {
-		QMessageBox::critical(this, "Could not stop recording", msg);
+		NotificationCenter::instance()->error("Could not stop recording", msg);
 	}
 }
 
@@ -104,6 +139,48 @@ void MeactlWindow::handleSaveDirectoryChanged(const QString& dir)
 			StatusMessageTimeout);
 }
 
+void MeactlWindow::handleConnectionLost(const QString& reason)
+{
+	/* Keep the message up until the connection is recovered. */
+	statusBar()->showMessage("Connection to BLDS lost, reconnecting: " + reason);
+}
+
+void MeactlWindow::handleReconnected(qint64 recoveryTime)
+{
+	statusBar()->showMessage(QString("Reconnected to BLDS after %1 ms").arg(
+				recoveryTime), StatusMessageTimeout);
+}
+
+void MeactlWindow::handleRecordingQueueAdvanced(int index, int count)
+{
+	statusBar()->showMessage(QString("Started recording %1 of %2 in the queue").arg(
+				index + 1).arg(count), StatusMessageTimeout);
+}
+
+void MeactlWindow::handleRecordingQueueTransition(int index, qint64 gap)
+{
+	/* Keep the gap up for the whole recording, it is most useful
+	 * when it can be checked at any time.
+	 */
+	statusBar()->showMessage(QString("Started recording %1 in the queue, "
+				"%2 ms after the previous one").arg(index + 1).arg(gap));
+}
+
+void MeactlWindow::handleLatencyRecorded(const QString& command, qint64 usec)
+{
+	latencyLabel->setText(QString("%1: %2 ms").arg(command).arg(
+				usec / 1000., 0, 'f', 1));
+}
+
+void MeactlWindow::showLatencyWindow()
+{
+	if (!latencyWindow)
+		latencyWindow = new LatencyWindow(latencyRecorder, this);
+	latencyWindow->show();
+	latencyWindow->raise();
+	latencyWindow->activateWindow();
+}
+
 void MeactlWindow::handleServerConnectionCanceled()
 {
 	statusBar()->showMessage("Pending connection to BLDS canceled", 
@@ -134,10 +211,13 @@ void MeactlWindow::handleConfigurationChanged(const QString& file)
 			StatusMessageTimeout);
 }
 
-void MeactlWindow::handleAnalogOutputChanged(const QString& file)
+void MeactlWindow::handleAnalogOutputChanged(const QString& file, int channels,
+		qint64 frames)
 {
 	statusBar()->showMessage(( (file.size() == 0) ?
-			"Analog output cleared" : "Analog output read from " + file),
+			"Analog output cleared" :
+			QString("Analog output set from %1 (%2 channel(s) of %3 samples)").arg(
+				file, QString::number(channels), QString::number(frames))),
 			StatusMessageTimeout);
 }
 
@@ -0,0 +1,315 @@
+/*! \file multi-rig-window.cc
+ *
+ * Implementation of the MultiRigWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "multi-rig-window.h"
+
+#include <algorithm>
+
+MultiRigWindow::MultiRigWindow(const QStringList& hosts, QWidget* parent) :
+	QMainWindow(parent),
+	fanOutActive(false)
+{
+	scheduler = new RigStatusScheduler(this);
+	QObject::connect(scheduler, &RigStatusScheduler::statusUpdated,
+			this, &MultiRigWindow::handleStatus);
+
+	setupLayout();
+	setWindowTitle("MEA controller (multiple rigs)");
+
+	/* Failures are shown as toasts, so they never hold up the next
+	 * command to the rigs.
+	 */
+	toasts = new NotificationToasts(NotificationCenter::instance(), this);
+	notificationButton = new NotificationButton(NotificationCenter::instance(), this);
+	QObject::connect(toasts, &NotificationToasts::activated,
+			notificationButton, &NotificationButton::showNotifications);
+	statusBar()->addPermanentWidget(notificationButton);
+	statusBar()->showMessage("Ready", StatusMessageTimeout);
+	for (auto& host : hosts)
+		addRig(host);
+}
+
+MultiRigWindow::~MultiRigWindow()
+{
+}
+
+void MultiRigWindow::setupLayout()
+{
+	central = new QWidget(this);
+	layout = new QGridLayout(central);
+
+	rigTable = new QTableWidget(0, ColumnCount, central);
+	rigTable->setHorizontalHeaderLabels({
+			"Host", "Connection", "Source", "Recording", "Position" });
+	rigTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	rigTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+	rigTable->verticalHeader()->setVisible(false);
+	rigTable->horizontalHeader()->setStretchLastSection(true);
+
+	hostLine = new QLineEdit("", central);
+	hostLine->setToolTip("Hostname or IP address of the rig's BLDS");
+	addRigButton = new QPushButton("Add", central);
+	addRigButton->setToolTip("Add a rig and connect to its BLDS");
+	removeRigButton = new QPushButton("Remove", central);
+	removeRigButton->setToolTip("Disconnect from and remove the selected rigs");
+	startAllButton = new QPushButton("Start all", central);
+	startAllButton->setToolTip("Start recording on every rig with a source");
+	stopAllButton = new QPushButton("Stop all", central);
+	stopAllButton->setToolTip("Stop recording on every rig");
+	skewLabel = new QLabel("Skew: -", central);
+	skewLabel->setToolTip("Estimated spread of the times at which the "
+			"rigs handled the last request sent to all of them");
+
+	layout->addWidget(rigTable, 0, 0, 1, 4);
+	layout->addWidget(hostLine, 1, 0, 1, 2);
+	layout->addWidget(addRigButton, 1, 2);
+	layout->addWidget(removeRigButton, 1, 3);
+	layout->addWidget(skewLabel, 2, 0, 1, 2);
+	layout->addWidget(startAllButton, 2, 2);
+	layout->addWidget(stopAllButton, 2, 3);
+	setCentralWidget(central);
+
+	QObject::connect(addRigButton, &QPushButton::clicked,
+			this, [this]() -> void {
+				if (!hostLine->text().isEmpty()) {
+					addRig(hostLine->text());
+					hostLine->clear();
+				}
+			});
+	QObject::connect(hostLine, &QLineEdit::returnPressed,
+			addRigButton, &QPushButton::click);
+	QObject::connect(removeRigButton, &QPushButton::clicked,
+			this, &MultiRigWindow::removeSelectedRigs);
+	QObject::connect(startAllButton, &QPushButton::clicked,
+			this, &MultiRigWindow::startAll);
+	QObject::connect(stopAllButton, &QPushButton::clicked,
+			this, &MultiRigWindow::stopAll);
+}
+
+int MultiRigWindow::rowOf(BldsSession* session) const
+{
+	for (int i = 0; i < rigs.size(); i++) {
+		if (rigs.at(i).session == session)
+			return i;
+	}
+	return -1;
+}
+
+void MultiRigWindow::setCell(BldsSession* session, Column column, const QString& text)
+{
+	auto row = rowOf(session);
+	if (row == -1)
+		return;
+	auto item = rigTable->item(row, column);
+	if (!item) {
+		item = new QTableWidgetItem;
+		rigTable->setItem(row, column, item);
+	}
+	item->setText(text);
+}
+
+void MultiRigWindow::addRig(const QString& host)
+{
+	auto session = new BldsSession(host, this);
+	Rig rig = { session, false, false };
+	rigs.append(rig);
+	rigTable->insertRow(rigTable->rowCount());
+	setCell(session, HostColumn, host);
+	setCell(session, ConnectionColumn, "Connecting");
+
+	QObject::connect(session, &BldsSession::connected,
+			this, [this,session](bool made) -> void {
+				setCell(session, ConnectionColumn, made ? "Connected" : "Failed");
+				if (made)
+					scheduler->addSession(session);
+			});
+	QObject::connect(session, &BldsSession::connectionLost,
+			this, [this,session](const QString& reason) -> void {
+				setCell(session, ConnectionColumn, "Reconnecting");
+
+				/* The reply to a request sent to all rigs is lost with
+				 * the connection, so count it as failed.
+				 */
+				if (fanOutActive)
+					handleFanOutReply(session, fanOutState.action, false, reason);
+			});
+	QObject::connect(session, &BldsSession::reconnected,
+			this, [this,session](qint64, const QJsonObject&) -> void {
+				setCell(session, ConnectionColumn, "Connected");
+			});
+	QObject::connect(session, &BldsSession::reconnectFailed,
+			this, [this,session](const QString&) -> void {
+				setCell(session, ConnectionColumn, "Lost");
+			});
+	QObject::connect(session, &BldsSession::recordingStarted,
+			this, [this,session](bool success, const QString& msg) -> void {
+				handleFanOutReply(session, "start", success, msg);
+			});
+	QObject::connect(session, &BldsSession::recordingStopped,
+			this, [this,session](bool success, const QString& msg) -> void {
+				handleFanOutReply(session, "stop", success, msg);
+			});
+	session->connectToServer();
+}
+
+void MultiRigWindow::removeSelectedRigs()
+{
+	if (fanOutActive) {
+		statusBar()->showMessage("Rigs cannot be removed while waiting for "
+				"them to reply", StatusMessageTimeout);
+		return;
+	}
+	auto selected = rigTable->selectionModel()->selectedRows();
+	QList<int> rows;
+	for (auto& index : selected)
+		rows << index.row();
+	std::sort(rows.begin(), rows.end(), std::greater<int>());
+	for (auto row : rows) {
+		auto session = rigs.takeAt(row).session;
+		rigTable->removeRow(row);
+		if (session) {
+			scheduler->removeSession(session);
+			QObject::disconnect(session, 0, this, 0);
+			session->disconnectFromServer();
+			session->deleteLater();
+		}
+	}
+}
+
+void MultiRigWindow::handleStatus(BldsSession* session, const QVariantMap& values)
+{
+	auto row = rowOf(session);
+	if (row == -1)
+		return;
+	auto& rig = rigs[row];
+	rig.sourceExists = values.value("source-exists").toBool();
+	rig.recordingExists = values.value("recording-exists").toBool();
+	setCell(session, SourceColumn, rig.sourceExists ? "Yes" : "No");
+	setCell(session, RecordingColumn, rig.recordingExists ? "Yes" : "No");
+	setCell(session, PositionColumn, rig.recordingExists ?
+			QString::number(values.value("recording-position").toDouble(), 'f', 1) : "");
+}
+
+void MultiRigWindow::startAll()
+{
+	QList<BldsSession*> ready;
+	for (auto& rig : rigs) {
+		if (rig.session && (rig.session->state() == BldsSession::State::Connected) &&
+				rig.sourceExists && !rig.recordingExists) {
+			ready << rig.session;
+		}
+	}
+	fanOut("start", ready);
+}
+
+void MultiRigWindow::stopAll()
+{
+	QList<BldsSession*> recording;
+	for (auto& rig : rigs) {
+		if (rig.session && (rig.session->state() == BldsSession::State::Connected) &&
+				rig.recordingExists) {
+			recording << rig.session;
+		}
+	}
+	fanOut("stop", recording);
+}
+
+void MultiRigWindow::fanOut(const QString& action, const QList<BldsSession*>& sessions)
+{
+	if (fanOutActive) {
+		statusBar()->showMessage("Still waiting for the rigs to reply",
+				StatusMessageTimeout);
+		return;
+	}
+	if (sessions.isEmpty()) {
+		statusBar()->showMessage("No rigs are ready to " + action,
+				StatusMessageTimeout);
+		return;
+	}
+
+	fanOutActive = true;
+	fanOutState.action = action;
+	fanOutState.sent.clear();
+	fanOutState.midpoints.clear();
+	fanOutState.errors.clear();
+	fanOutState.outstanding = sessions.size();
+	startAllButton->setEnabled(false);
+	stopAllButton->setEnabled(false);
+
+	/* Delay the request to each rig by how much sooner it would reach
+	 * its server than the request to the slowest rig. Rigs whose round
+	 * trip has not yet been measured are sent to first.
+	 */
+	double slowest = 0;
+	for (auto session : sessions)
+		slowest = std::max(slowest, scheduler->roundTripTime(session) / 2);
+
+	fanOutState.clock.start();
+	for (auto session : sessions) {
+		auto oneWay = scheduler->roundTripTime(session) / 2;
+		auto delay = (oneWay < 0) ? 0 : qRound(slowest - oneWay);
+		QPointer<BldsSession> target(session);
+		auto send = [this,target,action]() -> void {
+			if (!target)
+				return;
+			fanOutState.sent.insert(target, fanOutState.clock.nsecsElapsed() / 1e6);
+			if (action == "start") {
+				target->startRecording();
+			} else {
+				target->stopRecording();
+			}
+		};
+		if (delay == 0) {
+			send();
+		} else {
+			QTimer::singleShot(delay, Qt::PreciseTimer, this, send);
+		}
+	}
+}
+
+void MultiRigWindow::handleFanOutReply(BldsSession* session, const QString& action,
+		bool success, const QString& msg)
+{
+	if (!fanOutActive || (fanOutState.action != action) ||
+			!fanOutState.sent.contains(session)) {
+		return;
+	}
+
+	/* The server handled the request at some time between sending it
+	 * and receiving the reply, estimated as the midpoint.
+	 */
+	auto sent = fanOutState.sent.take(session);
+	auto received = fanOutState.clock.nsecsElapsed() / 1e6;
+	if (success) {
+		fanOutState.midpoints << (sent + received) / 2;
+	} else {
+		fanOutState.errors << QString("%1: %2").arg(session->hostname(), msg);
+	}
+	if (--fanOutState.outstanding > 0)
+		return;
+
+	fanOutActive = false;
+	startAllButton->setEnabled(true);
+	stopAllButton->setEnabled(true);
+	double skew = 0;
+	if (!fanOutState.midpoints.isEmpty()) {
+		auto range = std::minmax_element(fanOutState.midpoints.cbegin(),
+				fanOutState.midpoints.cend());
+		skew = *range.second - *range.first;
+	}
+	skewLabel->setText(QString("Skew: %1 ms").arg(skew, 0, 'f', 2));
+	if (fanOutState.errors.isEmpty()) {
+		statusBar()->showMessage(QString("Sent %1 to all rigs").arg(action),
+				StatusMessageTimeout);
+	} else {
+		NotificationCenter::instance()->warning("Some rigs failed",
+				QString("Could not %1 recording on some rigs:\n\n%2").arg(
+					action, fanOutState.errors.join("\n")));
+	}
+	emit fanOutFinished(action, skew, fanOutState.errors.size());
+}
+
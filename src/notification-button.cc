@@ -0,0 +1,45 @@
+/*! \file notification-button.cc
+ *
+ * Implementation of the NotificationButton class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "notification-button.h"
+
+NotificationButton::NotificationButton(NotificationCenter* c, QWidget* parent) :
+	QToolButton(parent),
+	center(c)
+{
+	setToolTip("Show all errors and warnings");
+	QObject::connect(this, &QToolButton::clicked,
+			this, [this]() -> void {
+				showNotifications();
+			});
+	QObject::connect(center, &NotificationCenter::unreadCountChanged,
+			this, &NotificationButton::showUnreadCount);
+	showUnreadCount(center->unreadCount());
+}
+
+NotificationButton::~NotificationButton()
+{
+}
+
+void NotificationButton::showNotifications(quint64 id)
+{
+	if (!center)
+		return;
+	if (!window)
+		window = new NotificationWindow(center, parentWidget());
+	window->show();
+	window->raise();
+	window->activateWindow();
+	window->select(id);
+}
+
+void NotificationButton::showUnreadCount(int count)
+{
+	setText((count > 0) ? QString("Notifications (%1)").arg(count) :
+			QString("Notifications"));
+}
+
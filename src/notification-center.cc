@@ -0,0 +1,160 @@
+/*! \file notification-center.cc
+ *
+ * Implementation of the NotificationCenter class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "notification-center.h"
+
+NotificationCenter* NotificationCenter::instance()
+{
+	/* The center is destroyed with the application. */
+	static QPointer<NotificationCenter> center;
+	if (!center)
+		center = new NotificationCenter(QCoreApplication::instance());
+	return center;
+}
+
+NotificationCenter::NotificationCenter(QObject* parent) :
+	QObject(parent),
+	nextId(1),
+	unread(0)
+{
+}
+
+NotificationCenter::~NotificationCenter()
+{
+}
+
+/* Return the key identifying repeats of a notification. */
+static QString repeatKey(NotificationCenter::Severity severity,
+		const QString& title, const QString& message)
+{
+	return QString("%1\n%2\n%3").arg(static_cast<int>(severity)).arg(title, message);
+}
+
+quint64 NotificationCenter::notify(Severity severity, const QString& title,
+		const QString& message)
+{
+	auto now = QDateTime::currentDateTime();
+	auto key = repeatKey(severity, title, message);
+	auto index = indexOf(latestByKey.value(key));
+	if ((index >= 0) &&
+			(notifications.at(index).last.msecsTo(now) <= DedupInterval)) {
+		auto& repeat = notifications[index];
+		repeat.last = now;
+		repeat.count++;
+		repeat.read = false;
+		emit repeated(repeat);
+		updateUnreadCount();
+		return repeat.id;
+	}
+
+	Notification notification;
+	notification.id = nextId++;
+	notification.severity = severity;
+	notification.title = title;
+	notification.message = message;
+	notification.first = now;
+	notification.last = now;
+	notification.count = 1;
+	notifications.append(notification);
+	latestByKey.insert(key, notification.id);
+	while (notifications.size() > MaxHistory) {
+		auto oldest = notifications.takeFirst();
+		auto oldestKey = repeatKey(oldest.severity, oldest.title, oldest.message);
+		if (latestByKey.value(oldestKey) == oldest.id)
+			latestByKey.remove(oldestKey);
+	}
+	emit posted(notification);
+	updateUnreadCount();
+	return notification.id;
+}
+
+quint64 NotificationCenter::info(const QString& title, const QString& message)
+{
+	return notify(Severity::Info, title, message);
+}
+
+quint64 NotificationCenter::warning(const QString& title, const QString& message)
+{
+	return notify(Severity::Warning, title, message);
+}
+
+quint64 NotificationCenter::error(const QString& title, const QString& message)
+{
+	return notify(Severity::Error, title, message);
+}
+
+NotificationCenter::Notification NotificationCenter::notification(quint64 id) const
+{
+	auto index = indexOf(id);
+	return (index >= 0) ? notifications.at(index) : Notification();
+}
+
+QList<NotificationCenter::Notification> NotificationCenter::history() const
+{
+	return notifications;
+}
+
+int NotificationCenter::unreadCount() const
+{
+	return unread;
+}
+
+QString NotificationCenter::severityName(Severity severity)
+{
+	switch (severity) {
+		case Severity::Info:
+			return "Info";
+		case Severity::Warning:
+			return "Warning";
+		case Severity::Error:
+			return "Error";
+	}
+	return QString();
+}
+
+void NotificationCenter::markAllRead()
+{
+	for (auto& notification : notifications)
+		notification.read = true;
+	updateUnreadCount();
+}
+
+void NotificationCenter::clear()
+{
+	notifications.clear();
+	latestByKey.clear();
+	emit cleared();
+	updateUnreadCount();
+}
+
+int NotificationCenter::indexOf(quint64 id) const
+{
+	/* IDs increase through the history, and recent notifications are
+	 * looked up most often.
+	 */
+	if (id == 0)
+		return -1;
+	for (int i = notifications.size() - 1; i >= 0; i--) {
+		if (notifications.at(i).id == id)
+			return i;
+		if (notifications.at(i).id < id)
+			break;
+	}
+	return -1;
+}
+
+void NotificationCenter::updateUnreadCount()
+{
+	int count = 0;
+	for (auto& notification : notifications)
+		count += notification.read ? 0 : 1;
+	if (count != unread) {
+		unread = count;
+		emit unreadCountChanged(unread);
+	}
+}
+
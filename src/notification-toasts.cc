@@ -0,0 +1,184 @@
+/*! \file notification-toasts.cc
+ *
+ * Implementation of the NotificationToasts class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "notification-toasts.h"
+
+NotificationToasts::NotificationToasts(NotificationCenter* c, QWidget* h) :
+	QObject(h),
+	center(c),
+	host(h)
+{
+	QObject::connect(center, &NotificationCenter::posted,
+			this, &NotificationToasts::handlePosted);
+	QObject::connect(center, &NotificationCenter::repeated,
+			this, &NotificationToasts::handleRepeated);
+	QObject::connect(center, &NotificationCenter::cleared,
+			this, &NotificationToasts::dismissAll);
+	host->installEventFilter(this);
+}
+
+NotificationToasts::~NotificationToasts()
+{
+	for (auto& toast : toasts)
+		delete toast.label;
+}
+
+int NotificationToasts::timeout(NotificationCenter::Severity severity)
+{
+	switch (severity) {
+		case NotificationCenter::Severity::Info:
+			return 4000;
+		case NotificationCenter::Severity::Warning:
+			return 8000;
+		case NotificationCenter::Severity::Error:
+			return 15000;
+	}
+	return 4000;
+}
+
+bool NotificationToasts::eventFilter(QObject* object, QEvent* event)
+{
+	if ((object == host) && ((event->type() == QEvent::Move) ||
+				(event->type() == QEvent::Resize))) {
+		arrange();
+		return false;
+	}
+	if (event->type() == QEvent::MouseButtonRelease) {
+		for (auto& toast : toasts) {
+			if (toast.label.data() == object) {
+				auto id = toast.id;
+				dismiss(id);
+				emit activated(id);
+				return true;
+			}
+		}
+	}
+	return QObject::eventFilter(object, event);
+}
+
+void NotificationToasts::handlePosted(const NotificationCenter::Notification& notification)
+{
+	queued.enqueue(notification.id);
+	showQueued();
+}
+
+void NotificationToasts::handleRepeated(const NotificationCenter::Notification& notification)
+{
+	for (auto& toast : toasts) {
+		if ((toast.id == notification.id) && toast.label) {
+			describe(toast.label, notification);
+			toast.label->adjustSize();
+			toast.timer->start(timeout(notification.severity));
+			arrange();
+			return;
+		}
+	}
+	if (!queued.contains(notification.id))
+		handlePosted(notification);
+}
+
+void NotificationToasts::dismissAll()
+{
+	queued.clear();
+	while (!toasts.isEmpty())
+		dismiss(toasts.first().id);
+}
+
+void NotificationToasts::showQueued()
+{
+	while ((toasts.size() < MaxVisible) && !queued.isEmpty() && center) {
+		auto notification = center->notification(queued.dequeue());
+		if (notification.id == 0)
+			continue;
+
+		/* The toast is a window of its own, so that it does not cover
+		 * the host's controls, but it never takes the focus from them.
+		 */
+		auto label = new QLabel(host, Qt::Tool | Qt::FramelessWindowHint |
+				Qt::WindowDoesNotAcceptFocus);
+		label->setAttribute(Qt::WA_ShowWithoutActivating);
+		label->setWordWrap(true);
+		label->setFixedWidth(ToastWidth);
+		label->setMargin(8);
+		label->setCursor(Qt::PointingHandCursor);
+		label->setToolTip("Click to dismiss and show all notifications");
+		describe(label, notification);
+		label->adjustSize();
+		label->installEventFilter(this);
+
+		auto timer = new QTimer(label);
+		timer->setSingleShot(true);
+		auto id = notification.id;
+		QObject::connect(timer, &QTimer::timeout,
+				this, [this, id]() -> void {
+					dismiss(id);
+				});
+		timer->start(timeout(notification.severity));
+		toasts.append({ id, label, timer });
+		arrange();
+		label->show();
+	}
+}
+
+void NotificationToasts::dismiss(quint64 id)
+{
+	for (int i = 0; i < toasts.size(); i++) {
+		if (toasts.at(i).id == id) {
+			auto label = toasts.takeAt(i).label;
+			if (label) {
+				label->hide();
+				label->deleteLater();
+			}
+			break;
+		}
+	}
+	arrange();
+	showQueued();
+}
+
+void NotificationToasts::describe(QLabel* label,
+		const NotificationCenter::Notification& notification)
+{
+	static const QHash<int, QString> Colors = {
+		{ static_cast<int>(NotificationCenter::Severity::Info), "#e8f0fe" },
+		{ static_cast<int>(NotificationCenter::Severity::Warning), "#fff4d6" },
+		{ static_cast<int>(NotificationCenter::Severity::Error), "#fde2e1" }
+	};
+	label->setStyleSheet(QString("QLabel { background: %1; color: black; "
+				"border: 1px solid #808080; }").arg(
+				Colors.value(static_cast<int>(notification.severity))));
+	auto text = QString("<b>%1: %2</b><br>%3").arg(
+			NotificationCenter::severityName(notification.severity),
+			notification.title.toHtmlEscaped(),
+			notification.message.toHtmlEscaped().replace("\n", "<br>"));
+	if (notification.count > 1)
+		text += QString("<br><i>Repeated %1 times</i>").arg(notification.count);
+	label->setText(text);
+}
+
+void NotificationToasts::arrange()
+{
+	if (!host)
+		return;
+
+	/* Stack the toasts upwards from the host's bottom right corner,
+	 * newest at the bottom, keeping them on the host's screen.
+	 */
+	auto frame = host->frameGeometry();
+	auto screen = QApplication::desktop()->availableGeometry(host);
+	auto x = qMin(frame.right() + Spacing, screen.right() - ToastWidth);
+	auto y = qMin(frame.bottom(), screen.bottom());
+	for (int i = toasts.size() - 1; i >= 0; i--) {
+		auto label = toasts.at(i).label;
+		if (!label)
+			continue;
+		y -= label->height();
+		label->move(x, y);
+		y -= Spacing;
+	}
+}
+
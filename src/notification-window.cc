@@ -0,0 +1,119 @@
+/*! \file notification-window.cc
+ *
+ * Implementation of the NotificationWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "notification-window.h"
+
+NotificationWindow::NotificationWindow(NotificationCenter* c, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	center(c)
+{
+	setWindowTitle("Notifications");
+	layout = new QGridLayout(this);
+
+	list = new QTreeWidget(this);
+	list->setColumnCount(5);
+	list->setHeaderLabels({ "Time", "Severity", "Title", "Message", "Count" });
+	list->setRootIsDecorated(false);
+	list->setSelectionMode(QAbstractItemView::SingleSelection);
+	list->setWordWrap(true);
+	list->header()->setSectionResizeMode(3, QHeaderView::Stretch);
+
+	clearButton = new QPushButton("Clear", this);
+	clearButton->setToolTip("Remove all notifications");
+	layout->addWidget(list, 0, 0, 1, 2);
+	layout->addWidget(clearButton, 1, 1);
+	resize(720, 320);
+
+	QObject::connect(clearButton, &QPushButton::clicked,
+			center, &NotificationCenter::clear);
+	QObject::connect(center, &NotificationCenter::posted,
+			this, &NotificationWindow::handlePosted);
+	QObject::connect(center, &NotificationCenter::repeated,
+			this, &NotificationWindow::handleRepeated);
+	QObject::connect(center, &NotificationCenter::cleared,
+			this, &NotificationWindow::refresh);
+	refresh();
+}
+
+NotificationWindow::~NotificationWindow()
+{
+}
+
+void NotificationWindow::showEvent(QShowEvent* event)
+{
+	if (center)
+		center->markAllRead();
+	QWidget::showEvent(event);
+}
+
+void NotificationWindow::refresh()
+{
+	list->clear();
+	items.clear();
+	if (!center)
+		return;
+	for (auto& notification : center->history())
+		handlePosted(notification);
+	list->resizeColumnToContents(0);
+}
+
+void NotificationWindow::select(quint64 id)
+{
+	auto item = items.value(id);
+	if (item) {
+		list->setCurrentItem(item);
+		list->scrollToItem(item);
+	}
+}
+
+void NotificationWindow::handlePosted(const NotificationCenter::Notification& notification)
+{
+	auto item = new QTreeWidgetItem;
+	describe(item, notification);
+	list->insertTopLevelItem(0, item);
+	items.insert(notification.id, item);
+
+	/* The center drops its oldest notifications, so drop them here too. */
+	while (center && (list->topLevelItemCount() > center->history().size())) {
+		auto oldest = list->takeTopLevelItem(list->topLevelItemCount() - 1);
+		items.remove(oldest->data(0, Qt::UserRole).toULongLong());
+		delete oldest;
+	}
+	if (isVisible() && center)
+		center->markAllRead();
+}
+
+void NotificationWindow::handleRepeated(const NotificationCenter::Notification& notification)
+{
+	auto item = items.value(notification.id);
+	if (item)
+		describe(item, notification);
+	if (isVisible() && center)
+		center->markAllRead();
+}
+
+void NotificationWindow::describe(QTreeWidgetItem* item,
+		const NotificationCenter::Notification& notification)
+{
+	QStyle::StandardPixmap icon = QStyle::SP_MessageBoxInformation;
+	if (notification.severity == NotificationCenter::Severity::Warning)
+		icon = QStyle::SP_MessageBoxWarning;
+	else if (notification.severity == NotificationCenter::Severity::Error)
+		icon = QStyle::SP_MessageBoxCritical;
+	item->setData(0, Qt::UserRole, notification.id);
+	item->setText(0, notification.last.toString("HH:mm:ss"));
+	item->setToolTip(0, QString("First posted at %1").arg(
+				notification.first.toString(Qt::ISODate)));
+	item->setIcon(1, style()->standardIcon(icon));
+	item->setText(1, NotificationCenter::severityName(notification.severity));
+	item->setText(2, notification.title);
+	item->setText(3, notification.message);
+	item->setToolTip(3, notification.message);
+	item->setText(4, QString::number(notification.count));
+	item->setTextAlignment(4, Qt::AlignRight | Qt::AlignVCenter);
+}
+
@@ -0,0 +1,87 @@
+/*! \file parameter-coalescer.cc
+ *
+ * Implementation of the ParameterCoalescer class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "parameter-coalescer.h"
+
+ParameterCoalescer::ParameterCoalescer(Sender s, int quietPeriod,
+		QObject* parent) :
+	QObject(parent),
+	sender(s),
+	hasPending(false),
+	inFlight(false)
+{
+	quietTimer = new QTimer(this);
+	quietTimer->setSingleShot(true);
+	quietTimer->setInterval(quietPeriod);
+	QObject::connect(quietTimer, &QTimer::timeout,
+			this, &ParameterCoalescer::sendPending);
+}
+
+ParameterCoalescer::~ParameterCoalescer()
+{
+}
+
+int ParameterCoalescer::quietPeriod() const
+{
+	return quietTimer->interval();
+}
+
+void ParameterCoalescer::setQuietPeriod(int ms)
+{
+	quietTimer->setInterval(ms);
+}
+
+bool ParameterCoalescer::hasPendingValue() const
+{
+	return hasPending;
+}
+
+bool ParameterCoalescer::isInFlight() const
+{
+	return inFlight;
+}
+
+void ParameterCoalescer::submit(const QVariant& value)
+{
+	pendingValue = value;
+	hasPending = true;
+	quietTimer->start();
+}
+
+void ParameterCoalescer::flush()
+{
+	quietTimer->stop();
+	sendPending();
+}
+
+void ParameterCoalescer::discard()
+{
+	quietTimer->stop();
+	hasPending = false;
+	pendingValue = QVariant();
+}
+
+void ParameterCoalescer::sendPending()
+{
+	/* A value arriving while a request is in flight waits for its
+	 * reply, which sends it if the quiet period has passed by then.
+	 */
+	if (!hasPending || inFlight || quietTimer->isActive())
+		return;
+
+	auto value = pendingValue;
+	hasPending = false;
+	pendingValue = QVariant();
+	inFlight = true;
+	QPointer<ParameterCoalescer> self(this);
+	sender(value, [self]() -> void {
+				if (!self)
+					return;
+				self->inFlight = false;
+				self->sendPending();
+			});
+}
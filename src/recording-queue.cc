@@ -0,0 +1,345 @@
+/*! \file recording-queue.cc
+ *
+ * Implementation of the RecordingQueue class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "recording-queue.h"
+
+RecordingQueue::RecordingQueue(BldsSession* s, RecordingStatusMonitor* m,
+		QObject* parent) :
+	QObject(parent),
+	session(s),
+	monitor(m),
+	current(-1),
+	state(State::Idle),
+	running(false),
+	outstanding(0)
+{
+	prepared.index = -1;
+	prepared.loading = false;
+	prepared.analogOutputChannels = 1;
+
+	loader = new AnalogOutputLoader(this);
+	QObject::connect(loader, &AnalogOutputLoader::loaded,
+			this, [this](const QString& file, const WaveformView& aout,
+					const QByteArray& hash) -> void {
+				if (session && session->stimulusCache())
+					session->stimulusCache()->insert(file, aout, hash,
+							loader->options().fingerprint());
+				handleAnalogOutputLoaded(aout, hash);
+			});
+	QObject::connect(loader, &AnalogOutputLoader::failed,
+			this, &RecordingQueue::handleAnalogOutputFailed);
+
+	transaction = new SourceConfigTransaction(session, this);
+	QObject::connect(transaction, &SourceConfigTransaction::finished,
+			this, [this](bool committed, const QMap<QString, QString>& errors) -> void {
+				QStringList msgs;
+				for (auto it = errors.cbegin(); it != errors.cend(); ++it)
+					msgs << QString("%1: %2").arg(it.key(), it.value());
+				handleConfigurationReply(committed, msgs.join("; "));
+			});
+
+	QObject::connect(session, &BldsSession::recordingStarted,
+			this, &RecordingQueue::handleRecordingStarted);
+	QObject::connect(session, &BldsSession::recordingStopped,
+			this, [this](bool success, const QString&) -> void {
+				if (success)
+					handleRecordingEnded();
+			});
+	QObject::connect(monitor, &RecordingStatusMonitor::recordingEnded,
+			this, &RecordingQueue::handleRecordingEnded);
+}
+
+RecordingQueue::~RecordingQueue()
+{
+}
+
+QList<RecordingQueue::Entry> RecordingQueue::readEntries(const QString& path,
+		QString* error)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		*error = file.errorString();
+		return {};
+	}
+	QJsonParseError parseError;
+	auto doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+	if (doc.isNull()) {
+		*error = parseError.errorString();
+		return {};
+	}
+	if (!doc.isArray()) {
+		*error = "The file must contain an array of recordings.";
+		return {};
+	}
+
+	QList<Entry> entries;
+	for (auto value : doc.array()) {
+		auto obj = value.toObject();
+		if (!obj.contains("filename") || !obj.contains("length")) {
+			*error = QString("Recording %1 must have a filename "
+					"and a length.").arg(entries.size() + 1);
+			return {};
+		}
+		Entry entry;
+		entry.filename = obj["filename"].toString();
+		entry.length = obj["length"].toInt();
+		entry.sourceSettings = obj["source"].toObject().toVariantMap();
+		entries.append(entry);
+	}
+	return entries;
+}
+
+void RecordingQueue::append(const Entry& entry)
+{
+	queue.append(entry);
+}
+
+void RecordingQueue::clear()
+{
+	if (!running)
+		queue.clear();
+}
+
+QList<RecordingQueue::Entry> RecordingQueue::entries() const
+{
+	return queue;
+}
+
+int RecordingQueue::currentIndex() const
+{
+	return current;
+}
+
+bool RecordingQueue::isRunning() const
+{
+	return running;
+}
+
+QList<qint64> RecordingQueue::transitionGaps() const
+{
+	return gaps;
+}
+
+void RecordingQueue::start()
+{
+	if (running || queue.isEmpty() || !session)
+		return;
+	running = true;
+	gaps.clear();
+	prepare(0);
+	begin(0);
+}
+
+void RecordingQueue::stop()
+{
+	running = false;
+
+	/* If no recording has started yet, there is nothing to wait for. */
+	if ((state == State::Idle) || (state == State::Loading))
+		finish();
+}
+
+void RecordingQueue::prepare(int index)
+{
+	prepared.index = index;
+	prepared.sourceSettings.clear();
+	prepared.error.clear();
+	prepared.analogOutputHash.clear();
+	prepared.analogOutputChannels = 1;
+	prepared.loading = false;
+	loader->cancel();
+	if (index >= queue.size())
+		return;
+
+	/* Convert each setting to the type the server expects, and start
+	 * reading the analog output from its file now rather than between
+	 * recordings. No one is watching to choose clipping, so a signal
+	 * beyond the DAC's limits fails the queue.
+	 */
+	if (session)
+		loader->setOptions(StimulusValidator::optionsFor(session->sourceStatus(), false));
+	auto variant = loader->options().fingerprint();
+	auto& settings = queue.at(index).sourceSettings;
+	for (auto it = settings.cbegin(); it != settings.cend(); ++it) {
+		if (it.key() == "analog-output") {
+			auto file = it.value().toString();
+			StimulusCache::Entry entry;
+			auto cache = session ? session->stimulusCache() : nullptr;
+			if (file.isEmpty()) {
+				prepared.sourceSettings.insert(it.key(),
+						QVariant::fromValue(WaveformView()));
+			} else if (cache && cache->lookup(file, &entry, variant)) {
+				prepared.sourceSettings.insert(it.key(),
+						QVariant::fromValue(entry.samples));
+				prepared.analogOutputHash = entry.hash;
+				prepared.analogOutputChannels = entry.samples.channels();
+			} else {
+				prepared.loading = true;
+				loader->load(file);
+			}
+		} else if (it.key() == "plug") {
+			prepared.sourceSettings.insert(it.key(),
+					static_cast<quint32>(it.value().toInt()));
+		} else if (it.key() == "adc-range") {
+			prepared.sourceSettings.insert(it.key(), it.value().toDouble());
+		} else {
+			prepared.sourceSettings.insert(it.key(), it.value());
+		}
+	}
+}
+
+void RecordingQueue::begin(int index)
+{
+	current = index;
+	if (prepared.index != index)
+		prepare(index);
+	if (!prepared.error.isEmpty()) {
+		fail(prepared.error);
+		return;
+	}
+	if (prepared.loading) {
+		state = State::Loading;
+		return;
+	}
+
+	/* Send every parameter at once. The server handles them in order,
+	 * so the last reply arrives one round trip after the first request.
+	 */
+	state = State::Configuring;
+	configurationErrors.clear();
+	auto& entry = queue.at(index);
+	auto handler = [this](bool success, const QString& msg) -> void {
+		handleConfigurationReply(success, msg);
+	};
+	outstanding = 2;
+	session->set("save-file", entry.filename, handler, RequestTimeout);
+	session->set("recording-length", entry.length, handler, RequestTimeout);
+	if (!prepared.analogOutputHash.isEmpty() &&
+			(prepared.analogOutputHash == session->analogOutputHash())) {
+		/* The server already holds this signal. */
+		prepared.sourceSettings.remove("analog-output");
+	}
+	if (prepared.sourceSettings.contains("analog-output") &&
+			session->needsAnalogOutputChannels(prepared.analogOutputChannels)) {
+		prepared.sourceSettings.insert("analog-output-channels",
+				static_cast<quint32>(prepared.analogOutputChannels));
+	}
+	if (!prepared.sourceSettings.isEmpty()) {
+		auto status = session->sourceStatus();
+		for (auto it = prepared.sourceSettings.cbegin();
+				it != prepared.sourceSettings.cend(); ++it) {
+			auto previous = status.contains(it.key()) ?
+				status[it.key()].toVariant() : QVariant();
+			transaction->stage(it.key(), it.value(), previous);
+		}
+		outstanding++;
+		transaction->apply(RequestTimeout);
+	}
+}
+
+void RecordingQueue::handleAnalogOutputLoaded(const WaveformView& aout,
+		const QByteArray& hash)
+{
+	if (!prepared.loading)
+		return;
+	prepared.loading = false;
+	prepared.sourceSettings.insert("analog-output", QVariant::fromValue(aout));
+	prepared.analogOutputHash = hash;
+	prepared.analogOutputChannels = aout.channels();
+	if (state == State::Loading)
+		begin(current);
+}
+
+void RecordingQueue::handleAnalogOutputFailed(const QString& file, const QString& msg)
+{
+	if (!prepared.loading)
+		return;
+	prepared.loading = false;
+	prepared.error = QString("Could not read analog output from %1: %2").arg(file, msg);
+	if (state == State::Loading)
+		fail(prepared.error);
+}
+
+void RecordingQueue::handleConfigurationReply(bool success, const QString& msg)
+{
+	if (state != State::Configuring)
+		return;
+	if (!success)
+		configurationErrors << msg;
+	if (--outstanding > 0)
+		return;
+
+	if (!configurationErrors.isEmpty()) {
+		fail("Could not configure the recording. " + configurationErrors.join(" "));
+		return;
+	}
+	if (prepared.sourceSettings.contains("analog-output"))
+		session->setAnalogOutputHash(prepared.analogOutputHash);
+	state = State::Starting;
+	session->startRecording();
+}
+
+void RecordingQueue::handleRecordingStarted(bool success, const QString& msg)
+{
+	if (state != State::Starting)
+		return;
+	if (!success) {
+		fail("Could not start the recording. " + msg);
+		return;
+	}
+
+	state = State::Recording;
+	auto gap = gapTimer.elapsed();
+	emit entryStarted(current, queue.at(current).filename);
+	if (current > 0) {
+		gaps.append(gap);
+		emit transition(current, gap);
+	}
+	if (monitor)
+		monitor->start();
+
+	/* Prepare the next entry while this one records. */
+	auto next = current + 1;
+	QTimer::singleShot(0, this, [this,next]() -> void {
+				if (running && (state == State::Recording))
+					prepare(next);
+			});
+}
+
+void RecordingQueue::handleRecordingEnded()
+{
+	if (state != State::Recording)
+		return;
+	gapTimer.start();
+	state = State::Idle;
+	emit entryFinished(current);
+
+	auto next = current + 1;
+	if (running && (next < queue.size())) {
+		begin(next);
+	} else {
+		finish();
+	}
+}
+
+void RecordingQueue::fail(const QString& msg)
+{
+	emit failed(current, msg);
+	finish();
+}
+
+void RecordingQueue::finish()
+{
+	state = State::Idle;
+	running = false;
+	current = -1;
+	prepared.index = -1;
+	prepared.loading = false;
+	loader->cancel();
+	emit finished();
+}
+
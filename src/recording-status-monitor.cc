@@ -0,0 +1,168 @@
+/*! \file recording-status-monitor.cc
+ *
+ * Implementation of the RecordingStatusMonitor class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "recording-status-monitor.h"
+
+RecordingStatusMonitor::RecordingStatusMonitor(BldsSession* s, QObject* parent) :
+	QObject(parent),
+	session(s),
+	currentMode(Mode::Idle)
+{
+	pollTimer = new QTimer(this);
+	pollTimer->setInterval(PollInterval);
+	QObject::connect(pollTimer, &QTimer::timeout,
+			this, &RecordingStatusMonitor::poll);
+
+	subscriptionWatchdog = new QTimer(this);
+	subscriptionWatchdog->setInterval(SubscriptionTimeout);
+	subscriptionWatchdog->setSingleShot(true);
+	QObject::connect(subscriptionWatchdog, &QTimer::timeout,
+			this, &RecordingStatusMonitor::fallBackToPolling);
+
+	QObject::connect(session, &BldsSession::valuePushed,
+			this, &RecordingStatusMonitor::handlePushedValue);
+}
+
+RecordingStatusMonitor::~RecordingStatusMonitor()
+{
+}
+
+RecordingStatusMonitor::Mode RecordingStatusMonitor::mode() const
+{
+	return currentMode;
+}
+
+void RecordingStatusMonitor::setMode(Mode mode)
+{
+	if (mode == currentMode)
+		return;
+	currentMode = mode;
+	emit modeChanged(mode);
+}
+
+void RecordingStatusMonitor::start()
+{
+	if (!session || (currentMode != Mode::Idle))
+		return;
+
+	/* Ask the server to push updates. The watchdog covers servers
+	 * which never reply to the request at all.
+	 */
+	setMode(Mode::Subscribing);
+	subscriptionWatchdog->start();
+	QPointer<RecordingStatusMonitor> self(this);
+	session->set(SubscriptionParameter, PushInterval,
+			[self](bool success, const QString& msg) -> void {
+				if (self)
+					self->handleSubscriptionReply(success, msg);
+			});
+}
+
+void RecordingStatusMonitor::stop()
+{
+	pollTimer->stop();
+	subscriptionWatchdog->stop();
+	if (session && ((currentMode == Mode::Subscribing) ||
+				(currentMode == Mode::Subscribed))) {
+		session->set(SubscriptionParameter, 0);
+	}
+	setMode(Mode::Idle);
+}
+
+void RecordingStatusMonitor::handleSubscriptionReply(bool success, const QString&)
+{
+	/* The monitor may have been stopped, or already received a
+	 * pushed update, before the reply arrived.
+	 */
+	if (currentMode != Mode::Subscribing)
+		return;
+	if (success) {
+		setMode(Mode::Subscribed);
+		subscriptionWatchdog->start();
+	} else {
+		fallBackToPolling();
+	}
+}
+
+void RecordingStatusMonitor::handlePushedValue(const QString& param,
+		bool valid, const QVariant& data)
+{
+	if (!valid || ((currentMode != Mode::Subscribing) &&
+				(currentMode != Mode::Subscribed))) {
+		return;
+	}
+
+	/* Any pushed update proves the subscription is alive, even one
+	 * arriving before the reply accepting it.
+	 */
+	setMode(Mode::Subscribed);
+	subscriptionWatchdog->start();
+	if (param == "recording-exists") {
+		if (!data.toBool())
+			finish();
+	} else if (param == "recording-position") {
+		emit positionChanged(data.toDouble());
+	}
+}
+
+void RecordingStatusMonitor::poll()
+{
+	if (!session)
+		return;
+	QPointer<RecordingStatusMonitor> self(this);
+	session->getMany({ "recording-exists", "recording-position", "source-exists" },
+			[self](const QVariantMap& values) -> void {
+				if (self)
+					self->handlePollReply(values);
+			});
+}
+
+void RecordingStatusMonitor::handlePollReply(const QVariantMap& values)
+{
+	if (currentMode != Mode::Polling)
+		return;
+	if (values.value("recording-exists").toBool()) {
+		emit positionChanged(values.value("recording-position").toDouble());
+	} else {
+		finish(values);
+	}
+}
+
+void RecordingStatusMonitor::fallBackToPolling()
+{
+	if (session && (currentMode == Mode::Subscribed))
+		session->set(SubscriptionParameter, 0);
+	subscriptionWatchdog->stop();
+	setMode(Mode::Polling);
+	poll();
+	pollTimer->start();
+}
+
+void RecordingStatusMonitor::finish(const QVariantMap& values)
+{
+	stop();
+	emit recordingEnded();
+
+	/* Check whether the source was removed along with the recording,
+	 * unless that arrived with the same reply.
+	 */
+	if (values.contains("source-exists")) {
+		if (!values["source-exists"].toBool())
+			emit sourceRemoved();
+		return;
+	}
+	if (!session)
+		return;
+	QPointer<RecordingStatusMonitor> self(this);
+	session->getMany({ "source-exists" },
+			[self](const QVariantMap& reply) -> void {
+				if (self && reply.contains("source-exists") &&
+						!reply["source-exists"].toBool()) {
+					emit self->sourceRemoved();
+				}
+			});
+}
@@ -0,0 +1,110 @@
+/*! \file rig-status-scheduler.cc
+ *
+ * Implementation of the RigStatusScheduler class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "rig-status-scheduler.h"
+
+RigStatusScheduler::RigStatusScheduler(QObject* parent) :
+	QObject(parent)
+{
+	pollTimer = new QTimer(this);
+	pollTimer->setInterval(DefaultInterval);
+	QObject::connect(pollTimer, &QTimer::timeout,
+			this, &RigStatusScheduler::poll);
+}
+
+RigStatusScheduler::~RigStatusScheduler()
+{
+}
+
+int RigStatusScheduler::indexOf(BldsSession* session) const
+{
+	for (int i = 0; i < rigs.size(); i++) {
+		if (rigs.at(i).session == session)
+			return i;
+	}
+	return -1;
+}
+
+void RigStatusScheduler::addSession(BldsSession* session)
+{
+	if (indexOf(session) != -1)
+		return;
+	Rig rig;
+	rig.session = session;
+	rig.inFlight = false;
+	rig.roundTrip = -1;
+	rigs.append(rig);
+	if (!pollTimer->isActive())
+		pollTimer->start();
+}
+
+void RigStatusScheduler::removeSession(BldsSession* session)
+{
+	auto index = indexOf(session);
+	if (index != -1)
+		rigs.removeAt(index);
+	if (rigs.isEmpty())
+		pollTimer->stop();
+}
+
+int RigStatusScheduler::interval() const
+{
+	return pollTimer->interval();
+}
+
+void RigStatusScheduler::setInterval(int ms)
+{
+	pollTimer->setInterval(ms);
+}
+
+double RigStatusScheduler::roundTripTime(BldsSession* session) const
+{
+	auto index = indexOf(session);
+	return (index == -1) ? -1 : rigs.at(index).roundTrip;
+}
+
+void RigStatusScheduler::poll()
+{
+	QPointer<RigStatusScheduler> self(this);
+	for (auto& rig : rigs) {
+		if (!rig.session || (rig.session->state() != BldsSession::State::Connected))
+			continue;
+
+		/* A reply lost with the connection would otherwise stop the
+		 * session from ever being polled again.
+		 */
+		if (rig.inFlight && (rig.sent.elapsed() <
+					LostPollIntervals * pollTimer->interval())) {
+			continue;
+		}
+
+		rig.inFlight = true;
+		rig.sent.start();
+		BldsSession* session = rig.session;
+		rig.session->getMany({ "source-exists", "recording-exists", "recording-position" },
+				[self,session](const QVariantMap& values) -> void {
+					if (self)
+						self->handleReply(session, values);
+				});
+	}
+}
+
+void RigStatusScheduler::handleReply(BldsSession* session, const QVariantMap& values)
+{
+	auto index = indexOf(session);
+	if (index == -1)
+		return;
+	auto& rig = rigs[index];
+	if (rig.inFlight) {
+		auto elapsed = rig.sent.nsecsElapsed() / 1e6;
+		rig.roundTrip = (rig.roundTrip < 0) ? elapsed :
+			((1 - RoundTripWeight) * rig.roundTrip + RoundTripWeight * elapsed);
+		rig.inFlight = false;
+	}
+	emit statusUpdated(session, values);
+}
+
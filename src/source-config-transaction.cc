@@ -0,0 +1,165 @@
+/*! \file source-config-transaction.cc
+ *
+ * Implementation of the SourceConfigTransaction class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "source-config-transaction.h"
+
+#include <algorithm>
+
+SourceConfigTransaction::SourceConfigTransaction(BldsSession* s, QObject* parent) :
+	QObject(parent),
+	session(s),
+	outstanding(0),
+	applying(false),
+	replyTimeout(BldsSession::NoTimeout)
+{
+}
+
+SourceConfigTransaction::~SourceConfigTransaction()
+{
+}
+
+int SourceConfigTransaction::sendOrder(const QString& param)
+{
+	/* The configuration reprograms the chip, so send it before the
+	 * parameters which depend on it, and the large analog output last.
+	 */
+	static const QStringList order = {
+		"configuration-file", "plug", "adc-range", "trigger",
+		"analog-output-channels", "analog-output"
+	};
+	auto index = order.indexOf(param);
+	return (index == -1) ? order.size() : index;
+}
+
+void SourceConfigTransaction::stage(const QString& param,
+		const QVariant& value, const QVariant& previous)
+{
+	if (applying)
+		return;
+	for (auto& change : staged) {
+		if (change.param == param) {
+			change.value = value;
+			return;
+		}
+	}
+	Change change = { param, value, previous };
+	staged.append(change);
+}
+
+QStringList SourceConfigTransaction::stagedParameters() const
+{
+	QStringList params;
+	for (auto& change : staged)
+		params << change.param;
+	return params;
+}
+
+bool SourceConfigTransaction::isEmpty() const
+{
+	return staged.isEmpty();
+}
+
+bool SourceConfigTransaction::isApplying() const
+{
+	return applying;
+}
+
+void SourceConfigTransaction::clear()
+{
+	if (!applying)
+		staged.clear();
+}
+
+void SourceConfigTransaction::apply(int timeout)
+{
+	if (applying || !session)
+		return;
+	if (staged.isEmpty()) {
+		emit finished(true, {});
+		return;
+	}
+
+	applying = true;
+	replyTimeout = timeout;
+	accepted.clear();
+	errors.clear();
+	std::stable_sort(staged.begin(), staged.end(),
+			[](const Change& a, const Change& b) -> bool {
+				return sendOrder(a.param) < sendOrder(b.param);
+			});
+
+	/* Send every change without waiting for replies. */
+	outstanding = staged.size();
+	QPointer<SourceConfigTransaction> self(this);
+	for (auto& change : staged) {
+		session->setSource(change.param, change.value,
+				[self,change](bool success, const QString& msg) -> void {
+					if (self)
+						self->handleReply(change, success, msg);
+				}, replyTimeout);
+	}
+}
+
+void SourceConfigTransaction::handleReply(const Change& change,
+		bool success, const QString& msg)
+{
+	if (success) {
+		accepted.append(change);
+	} else {
+		errors.insert(change.param, msg);
+	}
+	emit parameterApplied(change.param, success, msg);
+
+	if (--outstanding > 0)
+		return;
+	if (errors.isEmpty()) {
+		finish();
+	} else {
+		rollBack();
+	}
+}
+
+void SourceConfigTransaction::rollBack()
+{
+	/* Restore accepted changes in the reverse of the order they were made. */
+	QList<Change> restorable;
+	for (auto it = accepted.crbegin(); it != accepted.crend(); ++it) {
+		if (it->previous.isValid()) {
+			restorable.append(*it);
+		} else {
+			emit parameterRolledBack(it->param, false);
+		}
+	}
+	if (restorable.isEmpty() || !session) {
+		finish();
+		return;
+	}
+
+	outstanding = restorable.size();
+	QPointer<SourceConfigTransaction> self(this);
+	for (auto& change : restorable) {
+		auto param = change.param;
+		session->setSource(param, change.previous,
+				[self,param](bool success, const QString&) -> void {
+					if (!self)
+						return;
+					emit self->parameterRolledBack(param, success);
+					if (--self->outstanding == 0)
+						self->finish();
+				}, replyTimeout);
+	}
+}
+
+void SourceConfigTransaction::finish()
+{
+	applying = false;
+	staged.clear();
+	accepted.clear();
+	auto committed = errors.isEmpty();
+	emit finished(committed, errors);
+}
+
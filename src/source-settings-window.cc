@@ -5,35 +5,37 @@
  * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
  */
 
-#include "H5Cpp.h"
-
 #include "source-settings-window.h"
 
-SourceSettingsWindow::SourceSettingsWindow(const QString& hostname,
-				QWidget* parent) :
-	QWidget(parent, Qt::Window)
+SourceSettingsWindow::SourceSettingsWindow(BldsSession* s, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	session(s),
+	pendingSourceRequests(0),
+	applyingRequests(0)
 {
-	/* Create new client, request status after successfully connecting. */
-	client = new BldsClient(hostname);
-	QObject::connect(client, &BldsClient::sourceStatus,
-			this, &SourceSettingsWindow::handleSourceStatus);
-	QObject::connect(client, &BldsClient::connected,
-			[&](bool made) -> void { 
-				if (made) 
-					client->requestSourceStatus();
-				else { 
-					QMessageBox::warning(this, "Could not connect",
-							"The BLDS could not be reached. Verify "
-							"that it is running and the IP address is correct.");
-					close();
-				}
-			});
-	client->connect();
-
 	/* Setup UI. */
 	setupLayout();
+	setupTransaction();
+	setupCoalescers();
 	setWindowTitle("Source settings");
-	setAttribute(Qt::WA_DeleteOnClose);
+
+	/* Show the status of the source cached by the shared session right
+	 * away, if it is known, and keep following it. A fresh copy is
+	 * requested in the background in any case.
+	 */
+	QObject::connect(session, &BldsSession::sourceStatusChanged,
+			this, &SourceSettingsWindow::showSourceStatus);
+	if (session->hasSourceStatus())
+		showSourceStatus(session->sourceStatus());
+	QPointer<SourceSettingsWindow> self(this);
+	session->requestSourceStatus([self](bool exists, const QJsonObject&) -> void {
+				if (self && !exists) {
+					NotificationCenter::instance()->error("No source!",
+							"There doesn't appear to be a data source!");
+					self->close();
+				}
+			});
+	connectWidgets();
 
 	/* Move just below parent widget. */
 	auto upperLeft = parentWidget()->pos();
@@ -43,8 +45,6 @@ SourceSettingsWindow::SourceSettingsWindow(const QString& hostname,
 
 SourceSettingsWindow::~SourceSettingsWindow()
 {
-	client->disconnect();
-	client->deleteLater();
 }
 
 void SourceSettingsWindow::setupLayout()
@@ -93,6 +93,43 @@ void SourceSettingsWindow::setupLayout()
 	clearAnalogOutputButton = new QPushButton("Clear", this);
 	clearAnalogOutputButton->setToolTip("Clear analog output");
 
+	generateAnalogOutputButton = new QPushButton("Generate", this);
+	generateAnalogOutputButton->setToolTip("Show or hide the stimulus generator");
+	generateAnalogOutputButton->setCheckable(true);
+
+	analogOutputSummary = new QLabel(this);
+	analogOutputSummary->setToolTip("Summary of the analog output last checked");
+
+	clipAnalogOutputBox = new QCheckBox("Clip to DAC range", this);
+	clipAnalogOutputBox->setToolTip("Clip analog output samples beyond the "
+			"limits of the DAC, rather than rejecting the signal");
+
+	generatorPanel = new StimulusGeneratorPanel(this);
+	generatorPanel->setVisible(false);
+
+	analogOutputProgress = new QProgressBar(this);
+	analogOutputProgress->setRange(0, 100);
+	analogOutputProgress->setVisible(false);
+
+	cancelAnalogOutputButton = new QPushButton("Cancel", this);
+	cancelAnalogOutputButton->setToolTip("Cancel loading or sending analog output");
+	cancelAnalogOutputButton->setVisible(false);
+
+	analogOutputLoader = new AnalogOutputLoader(this);
+	analogOutputUpload = new AnalogOutputUpload(session, this);
+
+	stageChangesBox = new QCheckBox("Stage changes", this);
+	stageChangesBox->setToolTip("Collect changes and send them "
+			"together when applied");
+
+	applyChangesButton = new QPushButton("Apply", this);
+	applyChangesButton->setToolTip("Send all staged changes to the source");
+	applyChangesButton->setEnabled(false);
+
+	discardChangesButton = new QPushButton("Discard", this);
+	discardChangesButton->setToolTip("Discard all staged changes");
+	discardChangesButton->setEnabled(false);
+
 	layout->addWidget(adcRangeLabel, 0, 0);
 	layout->addWidget(adcRangeBox, 0, 1);
 	layout->addWidget(triggerLabel, 0, 2);
@@ -103,9 +140,18 @@ void SourceSettingsWindow::setupLayout()
 	layout->addWidget(configurationLine, 1, 1, 1, 4);
 	layout->addWidget(chooseConfigurationButton, 1, 5);
 	layout->addWidget(analogOutputLabel, 2, 0);
-	layout->addWidget(analogOutputLine, 2, 1, 1, 3);
+	layout->addWidget(analogOutputLine, 2, 1, 1, 2);
+	layout->addWidget(analogOutputProgress, 2, 1, 1, 2);
+	layout->addWidget(generateAnalogOutputButton, 2, 3);
 	layout->addWidget(selectAnalogOutputButton, 2, 4);
 	layout->addWidget(clearAnalogOutputButton, 2, 5);
+	layout->addWidget(cancelAnalogOutputButton, 2, 5);
+	layout->addWidget(analogOutputSummary, 3, 1, 1, 3);
+	layout->addWidget(clipAnalogOutputBox, 3, 4, 1, 2);
+	layout->addWidget(stageChangesBox, 4, 1, 1, 3);
+	layout->addWidget(applyChangesButton, 4, 4);
+	layout->addWidget(discardChangesButton, 4, 5);
+	layout->addWidget(generatorPanel, 5, 0, 1, 6);
 }
 
 void SourceSettingsWindow::chooseConfiguration()
@@ -116,50 +162,51 @@ void SourceSettingsWindow::chooseConfiguration()
 	if (fname.isNull() || fname.size() == 0)
 		return;
 
-	/* Connect functor to handle the response to the request. */
-	QObject::connect(client, &BldsClient::setSourceResponse,
-			this, [this,fname](const QString& param, bool success, 
-					const QString& msg) -> void {
-				if (!param.startsWith("configuration"))
-					return;
-				QObject::disconnect(client, &BldsClient::setSourceResponse, 0, 0);
-				if (success) {
-					configurationLine->setText(fname);
-					emit configurationChanged(configurationLine->text());
-				} else {
-					QMessageBox::warning(this, "Could not set configuration",
-							QString("The configuration could not be set: %1").arg(msg));
-				}
+	/* Make the request, updating the line only once it is accepted. */
+	setSourceParameter("configuration-file", fname, "configuration",
+			[this,fname]() -> void {
+				configurationLine->setText(fname);
+				emit configurationChanged(configurationLine->text());
 			});
-
-	/* Actually make the request */
-	client->setSource("configuration-file", fname);
 }
 
-void SourceSettingsWindow::handleSourceStatus(bool exists, QJsonObject obj)
+void SourceSettingsWindow::showSourceStatus(const QJsonObject& status)
 {
-	if (!exists) {
-		QMessageBox::critical(this, "No source!",
-				"There doesn't appear to be a data source!");
-		close();
-	}
-
-	/* Get current values of the parameters from the server. */
-	status = obj;
-	if (status.contains("adc-range")) {
+	/* Show the current values of the parameters, except those with
+	 * changes staged or awaiting a reply, without sending them back.
+	 */
+	auto settled = [this,&status](const QString& param) -> bool {
+		return status.contains(param) && !stagedValues.contains(param) &&
+			!deferredChanges.contains(param) &&
+			(inFlightParameters.value(param) == 0);
+	};
+	if (settled("adc-range")) {
+		QSignalBlocker blocker(adcRangeBox);
 		adcRangeBox->setValue(status["adc-range"].toDouble());
 	}
-	if (status.contains("trigger")) {
+	if (settled("trigger")) {
+		QSignalBlocker blocker(triggerBox);
 		triggerBox->setCurrentText(status["trigger"].toString());
 	}
-	if (status.contains("has-analog-output")) {
+	if (settled("plug")) {
+		QSignalBlocker blocker(plugBox);
+		plugBox->setCurrentText(QString::number(status["plug"].toInt()));
+	}
+	if (settled("has-analog-output")) {
 		if (status["has-analog-output"].toBool()) {
-			analogOutputLine->setText("Unknown analog output file");
-			analogOutputLine->setEnabled(false);
+			if (analogOutputLine->text().isEmpty()) {
+				analogOutputLine->setText("Unknown analog output file");
+				analogOutputLine->setEnabled(false);
+			}
+		} else {
+			analogOutputLine->clear();
+			analogOutputLine->setEnabled(true);
 		}
 	}
+}
 
-	/* Connect slots from UI widgets, now that we're connected. */
+void SourceSettingsWindow::connectWidgets()
+{
 	QObject::connect(triggerBox, &QComboBox::currentTextChanged,
 			this, &SourceSettingsWindow::onTriggerChanged);
 	QObject::connect(chooseConfigurationButton, &QPushButton::clicked,
@@ -171,6 +218,55 @@ void SourceSettingsWindow::handleSourceStatus(bool exists, QJsonObject obj)
 			this, &SourceSettingsWindow::chooseAnalogOutput);
 	QObject::connect(clearAnalogOutputButton, &QPushButton::clicked,
 			this, &SourceSettingsWindow::clearAnalogOutput);
+	QObject::connect(generateAnalogOutputButton, &QPushButton::toggled,
+			generatorPanel, &QWidget::setVisible);
+	QObject::connect(generatorPanel, &StimulusGeneratorPanel::generated,
+			this, &SourceSettingsWindow::useGeneratedAnalogOutput);
+	QObject::connect(cancelAnalogOutputButton, &QPushButton::clicked,
+			analogOutputLoader, &AnalogOutputLoader::cancel);
+	QObject::connect(cancelAnalogOutputButton, &QPushButton::clicked,
+			analogOutputUpload, &AnalogOutputUpload::cancel);
+	QObject::connect(analogOutputLoader, &AnalogOutputLoader::progress,
+			this, &SourceSettingsWindow::showAnalogOutputProgress);
+	QObject::connect(analogOutputLoader, &AnalogOutputLoader::validated,
+			this, &SourceSettingsWindow::showAnalogOutputSummary);
+	QObject::connect(analogOutputUpload, &AnalogOutputUpload::validated,
+			this, &SourceSettingsWindow::showAnalogOutputSummary);
+	QObject::connect(analogOutputLoader, &AnalogOutputLoader::loaded,
+			this, [this](const QString& file, const WaveformView& aout,
+					const QByteArray& hash) -> void {
+				setAnalogOutputLoading(false);
+				if (session->stimulusCache())
+					session->stimulusCache()->insert(file, aout, hash,
+							analogOutputLoader->options().fingerprint());
+				onAnalogOutputChanged(file, aout, hash);
+			});
+	QObject::connect(analogOutputLoader, &AnalogOutputLoader::failed,
+			this, [this](const QString&, const QString& msg) -> void {
+				setAnalogOutputLoading(false);
+				NotificationCenter::instance()->error("Error reading analog output", msg);
+			});
+	QObject::connect(analogOutputLoader, &AnalogOutputLoader::canceled,
+			this, [this]() -> void {
+				setAnalogOutputLoading(false);
+			});
+	QObject::connect(analogOutputUpload, &AnalogOutputUpload::progress,
+			this, &SourceSettingsWindow::showAnalogOutputProgress);
+	QObject::connect(analogOutputUpload, &AnalogOutputUpload::finished,
+			this, [this](const QString& file, bool success, const QString& msg) -> void {
+				setAnalogOutputLoading(false);
+				if (success) {
+					auto shape = analogOutputUpload->shape();
+					showAnalogOutput(file, shape.channels, shape.frames);
+				} else {
+					NotificationCenter::instance()->warning("Could not set analog output",
+							QString("The analog output could not be set: %1").arg(msg));
+				}
+			});
+	QObject::connect(analogOutputUpload, &AnalogOutputUpload::canceled,
+			this, [this]() -> void {
+				setAnalogOutputLoading(false);
+			});
 	QObject::connect(plugBox, &QComboBox::currentTextChanged,
 			this, &SourceSettingsWindow::onPlugChanged);
 }
@@ -183,145 +279,344 @@ void SourceSettingsWindow::chooseAnalogOutput()
 	if (fname.isNull() || fname.size() == 0)
 		return;
 
-	QVector<double> vec;
-	try {
-		vec = readAnalogOutputFromFile(fname);
-	} catch (std::invalid_argument& err) {
-		QMessageBox::critical(this, "Error reading analog output", err.what());
-		return;
+	/* Stimulus files can be large, so read the file on a worker
+	 * thread, leaving the GUI free to handle replies meanwhile. A staged
+	 * change needs the whole signal, but one made now is streamed to
+	 * the server in chunks as they are read. Either way, the signal is
+	 * checked before it is sent.
+	 */
+	auto options = analogOutputOptions();
+	if (stageChangesBox->isChecked()) {
+		StimulusCache::Entry entry;
+		auto cache = session->stimulusCache();
+		if (cache && cache->lookup(fname, &entry, options.fingerprint())) {
+			onAnalogOutputChanged(fname, entry.samples, entry.hash);
+			return;
+		}
+		analogOutputLoader->setOptions(options);
+		analogOutputLoader->load(fname);
+		analogOutputProgress->setFormat("Loading %p%");
+	} else {
+		analogOutputUpload->setOptions(options);
+		analogOutputUpload->start(fname);
+		analogOutputProgress->setFormat("Sending %p%");
 	}
-	onAnalogOutputChanged(fname, vec);
+	analogOutputProgress->setValue(0);
+	setAnalogOutputLoading(true);
 }
 
-QVector<double> SourceSettingsWindow::readAnalogOutputFromFile(const QString& fname)
+void SourceSettingsWindow::useGeneratedAnalogOutput(const QString& name,
+		const WaveformView& signal, const QByteArray& hash)
 {
-	auto name = fname.toStdString();
-	if (!H5::H5File::isHdf5(name)) {
-		throw std::invalid_argument("The selected file is not in valid HDF5 format.");
+	/* A generated signal is checked and sent like one read from a
+	 * file, without ever being written to disk.
+	 */
+	if (stageChangesBox->isChecked()) {
+		analogOutputLoader->setOptions(analogOutputOptions());
+		analogOutputLoader->load(name, signal, hash);
+		analogOutputProgress->setFormat("Checking %p%");
+	} else {
+		analogOutputUpload->setOptions(analogOutputOptions());
+		analogOutputUpload->start(name, signal, hash);
+		analogOutputProgress->setFormat("Sending %p%");
 	}
+	analogOutputProgress->setValue(0);
+	setAnalogOutputLoading(true);
+}
 
-	H5::H5File f(fname.toStdString().c_str(), H5F_ACC_RDONLY);
-	H5::DataSet dset;
-	try {
-		dset = f.openDataSet("analog-output");
-	} catch (...) {
-		f.close();
-		throw std::invalid_argument("The file doesn't have a dataset called 'analog-output'");
-	}
+StimulusValidator::Options SourceSettingsWindow::analogOutputOptions() const
+{
+	return StimulusValidator::optionsFor(session->sourceStatus(),
+			clipAnalogOutputBox->isChecked());
+}
 
-	auto space = dset.getSpace();
-	if (space.getSimpleExtentNdims() != 1) {
-		f.close();
-		throw std::invalid_argument("The selected file has a dataset with "
-				"more than 1 dimension. Analog output signals must be specified with "
-				"only a single dimension, and with double-precision data");
-	}
-	hsize_t dims[1] = { 0 };
-	space.getSimpleExtentDims(dims);
-	QVector<double> vec(dims[0]);
-	dset.read(vec.data(), H5::PredType::IEEE_F64LE);
-	return vec;
+void SourceSettingsWindow::showAnalogOutputSummary(const QString& file,
+		const StimulusValidator::Summary& summary)
+{
+	analogOutputSummary->setText(summary.describe());
+	analogOutputSummary->setToolTip(file);
+}
+
+void SourceSettingsWindow::showAnalogOutputProgress(qint64 read, qint64 total)
+{
+	auto busy = analogOutputLoader->isLoading() || analogOutputUpload->isRunning();
+	if (busy && (total > 0))
+		analogOutputProgress->setValue(static_cast<int>(100 * read / total));
+}
+
+void SourceSettingsWindow::setAnalogOutputLoading(bool loading)
+{
+	analogOutputLine->setVisible(!loading);
+	analogOutputProgress->setVisible(loading);
+	clearAnalogOutputButton->setVisible(!loading);
+	cancelAnalogOutputButton->setVisible(loading);
+	selectAnalogOutputButton->setEnabled(!loading);
+	clipAnalogOutputBox->setEnabled(!loading);
+	generatorPanel->setEnabled(!loading);
 }
 
 void SourceSettingsWindow::clearAnalogOutput()
 {
-	onAnalogOutputChanged("", {});
+	analogOutputSummary->clear();
+	analogOutputSummary->setToolTip(QString());
+	onAnalogOutputChanged("", WaveformView(), QByteArray());
 }
 
 void SourceSettingsWindow::onTriggerChanged(const QString& text)
 {
-	/* Connect functor to handle a response to the request to 
-	 * set the trigger.
-	 */
-	QObject::connect(client, &BldsClient::setSourceResponse,
-			this, [this](const QString& param, bool valid, const QString& msg) -> void {
-				if (param != "trigger")
-					return;
-				QObject::disconnect(client, &BldsClient::setSourceResponse, 0, 0);
-				if (valid) {
-					emit triggerChanged(triggerBox->currentText());
-				} else {
-					QMessageBox::warning(this, "Could not set trigger",
-							QString("The trigger could not be set: %1").arg(msg));
-					return;
-				}
-			});
-
-	/* Actually make the request. */
-	client->setSource("trigger", text);
+	setSourceParameter("trigger", text, "trigger",
+			[this,text]() -> void { emit triggerChanged(text); });
 }
 
 void SourceSettingsWindow::onAdcRangeChanged(double range)
 {
-	/* Connect functor to handle a response to the request to
-	 * set the ADC range.
+	/* The spin box produces a value for every step, so only send
+	 * the latest once it settles.
 	 */
-	QObject::connect(client, &BldsClient::setSourceResponse,
-			this, [this](const QString& param, bool valid, const QString& msg) -> void {
-				if (param != "adc-range")
-					return;
-				QObject::disconnect(client, &BldsClient::setSourceResponse, 0, 0);
-				if (valid) {
-					emit adcRangeChanged(adcRangeBox->value());
-				} else {
-					QMessageBox::warning(this, "Could not set ADC range",
-							QString("The ADC range could not be set: %1").arg(msg));
-					return;
-				}
-			});
-
-	/* Actually make the request. */
-	client->setSource("adc-range", range);
+	adcRangeCoalescer->submit(range);
 }
 
 void SourceSettingsWindow::onAnalogOutputChanged(const QString& file, 
-		const QVector<double>& aout)
+		const WaveformView& aout, const QByteArray& hash)
 {
-	/* Connect functor to handle a response to the request to
-	 * set the analog output.
+	auto channels = aout.channels();
+	auto frames = aout.frames();
+	auto show = [this,file,channels,frames]() -> void {
+		showAnalogOutput(file, channels, frames);
+	};
+
+	/* Nothing need be sent if the server already holds the signal. */
+	if (!file.isEmpty() && !hash.isEmpty() && (hash == session->analogOutputHash())) {
+		show();
+		return;
+	}
+
+	/* The number of channels goes first, since the server checks the
+	 * signal against it. The transaction also sends it first.
 	 */
-	QObject::connect(client, &BldsClient::setSourceResponse,
-			this, [this,file,aout](const QString& param, bool valid, 
-					const QString& msg) -> void {
-				if (param != "analog-output")
-					return;
-				QObject::disconnect(client, &BldsClient::setSourceResponse, 0, 0);
-				if (valid) {
-					analogOutputLine->setText(file);
-					analogOutputLine->setEnabled(true);
-					emit analogOutputChanged(file);
-				} else {
-					QMessageBox::warning(this, "Could not set analog output",
-							QString("The analog output could not be set: %1").arg(msg));
-					return;
-				}
+	if (session->needsAnalogOutputChannels(channels))
+		setSourceParameter("analog-output-channels", static_cast<quint32>(channels),
+				"number of analog output channels", []() -> void { });
+	QPointer<BldsSession> s(session);
+	setSourceParameter("analog-output", QVariant::fromValue(aout), "analog output",
+			[s,hash,show]() -> void {
+				if (s)
+					s->setAnalogOutputHash(hash);
+				show();
 			});
+}
 
-	/* Actually make the request. */
-	client->setSource("analog-output", QVariant::fromValue(aout));
+void SourceSettingsWindow::showAnalogOutput(const QString& file, int channels,
+		qint64 frames)
+{
+	analogOutputLine->setText(file);
+	analogOutputLine->setToolTip(file.isEmpty() ? QString() :
+			QString("%1 channel(s) of %2 samples").arg(channels).arg(frames));
+	analogOutputLine->setEnabled(true);
+	emit analogOutputChanged(file, channels, frames);
 }
 
 void SourceSettingsWindow::onPlugChanged(const QString& plug)
 {
-	/* Connect functor handling response to request to set
-	 * the plug number.
+	setSourceParameter("plug", static_cast<quint32>(plug.toInt()),
+			"Neurolizer plug", [this,plug]() -> void { emit plugChanged(plug); });
+}
+
+
+void SourceSettingsWindow::setSourceParameter(const QString& param,
+		const QVariant& value, const QString& description,
+		std::function<void()> onSuccess, std::function<void()> onReply)
+{
+	/* When staging, only record the change, to be sent with the others.
+	 * The transaction takes no changes while it is being applied, so
+	 * those are staged once it finishes.
+	 */
+	if (stageChangesBox->isChecked() && transaction->isApplying()) {
+		deferredChanges.insert(param, { value, description, onSuccess });
+		if (onReply)
+			onReply();
+		return;
+	}
+	if (stageChangesBox->isChecked()) {
+		auto status = session->sourceStatus();
+		auto previous = status.contains(param) ?
+				status.value(param).toVariant() : QVariant();
+		transaction->stage(param, value, previous);
+		stagedChangeHandlers.insert(param, onSuccess);
+		stagedValues.insert(param, value);
+		updateStagedIndicator();
+		if (onReply)
+			onReply();
+		return;
+	}
+
+	/* Each request is tracked on its own, so that changing several
+	 * parameters quickly never loses a reply. Only the most recent
+	 * request for a parameter may change the widgets.
 	 */
-	QObject::connect(client, &BldsClient::setSourceResponse,
-			this, [this,plug](const QString& param, bool valid, 
+	auto generation = ++sourceRequestGenerations[param];
+	pendingSourceRequests++;
+	inFlightParameters[param]++;
+	updatePendingIndicator();
+
+	/* The shared session records accepted values in its cached status. */
+	QPointer<SourceSettingsWindow> self(this);
+	session->setSource(param, value,
+			[self,param,description,onSuccess,onReply,generation](bool valid,
 					const QString& msg) -> void {
-				if (param != "plug")
+				if (!self)
 					return;
-				QObject::disconnect(client, &BldsClient::setSourceResponse, 0, 0);
+				if (onReply)
+					onReply();
+				self->pendingSourceRequests--;
+				self->inFlightParameters[param]--;
+				self->updatePendingIndicator();
+				auto latest = (self->sourceRequestGenerations.value(param) == generation);
 				if (valid) {
-					emit plugChanged(plug);
+					if (latest)
+						onSuccess();
 				} else {
-					QMessageBox::warning(this, "Could not select plug",
-							QString("The Neurolizer plug could not "
-							"be selected: %1").arg(msg));
+					if (latest)
+						self->restoreConfirmedValue(param);
+					NotificationCenter::instance()->warning("Could not set " + description,
+							QString("The %1 could not be set: %2").arg(description).arg(msg));
 				}
+			}, SourceRequestTimeout);
+}
+
+void SourceSettingsWindow::restoreConfirmedValue(const QString& param)
+{
+	auto status = session->sourceStatus();
+	if (!status.contains(param))
+		return;
+
+	/* Show the value last accepted by the server, without sending it again. */
+	auto value = status.value(param);
+	if (param == "adc-range") {
+		QSignalBlocker blocker(adcRangeBox);
+		adcRangeBox->setValue(value.toDouble());
+	} else if (param == "trigger") {
+		QSignalBlocker blocker(triggerBox);
+		triggerBox->setCurrentText(value.toString());
+	} else if (param == "plug") {
+		QSignalBlocker blocker(plugBox);
+		plugBox->setCurrentText(QString::number(value.toInt()));
+	}
+}
+
+void SourceSettingsWindow::updatePendingIndicator()
+{
+	if (pendingSourceRequests > 0) {
+		setWindowTitle(QString("Source settings (%1 pending)").arg(pendingSourceRequests));
+	} else {
+		setWindowTitle("Source settings");
+	}
+}
+
+void SourceSettingsWindow::setupTransaction()
+{
+	transaction = new SourceConfigTransaction(session, this);
+	QObject::connect(applyChangesButton, &QPushButton::clicked,
+			this, &SourceSettingsWindow::applyStagedChanges);
+	QObject::connect(discardChangesButton, &QPushButton::clicked,
+			this, &SourceSettingsWindow::discardStagedChanges);
+
+	/* Track which changes the server holds, after any rollback. */
+	QObject::connect(transaction, &SourceConfigTransaction::parameterApplied,
+			this, [this](const QString& param, bool success, const QString&) -> void {
+				if (success)
+					acceptedStagedChanges.insert(param);
 			});
+	QObject::connect(transaction, &SourceConfigTransaction::parameterRolledBack,
+			this, [this](const QString& param, bool success) -> void {
+				if (success)
+					acceptedStagedChanges.remove(param);
+			});
+	QObject::connect(transaction, &SourceConfigTransaction::finished,
+			this, &SourceSettingsWindow::handleTransactionFinished);
+}
 
-	/* Actually make the request. */
-	client->setSource("plug", static_cast<quint32>(plug.toInt()));
+void SourceSettingsWindow::applyStagedChanges()
+{
+	if (transaction->isEmpty() || transaction->isApplying())
+		return;
+	acceptedStagedChanges.clear();
+	applyingRequests = transaction->stagedParameters().size();
+	pendingSourceRequests += applyingRequests;
+	updatePendingIndicator();
+	applyChangesButton->setEnabled(false);
+	discardChangesButton->setEnabled(false);
+	transaction->apply(SourceRequestTimeout);
 }
 
+void SourceSettingsWindow::discardStagedChanges()
+{
+	if (transaction->isApplying())
+		return;
+	for (auto& param : transaction->stagedParameters())
+		restoreConfirmedValue(param);
+	transaction->clear();
+	stagedChangeHandlers.clear();
+	stagedValues.clear();
+	updateStagedIndicator();
+}
+
+void SourceSettingsWindow::handleTransactionFinished(bool committed,
+		const QMap<QString, QString>& errors)
+{
+	/* Update the widgets for changes the server holds, and restore
+	 * the others to the values last accepted, unless they have been
+	 * changed again since.
+	 */
+	for (auto it = stagedChangeHandlers.cbegin(); it != stagedChangeHandlers.cend(); ++it) {
+		if (acceptedStagedChanges.contains(it.key())) {
+			it.value()();
+		} else if (!deferredChanges.contains(it.key())) {
+			restoreConfirmedValue(it.key());
+		}
+	}
+	pendingSourceRequests -= applyingRequests;
+	applyingRequests = 0;
+	stagedChangeHandlers.clear();
+	stagedValues.clear();
+	acceptedStagedChanges.clear();
+
+	/* Changes made while applying are staged or sent now. */
+	auto deferred = deferredChanges;
+	deferredChanges.clear();
+	for (auto it = deferred.cbegin(); it != deferred.cend(); ++it) {
+		setSourceParameter(it.key(), it->value, it->description,
+				it->onSuccess);
+	}
+	updatePendingIndicator();
+	updateStagedIndicator();
+
+	if (!committed) {
+		QStringList lines;
+		for (auto it = errors.cbegin(); it != errors.cend(); ++it)
+			lines << QString("%1: %2").arg(it.key()).arg(it.value());
+		NotificationCenter::instance()->warning("Could not apply changes",
+				QString("The staged changes could not all be applied, and "
+				"the accepted changes were rolled back.\n\n%1").arg(lines.join("\n")));
+	}
+}
+
+void SourceSettingsWindow::updateStagedIndicator()
+{
+	auto staged = !transaction->isEmpty();
+	applyChangesButton->setEnabled(staged && !transaction->isApplying());
+	discardChangesButton->setEnabled(staged && !transaction->isApplying());
+	applyChangesButton->setText(staged ?
+			QString("Apply (%1)").arg(transaction->stagedParameters().size()) : "Apply");
+}
+
+void SourceSettingsWindow::setupCoalescers()
+{
+	adcRangeCoalescer = new ParameterCoalescer(
+			[this](const QVariant& value, std::function<void()> done) -> void {
+				auto range = value.toDouble();
+				setSourceParameter("adc-range", range, "ADC range",
+						[this,range]() -> void { emit adcRangeChanged(range); },
+						done);
+			}, ParameterCoalescer::DefaultQuietPeriod, this);
+}
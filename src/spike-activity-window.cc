@@ -0,0 +1,188 @@
+/*! \file spike-activity-window.cc
+ *
+ * Implementation of the SpikeActivityWindow class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "spike-activity-window.h"
+
+#include <cmath>
+#include <numeric>
+
+SpikeActivityWindow::SpikeActivityWindow(LiveDataFeed* f, QWidget* parent) :
+	QWidget(parent, Qt::Window),
+	feed(f),
+	state(std::make_shared<State>()),
+	busyNsecs(0),
+	processedSeconds(0.)
+{
+	layout = new QGridLayout(this);
+
+	thresholdLabel = new QLabel("Threshold:", this);
+	thresholdLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	thresholdBox = new QDoubleSpinBox(this);
+	thresholdBox->setRange(2., 20.);
+	thresholdBox->setSingleStep(0.5);
+	thresholdBox->setDecimals(1);
+	thresholdBox->setValue(5.);
+	thresholdBox->setSuffix(" x noise");
+	thresholdBox->setToolTip("Spike threshold, as a multiple of the noise of each channel");
+
+	scaleLabel = new QLabel("Scale:", this);
+	scaleLabel->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	scaleBox = new QSpinBox(this);
+	scaleBox->setRange(1, 1000);
+	scaleBox->setValue(20);
+	scaleBox->setSuffix(" spikes/s");
+	scaleBox->setToolTip("Spike rate shown in the brightest color");
+
+	statusLabel = new QLabel("Waiting for data", this);
+
+	heatmap = new ChannelHeatmap(this);
+	heatmap->setRange(0.f, scaleBox->value());
+	heatmap->setUnit("spikes/s");
+
+	layout->addWidget(thresholdLabel, 0, 0);
+	layout->addWidget(thresholdBox, 0, 1);
+	layout->addWidget(scaleLabel, 0, 2);
+	layout->addWidget(scaleBox, 0, 3);
+	layout->addWidget(statusLabel, 0, 4);
+	layout->addWidget(heatmap, 1, 0, 1, 5);
+	layout->setColumnStretch(4, 1);
+	layout->setRowStretch(1, 1);
+	setLayout(layout);
+	setWindowTitle("Spike activity");
+	resize(600, 640);
+
+	QObject::connect(scaleBox, static_cast<void(QSpinBox::*)(int)>(
+				&QSpinBox::valueChanged),
+			this, [this](int scale) -> void {
+				heatmap->setRange(0.f, scale);
+			});
+	if (feed) {
+		QObject::connect(feed, &LiveDataFeed::chunkReceived,
+				this, &SpikeActivityWindow::handleChunk);
+		QObject::connect(feed, &LiveDataFeed::requestFailed,
+				this, [this](const QString& msg) -> void {
+					statusLabel->setText(QString("Could not get data: %1").arg(msg));
+				});
+	}
+	statusTimer.start();
+}
+
+SpikeActivityWindow::~SpikeActivityWindow()
+{
+	worker.waitForFinished();
+}
+
+void SpikeActivityWindow::showEvent(QShowEvent* event)
+{
+	if (feed)
+		feed->addConsumer(this);
+	QWidget::showEvent(event);
+}
+
+void SpikeActivityWindow::hideEvent(QHideEvent* event)
+{
+	if (feed)
+		feed->removeConsumer(this);
+	pendingChunks.clear();
+	QWidget::hideEvent(event);
+}
+
+void SpikeActivityWindow::handleChunk(const DataChunk& chunk)
+{
+	if (!isVisible())
+		return;
+	pendingChunks.append(chunk);
+	if (!worker.isRunning())
+		processChunks();
+}
+
+void SpikeActivityWindow::processChunks()
+{
+	if (worker.isRunning() || pendingChunks.isEmpty())
+		return;
+
+	auto chunks = pendingChunks;
+	pendingChunks.clear();
+	auto shared = state;
+	auto factor = static_cast<float>(thresholdBox->value());
+	auto timeConstant = RateTimeConstant;
+	worker = QtConcurrent::run([shared, chunks, factor, timeConstant]() -> Result {
+				return detect(shared.get(), chunks, factor, timeConstant);
+			});
+	auto watcher = new QFutureWatcher<Result>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher]() -> void {
+				watcher->deleteLater();
+				auto result = watcher->result();
+				if (result.channels != heatmap->channelCount())
+					heatmap->setChannelCount(result.channels);
+				heatmap->setValues(result.rates);
+
+				busyNsecs += result.nsecs;
+				processedSeconds += result.seconds;
+				if ((statusTimer.elapsed() >= 1000) && (processedSeconds > 0)) {
+					auto total = std::accumulate(result.rates.cbegin(),
+							result.rates.cend(), 0.);
+					statusLabel->setText(QString("%1 channels at %2 Hz, "
+								"%3 spikes/s in all, detection uses %4% of a core")
+							.arg(result.channels)
+							.arg(result.sampleRate, 0, 'f', 0)
+							.arg(total, 0, 'f', 0)
+							.arg(100. * busyNsecs / (processedSeconds * 1e9), 0, 'f', 1));
+					busyNsecs = 0;
+					processedSeconds = 0.;
+					statusTimer.restart();
+				}
+				processChunks();
+			});
+	watcher->setFuture(worker);
+}
+
+SpikeActivityWindow::Result SpikeActivityWindow::detect(State* state,
+		const QList<DataChunk>& chunks, float factor, double timeConstant)
+{
+	QElapsedTimer timer;
+	timer.start();
+	Result result;
+	auto& detector = state->detector;
+	auto& rates = state->rates;
+	detector.setThresholdFactor(factor);
+
+	/* Start afresh when the shape of the data changes or a new
+	 * recording begins.
+	 */
+	for (auto& chunk : chunks) {
+		if ((chunk.channels <= 0) || (chunk.frames <= 0))
+			continue;
+		if ((chunk.channels != detector.channels()) ||
+				(chunk.start < state->lastStop)) {
+			detector.reset(chunk.channels, chunk.sampleRate());
+			rates.fill(0.f, chunk.channels);
+		}
+		if (!detector.process(chunk))
+			continue;
+
+		/* Average the rate exponentially over time, however long the
+		 * chunks are.
+		 */
+		auto span = static_cast<double>(chunk.stop - chunk.start);
+		auto decay = std::exp(-span / timeConstant);
+		auto& counts = detector.counts();
+		for (int channel = 0; channel < rates.size(); channel++) {
+			rates[channel] = static_cast<float>(rates[channel] * decay +
+					(counts[channel] / span) * (1 - decay));
+		}
+		state->lastStop = chunk.stop;
+		result.seconds += span;
+	}
+
+	result.rates = rates;
+	result.channels = detector.channels();
+	result.sampleRate = detector.sampleRate();
+	result.nsecs = timer.nsecsElapsed();
+	return result;
+}
@@ -0,0 +1,276 @@
+/*! \file spike-detector.cc
+ *
+ * Implementation of the SpikeDetector class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "spike-detector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Ratio of the median absolute deviation of Gaussian noise to its
+ * standard deviation.
+ */
+static const float MadScale = 0.6745f;
+
+/* Number of values of the delay state of each channel. */
+static const int StateSize = 4;
+
+/* Return the level below which a sample is a spike, given the noise of
+ * its channel, or infinity if the noise is not known.
+ */
+static inline float limitOf(float noise, float factor)
+{
+	return (noise > 0) ? noise * (factor / MadScale) :
+		std::numeric_limits<float>::infinity();
+}
+
+/* Compute the coefficients of a second-order Butterworth section. */
+static void butterworth(double cutoff, double rate, bool highpass, float* c)
+{
+	auto w = 2 * 3.14159265358979323846 * cutoff / rate;
+	auto cosw = std::cos(w);
+	auto alpha = std::sin(w) / std::sqrt(2.);
+	auto a0 = 1 + alpha;
+	auto b = highpass ? (1 + cosw) / 2 : (1 - cosw) / 2;
+	c[0] = static_cast<float>(b / a0);
+	c[1] = static_cast<float>((highpass ? -2 * b : 2 * b) / a0);
+	c[2] = static_cast<float>(b / a0);
+	c[3] = static_cast<float>(-2 * cosw / a0);
+	c[4] = static_cast<float>((1 - alpha) / a0);
+}
+
+/* Filter one sample through a section in transposed direct form II. */
+static inline float section(const float* c, float x, float& z1, float& z2)
+{
+	auto y = c[0] * x + z1;
+	z1 = (c[1] * x - c[3] * y) + z2;
+	z2 = c[2] * x - c[4] * y;
+	return y;
+}
+
+SpikeDetector::SpikeDetector(int channels, double sampleRate) :
+	factor(5.f)
+{
+	reset(channels, sampleRate);
+}
+
+int SpikeDetector::laneIndex(int channel, int item, int items)
+{
+	return ((channel / Lanes) * items + item) * Lanes + channel % Lanes;
+}
+
+void SpikeDetector::reset(int channels, double sampleRate)
+{
+	nchannels = qMax(channels, 0);
+	padded = (nchannels + Lanes - 1) / Lanes * Lanes;
+	rate = sampleRate;
+	if (rate > 0) {
+		butterworth(LowCutoff, rate, true, coefficients[0]);
+		butterworth(qMin(static_cast<double>(HighCutoff), 0.45 * rate),
+				rate, false, coefficients[1]);
+	} else {
+		std::fill(&coefficients[0][0], &coefficients[0][0] + 10, 0.f);
+	}
+	refractorySamples = static_cast<qint32>(std::ceil(RefractoryPeriod * rate));
+
+	state.assign(padded * StateSize, 0.f);
+	refractory.assign(padded, static_cast<qint32>(std::ceil(SettlingTime * rate)));
+	noise.assign(padded, 0.f);
+	magnitudes.assign(padded * MadSamples, 0.f);
+	scratch.assign(MadSamples, 0.f);
+	spikeCounts.fill(0, nchannels);
+}
+
+int SpikeDetector::channels() const
+{
+	return nchannels;
+}
+
+double SpikeDetector::sampleRate() const
+{
+	return rate;
+}
+
+void SpikeDetector::setThresholdFactor(float f)
+{
+	factor = f;
+}
+
+float SpikeDetector::thresholdFactor() const
+{
+	return factor;
+}
+
+float SpikeDetector::threshold(int channel) const
+{
+	if ((channel < 0) || (channel >= nchannels) || (noise[channel] <= 0))
+		return 0.f;
+	return limitOf(noise[channel], factor);
+}
+
+const QVector<int>& SpikeDetector::counts() const
+{
+	return spikeCounts;
+}
+
+bool SpikeDetector::process(const DataChunk& chunk)
+{
+	if ((chunk.channels != nchannels) || (nchannels == 0) || (rate <= 0))
+		return false;
+	spikeCounts.fill(0);
+	auto frames = chunk.frames;
+	if (frames <= 0)
+		return true;
+
+	/* Every stride-th sample is kept for the estimate of the noise. The
+	 * stride is a whole number of blocks, so the SIMD kernel only keeps
+	 * the first sample of a block.
+	 */
+	auto blocks = frames / Lanes;
+	auto stride = qMax(static_cast<qint64>(1),
+			(frames + Lanes * MadSamples - 1) / (Lanes * MadSamples)) * Lanes;
+	auto sampled = static_cast<int>((frames + stride - 1) / stride);
+	int channel = 0;
+
+#ifdef __SSE2__
+	const auto hb0 = _mm_set1_ps(coefficients[0][0]);
+	const auto hb1 = _mm_set1_ps(coefficients[0][1]);
+	const auto hb2 = _mm_set1_ps(coefficients[0][2]);
+	const auto ha1 = _mm_set1_ps(coefficients[0][3]);
+	const auto ha2 = _mm_set1_ps(coefficients[0][4]);
+	const auto lb0 = _mm_set1_ps(coefficients[1][0]);
+	const auto lb1 = _mm_set1_ps(coefficients[1][1]);
+	const auto lb2 = _mm_set1_ps(coefficients[1][2]);
+	const auto la1 = _mm_set1_ps(coefficients[1][3]);
+	const auto la2 = _mm_set1_ps(coefficients[1][4]);
+	const auto sign = _mm_set1_ps(-0.f);
+	const auto one = _mm_set1_epi32(1);
+	const auto zero = _mm_setzero_si128();
+	const auto reload = _mm_set1_epi32(refractorySamples);
+
+	for (; channel + Lanes <= nchannels; channel += Lanes) {
+		const qint16* x[Lanes];
+		for (int lane = 0; lane < Lanes; lane++)
+			x[lane] = chunk.channel(channel + lane);
+		auto z = state.data() + laneIndex(channel, 0, StateSize);
+		auto z0 = _mm_loadu_ps(z);
+		auto z1 = _mm_loadu_ps(z + Lanes);
+		auto z2 = _mm_loadu_ps(z + 2 * Lanes);
+		auto z3 = _mm_loadu_ps(z + 3 * Lanes);
+
+		/* The limit is negated, so a spike is a sample below it. */
+		auto n = _mm_loadu_ps(noise.data() + channel);
+		auto known = _mm_cmpgt_ps(n, _mm_setzero_ps());
+		auto limit = _mm_or_ps(
+				_mm_and_ps(known, _mm_mul_ps(n, _mm_set1_ps(factor / MadScale))),
+				_mm_andnot_ps(known, _mm_set1_ps(std::numeric_limits<float>::infinity())));
+		limit = _mm_xor_ps(limit, sign);
+		auto wait = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+					refractory.data() + channel));
+		auto found = _mm_setzero_si128();
+		auto kept = magnitudes.data() + laneIndex(channel, 0, MadSamples);
+
+		for (qint64 block = 0; block < blocks; block++) {
+			auto t = block * Lanes;
+
+			/* Load a block of each channel, and transpose them, so
+			 * that each vector holds one sample of every channel.
+			 */
+			__m128 v[Lanes];
+			for (int lane = 0; lane < Lanes; lane++) {
+				auto s = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x[lane] + t));
+				v[lane] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+			}
+			_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+
+			for (int k = 0; k < Lanes; k++) {
+				auto y = _mm_add_ps(_mm_mul_ps(hb0, v[k]), z0);
+				z0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(hb1, v[k]), _mm_mul_ps(ha1, y)), z1);
+				z1 = _mm_sub_ps(_mm_mul_ps(hb2, v[k]), _mm_mul_ps(ha2, y));
+				auto w = y;
+				y = _mm_add_ps(_mm_mul_ps(lb0, w), z2);
+				z2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(lb1, w), _mm_mul_ps(la1, y)), z3);
+				z3 = _mm_sub_ps(_mm_mul_ps(lb2, w), _mm_mul_ps(la2, y));
+
+				auto below = _mm_castps_si128(_mm_cmplt_ps(y, limit));
+				auto hit = _mm_and_si128(below, _mm_cmpgt_epi32(one, wait));
+				found = _mm_sub_epi32(found, hit);
+				wait = _mm_sub_epi32(wait, _mm_and_si128(one, _mm_cmpgt_epi32(wait, zero)));
+				wait = _mm_or_si128(_mm_and_si128(hit, reload),
+						_mm_andnot_si128(hit, wait));
+				if ((k == 0) && (t % stride == 0))
+					_mm_storeu_ps(kept + (t / stride) * Lanes, _mm_andnot_ps(sign, y));
+			}
+		}
+
+		_mm_storeu_ps(z, z0);
+		_mm_storeu_ps(z + Lanes, z1);
+		_mm_storeu_ps(z + 2 * Lanes, z2);
+		_mm_storeu_ps(z + 3 * Lanes, z3);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(refractory.data() + channel), wait);
+		qint32 lanes[Lanes];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), found);
+
+		/* Samples which do not fill a block are done one at a time. */
+		for (int lane = 0; lane < Lanes; lane++) {
+			spikeCounts[channel + lane] = lanes[lane];
+			processChannel(channel + lane, x[lane], blocks * Lanes, frames, stride,
+					limitOf(noise[channel + lane], factor));
+		}
+	}
+#endif
+
+	for (; channel < nchannels; channel++) {
+		processChannel(channel, chunk.channel(channel), 0, frames, stride,
+				limitOf(noise[channel], factor));
+	}
+	updateThresholds(sampled);
+	return true;
+}
+
+void SpikeDetector::processChannel(int channel, const qint16* x, qint64 from,
+		qint64 frames, qint64 stride, float limit)
+{
+	float* z[StateSize];
+	for (int i = 0; i < StateSize; i++)
+		z[i] = state.data() + laneIndex(channel, i, StateSize);
+	auto& wait = refractory[channel];
+	auto found = 0;
+	for (auto t = from; t < frames; t++) {
+		auto y = section(coefficients[0], x[t], *z[0], *z[1]);
+		y = section(coefficients[1], y, *z[2], *z[3]);
+		if ((y < -limit) && (wait <= 0)) {
+			found++;
+			wait = refractorySamples;
+		} else if (wait > 0) {
+			wait--;
+		}
+		if (t % stride == 0)
+			magnitudes[laneIndex(channel, static_cast<int>(t / stride), MadSamples)] =
+				std::fabs(y);
+	}
+	spikeCounts[channel] += found;
+}
+
+void SpikeDetector::updateThresholds(int sampled)
+{
+	if (sampled <= 0)
+		return;
+	for (int channel = 0; channel < nchannels; channel++) {
+		for (int i = 0; i < sampled; i++)
+			scratch[i] = magnitudes[laneIndex(channel, i, MadSamples)];
+		auto middle = scratch.begin() + sampled / 2;
+		std::nth_element(scratch.begin(), middle, scratch.begin() + sampled);
+		auto median = *middle;
+		auto& n = noise[channel];
+		n = (n > 0) ? n + NoiseSmoothing * (median - n) : median;
+	}
+}
@@ -0,0 +1,195 @@
+/*! \file stimulus-cache.cc
+ *
+ * Implementation of the StimulusCache class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "stimulus-cache.h"
+
+StimulusCache::StimulusCache(qint64 capacity, QObject* parent) :
+	QObject(parent),
+	maxBytes(capacity),
+	usedBytes(0),
+	hitCount(0),
+	missCount(0)
+{
+}
+
+StimulusCache::~StimulusCache()
+{
+}
+
+QByteArray StimulusCache::hash(const WaveformView& samples,
+		std::function<bool(qint64, qint64)> progress)
+{
+	/* Hash a megabyte at a time, so that a long signal can report
+	 * progress, and no more than that is faulted in at once.
+	 */
+	const qint64 step = 1 << 17;
+	QCryptographicHash hasher(QCryptographicHash::Sha1);
+	auto data = samples.constData();
+	auto total = samples.size();
+	for (qint64 offset = 0; offset < total; offset += step) {
+		auto count = qMin(step, total - offset);
+		hasher.addData(reinterpret_cast<const char*>(data + offset),
+				static_cast<int>(count * sizeof(double)));
+		if (progress && !progress(offset + count, total))
+			return QByteArray();
+	}
+	if (samples.channels() != 1)
+		hasher.addData(QByteArray::number(samples.channels()));
+	return hasher.result();
+}
+
+QString StimulusCache::key(const QString& file, const QString& variant)
+{
+	QFileInfo info(file);
+	if (!info.exists())
+		return QString();
+	auto k = QString("%1:%2:%3").arg(info.canonicalFilePath())
+		.arg(info.lastModified().toMSecsSinceEpoch())
+		.arg(info.size());
+	return variant.isEmpty() ? k : (k + "|" + variant);
+}
+
+qint64 StimulusCache::bytes(const WaveformView& samples)
+{
+	return static_cast<qint64>(samples.size()) * sizeof(double);
+}
+
+bool StimulusCache::contains(const QString& file, const QString& variant) const
+{
+	auto k = key(file, variant);
+	return !k.isEmpty() && entries.contains(k);
+}
+
+bool StimulusCache::lookup(const QString& file, Entry* entry,
+		const QString& variant)
+{
+	auto k = key(file, variant);
+	auto it = entries.constFind(k);
+	if (k.isEmpty() || (it == entries.cend())) {
+		missCount++;
+		return false;
+	}
+	hitCount++;
+	order.removeOne(k);
+	order.append(k);
+	*entry = it.value();
+	return true;
+}
+
+void StimulusCache::insert(const QString& file, const WaveformView& samples,
+		const QByteArray& digest, const QString& variant)
+{
+	auto k = key(file, variant);
+	if (k.isEmpty() || (bytes(samples) > maxBytes))
+		return;
+
+	auto path = QFileInfo(file).canonicalFilePath();
+	remove(path);
+
+	Entry entry;
+	entry.hash = digest.isEmpty() ? hash(samples) : digest;
+	entry.samples = samples;
+	entries.insert(k, entry);
+	order.append(k);
+	fileKeys.insert(path, k);
+	usedBytes += bytes(samples);
+	evict();
+}
+
+void StimulusCache::insertHash(const QString& file, const QByteArray& digest,
+		const QString& variant)
+{
+	auto k = key(file, variant);
+	if (k.isEmpty() || digest.isEmpty())
+		return;
+	auto path = QFileInfo(file).canonicalFilePath();
+	remove(path);
+	hashes.insert(k, digest);
+	fileKeys.insert(path, k);
+}
+
+QByteArray StimulusCache::lookupHash(const QString& file,
+		const QString& variant) const
+{
+	auto k = key(file, variant);
+	if (k.isEmpty())
+		return QByteArray();
+	auto it = entries.constFind(k);
+	if (it != entries.cend())
+		return it->hash;
+	return hashes.value(k);
+}
+
+void StimulusCache::remove(const QString& path)
+{
+	/* An earlier version, or another variant, of the file is never
+	 * used again.
+	 */
+	auto old = fileKeys.take(path);
+	if (old.isEmpty())
+		return;
+	hashes.remove(old);
+	if (entries.contains(old)) {
+		usedBytes -= bytes(entries.take(old).samples);
+		order.removeOne(old);
+	}
+}
+
+qint64 StimulusCache::capacity() const
+{
+	return maxBytes;
+}
+
+void StimulusCache::setCapacity(qint64 capacity)
+{
+	maxBytes = capacity;
+	evict();
+}
+
+qint64 StimulusCache::size() const
+{
+	return usedBytes;
+}
+
+int StimulusCache::count() const
+{
+	return entries.size();
+}
+
+int StimulusCache::hits() const
+{
+	return hitCount;
+}
+
+int StimulusCache::misses() const
+{
+	return missCount;
+}
+
+void StimulusCache::clear()
+{
+	entries.clear();
+	order.clear();
+	hashes.clear();
+	fileKeys.clear();
+	usedBytes = 0;
+}
+
+void StimulusCache::evict()
+{
+	while ((usedBytes > maxBytes) && !order.isEmpty()) {
+		/* Keep the hash of an evicted signal, as for one streamed
+		 * from its file, so that it need not be sent again. Its file
+		 * still maps to the same key.
+		 */
+		auto k = order.takeFirst();
+		auto entry = entries.take(k);
+		hashes.insert(k, entry.hash);
+		usedBytes -= bytes(entry.samples);
+	}
+}
+
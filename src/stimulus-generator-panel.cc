@@ -0,0 +1,141 @@
+/*! \file stimulus-generator-panel.cc
+ *
+ * Implementation of the StimulusGeneratorPanel class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "stimulus-generator-panel.h"
+#include "notification-center.h"
+#include "stimulus-cache.h"
+
+#include <limits>
+
+StimulusGeneratorPanel::StimulusGeneratorPanel(QWidget* parent) :
+	QGroupBox("Generate analog output", parent)
+{
+	StimulusGenerator::Parameters defaults;
+	layout = new QFormLayout(this);
+
+	waveformBox = new QComboBox(this);
+	waveformBox->addItems(StimulusGenerator::waveformNames());
+	waveformBox->setToolTip("Shape of the generated signal");
+	layout->addRow("Waveform:", waveformBox);
+
+	sampleRateBox = addParameter("Sample rate:", 1, 1e6, defaults.sampleRate, " Hz", 0);
+	durationBox = addParameter("Duration:", 0.001, 3600, defaults.duration, " s", 3);
+	amplitudeBox = addParameter("Amplitude:", -10, 10, defaults.amplitude, " V", 3);
+	offsetBox = addParameter("Offset:", -10, 10, defaults.offset, " V", 3);
+	frequencyBox = addParameter("Frequency:", 0, 1e5, defaults.frequency, " Hz");
+	endFrequencyBox = addParameter("End frequency:", 0, 1e5,
+			defaults.endFrequency, " Hz");
+	periodBox = addParameter("Period:", 0, 3600, defaults.period, " s", 3);
+	dutyCycleBox = addParameter("Duty cycle:", 0, 1, defaults.dutyCycle, "");
+
+	seedBox = new QSpinBox(this);
+	seedBox->setRange(0, std::numeric_limits<int>::max());
+	seedBox->setValue(static_cast<int>(defaults.seed));
+	seedBox->setToolTip("The same seed always gives the same noise");
+	layout->addRow("Seed:", seedBox);
+
+	lengthLabel = new QLabel(this);
+	layout->addRow("Samples:", lengthLabel);
+
+	generateButton = new QPushButton("Generate", this);
+	generateButton->setToolTip("Generate the signal and use it as the analog output");
+	layout->addRow(generateButton);
+
+	QObject::connect(waveformBox, &QComboBox::currentTextChanged,
+			this, [this]() -> void { updateEnabledParameters(); });
+	for (auto box : { sampleRateBox, durationBox }) {
+		QObject::connect(box, static_cast<void(QDoubleSpinBox::*)(double)>(
+					&QDoubleSpinBox::valueChanged),
+				this, [this]() -> void { updateEnabledParameters(); });
+	}
+	QObject::connect(generateButton, &QPushButton::clicked,
+			this, &StimulusGeneratorPanel::generate);
+	updateEnabledParameters();
+}
+
+StimulusGeneratorPanel::~StimulusGeneratorPanel()
+{
+	worker.waitForFinished();
+}
+
+QDoubleSpinBox* StimulusGeneratorPanel::addParameter(const QString& label,
+		double min, double max, double value, const QString& suffix, int decimals)
+{
+	auto box = new QDoubleSpinBox(this);
+	box->setDecimals(decimals);
+	box->setRange(min, max);
+	box->setValue(value);
+	box->setSuffix(suffix);
+	layout->addRow(label, box);
+	return box;
+}
+
+StimulusGenerator::Parameters StimulusGeneratorPanel::parameters() const
+{
+	StimulusGenerator::Parameters params;
+	params.waveform = static_cast<StimulusGenerator::Waveform>(
+			waveformBox->currentIndex());
+	params.sampleRate = sampleRateBox->value();
+	params.duration = durationBox->value();
+	params.amplitude = amplitudeBox->value();
+	params.offset = offsetBox->value();
+	params.frequency = frequencyBox->value();
+	params.endFrequency = endFrequencyBox->value();
+	params.period = periodBox->value();
+	params.dutyCycle = dutyCycleBox->value();
+	params.seed = static_cast<quint64>(seedBox->value());
+	return params;
+}
+
+void StimulusGeneratorPanel::updateEnabledParameters()
+{
+	using Waveform = StimulusGenerator::Waveform;
+	auto waveform = static_cast<Waveform>(waveformBox->currentIndex());
+	frequencyBox->setEnabled((waveform == Waveform::Sine) ||
+			(waveform == Waveform::Chirp));
+	endFrequencyBox->setEnabled(waveform == Waveform::Chirp);
+	periodBox->setEnabled((waveform == Waveform::Flash) ||
+			(waveform == Waveform::Ramp));
+	dutyCycleBox->setEnabled(waveform == Waveform::Flash);
+	seedBox->setEnabled(waveform == Waveform::Noise);
+	lengthLabel->setText(QString::number(StimulusGenerator::sampleCount(parameters())));
+}
+
+void StimulusGeneratorPanel::generate()
+{
+	if (worker.isRunning())
+		return;
+	auto params = parameters();
+	generateButton->setEnabled(false);
+	generateButton->setText("Generating...");
+
+	worker = QtConcurrent::run([params]() -> Result {
+				Result result;
+				result.signal = StimulusGenerator::generate(params);
+				result.hash = StimulusCache::hash(result.signal);
+				return result;
+			});
+	auto watcher = new QFutureWatcher<Result>(this);
+	QObject::connect(watcher, &QFutureWatcherBase::finished,
+			this, [this, watcher, params]() -> void {
+				watcher->deleteLater();
+				generateButton->setEnabled(true);
+				generateButton->setText("Generate");
+				auto result = watcher->result();
+				if (result.signal.isEmpty()) {
+					NotificationCenter::instance()->warning(
+							"Could not generate analog output",
+							"The parameters do not describe a signal which "
+							"can be generated.");
+					return;
+				}
+				emit generated(StimulusGenerator::describe(params),
+						result.signal, result.hash);
+			});
+	watcher->setFuture(worker);
+}
+
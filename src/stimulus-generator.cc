@@ -0,0 +1,334 @@
+/*! \file stimulus-generator.cc
+ *
+ * Implementation of the StimulusGenerator class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "stimulus-generator.h"
+
+#include <QtConcurrent>
+
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const double TwoPi = 6.283185307179586476925286766559;
+
+/* Coefficients of the Taylor series of sin(x), which is accurate to
+ * better than 1e-9 over [-pi/2, pi/2].
+ */
+static const double S3 = -1. / 6.;
+static const double S5 = 1. / 120.;
+static const double S7 = -1. / 5040.;
+static const double S9 = 1. / 362880.;
+static const double S11 = -1. / 39916800.;
+static const double S13 = 1. / 6227020800.;
+
+/* Return sin(2 pi u). The number of turns u is first reduced to
+ * [-1/2, 1/2], then folded into [-1/4, 1/4] using sin(pi - x) = sin(x).
+ * This and the vector version below make the same operations in the
+ * same order, so they give the same results.
+ */
+static inline double sinTurns(double u)
+{
+	auto r = u - std::nearbyint(u);
+	if (std::fabs(r) > 0.25)
+		r = std::copysign(0.5, r) - r;
+	auto x = TwoPi * r;
+	auto x2 = x * x;
+	auto p = S13;
+	p = p * x2 + S11;
+	p = p * x2 + S9;
+	p = p * x2 + S7;
+	p = p * x2 + S5;
+	p = p * x2 + S3;
+	p = p * x2 + 1.;
+	return x * p;
+}
+
+#ifdef __SSE2__
+/* Return sin(2 pi u) for two values of u, each less than 2^31. */
+static inline __m128d sinTurns(__m128d u)
+{
+	const auto signBit = _mm_set1_pd(-0.);
+	auto r = _mm_sub_pd(u, _mm_cvtepi32_pd(_mm_cvtpd_epi32(u)));
+	auto sign = _mm_and_pd(r, signBit);
+	auto fold = _mm_cmpgt_pd(_mm_andnot_pd(signBit, r), _mm_set1_pd(0.25));
+	auto folded = _mm_sub_pd(_mm_or_pd(_mm_set1_pd(0.5), sign), r);
+	r = _mm_or_pd(_mm_and_pd(fold, folded), _mm_andnot_pd(fold, r));
+	auto x = _mm_mul_pd(_mm_set1_pd(TwoPi), r);
+	auto x2 = _mm_mul_pd(x, x);
+	auto p = _mm_set1_pd(S13);
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(S11));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(S9));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(S7));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(S5));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(S3));
+	p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(1.));
+	return _mm_mul_pd(x, p);
+}
+#endif
+
+/* Write offset + amplitude * sin(2 pi (base + step * k + curve * k^2))
+ * for k from 0 to count. Keeping base small keeps the phase accurate
+ * however long the signal is.
+ */
+static void sineKernel(double base, double step, double curve, double amplitude,
+		double offset, qint64 count, double* out)
+{
+	qint64 k = 0;
+#ifdef __SSE2__
+	const auto a = _mm_set1_pd(amplitude);
+	const auto b = _mm_set1_pd(offset);
+	for (; k + 1 < count; k += 2) {
+		auto kk = _mm_set_pd(static_cast<double>(k + 1), static_cast<double>(k));
+		auto u = _mm_add_pd(_mm_set1_pd(base), _mm_add_pd(
+					_mm_mul_pd(_mm_set1_pd(step), kk),
+					_mm_mul_pd(_mm_set1_pd(curve), _mm_mul_pd(kk, kk))));
+		_mm_storeu_pd(out + k, _mm_add_pd(_mm_mul_pd(a, sinTurns(u)), b));
+	}
+#endif
+	for (; k < count; k++) {
+		auto kk = static_cast<double>(k);
+		auto u = base + (step * kk + curve * (kk * kk));
+		out[k] = amplitude * sinTurns(u) + offset;
+	}
+}
+
+/* Return the fractional part of x. */
+static inline double fraction(double x)
+{
+	return x - std::floor(x);
+}
+
+/* Mix the bits of a 64-bit value, as in the SplitMix64 generator. */
+static inline quint64 mix(quint64 z)
+{
+	z += Q_UINT64_C(0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+	return z ^ (z >> 31);
+}
+
+/* Return the nth uniform deviate in (0, 1] of the stream with the
+ * given key. Any deviate is computed directly from its position.
+ */
+static inline double uniform(quint64 key, quint64 n)
+{
+	return static_cast<double>((mix(key + n) >> 11) + 1) * (1. / 9007199254740992.);
+}
+
+#ifdef __SSE2__
+/* Return the fractional parts of two values, each non-negative and less
+ * than 2^31, for which truncation is the same as the floor.
+ */
+static inline __m128d fraction(__m128d x)
+{
+	return _mm_sub_pd(x, _mm_cvtepi32_pd(_mm_cvttpd_epi32(x)));
+}
+#endif
+
+/* Return true if the phases of a block, base + step * k for k up to
+ * count, may be reduced two at a time.
+ */
+static inline bool vectorPhases(double base, double step, qint64 count)
+{
+	return (base >= 0) && (step >= 0) && (base + step * count < 2147483648.);
+}
+
+/* Write offset + amplitude * fraction(base + step * k) for k from 0 to
+ * count, a ramp of phase base and slope step turns per sample.
+ */
+static void rampKernel(double base, double step, double amplitude,
+		double offset, qint64 count, double* out)
+{
+	qint64 k = 0;
+#ifdef __SSE2__
+	if (vectorPhases(base, step, count)) {
+		const auto a = _mm_set1_pd(amplitude);
+		const auto b = _mm_set1_pd(offset);
+		for (; k + 1 < count; k += 2) {
+			auto kk = _mm_set_pd(static_cast<double>(k + 1), static_cast<double>(k));
+			auto u = _mm_add_pd(_mm_set1_pd(base), _mm_mul_pd(_mm_set1_pd(step), kk));
+			_mm_storeu_pd(out + k, _mm_add_pd(b, _mm_mul_pd(a, fraction(u))));
+		}
+	}
+#endif
+	for (; k < count; k++)
+		out[k] = offset + amplitude * fraction(base + step * k);
+}
+
+/* Write offset + amplitude for k from 0 to count while the phase
+ * base + step * k is within the first duty of its turn, and offset
+ * otherwise.
+ */
+static void flashKernel(double base, double step, double duty, double amplitude,
+		double offset, qint64 count, double* out)
+{
+	qint64 k = 0;
+#ifdef __SSE2__
+	if (vectorPhases(base, step, count)) {
+		const auto a = _mm_set1_pd(amplitude);
+		const auto b = _mm_set1_pd(offset);
+		const auto d = _mm_set1_pd(duty);
+		for (; k + 1 < count; k += 2) {
+			auto kk = _mm_set_pd(static_cast<double>(k + 1), static_cast<double>(k));
+			auto u = _mm_add_pd(_mm_set1_pd(base), _mm_mul_pd(_mm_set1_pd(step), kk));
+			auto on = _mm_cmplt_pd(fraction(u), d);
+			_mm_storeu_pd(out + k, _mm_add_pd(b, _mm_and_pd(on, a)));
+		}
+	}
+#endif
+	for (; k < count; k++) {
+		auto on = fraction(base + step * k) < duty;
+		out[k] = offset + (on ? amplitude : 0.);
+	}
+}
+
+/* Return sample n of the noise with the given key. Each pair of samples
+ * is drawn with the Box-Muller transform from a pair of uniform deviates.
+ */
+static inline double noiseSample(quint64 key, qint64 n, double amplitude,
+		double offset)
+{
+	auto pair = static_cast<quint64>(n / 2);
+	auto radius = std::sqrt(-2. * std::log(uniform(key, 2 * pair)));
+	auto angle = uniform(key, 2 * pair + 1);
+	auto z = (n % 2) ? sinTurns(angle) : sinTurns(angle + 0.25);
+	return amplitude * radius * z + offset;
+}
+
+/* Write samples first to first + count of the noise with the given key.
+ * With SSE2, both samples of a pair are transformed at once, and only
+ * the logarithm and square root of the radius are scalar.
+ */
+static void noiseKernel(quint64 key, qint64 first, double amplitude,
+		double offset, qint64 count, double* out)
+{
+	qint64 k = 0;
+	if ((count > 0) && (first % 2)) {
+		out[0] = noiseSample(key, first, amplitude, offset);
+		k = 1;
+	}
+#ifdef __SSE2__
+	const auto b = _mm_set1_pd(offset);
+	for (; k + 1 < count; k += 2) {
+		auto pair = static_cast<quint64>((first + k) / 2);
+		auto radius = std::sqrt(-2. * std::log(uniform(key, 2 * pair)));
+		auto angle = uniform(key, 2 * pair + 1);
+		auto z = sinTurns(_mm_set_pd(angle, angle + 0.25));
+		_mm_storeu_pd(out + k, _mm_add_pd(
+					_mm_mul_pd(_mm_set1_pd(amplitude * radius), z), b));
+	}
+#endif
+	for (; k < count; k++)
+		out[k] = noiseSample(key, first + k, amplitude, offset);
+}
+
+QStringList StimulusGenerator::waveformNames()
+{
+	return { "Sine", "Chirp", "Noise", "Flash", "Ramp" };
+}
+
+qint64 StimulusGenerator::sampleCount(const Parameters& params)
+{
+	if (!(params.sampleRate > 0) || !(params.duration > 0))
+		return 0;
+	return std::llround(params.duration * params.sampleRate);
+}
+
+WaveformView StimulusGenerator::generate(const Parameters& params)
+{
+	auto count = sampleCount(params);
+	auto periodic = (params.waveform == Waveform::Flash);
+	if ((count <= 0) || (count > std::numeric_limits<int>::max()) ||
+			(params.frequency < 0) || (params.endFrequency < 0) ||
+			(periodic && !(params.period > 0)) || (params.period < 0))
+		return WaveformView(QVector<double>());
+
+	QVector<double> samples(static_cast<int>(count));
+	auto out = samples.data();
+	QVector<qint64> blocks;
+	for (qint64 first = 0; first < count; first += BlockSize)
+		blocks << first;
+	QtConcurrent::blockingMap(blocks, [&params, count, out](const qint64& first) -> void {
+				generateBlock(params, first, qMin(first + BlockSize, count), out);
+			});
+	return WaveformView(samples, 1, params.sampleRate);
+}
+
+void StimulusGenerator::generateBlock(const Parameters& params, qint64 first,
+		qint64 last, double* out)
+{
+	auto rate = params.sampleRate;
+	auto t0 = first / rate;
+	auto count = last - first;
+	out += first;
+
+	switch (params.waveform) {
+		case Waveform::Sine:
+			sineKernel(fraction(params.frequency * t0), params.frequency / rate,
+					0., params.amplitude, params.offset, count, out);
+			break;
+
+		case Waveform::Chirp: {
+			/* The phase in turns is f0 t + c t^2, written about t0. */
+			auto c = (params.endFrequency - params.frequency) / (2 * params.duration);
+			auto base = params.frequency * t0 + c * t0 * t0;
+			auto slope = params.frequency + 2 * c * t0;
+			sineKernel(fraction(base), slope / rate, c / (rate * rate),
+					params.amplitude, params.offset, count, out);
+			break;
+		}
+
+		case Waveform::Noise:
+			noiseKernel(mix(params.seed), first, params.amplitude,
+					params.offset, count, out);
+			break;
+
+		case Waveform::Flash: {
+			auto step = 1. / (rate * params.period);
+			flashKernel(fraction(first * step), step, params.dutyCycle,
+					params.amplitude, params.offset, count, out);
+			break;
+		}
+
+		case Waveform::Ramp: {
+			auto period = (params.period > 0) ? params.period : params.duration;
+			auto step = 1. / (rate * period);
+			rampKernel(fraction(first * step), step, params.amplitude,
+					params.offset, count, out);
+			break;
+		}
+	}
+}
+
+QString StimulusGenerator::describe(const Parameters& params)
+{
+	QString shape;
+	switch (params.waveform) {
+		case Waveform::Sine:
+			shape = QString("sine at %1 Hz").arg(params.frequency);
+			break;
+		case Waveform::Chirp:
+			shape = QString("chirp from %1 to %2 Hz").arg(params.frequency).arg(
+					params.endFrequency);
+			break;
+		case Waveform::Noise:
+			shape = QString("noise with seed %1").arg(params.seed);
+			break;
+		case Waveform::Flash:
+			shape = QString("flashes every %1 s").arg(params.period);
+			break;
+		case Waveform::Ramp:
+			shape = "ramp";
+			break;
+	}
+	return QString("Generated %1, %2 V, %3 s").arg(shape).arg(
+			params.amplitude).arg(params.duration);
+}
+
@@ -0,0 +1,374 @@
+/*! \file stimulus-validator.cc
+ *
+ * Implementation of the StimulusValidator class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "stimulus-validator.h"
+
+#include <QtConcurrent>
+
+#include <cmath>
+#include <functional>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+constexpr double StimulusValidator::DefaultMinimum;
+constexpr double StimulusValidator::DefaultMaximum;
+
+static const double Pi = 3.14159265358979323846264338327950;
+
+/* Run a function over consecutive ranges of at most size items, from
+ * 0 up to count, on the global thread pool.
+ */
+static void forEachBlock(qint64 count, qint64 size,
+		std::function<void(int block, qint64 first, qint64 last)> func)
+{
+	QVector<int> blocks;
+	for (qint64 first = 0; first < count; first += size)
+		blocks << blocks.size();
+	QtConcurrent::blockingMap(blocks, [count, size, &func](const int& block) -> void {
+				auto first = block * size;
+				func(block, first, qMin(first + size, count));
+			});
+}
+
+QString StimulusValidator::Options::fingerprint() const
+{
+	return QString("%1:%2:%3:%4").arg(minimum).arg(maximum).arg(
+			clip ? 1 : 0).arg(sampleRate);
+}
+
+double StimulusValidator::Summary::rms() const
+{
+	auto finite = samples - nonFinite;
+	return (finite > 0) ? std::sqrt(sumSquares / finite) : 0.;
+}
+
+double StimulusValidator::Summary::duration() const
+{
+	return (sampleRate > 0) ? (samples / channels) / sampleRate : 0.;
+}
+
+void StimulusValidator::Summary::merge(const Summary& other)
+{
+	samples += other.samples;
+	minimum = qMin(minimum, other.minimum);
+	maximum = qMax(maximum, other.maximum);
+	sumSquares += other.sumSquares;
+	nonFinite += other.nonFinite;
+	outOfRange += other.outOfRange;
+	clipped += other.clipped;
+}
+
+QString StimulusValidator::Summary::error(const Options& options) const
+{
+	if (nonFinite > 0)
+		return QString("The analog output has %1 samples which are NaN "
+				"or infinite.").arg(nonFinite);
+	if (outOfRange > 0)
+		return QString("The analog output has %1 samples outside the range "
+				"of the DAC, from %2 V to %3 V.").arg(outOfRange).arg(
+				options.minimum).arg(options.maximum);
+	if ((options.sampleRate > 0) && (sampleRate > 0) &&
+			(std::fabs(sampleRate - options.sampleRate) > 1e-6 * options.sampleRate))
+		return QString("The analog output has a sample rate of %1 Hz, and "
+				"cannot be resampled to the source's rate of %2 Hz.").arg(
+				sampleRate).arg(options.sampleRate);
+	return QString();
+}
+
+QString StimulusValidator::Summary::describe() const
+{
+	if (samples == 0)
+		return "No samples";
+	auto length = (sampleRate > 0) ?
+		QString("%1 s").arg(duration(), 0, 'f', 3) :
+		QString("%1 samples").arg(samples / channels);
+	auto text = QString("%1 channel(s), %2, %3 V to %4 V, RMS %5 V").arg(
+			channels).arg(length).arg(minimum, 0, 'f', 3).arg(
+			maximum, 0, 'f', 3).arg(rms(), 0, 'f', 3);
+	if (resampledFrom > 0)
+		text += QString(", resampled from %1 Hz").arg(resampledFrom);
+	if (clipped > 0)
+		text += QString(", %1 samples clipped").arg(clipped);
+	return text;
+}
+
+StimulusValidator::Options StimulusValidator::optionsFor(const QJsonObject& status,
+		bool clip)
+{
+	Options options;
+	options.clip = clip;
+	options.sampleRate = status.value("analog-output-sample-rate").toDouble(0.);
+	return options;
+}
+
+bool StimulusValidator::needsResampling(double sampleRate, const Options& options)
+{
+	return (options.sampleRate > 0) && (sampleRate > 0) &&
+		(sampleRate != options.sampleRate);
+}
+
+StimulusValidator::Summary StimulusValidator::scan(const double* x, qint64 count,
+		const Options& options)
+{
+	Summary summary;
+	summary.samples = count;
+	auto lo = options.minimum;
+	auto hi = options.maximum;
+	qint64 k = 0;
+#ifdef __SSE2__
+	/* A sample is finite if multiplying it by zero gives a number. Each
+	 * count is kept as a sum of ones, which is exact below 2^53.
+	 */
+	const auto inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+	const auto ninf = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+	const auto one = _mm_set1_pd(1.);
+	const auto lov = _mm_set1_pd(lo);
+	const auto hiv = _mm_set1_pd(hi);
+	auto mn = inf;
+	auto mx = ninf;
+	auto ss = _mm_setzero_pd();
+	auto bad = _mm_setzero_pd();
+	auto beyond = _mm_setzero_pd();
+	for (; k + 1 < count; k += 2) {
+		auto v = _mm_loadu_pd(x + k);
+		auto z = _mm_mul_pd(v, _mm_setzero_pd());
+		auto nonFinite = _mm_cmpunord_pd(z, z);
+		auto finite = _mm_andnot_pd(nonFinite, v);
+		mn = _mm_min_pd(mn, _mm_or_pd(_mm_and_pd(nonFinite, inf), finite));
+		mx = _mm_max_pd(mx, _mm_or_pd(_mm_and_pd(nonFinite, ninf), finite));
+		ss = _mm_add_pd(ss, _mm_mul_pd(finite, finite));
+		bad = _mm_add_pd(bad, _mm_and_pd(nonFinite, one));
+		auto out = _mm_or_pd(_mm_cmplt_pd(v, lov), _mm_cmpgt_pd(v, hiv));
+		beyond = _mm_add_pd(beyond, _mm_and_pd(_mm_andnot_pd(nonFinite, out), one));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, mn);
+	summary.minimum = qMin(lanes[0], lanes[1]);
+	_mm_storeu_pd(lanes, mx);
+	summary.maximum = qMax(lanes[0], lanes[1]);
+	_mm_storeu_pd(lanes, ss);
+	summary.sumSquares = lanes[0] + lanes[1];
+	_mm_storeu_pd(lanes, bad);
+	summary.nonFinite = static_cast<qint64>(lanes[0] + lanes[1]);
+	_mm_storeu_pd(lanes, beyond);
+	summary.outOfRange = static_cast<qint64>(lanes[0] + lanes[1]);
+#endif
+	for (; k < count; k++) {
+		auto v = x[k];
+		if (!std::isfinite(v)) {
+			summary.nonFinite++;
+			continue;
+		}
+		summary.minimum = qMin(summary.minimum, v);
+		summary.maximum = qMax(summary.maximum, v);
+		summary.sumSquares += v * v;
+		if ((v < lo) || (v > hi))
+			summary.outOfRange++;
+	}
+	return summary;
+}
+
+StimulusValidator::Summary StimulusValidator::scan(const WaveformView& signal,
+		const Options& options)
+{
+	auto data = signal.constData();
+	auto count = signal.size();
+	QVector<Summary> parts((count + BlockSize - 1) / BlockSize);
+	forEachBlock(count, BlockSize, [data, &options, &parts](int block,
+				qint64 first, qint64 last) -> void {
+				parts[block] = scan(data + first, last - first, options);
+			});
+
+	Summary summary;
+	for (auto& part : parts)
+		summary.merge(part);
+	summary.channels = signal.channels();
+	summary.sampleRate = signal.sampleRate();
+	return summary;
+}
+
+qint64 StimulusValidator::clip(double* x, qint64 count, const Options& options)
+{
+	auto lo = options.minimum;
+	auto hi = options.maximum;
+	qint64 clipped = 0;
+	qint64 k = 0;
+#ifdef __SSE2__
+	const auto one = _mm_set1_pd(1.);
+	const auto lov = _mm_set1_pd(lo);
+	const auto hiv = _mm_set1_pd(hi);
+	auto n = _mm_setzero_pd();
+	for (; k + 1 < count; k += 2) {
+		auto v = _mm_loadu_pd(x + k);
+		auto out = _mm_or_pd(_mm_cmplt_pd(v, lov), _mm_cmpgt_pd(v, hiv));
+		n = _mm_add_pd(n, _mm_and_pd(out, one));
+		_mm_storeu_pd(x + k, _mm_min_pd(_mm_max_pd(v, lov), hiv));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, n);
+	clipped = static_cast<qint64>(lanes[0] + lanes[1]);
+#endif
+	for (; k < count; k++) {
+		if ((x[k] < lo) || (x[k] > hi)) {
+			x[k] = qBound(lo, x[k], hi);
+			clipped++;
+		}
+	}
+	return clipped;
+}
+
+/* Return the greatest common divisor of two positive numbers. */
+static qint64 greatestCommonDivisor(qint64 a, qint64 b)
+{
+	while (b != 0) {
+		auto r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+/* Write the dot product of count coefficients and count samples,
+ * spaced stride apart. Samples of interleaved channels are gathered in
+ * pairs, so that each channel is summed in the same order as a single
+ * channel would be. Two accumulators break the chain of dependent adds.
+ */
+static double dot(const double* h, const double* x, qint64 count, int stride)
+{
+	double acc = 0.;
+	qint64 j = 0;
+#ifdef __SSE2__
+	auto even = _mm_setzero_pd();
+	auto odd = _mm_setzero_pd();
+	if (stride == 1) {
+		for (; j + 3 < count; j += 4) {
+			even = _mm_add_pd(even, _mm_mul_pd(_mm_loadu_pd(h + j), _mm_loadu_pd(x + j)));
+			odd = _mm_add_pd(odd, _mm_mul_pd(_mm_loadu_pd(h + j + 2), _mm_loadu_pd(x + j + 2)));
+		}
+	} else {
+		for (; j + 3 < count; j += 4) {
+			auto first = _mm_set_pd(x[(j + 1) * stride], x[j * stride]);
+			auto second = _mm_set_pd(x[(j + 3) * stride], x[(j + 2) * stride]);
+			even = _mm_add_pd(even, _mm_mul_pd(_mm_loadu_pd(h + j), first));
+			odd = _mm_add_pd(odd, _mm_mul_pd(_mm_loadu_pd(h + j + 2), second));
+		}
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(even, odd));
+	acc = lanes[0] + lanes[1];
+#endif
+	for (; j < count; j++)
+		acc += h[j] * x[j * stride];
+	return acc;
+}
+
+WaveformView StimulusValidator::resample(const WaveformView& signal,
+		double fromRate, double toRate)
+{
+	auto from = static_cast<qint64>(std::llround(fromRate));
+	auto to = static_cast<qint64>(std::llround(toRate));
+	if ((from <= 0) || (to <= 0))
+		return WaveformView();
+
+	/* Upsample by L, filter, and downsample by M. */
+	auto divisor = greatestCommonDivisor(from, to);
+	auto L = to / divisor;
+	auto M = from / divisor;
+	if (L > MaxInterpolation)
+		return WaveformView();
+
+	/* Design a Blackman-windowed sinc low-pass filter at the upsampled
+	 * rate, with its cutoff just below the lower of the two Nyquist
+	 * frequencies, and a gain of L to make up for the inserted zeros.
+	 */
+	auto taps = TapsPerPhase * L + 1;
+	auto center = (taps - 1) / 2;
+	auto cutoff = 0.45 / qMax(L, M);
+	QVector<double> h(static_cast<int>(taps));
+	double sum = 0.;
+	for (qint64 i = 0; i < taps; i++) {
+		auto t = static_cast<double>(i - center);
+		auto sinc = (i == center) ? 2 * cutoff : std::sin(2 * Pi * cutoff * t) / (Pi * t);
+		auto window = 0.42 - 0.5 * std::cos(2 * Pi * i / (taps - 1)) +
+			0.08 * std::cos(4 * Pi * i / (taps - 1));
+		h[i] = sinc * window;
+		sum += h[i];
+	}
+
+	/* Split the filter into L phases, each reversed, so that each output
+	 * sample is one dot product with consecutive input frames.
+	 */
+	QVector<QVector<double>> phases(static_cast<int>(L));
+	for (qint64 p = 0; p < L; p++) {
+		auto& phase = phases[p];
+		for (auto i = p; i < taps; i += L)
+			phase.prepend(h[i] * L / sum);
+	}
+
+	auto channels = signal.channels();
+	auto frames = signal.frames();
+	auto outFrames = (frames * L + M - 1) / M;
+	QVector<double> out(static_cast<int>(outFrames * channels));
+	auto x = signal.constData();
+	auto y = out.data();
+	forEachBlock(outFrames, BlockSize, [=, &phases](int, qint64 first, qint64 last) -> void {
+				for (auto n = first; n < last; n++) {
+					/* Output n lies at n * M in the upsampled signal. */
+					auto s = n * M + center;
+					auto& phase = phases[s % L];
+					qint64 count = phase.size();
+					auto start = s / L - count + 1;
+
+					/* Frames before or after the signal are zero. */
+					auto skip = qMax(-start, Q_INT64_C(0));
+					auto keep = qMin(count, frames - start) - skip;
+					for (int c = 0; c < channels; c++) {
+						y[n * channels + c] = (keep > 0) ?
+							dot(phase.constData() + skip,
+									x + (start + skip) * channels + c,
+									keep, channels) : 0.;
+					}
+				}
+			});
+	return WaveformView(out, channels, toRate);
+}
+
+WaveformView StimulusValidator::process(const WaveformView& signal,
+		const Options& options, Summary* summary)
+{
+	auto result = signal;
+	double resampledFrom = 0.;
+	if (needsResampling(signal.sampleRate(), options)) {
+		auto resampled = resample(signal, signal.sampleRate(), options.sampleRate);
+		if (!resampled.isNull()) {
+			result = resampled;
+			resampledFrom = signal.sampleRate();
+		}
+	}
+
+	*summary = scan(result, options);
+	summary->resampledFrom = resampledFrom;
+	if (options.clip && (summary->outOfRange > 0) && (summary->nonFinite == 0)) {
+		auto samples = result.toVector();
+		auto data = samples.data();
+		QVector<qint64> counts((samples.size() + BlockSize - 1) / BlockSize);
+		forEachBlock(samples.size(), BlockSize, [data, &options, &counts](int block,
+					qint64 first, qint64 last) -> void {
+					counts[block] = clip(data + first, last - first, options);
+				});
+		for (auto count : counts)
+			summary->clipped += count;
+		summary->outOfRange = 0;
+		summary->minimum = qMax(summary->minimum, options.minimum);
+		summary->maximum = qMin(summary->maximum, options.maximum);
+		result = WaveformView(samples, result.channels(), result.sampleRate());
+	}
+	return result;
+}
+
@@ -0,0 +1,162 @@
+/*! \file waveform-view.cc
+ *
+ * Implementation of the WaveformView class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "waveform-view.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+WaveformView::WaveformView() :
+	mapped(nullptr),
+	mappedCount(0),
+	channelCount(1),
+	rate(0.),
+	valid(false)
+{
+}
+
+WaveformView::WaveformView(const QVector<double>& s, int channels,
+		double sampleRate) :
+	samples(s),
+	mapped(nullptr),
+	mappedCount(0),
+	channelCount(qMax(channels, 1)),
+	rate(sampleRate),
+	valid(true)
+{
+}
+
+WaveformView WaveformView::map(const QString& fname, qint64 offset, qint64 count)
+{
+	WaveformView view;
+	if ((offset < 0) || (count <= 0))
+		return view;
+	auto file = std::make_shared<QFile>(fname);
+	if (!file->open(QIODevice::ReadOnly) ||
+			(offset + count * static_cast<qint64>(sizeof(double)) > file->size()))
+		return view;
+	auto data = file->map(offset, count * sizeof(double));
+	if (!data)
+		return view;
+	if (reinterpret_cast<quintptr>(data) % alignof(double))
+		return view;
+
+	/* The file may be closed once mapped, but closing it unmaps it. */
+	view.mappedFile = file;
+	view.mapped = reinterpret_cast<const double*>(data);
+	view.mappedCount = count;
+	view.valid = true;
+	return view;
+}
+
+void WaveformView::interleave(const double* planar, int channels,
+		qint64 frames, double* out)
+{
+	/* Work through blocks of frames, so that the rows being read and
+	 * the frames being written both stay in cache.
+	 */
+	const qint64 block = 512;
+	for (qint64 first = 0; first < frames; first += block) {
+		auto last = qMin(first + block, frames);
+		int c = 0;
+#ifdef __SSE2__
+		/* Transpose 2x2 tiles, two channels of two frames at a time. */
+		for (; c + 1 < channels; c += 2) {
+			auto a = planar + c * frames;
+			auto b = a + frames;
+			auto f = first;
+			for (; f + 1 < last; f += 2) {
+				auto x = _mm_loadu_pd(a + f);
+				auto y = _mm_loadu_pd(b + f);
+				_mm_storeu_pd(out + f * channels + c, _mm_unpacklo_pd(x, y));
+				_mm_storeu_pd(out + (f + 1) * channels + c, _mm_unpackhi_pd(x, y));
+			}
+			for (; f < last; f++) {
+				out[f * channels + c] = a[f];
+				out[f * channels + c + 1] = b[f];
+			}
+		}
+#endif
+		for (; c < channels; c++) {
+			auto a = planar + c * frames;
+			for (auto f = first; f < last; f++)
+				out[f * channels + c] = a[f];
+		}
+	}
+}
+
+bool WaveformView::isNull() const
+{
+	return !valid;
+}
+
+bool WaveformView::isEmpty() const
+{
+	return size() == 0;
+}
+
+bool WaveformView::isMapped() const
+{
+	return mapped != nullptr;
+}
+
+qint64 WaveformView::size() const
+{
+	return mapped ? mappedCount : samples.size();
+}
+
+int WaveformView::channels() const
+{
+	return channelCount;
+}
+
+qint64 WaveformView::frames() const
+{
+	return size() / channelCount;
+}
+
+double WaveformView::sampleRate() const
+{
+	return rate;
+}
+
+void WaveformView::setSampleRate(double sampleRate)
+{
+	rate = sampleRate;
+}
+
+const double* WaveformView::constData() const
+{
+	return mapped ? mapped : samples.constData();
+}
+
+double WaveformView::at(qint64 index) const
+{
+	return constData()[index];
+}
+
+QVector<double> WaveformView::mid(qint64 offset, qint64 count) const
+{
+	auto length = size();
+	if ((offset < 0) || (offset >= length) || (count <= 0))
+		return {};
+	count = qMin(count, length - offset);
+	if (!mapped)
+		return samples.mid(static_cast<int>(offset), static_cast<int>(count));
+	QVector<double> out(static_cast<int>(count));
+	std::memcpy(out.data(), mapped + offset, count * sizeof(double));
+	return out;
+}
+
+QVector<double> WaveformView::toVector() const
+{
+	return mapped ? mid(0, mappedCount) : samples;
+}
+
@@ -0,0 +1,198 @@
+/*! \file blds-client-test.cc
+ *
+ * Tests of the MockBldsServer against the BldsClient library.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "libblds-client/include/blds-client.h"
+
+#include "mock-blds-server.h"
+
+#include <QtTest>
+
+/*! \class BldsClientTest
+ *
+ * The BldsClientTest talks to a MockBldsServer with a BldsClient from
+ * libblds-client, used directly rather than through a BldsSession, and
+ * checks that every kind of request the session makes is understood and
+ * answered. The mock's framing was written without the library's
+ * sources, so these tests are what show the two agree.
+ */
+class BldsClientTest : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds allowed for each request. */
+		const int RequestTimeout = 5000;
+
+	private slots:
+
+		/* Start a server, and connect a client to it. */
+		void init();
+
+		/* Disconnect, and stop the server. */
+		void cleanup();
+
+		/* The status of the server is received whole. */
+		void requestsServerStatus();
+
+		/* A parameter which is set reads back with the same value. */
+		void setsAndGetsParameter();
+
+		/* An unknown parameter is answered with a failure. */
+		void rejectsUnknownParameter();
+
+		/* A source is created, its parameters set, and its status read. */
+		void createsAndConfiguresSource();
+
+		/* Data is read from a recording, in frames of the right shape. */
+		void readsRecordedData();
+
+	private:
+
+		/* Create a source of the given type. */
+		void createSource(const QString& type);
+
+		/*! Server being talked to. */
+		QScopedPointer<MockBldsServer> server;
+
+		/*! Client connected to the server. */
+		QScopedPointer<BldsClient> client;
+};
+
+void BldsClientTest::init()
+{
+	server.reset(new MockBldsServer);
+	QVERIFY2(server->listen(), qPrintable(server->errorString()));
+	client.reset(new BldsClient("localhost"));
+	QSignalSpy connected(client.data(), &BldsClient::connected);
+	client->connect();
+	QVERIFY(connected.wait(RequestTimeout));
+	QVERIFY(connected.first().first().toBool());
+}
+
+void BldsClientTest::cleanup()
+{
+	if (client)
+		client->disconnect();
+	client.reset();
+	server.reset();
+}
+
+void BldsClientTest::createSource(const QString& type)
+{
+	QSignalSpy created(client.data(), &BldsClient::sourceCreated);
+	client->createSource(type, "test");
+	QVERIFY(created.wait(RequestTimeout));
+	QVERIFY2(created.first().first().toBool(),
+			qPrintable(created.first().at(1).toString()));
+}
+
+void BldsClientTest::requestsServerStatus()
+{
+	QSignalSpy status(client.data(), &BldsClient::serverStatus);
+	client->requestServerStatus();
+	QVERIFY(status.wait(RequestTimeout));
+	auto json = status.first().first().toJsonObject();
+	for (auto& param : { "source-exists", "recording-exists",
+			"recording-length", "save-file" })
+		QVERIFY2(json.contains(param), param);
+	QCOMPARE(json.value("recording-exists").toBool(), false);
+}
+
+void BldsClientTest::setsAndGetsParameter()
+{
+	QSignalSpy set(client.data(), &BldsClient::setResponse);
+	client->set("recording-length", 42);
+	QVERIFY(set.wait(RequestTimeout));
+	QCOMPARE(set.first().at(0).toString(), QString("recording-length"));
+	QVERIFY2(set.first().at(1).toBool(), qPrintable(set.first().at(2).toString()));
+
+	QSignalSpy get(client.data(), &BldsClient::getResponse);
+	client->get("recording-length");
+	QVERIFY(get.wait(RequestTimeout));
+	QCOMPARE(get.first().at(0).toString(), QString("recording-length"));
+	QVERIFY(get.first().at(1).toBool());
+	QCOMPARE(get.first().at(2).value<QVariant>().toInt(), 42);
+}
+
+void BldsClientTest::rejectsUnknownParameter()
+{
+	QSignalSpy get(client.data(), &BldsClient::getResponse);
+	client->get("no-such-parameter");
+	QVERIFY(get.wait(RequestTimeout));
+	QCOMPARE(get.first().at(0).toString(), QString("no-such-parameter"));
+	QVERIFY(!get.first().at(1).toBool());
+}
+
+void BldsClientTest::createsAndConfiguresSource()
+{
+	createSource("file");
+	if (QTest::currentTestFailed())
+		return;
+
+	QSignalSpy set(client.data(), &BldsClient::setSourceResponse);
+	client->setSource("adc-range", 1.0);
+	QVERIFY(set.wait(RequestTimeout));
+	QCOMPARE(set.first().at(0).toString(), QString("adc-range"));
+	QVERIFY2(set.first().at(1).toBool(), qPrintable(set.first().at(2).toString()));
+
+	QSignalSpy status(client.data(), &BldsClient::sourceStatus);
+	client->requestSourceStatus();
+	QVERIFY(status.wait(RequestTimeout));
+	QVERIFY(status.first().at(0).toBool());
+	auto json = status.first().at(1).toJsonObject();
+	QCOMPARE(json.value("adc-range").toDouble(), 1.0);
+	QCOMPARE(json.value("nchannels").toInt(), 64);
+
+	QSignalSpy deleted(client.data(), &BldsClient::sourceDeleted);
+	client->deleteSource();
+	QVERIFY(deleted.wait(RequestTimeout));
+	QVERIFY(deleted.first().first().toBool());
+}
+
+void BldsClientTest::readsRecordedData()
+{
+	createSource("hidens");
+	if (QTest::currentTestFailed())
+		return;
+
+	QSignalSpy started(client.data(), &BldsClient::recordingStarted);
+	client->startRecording();
+	QVERIFY(started.wait(RequestTimeout));
+	QVERIFY(started.first().first().toBool());
+	QTest::qWait(200);
+
+	/* Frames are checked as they arrive, so their type need not be
+	 * known to the meta-object system.
+	 */
+	bool received = false, valid = false;
+	qint64 rows = 0, columns = 0;
+	float start = 0., stop = 0.;
+	QObject::connect(client.data(), &BldsClient::dataFrameReceived,
+			this, [&](bool ok, const QString&, const DataFrame& frame) -> void {
+				received = true;
+				valid = ok;
+				if (ok) {
+					rows = static_cast<qint64>(frame.data().n_rows);
+					columns = static_cast<qint64>(frame.data().n_cols);
+					start = frame.start();
+					stop = frame.stop();
+				}
+			});
+	client->requestData(0., 0.1);
+	QTRY_VERIFY_WITH_TIMEOUT(received, RequestTimeout);
+	QVERIFY(valid);
+	QCOMPARE(columns, static_cast<qint64>(126));
+	QCOMPARE(rows, static_cast<qint64>(2000));
+	QCOMPARE(start, 0.f);
+	QCOMPARE(stop, 0.1f);
+
+	QSignalSpy stopped(client.data(), &BldsClient::recordingStopped);
+	client->stopRecording();
+	QVERIFY(stopped.wait(RequestTimeout));
+	QVERIFY(stopped.first().first().toBool());
+}
+
+QTEST_GUILESS_MAIN(BldsClientTest)
+#include "blds-client-test.moc"
@@ -0,0 +1,13 @@
+######################################################################
+# Tests that a BldsClient from libblds-client understands the mock
+# BLDS. The other tests only mean something once these pass.
+######################################################################
+
+TEMPLATE = app
+TARGET = blds-client-test
+CONFIG += testcase
+
+include(../tests.pri)
+include(../session.pri)
+
+SOURCES += blds-client-test.cc
@@ -0,0 +1,79 @@
+/*! \file control-path-benchmark.cc
+ *
+ * Benchmark of the requests meactl makes to the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "blds-benchmark.h"
+#include "mock-blds-server.h"
+
+#include <QtTest>
+
+/*! \class ControlPathBenchmark
+ *
+ * The ControlPathBenchmark runs a BldsBenchmark against a MockBldsServer
+ * in the same process, and fails if any operation of the benchmark
+ * failed. The results are printed as JSON, or written to the file named
+ * by the MEACTL_BENCHMARK_OUTPUT environment variable.
+ *
+ * The benchmark is controlled through the environment, since QtTest
+ * takes the command line:
+ *
+ * 	- MEACTL_BENCHMARK_ITERATIONS, the number of times each operation
+ * 	is repeated, 100 by default.
+ * 	- MEACTL_BENCHMARK_HOST, a BLDS to benchmark instead of the mock
+ * 	server.
+ * 	- MEACTL_MOCK_LATENCY, MEACTL_MOCK_JITTER, MEACTL_MOCK_DROP_RATE and
+ * 	MEACTL_MOCK_ERROR_RATE, the behavior of the mock server, as given
+ * 	to the mock-blds-server tool.
+ */
+class ControlPathBenchmark : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds allowed for the whole benchmark. */
+		const int BenchmarkTimeout = 600000;
+
+	private slots:
+
+		/* Run the benchmark, and report its results. */
+		void benchmark();
+};
+
+void ControlPathBenchmark::benchmark()
+{
+	auto env = QProcessEnvironment::systemEnvironment();
+	QScopedPointer<MockBldsServer> server;
+	auto host = env.value("MEACTL_BENCHMARK_HOST");
+	if (host.isEmpty()) {
+		MockBldsServer::Config config;
+		config.latency = env.value("MEACTL_MOCK_LATENCY", "0").toInt();
+		config.jitter = env.value("MEACTL_MOCK_JITTER", "0").toInt();
+		config.dropRate = env.value("MEACTL_MOCK_DROP_RATE", "0").toDouble();
+		config.errorRate = env.value("MEACTL_MOCK_ERROR_RATE", "0").toDouble();
+		server.reset(new MockBldsServer(config));
+		QVERIFY2(server->listen(), qPrintable(server->errorString()));
+		host = "localhost";
+	}
+
+	BldsBenchmark benchmark(host,
+			env.value("MEACTL_BENCHMARK_ITERATIONS", "100").toInt());
+	QSignalSpy finished(&benchmark, &BldsBenchmark::finished);
+	benchmark.start();
+	QVERIFY(!finished.isEmpty() || finished.wait(BenchmarkTimeout));
+
+	auto json = QJsonDocument(benchmark.results()).toJson();
+	auto output = env.value("MEACTL_BENCHMARK_OUTPUT");
+	if (output.isEmpty()) {
+		QTextStream(stdout) << json;
+	} else {
+		QFile file(output);
+		QVERIFY2(file.open(QIODevice::WriteOnly | QIODevice::Text),
+				qPrintable(file.errorString()));
+		file.write(json);
+	}
+	QVERIFY2(finished.first().first().toBool(), "An operation of the benchmark failed");
+}
+
+QTEST_GUILESS_MAIN(ControlPathBenchmark)
+#include "control-path-benchmark.moc"
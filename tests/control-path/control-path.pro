@@ -0,0 +1,16 @@
+######################################################################
+# Benchmark of the control path between meactl and a mock BLDS.
+######################################################################
+
+TEMPLATE = app
+TARGET = control-path-benchmark
+CONFIG += testcase
+
+include(../tests.pri)
+include(../session.pri)
+
+HEADERS += ../include/blds-benchmark.h \
+		$$MEACTL/include/source-config-transaction.h
+SOURCES += control-path-benchmark.cc \
+		../src/blds-benchmark.cc \
+		$$MEACTL/src/source-config-transaction.cc
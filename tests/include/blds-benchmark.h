@@ -0,0 +1,175 @@
+/*! \file blds-benchmark.h
+ *
+ * Header for the BldsBenchmark class, which measures the performance of
+ * the control path between meactl and the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_BLDS_BENCHMARK_H
+#define MEACTL_BLDS_BENCHMARK_H
+
+#include "blds-session.h"
+#include "latency-recorder.h"
+
+#include <QtCore>
+
+#include <functional>
+
+/*! \class BldsBenchmark
+ *
+ * The BldsBenchmark drives a BldsSession through the operations meactl
+ * performs most, and records how long each takes. It runs four stages
+ * in turn, each repeated a number of times:
+ *
+ * 	- `connect`, the time taken to connect a new session.
+ * 	- `status-refresh`, the round trip time of a status refresh made
+ * 	through BldsSession::getMany(), with several callers refreshing
+ * 	at once, as the widgets of meactl do. The number of refreshes
+ * 	served per second is also reported.
+ * 	- `reconfigure-source`, the time taken to apply a change to several
+ * 	source parameters with a SourceConfigTransaction.
+ * 	- `start-recording` and `stop-recording`, the time from each request
+ * 	to the server's reply.
+ *
+ * A data source is created if there is none, so the benchmark is meant
+ * to be run against a MockBldsServer rather than a rig in use. Results
+ * are reported as JSON, with the latencies of each stage summarized as
+ * by LatencyRecorder::toJson().
+ *
+ * A stage is abandoned if any operation is not answered within
+ * OperationTimeout, e.g., because the server dropped the reply.
+ */
+class BldsBenchmark : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds to wait for each operation. */
+		const int OperationTimeout = 10000;
+
+		/*! Number of callers refreshing the status at once. */
+		const int RefreshCallers = 4;
+
+		/*! Length of the recording made by the start-recording stage,
+		 * long enough never to end on its own, in seconds.
+		 */
+		const int RecordingLength = 3600;
+
+	public:
+
+		/*! Construct a BldsBenchmark.
+		 *
+		 * \param hostname The hostname or IP address of the BLDS.
+		 * \param iterations Number of times each operation is repeated.
+		 * \param parent The parent object.
+		 */
+		BldsBenchmark(const QString& hostname, int iterations,
+				QObject* parent = nullptr);
+
+		/*! Destroy a BldsBenchmark. */
+		~BldsBenchmark();
+
+		/* Copying is not allowed. */
+		BldsBenchmark(const BldsBenchmark&) = delete;
+		BldsBenchmark(BldsBenchmark&&) = delete;
+		BldsBenchmark& operator=(const BldsBenchmark&) = delete;
+
+		/*! Return the results of the benchmark as a JSON object. */
+		QJsonObject results() const;
+
+	public slots:
+
+		/*! Run the benchmark. finished() is emitted when it is done. */
+		void start();
+
+	signals:
+
+		/*! Emitted when all stages have run.
+		 *
+		 * \param success True if every operation succeeded.
+		 */
+		void finished(bool success);
+
+	private:
+
+		/* Stages of the benchmark. Each runs one iteration, repeating
+		 * itself until all have run, then calls nextStage().
+		 */
+		void measureConnect(int iteration);
+		void measureReconfiguration(int iteration);
+		void measureStartStop(int iteration);
+
+		/* Start the status refresh stage, in which several callers
+		 * refresh the status until enough refreshes are served.
+		 */
+		void measureStatusRefresh();
+
+		/* Make one status refresh, making another once it is served. */
+		void refreshStatus();
+
+		/* Connect the session used by all stages after the first,
+		 * and create a data source for them.
+		 */
+		void prepare();
+
+		/* Run the next stage, or finish if none remain. */
+		void nextStage();
+
+		/* Note a failed operation of a stage. */
+		void fail(const QString& stage, const QString& msg);
+
+		/* Wait for an operation, abandoning its stage after a timeout. */
+		void expect(const QString& stage);
+
+		/* Note that the awaited operation has completed. */
+		void complete();
+
+		/* Return the microseconds elapsed since the operation started. */
+		qint64 elapsed() const;
+
+		/*! Hostname or IP address of the BLDS. */
+		QString host;
+
+		/*! Number of times each operation is repeated. */
+		int iterations;
+
+		/*! Session used by all stages after the first. */
+		BldsSession* session;
+
+		/*! Recorder of the time taken by each operation. */
+		LatencyRecorder* recorder;
+
+		/*! Stages yet to run, in order. */
+		QQueue<std::function<void()>> stages;
+
+		/*! Number of the running stage. Replies to operations of an
+		 * abandoned stage are ignored.
+		 */
+		quint64 currentStage;
+
+		/*! Name of the stage whose operation is awaited. */
+		QString awaitedStage;
+
+		/*! Fires if an operation is not completed in time. */
+		QTimer* watchdog;
+
+		/*! Measures the time taken by the current operation. */
+		QElapsedTimer timer;
+
+		/*! Called with the result of the awaited connection, source
+		 * creation, or start or stop request.
+		 */
+		std::function<void(bool, const QString&)> pendingReply;
+
+		/*! Number of status refreshes made and served, and the time taken. */
+		int refreshesIssued;
+		int refreshes;
+		QElapsedTimer refreshTimer;
+		qint64 refreshDuration;
+
+		/*! Number of failed operations, and the last error, by stage. */
+		QMap<QString, int> failures;
+		QMap<QString, QString> errors;
+};
+
+#endif
+
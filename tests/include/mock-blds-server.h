@@ -0,0 +1,239 @@
+/*! \file mock-blds-server.h
+ *
+ * Header for the MockBldsServer class, a local stand-in for the BLDS.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#ifndef MEACTL_MOCK_BLDS_SERVER_H
+#define MEACTL_MOCK_BLDS_SERVER_H
+
+#include <QtCore>
+#include <QtNetwork>
+
+#include <random>
+
+/*! \class MockBldsServer
+ *
+ * The MockBldsServer accepts connections from BldsClient objects and
+ * answers their requests as the BLDS would, without any data source
+ * hardware. It keeps the server's state, i.e., whether a source and
+ * recording exist, the recording's length, position and file, and the
+ * source's parameters, so that meactl can be run and benchmarked offline.
+ *
+ * Replies are delayed by a configurable latency plus uniform jitter, while
+ * keeping the order of replies on each connection. A fraction of replies
+ * can be dropped, and a fraction of requests can be failed with an error,
+ * to exercise timeouts and error handling. The server can also act as an
+ * older one, rejecting subscriptions to the recording's status, or accept
+ * subscriptions but stop pushing updates or push only that a recording
+ * exists, to exercise the fallbacks of the RecordingStatusMonitor.
+ *
+ * Data requested from a recording is noise with occasional spikes on
+ * every channel, which depends only on the channel and the time of each
+ * sample, and is sent base64-encoded, one channel after another. A
+ * HiDens source has as many channels, at the same rate, as the real
+ * array reads out.
+ *
+ * Each message is framed by its size as a 32-bit integer in network
+ * byte order, followed by the message type and its fields, each
+ * terminated by a newline, with fields sent as single-line JSON. This
+ * framing was written without the libblds-client sources, so the
+ * blds-client test checks it against a real BldsClient, and the results
+ * of the other tests only count once that test passes. All framing is
+ * done by encodeMessage() and decodeMessage().
+ *
+ * The server is built only with the tests, see tests/tests.pro, and is
+ * not part of meactl itself.
+ */
+class MockBldsServer : public QObject {
+	Q_OBJECT
+
+	public:
+
+		/*! Port on which the BLDS listens for clients. */
+		static const quint16 DefaultPort = 12345;
+
+		/*! Behavior of the server's replies. */
+		struct Config {
+
+			/*! Delay before each reply, in milliseconds. */
+			int latency = 0;
+
+			/*! Largest random delay added to each reply, in milliseconds. */
+			int jitter = 0;
+
+			/*! Probability that a reply is never sent. */
+			double dropRate = 0;
+
+			/*! Probability that a request fails with an injected error. */
+			double errorRate = 0;
+
+			/*! Whether clients may subscribe to the recording's status. */
+			bool acceptSubscriptions = true;
+
+			/*! Whether subscribed clients are sent the recording's status. */
+			bool pushUpdates = true;
+
+			/*! Whether the status pushed during a recording is its
+			 * position, rather than only that it exists.
+			 */
+			bool pushPosition = true;
+		};
+
+		/*! Construct a MockBldsServer. It does not listen until started.
+		 *
+		 * \param config The behavior of the server's replies.
+		 * \param parent The parent object.
+		 */
+		MockBldsServer(const Config& config = Config(), QObject* parent = nullptr);
+
+		/*! Destroy a MockBldsServer, closing all connections. */
+		~MockBldsServer();
+
+		/* Copying is not allowed. */
+		MockBldsServer(const MockBldsServer&) = delete;
+		MockBldsServer(MockBldsServer&&) = delete;
+		MockBldsServer& operator=(const MockBldsServer&) = delete;
+
+		/*! Start listening for clients.
+		 *
+		 * \param port The port on which to listen.
+		 * \return True if listening, else false.
+		 */
+		bool listen(quint16 port = DefaultPort);
+
+		/*! Return a description of the last error. */
+		QString errorString() const;
+
+		/*! Return the behavior of the server's replies. */
+		Config config() const;
+
+		/*! Set the behavior of the server's replies. */
+		void setConfig(const Config& config);
+
+		/*! Return the number of requests handled. */
+		qint64 requestCount() const;
+
+		/*! Encode a message as sent over the wire.
+		 *
+		 * \param type The type of the message, e.g., `get`.
+		 * \param fields The fields of the message.
+		 */
+		static QByteArray encodeMessage(const QString& type, const QVariantList& fields);
+
+		/*! Decode one message from the front of a buffer, removing it.
+		 *
+		 * \param buffer Bytes received, from which the message is removed.
+		 * \param type Set to the type of the message.
+		 * \param fields Set to the fields of the message.
+		 * \return True if a whole message was available, else false.
+		 */
+		static bool decodeMessage(QByteArray& buffer, QString* type, QVariantList* fields);
+
+	private slots:
+
+		/* Accept new clients. */
+		void acceptConnections();
+
+		/* Read and handle requests from a client. */
+		void readRequests(QTcpSocket* socket);
+
+		/* Push the recording's status to subscribed clients. */
+		void pushStatus();
+
+	private:
+
+		/* Handle a single request, returning its replies. */
+		QList<QByteArray> handle(const QString& type, const QVariantList& fields,
+				QTcpSocket* socket);
+
+		/* Return the reply failing a request with an injected error, or
+		 * an empty array if the request cannot fail.
+		 */
+		static QByteArray injectedError(const QString& type, const QVariantList& fields);
+
+		/* Handle requests to get, set and set source parameters. */
+		QByteArray handleGet(const QString& param);
+		QByteArray handleSet(const QString& param, const QVariant& value,
+				QTcpSocket* socket);
+		QByteArray handleSetSource(const QString& param, const QVariant& value);
+
+		/* Handle a request for the data recorded between two times. */
+		QByteArray handleGetData(double start, double stop);
+
+		/* Return the status of the server and source. */
+		QJsonObject serverStatus();
+		QJsonObject sourceStatus() const;
+
+		/* Update the recording, ending it once its length is reached. */
+		void updateRecording();
+
+		/* Return the position of the recording in seconds. */
+		double recordingPosition() const;
+
+		/* Restart the push timer at the shortest subscribed interval. */
+		void updatePushTimer();
+
+		/* Send a reply after the configured delay, after any earlier
+		 * replies to the same client.
+		 */
+		void reply(QTcpSocket* socket, const QByteArray& message);
+
+		/* Forget a client which has disconnected. */
+		void removeClient(QTcpSocket* socket);
+
+		/* Return true with the given probability. */
+		bool chance(double probability);
+
+		/*! Listens for clients. */
+		QTcpServer* server;
+
+		/*! Behavior of the server's replies. */
+		Config settings;
+
+		/*! Buffered bytes received from each client. */
+		QHash<QTcpSocket*, QByteArray> buffers;
+
+		/*! Time at which the last reply to each client is due, used
+		 * to keep replies in order.
+		 */
+		QHash<QTcpSocket*, qint64> lastReplyDue;
+
+		/*! Interval at which each subscribed client is pushed the status
+		 * of the recording, in milliseconds.
+		 */
+		QHash<QTcpSocket*, int> subscriptions;
+
+		/*! Timer driving pushed status updates. */
+		QTimer* pushTimer;
+
+		/*! Clock used to schedule replies. */
+		QElapsedTimer clock;
+
+		/*! Random number generator for jitter, drops and errors. */
+		std::mt19937 generator;
+
+		/*! Number of requests handled. */
+		qint64 requests;
+
+		/*! State of the server and its source. */
+		bool sourceExists;
+		QString sourceType;
+		QString sourceLocation;
+		bool recordingExists;
+		int recordingLength;
+		QElapsedTimer recordingTimer;
+		bool recordingEndPending;
+		QString saveDirectory;
+		QString saveFile;
+		QVariantMap sourceParameters;
+
+		/*! State of an upload of the analog output in chunks. */
+		bool uploading;
+		qint64 uploadExpected;
+		qint64 uploadReceived;
+};
+
+#endif
+
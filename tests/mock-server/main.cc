@@ -0,0 +1,46 @@
+/*! \file main.cc
+ *
+ * Runs a MockBldsServer until interrupted.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "mock-blds-server.h"
+
+/*! \fn * Main entry point for the mock BLDS.
+ *
+ * This listens for clients on the given port, replying as described by
+ * the options, until interrupted. meactl may then be used without a rig
+ * by connecting it to this host.
+ */
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mock-blds-server");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Run a mock BLDS, without any hardware.");
+	parser.addHelpOption();
+	parser.addOption({ "port", "Port on which to listen.", "port",
+			QString::number(MockBldsServer::DefaultPort) });
+	parser.addOption({ "latency", "Delay before each reply.", "ms", "0" });
+	parser.addOption({ "jitter", "Largest random delay added to each reply.",
+			"ms", "0" });
+	parser.addOption({ "drop-rate", "Probability that a reply is never sent.",
+			"p", "0" });
+	parser.addOption({ "error-rate", "Probability that a request fails.",
+			"p", "0" });
+	parser.process(app);
+
+	MockBldsServer::Config config;
+	config.latency = parser.value("latency").toInt();
+	config.jitter = parser.value("jitter").toInt();
+	config.dropRate = parser.value("drop-rate").toDouble();
+	config.errorRate = parser.value("error-rate").toDouble();
+	MockBldsServer server(config);
+	if (!server.listen(parser.value("port").toUShort())) {
+		QTextStream(stderr) << "Could not listen: " << server.errorString() << endl;
+		return 1;
+	}
+	return app.exec();
+}
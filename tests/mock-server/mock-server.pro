@@ -0,0 +1,11 @@
+######################################################################
+# A local stand-in for the BLDS, for running meactl offline.
+######################################################################
+
+TEMPLATE = app
+TARGET = mock-blds-server
+
+include(../tests.pri)
+include(../session.pri)
+
+SOURCES += main.cc
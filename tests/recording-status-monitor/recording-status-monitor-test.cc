@@ -0,0 +1,217 @@
+/*! \file recording-status-monitor-test.cc
+ *
+ * Tests of the RecordingStatusMonitor class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "mock-blds-server.h"
+#include "recording-status-monitor.h"
+
+#include <QtTest>
+
+#include <memory>
+
+/*! \class RecordingStatusMonitorTest
+ *
+ * The RecordingStatusMonitorTest follows recordings on a MockBldsServer
+ * with a RecordingStatusMonitor, checking that it takes pushed updates
+ * from a server which offers them, and polls a server which does not or
+ * which stops pushing them.
+ */
+class RecordingStatusMonitorTest : public QObject {
+	Q_OBJECT
+
+		/*! Time in milliseconds allowed for each request. */
+		const int RequestTimeout = 5000;
+
+		/*! Time in milliseconds without a pushed update after which the
+		 * monitor should poll, as RecordingStatusMonitor uses.
+		 */
+		const int SubscriptionTimeout = 2000;
+
+		/*! Interval in milliseconds at which the monitor should poll, as
+		 * RecordingStatusMonitor uses.
+		 */
+		const int PollInterval = 1000;
+
+	private slots:
+
+		/* Start a server, and connect a session to it. */
+		void init();
+
+		/* Disconnect, and stop the server. */
+		void cleanup();
+
+		/* A server accepting the subscription pushes the position, and
+		 * the end of the recording, without being polled.
+		 */
+		void followsPushedUpdates();
+
+		/* A subscription which stops receiving updates is abandoned for
+		 * polling once the watchdog fires.
+		 */
+		void pollsWhenUpdatesStop();
+
+		/* Pushed updates of whether the recording exists keep the
+		 * subscription alive, without any of its position.
+		 */
+		void staysSubscribedWithoutPosition();
+
+		/* A server rejecting the subscription is polled at once. */
+		void pollsWhenSubscriptionRejected();
+
+	private:
+
+		/* Create a source, and start a recording of the given length in
+		 * seconds.
+		 */
+		void startRecording(int length);
+
+		/*! Server being monitored. */
+		QScopedPointer<MockBldsServer> server;
+
+		/*! Session connected to the server. */
+		QScopedPointer<BldsSession> session;
+};
+
+void RecordingStatusMonitorTest::init()
+{
+	server.reset(new MockBldsServer);
+	QVERIFY2(server->listen(), qPrintable(server->errorString()));
+	session.reset(new BldsSession("localhost"));
+	QSignalSpy connected(session.data(), &BldsSession::connected);
+	session->connectToServer();
+	QVERIFY(connected.wait(RequestTimeout));
+	QVERIFY(connected.first().first().toBool());
+}
+
+void RecordingStatusMonitorTest::cleanup()
+{
+	if (session)
+		session->disconnectFromServer();
+	session.reset();
+	server.reset();
+}
+
+void RecordingStatusMonitorTest::startRecording(int length)
+{
+	QSignalSpy created(session.data(), &BldsSession::sourceCreated);
+	session->createSource("file", "test");
+	QVERIFY(created.wait(RequestTimeout));
+	QVERIFY(created.first().first().toBool());
+
+	auto lengthSet = std::make_shared<bool>(false);
+	session->set("recording-length", length,
+			[lengthSet](bool success, const QString&) -> void {
+				*lengthSet = success;
+			}, RequestTimeout);
+	QTRY_VERIFY_WITH_TIMEOUT(*lengthSet, RequestTimeout);
+
+	QSignalSpy started(session.data(), &BldsSession::recordingStarted);
+	session->startRecording();
+	QVERIFY(started.wait(RequestTimeout));
+	QVERIFY(started.first().first().toBool());
+}
+
+void RecordingStatusMonitorTest::followsPushedUpdates()
+{
+	startRecording(2);
+	if (QTest::currentTestFailed())
+		return;
+
+	RecordingStatusMonitor monitor(session.data());
+	QSignalSpy positions(&monitor, &RecordingStatusMonitor::positionChanged);
+	QSignalSpy ended(&monitor, &RecordingStatusMonitor::recordingEnded);
+	monitor.start();
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Subscribing);
+	QTRY_VERIFY_WITH_TIMEOUT(monitor.mode() ==
+			RecordingStatusMonitor::Mode::Subscribed, RequestTimeout);
+
+	/* Updates are pushed far more often than the server would be polled. */
+	QTest::qWait(PollInterval);
+	QVERIFY(positions.count() > 2);
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Subscribed);
+	QVERIFY(positions.last().first().toDouble() >= positions.first().first().toDouble());
+
+	QTRY_COMPARE_WITH_TIMEOUT(ended.count(), 1, RequestTimeout);
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Idle);
+}
+
+void RecordingStatusMonitorTest::pollsWhenUpdatesStop()
+{
+	startRecording(60);
+	if (QTest::currentTestFailed())
+		return;
+
+	RecordingStatusMonitor monitor(session.data());
+	QSignalSpy positions(&monitor, &RecordingStatusMonitor::positionChanged);
+	monitor.start();
+	QTRY_VERIFY_WITH_TIMEOUT(!positions.isEmpty(), RequestTimeout);
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Subscribed);
+
+	/* Once pushes stop, the monitor waits out the watchdog, then polls. */
+	auto config = server->config();
+	config.pushUpdates = false;
+	server->setConfig(config);
+	QElapsedTimer timer;
+	timer.start();
+	QTRY_VERIFY_WITH_TIMEOUT(monitor.mode() ==
+			RecordingStatusMonitor::Mode::Polling, 2 * SubscriptionTimeout);
+	QVERIFY(timer.elapsed() >= SubscriptionTimeout / 2);
+
+	positions.clear();
+	QTRY_VERIFY_WITH_TIMEOUT(!positions.isEmpty(), 2 * PollInterval);
+	QVERIFY(positions.last().first().toDouble() > 0.);
+	monitor.stop();
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Idle);
+}
+
+void RecordingStatusMonitorTest::staysSubscribedWithoutPosition()
+{
+	auto config = server->config();
+	config.pushPosition = false;
+	server->setConfig(config);
+	startRecording(60);
+	if (QTest::currentTestFailed())
+		return;
+
+	RecordingStatusMonitor monitor(session.data());
+	monitor.start();
+	QTRY_VERIFY_WITH_TIMEOUT(monitor.mode() ==
+			RecordingStatusMonitor::Mode::Subscribed, RequestTimeout);
+
+	/* The watchdog would have fired twice over, were it not reset. */
+	int changes = 0;
+	QObject::connect(&monitor, &RecordingStatusMonitor::modeChanged,
+			this, [&changes]() -> void { changes++; });
+	QTest::qWait(2 * SubscriptionTimeout);
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Subscribed);
+	QCOMPARE(changes, 0);
+	monitor.stop();
+}
+
+void RecordingStatusMonitorTest::pollsWhenSubscriptionRejected()
+{
+	auto config = server->config();
+	config.acceptSubscriptions = false;
+	server->setConfig(config);
+	startRecording(2);
+	if (QTest::currentTestFailed())
+		return;
+
+	RecordingStatusMonitor monitor(session.data());
+	QSignalSpy positions(&monitor, &RecordingStatusMonitor::positionChanged);
+	QSignalSpy ended(&monitor, &RecordingStatusMonitor::recordingEnded);
+	monitor.start();
+
+	/* The rejection arrives long before the watchdog would fire. */
+	QTRY_VERIFY_WITH_TIMEOUT(monitor.mode() ==
+			RecordingStatusMonitor::Mode::Polling, SubscriptionTimeout / 2);
+	QTRY_VERIFY_WITH_TIMEOUT(!positions.isEmpty(), 2 * PollInterval);
+	QTRY_COMPARE_WITH_TIMEOUT(ended.count(), 1, RequestTimeout);
+	QVERIFY(monitor.mode() == RecordingStatusMonitor::Mode::Idle);
+}
+
+QTEST_GUILESS_MAIN(RecordingStatusMonitorTest)
+#include "recording-status-monitor-test.moc"
@@ -0,0 +1,14 @@
+######################################################################
+# Tests of the RecordingStatusMonitor against a mock BLDS.
+######################################################################
+
+TEMPLATE = app
+TARGET = recording-status-monitor-test
+CONFIG += testcase
+
+include(../tests.pri)
+include(../session.pri)
+
+HEADERS += $$MEACTL/include/recording-status-monitor.h
+SOURCES += recording-status-monitor-test.cc \
+		$$MEACTL/src/recording-status-monitor.cc
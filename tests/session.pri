@@ -0,0 +1,33 @@
+######################################################################
+# The session and the mock BLDS, for projects which talk to a server.
+#
+# Include after tests.pri.
+######################################################################
+
+INCLUDEPATH += $$MEACTL/../ \
+	$$MEACTL/../libblds-client/include \
+	/usr/local/include
+
+LIBS += -L$$MEACTL/../libblds-client/lib -L/usr/local/lib
+
+QMAKE_RPATHDIR += $$MEACTL/../libblds-client/lib
+
+win32 {
+	LIBS += -lblds-client0
+} else {
+	LIBS += -lblds-client
+}
+
+HEADERS += $$PWD/include/mock-blds-server.h \
+		$$MEACTL/include/blds-session.h \
+		$$MEACTL/include/data-chunk.h \
+		$$MEACTL/include/latency-histogram.h \
+		$$MEACTL/include/latency-recorder.h \
+		$$MEACTL/include/stimulus-cache.h \
+		$$MEACTL/include/waveform-view.h
+SOURCES += $$PWD/src/mock-blds-server.cc \
+		$$MEACTL/src/blds-session.cc \
+		$$MEACTL/src/latency-histogram.cc \
+		$$MEACTL/src/latency-recorder.cc \
+		$$MEACTL/src/stimulus-cache.cc \
+		$$MEACTL/src/waveform-view.cc
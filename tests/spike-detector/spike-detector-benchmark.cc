@@ -0,0 +1,160 @@
+/*! \file spike-detector-benchmark.cc
+ *
+ * Benchmark of the SpikeDetector class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "spike-detector.h"
+
+#include <QtTest>
+
+#include <cmath>
+
+/*! \class SpikeDetectorBenchmark
+ *
+ * The SpikeDetectorBenchmark runs a SpikeDetector over chunks of
+ * synthetic data, checking that it finds the spikes in them and
+ * measuring how fast it does so. Each test is run on data shaped like
+ * that of a HiDens source, and on data from many more channels. The rate
+ * is reported as samples per second and as a multiple of real time, but
+ * is not checked, as it depends on the machine.
+ */
+class SpikeDetectorBenchmark : public QObject {
+	Q_OBJECT
+
+		/*! Sample rate of the data, in Hz. */
+		const int SampleRate = 20000;
+
+		/*! Number of samples of each channel in each chunk. */
+		const int ChunkFrames = 2000;
+
+		/*! Number of samples between spikes on each channel. */
+		const int SpikeInterval = 400;
+
+		/*! Number of samples in each spike. */
+		const int SpikeLength = 20;
+
+	private slots:
+
+		/* Every channel has spikes once the noise has been estimated. */
+		void detectsSpikes_data();
+		void detectsSpikes();
+
+		/* Measure the time taken to process a chunk. */
+		void process_data();
+		void process();
+
+	private:
+
+		/* Add a row for each shape of data to the current test. */
+		void addShapes();
+
+		/* Make a chunk of synthetic data with the given number of
+		 * channels.
+		 */
+		DataChunk makeChunk(int channels) const;
+
+		/* Set the time spanned by a chunk to that of the given chunk
+		 * of a recording.
+		 */
+		void setChunkIndex(DataChunk& chunk, int index) const;
+};
+
+void SpikeDetectorBenchmark::addShapes()
+{
+	/* A HiDens source reads out 126 electrodes at a time. */
+	QTest::addColumn<int>("channels");
+	QTest::newRow("hidens") << 126;
+	QTest::newRow("1024-channels") << 1024;
+}
+
+DataChunk SpikeDetectorBenchmark::makeChunk(int channels) const
+{
+	/* Every channel holds noise, with a spike every SpikeInterval
+	 * samples, like the data sent by the MockBldsServer. The spikes of
+	 * each channel are offset from those of the others.
+	 */
+	DataChunk chunk;
+	chunk.channels = channels;
+	chunk.frames = ChunkFrames;
+	chunk.samples.resize(channels * ChunkFrames);
+	quint32 seed = 1;
+	for (int c = 0; c < channels; c++) {
+		auto x = chunk.samples.data() + c * ChunkFrames;
+		for (int i = 0; i < ChunkFrames; i++) {
+			seed = seed * 1664525u + 1013904223u;
+			x[i] = static_cast<qint16>(static_cast<int>(seed >> 24) - 128);
+		}
+		for (int i = (c * 7) % SpikeInterval; i + SpikeLength <= ChunkFrames;
+				i += SpikeInterval) {
+			for (int j = 0; j < SpikeLength; j++)
+				x[i + j] = static_cast<qint16>(x[i + j] -
+						150 * (SpikeLength / 2 - std::abs(j - SpikeLength / 2)));
+		}
+	}
+	setChunkIndex(chunk, 0);
+	return chunk;
+}
+
+void SpikeDetectorBenchmark::setChunkIndex(DataChunk& chunk, int index) const
+{
+	chunk.start = static_cast<float>(index) * ChunkFrames / SampleRate;
+	chunk.stop = static_cast<float>(index + 1) * ChunkFrames / SampleRate;
+}
+
+void SpikeDetectorBenchmark::detectsSpikes_data()
+{
+	addShapes();
+}
+
+void SpikeDetectorBenchmark::detectsSpikes()
+{
+	QFETCH(int, channels);
+	auto chunk = makeChunk(channels);
+
+	/* No spike is reported until the first chunk has been seen. */
+	SpikeDetector detector(channels, SampleRate);
+	for (int i = 0; i < 3; i++) {
+		setChunkIndex(chunk, i);
+		QVERIFY(detector.process(chunk));
+		QCOMPARE(detector.counts().size(), channels);
+	}
+	for (int c = 0; c < channels; c++) {
+		QVERIFY2(detector.threshold(c) > 0,
+				qPrintable(QString("No threshold on channel %1").arg(c)));
+		QVERIFY2(detector.counts()[c] > 0,
+				qPrintable(QString("No spikes on channel %1").arg(c)));
+	}
+}
+
+void SpikeDetectorBenchmark::process_data()
+{
+	addShapes();
+}
+
+void SpikeDetectorBenchmark::process()
+{
+	QFETCH(int, channels);
+	auto chunk = makeChunk(channels);
+	SpikeDetector detector(channels, SampleRate);
+	detector.process(chunk);
+
+	int index = 1;
+	QElapsedTimer timer;
+	timer.start();
+	QBENCHMARK {
+		setChunkIndex(chunk, index++);
+		detector.process(chunk);
+	}
+	auto nsecs = timer.nsecsElapsed();
+
+	auto samples = static_cast<double>(index - 1) * channels * ChunkFrames;
+	auto samplesPerSecond = (nsecs > 0) ? (samples * 1e9 / nsecs) : 0.;
+	qInfo("%d channels at %d Hz: %.3g samples per second, %.1f times real time",
+			channels, SampleRate, samplesPerSecond,
+			samplesPerSecond / (static_cast<double>(channels) * SampleRate));
+}
+
+QTEST_GUILESS_MAIN(SpikeDetectorBenchmark)
+#include "spike-detector-benchmark.moc"
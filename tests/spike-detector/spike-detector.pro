@@ -0,0 +1,15 @@
+######################################################################
+# Benchmark of the SpikeDetector, on synthetic data. No server is
+# needed.
+######################################################################
+
+TEMPLATE = app
+TARGET = spike-detector-benchmark
+CONFIG += testcase
+
+include(../tests.pri)
+
+HEADERS += $$MEACTL/include/data-chunk.h \
+		$$MEACTL/include/spike-detector.h
+SOURCES += spike-detector-benchmark.cc \
+		$$MEACTL/src/spike-detector.cc
@@ -0,0 +1,294 @@
+/*! \file blds-benchmark.cc
+ *
+ * Implementation of the BldsBenchmark class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "blds-benchmark.h"
+#include "source-config-transaction.h"
+
+BldsBenchmark::BldsBenchmark(const QString& hostname, int n, QObject* parent) :
+	QObject(parent),
+	host(hostname),
+	iterations(qMax(n, 1)),
+	currentStage(0),
+	refreshesIssued(0),
+	refreshes(0),
+	refreshDuration(0)
+{
+	recorder = new LatencyRecorder(this);
+	session = new BldsSession(host, this);
+
+	/* Every reply awaited through pendingReply is taken before the
+	 * handler runs, since the handler may await the next one.
+	 */
+	auto dispatch = [this](bool success, const QString& msg) -> void {
+		auto handler = std::move(pendingReply);
+		pendingReply = nullptr;
+		if (handler)
+			handler(success, msg);
+	};
+	QObject::connect(session, &BldsSession::connected,
+			this, [dispatch](bool made) -> void {
+				dispatch(made, "Could not connect to the BLDS");
+			});
+	QObject::connect(session, &BldsSession::sourceCreated, this, dispatch);
+	QObject::connect(session, &BldsSession::recordingStarted, this, dispatch);
+	QObject::connect(session, &BldsSession::recordingStopped, this, dispatch);
+
+	watchdog = new QTimer(this);
+	watchdog->setSingleShot(true);
+	watchdog->setInterval(OperationTimeout);
+	QObject::connect(watchdog, &QTimer::timeout,
+			this, [this]() -> void {
+				pendingReply = nullptr;
+				fail(awaitedStage, QString("No reply within %1 ms").arg(OperationTimeout));
+				nextStage();
+			});
+}
+
+BldsBenchmark::~BldsBenchmark()
+{
+}
+
+void BldsBenchmark::start()
+{
+	stages.clear();
+	stages.enqueue([this]() -> void { measureConnect(0); });
+	stages.enqueue([this]() -> void { prepare(); });
+	stages.enqueue([this]() -> void { measureStatusRefresh(); });
+	stages.enqueue([this]() -> void { measureReconfiguration(0); });
+	stages.enqueue([this]() -> void { measureStartStop(0); });
+	nextStage();
+}
+
+void BldsBenchmark::nextStage()
+{
+	currentStage++;
+	watchdog->stop();
+	if (stages.isEmpty()) {
+		session->disconnectFromServer();
+		emit finished(failures.isEmpty());
+		return;
+	}
+	auto stage = stages.dequeue();
+	stage();
+}
+
+void BldsBenchmark::fail(const QString& stage, const QString& msg)
+{
+	failures[stage]++;
+	errors.insert(stage, msg);
+}
+
+void BldsBenchmark::expect(const QString& stage)
+{
+	awaitedStage = stage;
+	watchdog->start();
+	timer.start();
+}
+
+void BldsBenchmark::complete()
+{
+	watchdog->stop();
+}
+
+qint64 BldsBenchmark::elapsed() const
+{
+	return timer.nsecsElapsed() / 1000;
+}
+
+void BldsBenchmark::measureConnect(int iteration)
+{
+	if (iteration >= iterations) {
+		nextStage();
+		return;
+	}
+
+	/* Each iteration connects a new session, as meactl does when
+	 * the user clicks "Connect".
+	 */
+	auto stage = currentStage;
+	auto connecting = new BldsSession(host, this);
+	QObject::connect(connecting, &BldsSession::connected,
+			this, [this, stage, connecting, iteration](bool made) -> void {
+				connecting->disconnectFromServer();
+				connecting->deleteLater();
+				if (stage != currentStage)
+					return;
+				complete();
+				if (made)
+					recorder->record("connect", elapsed());
+				else
+					fail("connect", "Could not connect to the BLDS");
+				measureConnect(iteration + 1);
+			});
+	expect("connect");
+	connecting->connectToServer();
+}
+
+void BldsBenchmark::prepare()
+{
+	pendingReply = [this](bool made, const QString& msg) -> void {
+		complete();
+		if (!made) {
+
+			/* No later stage can run without a connection. */
+			fail("prepare", msg);
+			stages.clear();
+			nextStage();
+			return;
+		}
+
+		/* The source may already exist, in which case it is used as is. */
+		pendingReply = [this](bool, const QString&) -> void {
+			complete();
+			auto stage = currentStage;
+			session->set("recording-length", RecordingLength,
+					[this, stage](bool success, const QString& msg) -> void {
+						if (stage != currentStage)
+							return;
+						complete();
+						if (!success)
+							fail("prepare", msg);
+						nextStage();
+					}, OperationTimeout);
+			expect("prepare");
+		};
+		expect("prepare");
+		session->createSource("file", "benchmark");
+	};
+	expect("prepare");
+	session->connectToServer();
+}
+
+void BldsBenchmark::measureStatusRefresh()
+{
+	refreshes = 0;
+	refreshesIssued = 0;
+	refreshTimer.start();
+	expect("status-refresh");
+	for (int i = 0; i < qMin(RefreshCallers, iterations); i++)
+		refreshStatus();
+}
+
+void BldsBenchmark::refreshStatus()
+{
+	auto stage = currentStage;
+	auto sent = refreshTimer.nsecsElapsed();
+	refreshesIssued++;
+	session->getMany({ "recording-exists", "recording-position", "source-exists" },
+			[this, stage, sent](const QVariantMap& values) -> void {
+				if (stage != currentStage)
+					return;
+				if (values.isEmpty()) {
+					fail("status-refresh", "The status was not received");
+				} else {
+					recorder->record("status-refresh",
+							(refreshTimer.nsecsElapsed() - sent) / 1000);
+				}
+				refreshes++;
+				watchdog->start();
+				if (refreshes == iterations) {
+					refreshDuration = refreshTimer.elapsed();
+					nextStage();
+				} else if (refreshesIssued < iterations) {
+					refreshStatus();
+				}
+			});
+}
+
+void BldsBenchmark::measureReconfiguration(int iteration)
+{
+	if (iteration >= iterations) {
+		nextStage();
+		return;
+	}
+
+	/* Alternate between two configurations, so that every
+	 * iteration changes each parameter.
+	 */
+	auto even = (iteration % 2) == 0;
+	auto transaction = new SourceConfigTransaction(session, this);
+	transaction->stage("adc-range", even ? 1.0 : 0.5, even ? 0.5 : 1.0);
+	transaction->stage("trigger", even ? "photodiode" : "none",
+			even ? "none" : "photodiode");
+
+	auto stage = currentStage;
+	QObject::connect(transaction, &SourceConfigTransaction::finished,
+			this, [this, stage, transaction, iteration](bool committed,
+				const QMap<QString, QString>& errors) -> void {
+				transaction->deleteLater();
+				if (stage != currentStage)
+					return;
+				complete();
+				if (committed) {
+					recorder->record("reconfigure-source", elapsed());
+				} else {
+					fail("reconfigure-source",
+							QStringList(errors.values()).join("; "));
+				}
+				measureReconfiguration(iteration + 1);
+			});
+	expect("reconfigure-source");
+	transaction->apply(OperationTimeout);
+}
+
+void BldsBenchmark::measureStartStop(int iteration)
+{
+	if (iteration >= iterations) {
+		nextStage();
+		return;
+	}
+
+	pendingReply = [this, iteration](bool success, const QString& msg) -> void {
+		complete();
+		if (!success) {
+			fail("start-recording", msg);
+			measureStartStop(iteration + 1);
+			return;
+		}
+		recorder->record("start-recording", elapsed());
+
+		pendingReply = [this, iteration](bool success, const QString& msg) -> void {
+			complete();
+			if (success)
+				recorder->record("stop-recording", elapsed());
+			else
+				fail("stop-recording", msg);
+			measureStartStop(iteration + 1);
+		};
+		expect("stop-recording");
+		session->stopRecording();
+	};
+	expect("start-recording");
+	session->startRecording();
+}
+
+QJsonObject BldsBenchmark::results() const
+{
+	QJsonObject failed;
+	for (auto it = failures.cbegin(); it != failures.cend(); ++it) {
+		failed.insert(it.key(), QJsonObject {
+				{ "count", it.value() },
+				{ "last-error", errors.value(it.key()) }
+			});
+	}
+	auto perSecond = (refreshDuration > 0) ?
+		(refreshes * 1000. / refreshDuration) : 0.;
+	return QJsonObject {
+		{ "host", host },
+		{ "iterations", iterations },
+		{ "latency", recorder->toJson() },
+		{ "status-refresh", QJsonObject {
+				{ "refreshes", refreshes },
+				{ "callers", qMin(RefreshCallers, iterations) },
+				{ "duration-ms", refreshDuration },
+				{ "per-second", perSecond }
+			}
+		},
+		{ "failures", failed }
+	};
+}
+
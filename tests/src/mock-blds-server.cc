@@ -0,0 +1,512 @@
+/*! \file mock-blds-server.cc
+ *
+ * Implementation of the MockBldsServer class.
+ *
+ * (C) 2017 Benjamin Naecker bnaecker@stanford.edu
+ */
+
+#include "mock-blds-server.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* Parameters of the data source which may be set by clients. */
+static const QStringList SourceParameters = {
+	"adc-range", "trigger", "plug", "analog-output", "configuration-file",
+	"analog-output-begin", "analog-output-chunk", "analog-output-end",
+	"analog-output-channels"
+};
+
+/* Longest span of data which may be requested at once, in seconds. */
+static const double MaxDataSpan = 10.;
+
+/* Parameters which may not be changed while recording. */
+static const QStringList RecordingParameters = {
+	"save-file", "save-directory", "recording-length"
+};
+
+MockBldsServer::MockBldsServer(const Config& config, QObject* parent) :
+	QObject(parent),
+	settings(config),
+	generator(std::random_device{}()),
+	requests(0),
+	sourceExists(false),
+	recordingExists(false),
+	recordingLength(1000),
+	recordingEndPending(false),
+	saveDirectory(QDir::tempPath()),
+	saveFile("recording.h5"),
+	uploading(false),
+	uploadExpected(0),
+	uploadReceived(0)
+{
+	server = new QTcpServer(this);
+	QObject::connect(server, &QTcpServer::newConnection,
+			this, &MockBldsServer::acceptConnections);
+	pushTimer = new QTimer(this);
+	QObject::connect(pushTimer, &QTimer::timeout,
+			this, &MockBldsServer::pushStatus);
+	clock.start();
+}
+
+MockBldsServer::~MockBldsServer()
+{
+	server->close();
+}
+
+bool MockBldsServer::listen(quint16 port)
+{
+	return server->listen(QHostAddress::Any, port);
+}
+
+QString MockBldsServer::errorString() const
+{
+	return server->errorString();
+}
+
+MockBldsServer::Config MockBldsServer::config() const
+{
+	return settings;
+}
+
+void MockBldsServer::setConfig(const Config& config)
+{
+	settings = config;
+}
+
+qint64 MockBldsServer::requestCount() const
+{
+	return requests;
+}
+
+QByteArray MockBldsServer::encodeMessage(const QString& type,
+		const QVariantList& fields)
+{
+	QByteArray body = type.toUtf8() + '\n';
+	for (auto& field : fields) {
+		auto doc = QJsonDocument(QJsonArray{ QJsonValue::fromVariant(field) });
+		auto json = doc.toJson(QJsonDocument::Compact);
+
+		/* Strip the enclosing brackets, leaving the bare value. */
+		body += json.mid(1, json.size() - 2) + '\n';
+	}
+	quint32 size = qToBigEndian(static_cast<quint32>(body.size()));
+	return QByteArray(reinterpret_cast<const char*>(&size), sizeof(size)) + body;
+}
+
+bool MockBldsServer::decodeMessage(QByteArray& buffer, QString* type,
+		QVariantList* fields)
+{
+	quint32 size = 0;
+	if (static_cast<size_t>(buffer.size()) < sizeof(size))
+		return false;
+	std::memcpy(&size, buffer.constData(), sizeof(size));
+	size = qFromBigEndian(size);
+	if (static_cast<quint32>(buffer.size()) < sizeof(size) + size)
+		return false;
+
+	auto body = buffer.mid(sizeof(size), size);
+	buffer.remove(0, sizeof(size) + size);
+	auto lines = body.split('\n');
+	if (lines.last().isEmpty())
+		lines.removeLast();
+	if (lines.isEmpty())
+		return false;
+
+	*type = QString::fromUtf8(lines.takeFirst());
+	fields->clear();
+	for (auto& line : lines) {
+		auto doc = QJsonDocument::fromJson("[" + line + "]");
+		fields->append(doc.isArray() ? doc.array().at(0).toVariant() :
+				QVariant(QString::fromUtf8(line)));
+	}
+	return true;
+}
+
+void MockBldsServer::acceptConnections()
+{
+	while (server->hasPendingConnections()) {
+		auto socket = server->nextPendingConnection();
+		buffers.insert(socket, QByteArray());
+		QObject::connect(socket, &QTcpSocket::readyRead,
+				this, [this, socket]() -> void {
+					readRequests(socket);
+				});
+		QObject::connect(socket, &QTcpSocket::disconnected,
+				this, [this, socket]() -> void {
+					removeClient(socket);
+				});
+	}
+}
+
+void MockBldsServer::removeClient(QTcpSocket* socket)
+{
+	buffers.remove(socket);
+	lastReplyDue.remove(socket);
+	if (subscriptions.remove(socket))
+		updatePushTimer();
+	socket->deleteLater();
+}
+
+void MockBldsServer::readRequests(QTcpSocket* socket)
+{
+	auto& buffer = buffers[socket];
+	buffer.append(socket->readAll());
+
+	QString type;
+	QVariantList fields;
+	while (decodeMessage(buffer, &type, &fields)) {
+		requests++;
+		if (chance(settings.dropRate))
+			continue;
+		QList<QByteArray> replies;
+		auto error = injectedError(type, fields);
+		if (!error.isEmpty() && chance(settings.errorRate))
+			replies.append(error);
+		else
+			replies = handle(type, fields, socket);
+		for (auto& message : replies)
+			reply(socket, message);
+	}
+}
+
+QByteArray MockBldsServer::injectedError(const QString& type,
+		const QVariantList& fields)
+{
+	const QString msg = "Injected error";
+	if (type == "create-source")
+		return encodeMessage("source-created", { false, msg });
+	if (type == "delete-source")
+		return encodeMessage("source-deleted", { false, msg });
+	if (type == "start-recording")
+		return encodeMessage("recording-started", { false, msg });
+	if (type == "stop-recording")
+		return encodeMessage("recording-stopped", { false, msg });
+	if ((type == "get") || (type == "set") || (type == "set-source"))
+		return encodeMessage(type, { fields.value(0), false, msg });
+	if (type == "get-data")
+		return encodeMessage("data", { false, msg });
+	return QByteArray();
+}
+
+QList<QByteArray> MockBldsServer::handle(const QString& type,
+		const QVariantList& fields, QTcpSocket* socket)
+{
+	updateRecording();
+
+	if (type == "create-source") {
+		if (sourceExists)
+			return { encodeMessage("source-created",
+					{ false, "A data source already exists" }) };
+		sourceExists = true;
+		sourceType = fields.value(0).toString();
+		sourceLocation = fields.value(1).toString();
+		sourceParameters = QVariantMap {
+			{ "adc-range", 0.5 },
+			{ "trigger", "none" },
+			{ "has-analog-output", false },
+			{ "analog-output-channels", 1 },
+			{ "analog-output-sample-rate", 10000. },
+			{ "nchannels", 64 },
+			{ "sample-rate", 10000. }
+		};
+		if (sourceType == "hidens") {
+
+			/* A HiDens source reads out 126 electrodes at 20 kHz. */
+			sourceParameters.insert("plug", 0);
+			sourceParameters.insert("nchannels", 126);
+			sourceParameters.insert("sample-rate", 20000.);
+		}
+		return { encodeMessage("source-created", { true, QString() }) };
+
+	} else if (type == "delete-source") {
+		if (!sourceExists)
+			return { encodeMessage("source-deleted",
+					{ false, "There is no data source" }) };
+		if (recordingExists)
+			return { encodeMessage("source-deleted",
+					{ false, "Cannot delete the source while recording" }) };
+		sourceExists = false;
+		sourceParameters.clear();
+		return { encodeMessage("source-deleted", { true, QString() }) };
+
+	} else if (type == "start-recording") {
+		if (!sourceExists)
+			return { encodeMessage("recording-started",
+					{ false, "There is no data source" }) };
+		if (recordingExists)
+			return { encodeMessage("recording-started",
+					{ false, "A recording already exists" }) };
+		recordingExists = true;
+		recordingEndPending = false;
+		recordingTimer.start();
+		return { encodeMessage("recording-started", { true, QString() }) };
+
+	} else if (type == "stop-recording") {
+		if (!recordingExists)
+			return { encodeMessage("recording-stopped",
+					{ false, "There is no recording" }) };
+		recordingExists = false;
+		return { encodeMessage("recording-stopped", { true, QString() }) };
+
+	} else if (type == "get") {
+		return { handleGet(fields.value(0).toString()) };
+
+	} else if (type == "set") {
+		return { handleSet(fields.value(0).toString(), fields.value(1), socket) };
+
+	} else if (type == "set-source") {
+		return { handleSetSource(fields.value(0).toString(), fields.value(1)) };
+
+	} else if (type == "get-data") {
+		return { handleGetData(fields.value(0).toDouble(), fields.value(1).toDouble()) };
+
+	} else if (type == "server-status") {
+		return { encodeMessage("server-status", { serverStatus() }) };
+
+	} else if (type == "source-status") {
+		return { encodeMessage("source-status", { sourceExists, sourceStatus() }) };
+	}
+	return { encodeMessage("error", { "Unknown message type: " + type }) };
+}
+
+QByteArray MockBldsServer::handleGet(const QString& param)
+{
+	auto status = serverStatus();
+	if (status.contains(param))
+		return encodeMessage("get", { param, true, status.value(param).toVariant() });
+	return encodeMessage("get", { param, false, "Unknown parameter: " + param });
+}
+
+QByteArray MockBldsServer::handleSet(const QString& param,
+		const QVariant& value, QTcpSocket* socket)
+{
+	if ((param == "recording-status-subscription") && settings.acceptSubscriptions) {
+		auto interval = value.toInt();
+		if (interval > 0)
+			subscriptions.insert(socket, interval);
+		else
+			subscriptions.remove(socket);
+		updatePushTimer();
+		return encodeMessage("set", { param, true, QString() });
+	}
+	if (!RecordingParameters.contains(param))
+		return encodeMessage("set", { param, false, "Unknown parameter: " + param });
+	if (recordingExists)
+		return encodeMessage("set", { param, false,
+				"Cannot set " + param + " while recording" });
+
+	if (param == "save-file") {
+		saveFile = value.toString();
+	} else if (param == "save-directory") {
+		saveDirectory = value.toString();
+	} else {
+		if (value.toInt() <= 0)
+			return encodeMessage("set", { param, false,
+					"The recording length must be positive" });
+		recordingLength = value.toInt();
+	}
+	return encodeMessage("set", { param, true, QString() });
+}
+
+QByteArray MockBldsServer::handleSetSource(const QString& param,
+		const QVariant& value)
+{
+	if (!sourceExists)
+		return encodeMessage("set-source", { param, false, "There is no data source" });
+	if (!SourceParameters.contains(param))
+		return encodeMessage("set-source", { param, false,
+				"Unknown source parameter: " + param });
+	if (recordingExists)
+		return encodeMessage("set-source", { param, false,
+				"Cannot set " + param + " while recording" });
+
+	/* The analog output may be sent whole, or uploaded in chunks, and
+	 * must hold whole frames of the current number of channels.
+	 */
+	auto channels = sourceParameters.value("analog-output-channels", 1).toLongLong();
+	auto partialFrame = [param,channels]() -> QByteArray {
+		return encodeMessage("set-source", { param, false,
+				QString("The analog output must hold whole frames of "
+					"%1 channel(s)").arg(channels) });
+	};
+	if (param == "analog-output-channels") {
+		auto count = value.toLongLong();
+		if ((count < 1) || (count > 64))
+			return encodeMessage("set-source", { param, false,
+					"The analog output must have between 1 and 64 channels" });
+		sourceParameters.insert(param, count);
+	} else if (param == "analog-output") {
+		if (value.toList().size() % channels)
+			return partialFrame();
+		sourceParameters.insert("has-analog-output", !value.toList().isEmpty());
+	} else if (param == "analog-output-begin") {
+		if (value.toLongLong() % channels)
+			return partialFrame();
+		uploading = true;
+		uploadExpected = value.toLongLong();
+		uploadReceived = 0;
+	} else if (param == "analog-output-chunk") {
+		if (!uploading)
+			return encodeMessage("set-source", { param, false,
+					"No upload of the analog output has begun" });
+		uploadReceived += value.toList().size();
+	} else if (param == "analog-output-end") {
+		auto expected = value.toLongLong();
+		auto received = uploading ? uploadReceived : -1;
+		uploading = false;
+		if ((received != expected) || (expected != uploadExpected))
+			return encodeMessage("set-source", { param, false,
+					QString("Expected %1 samples of analog output, but "
+						"received %2").arg(expected).arg(received) });
+		sourceParameters.insert("has-analog-output", expected > 0);
+	} else {
+		sourceParameters.insert(param, value);
+	}
+	return encodeMessage("set-source", { param, true, QString() });
+}
+
+/* Return a pseudo-random number fixed by a channel and sample. */
+static quint32 sampleHash(quint32 channel, quint32 index)
+{
+	quint32 x = channel * 0x9e3779b9u ^ index * 0x85ebca6bu;
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+QByteArray MockBldsServer::handleGetData(double start, double stop)
+{
+	if (!recordingExists)
+		return encodeMessage("data", { false, "There is no recording" });
+	if ((start < 0) || (stop <= start) || (stop > recordingPosition()))
+		return encodeMessage("data", { false, "Requested data is not available" });
+	if (stop - start > MaxDataSpan)
+		return encodeMessage("data", { false, "Requested too much data at once" });
+
+	/* Send noise on every channel, with an occasional spike, which is
+	 * the same however the recording is split into requests.
+	 */
+	auto channels = sourceParameters.value("nchannels").toInt();
+	auto rate = sourceParameters.value("sample-rate").toDouble();
+	auto first = static_cast<qint64>(std::ceil(start * rate));
+	auto frames = static_cast<qint64>(std::ceil(stop * rate)) - first;
+	QVector<qint16> samples(static_cast<int>(channels * frames));
+	const int SpikeLength = 20;
+	for (int c = 0; c < channels; c++) {
+		auto x = samples.data() + c * frames;
+		for (qint64 i = 0; i < frames; i++) {
+			auto index = static_cast<quint32>(first + i);
+			auto noise = static_cast<int>(sampleHash(c, index) % 201) - 100;
+			auto phase = static_cast<int>(index % SpikeLength);
+			auto spike = (sampleHash(c, index / SpikeLength) % 400 == 0) ?
+					-150 * (SpikeLength / 2 - std::abs(phase - SpikeLength / 2)) : 0;
+			x[i] = static_cast<qint16>(noise + spike);
+		}
+	}
+	auto bytes = QByteArray(reinterpret_cast<const char*>(samples.constData()),
+			samples.size() * static_cast<int>(sizeof(qint16)));
+	return encodeMessage("data", { true, QString(), first / rate, (first + frames) / rate,
+			channels, frames, QString::fromLatin1(bytes.toBase64()) });
+}
+
+QJsonObject MockBldsServer::serverStatus()
+{
+	return QJsonObject {
+		{ "source-exists", sourceExists },
+		{ "source-type", sourceType },
+		{ "source-location", sourceLocation },
+		{ "recording-exists", recordingExists },
+		{ "recording-length", recordingLength },
+		{ "recording-position", recordingPosition() },
+		{ "save-directory", saveDirectory },
+		{ "save-file", saveFile },
+		{ "client-count", buffers.size() }
+	};
+}
+
+QJsonObject MockBldsServer::sourceStatus() const
+{
+	if (!sourceExists)
+		return QJsonObject();
+	auto status = QJsonObject::fromVariantMap(sourceParameters);
+	status.insert("source-type", sourceType);
+	status.insert("source-location", sourceLocation);
+	status.insert("state", recordingExists ? "streaming" : "idle");
+	return status;
+}
+
+double MockBldsServer::recordingPosition() const
+{
+	if (!recordingExists)
+		return 0.;
+	return qMin(recordingTimer.elapsed() / 1000., static_cast<double>(recordingLength));
+}
+
+void MockBldsServer::updateRecording()
+{
+	if (recordingExists && (recordingTimer.elapsed() >= recordingLength * 1000LL)) {
+		recordingExists = false;
+		recordingEndPending = true;
+	}
+}
+
+void MockBldsServer::updatePushTimer()
+{
+	if (subscriptions.isEmpty()) {
+		pushTimer->stop();
+		return;
+	}
+	auto intervals = subscriptions.values();
+	pushTimer->start(*std::min_element(intervals.cbegin(), intervals.cend()));
+}
+
+void MockBldsServer::pushStatus()
+{
+	if (!settings.pushUpdates)
+		return;
+	updateRecording();
+	QByteArray message;
+	if (recordingExists && settings.pushPosition) {
+		message = encodeMessage("get", { "recording-position", true,
+				recordingPosition() });
+	} else if (recordingExists) {
+		message = encodeMessage("get", { "recording-exists", true, true });
+	} else if (recordingEndPending) {
+		message = encodeMessage("get", { "recording-exists", true, false });
+		recordingEndPending = false;
+	} else {
+		return;
+	}
+	for (auto socket : subscriptions.keys())
+		reply(socket, message);
+}
+
+void MockBldsServer::reply(QTcpSocket* socket, const QByteArray& message)
+{
+	auto delay = settings.latency;
+	if (settings.jitter > 0) {
+		std::uniform_int_distribution<int> jitter(0, settings.jitter);
+		delay += jitter(generator);
+	}
+	auto now = clock.elapsed();
+	auto due = qMax(now + delay, lastReplyDue.value(socket, 0));
+	lastReplyDue.insert(socket, due);
+	QTimer::singleShot(static_cast<int>(due - now), socket,
+			[socket, message]() -> void {
+				socket->write(message);
+			});
+}
+
+bool MockBldsServer::chance(double probability)
+{
+	if (probability <= 0)
+		return false;
+	std::bernoulli_distribution draw(qMin(probability, 1.));
+	return draw(generator);
+}
+
@@ -0,0 +1,18 @@
+######################################################################
+# Settings shared by every test and tool in the tests directory.
+#
+# Each project includes this file, and lists only its own sources.
+# The parts of meactl under test are built from the sources in ../src.
+# Projects which talk to a BLDS include session.pri as well, which
+# brings in libblds-client.
+######################################################################
+
+MEACTL = $$PWD/..
+
+INCLUDEPATH += $$PWD/include \
+	$$MEACTL/include
+
+QT += network concurrent testlib
+QT -= gui
+CONFIG += c++11 console
+CONFIG -= app_bundle
@@ -0,0 +1,13 @@
+######################################################################
+# Tests and benchmarks of meactl, most run against a mock BLDS.
+#
+# Build with `qmake && make` in this directory, and run with
+# `make check`.
+######################################################################
+
+TEMPLATE = subdirs
+SUBDIRS = blds-client \
+		mock-server \
+		control-path \
+		recording-status-monitor \
+		spike-detector